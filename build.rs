@@ -1,5 +1,23 @@
+use std::fmt::Write as _;
 use std::fs;
-use std::path::Path;
+use std::io::Write as _;
+use std::path::{Path, PathBuf};
+
+use flate2::write::GzEncoder;
+use flate2::Compression;
+
+// Shared with the host benchmark crate, which renders the same templates
+mod build_templates;
+
+/// Static assets served from flash: (route, source, content type, cache policy).
+/// Pages that need runtime substitution (home, dashboard, OTA) stay dynamic.
+const STATIC_ASSETS: &[(&str, &str, &str, &str)] = &[
+    ("/graphs", "src/templates/graphs.html", "text/html; charset=utf-8", "no-cache"),
+    ("/dev", "src/templates/dev.html", "text/html; charset=utf-8", "no-cache"),
+    ("/logs", "src/templates/logs_enhanced.html", "text/html; charset=utf-8", "no-cache"),
+    ("/sw.js", "src/templates/sw.js", "application/javascript", "no-cache"),
+    ("/apple-touch-icon.png", "static/icons/apple-touch-icon.png", "image/png", "max-age=86400"),
+];
 
 fn main() -> anyhow::Result<()> {
     // Necessary for ESP-IDF
@@ -41,6 +59,61 @@ fn main() -> anyhow::Result<()> {
         println!("cargo:rustc-env=WIFI_PASSWORD=");
         println!("cargo:warning=wifi_config.h not found! Copy wifi_config.h.example to wifi_config.h and add your credentials.");
     }
+
+    embed_static_assets()?;
+    let manifest_dir = PathBuf::from(std::env::var("CARGO_MANIFEST_DIR")?);
+    let out_dir = PathBuf::from(std::env::var("OUT_DIR")?);
+    build_templates::compile_templates(&manifest_dir, &out_dir)
+        .map_err(|e| anyhow::anyhow!("compiling templates: {e}"))?;
     
     Ok(())
+}
+
+/// Gzip each static asset and write `$OUT_DIR/static_assets.rs`, a table of
+/// flash-resident byte slices with content-hash ETags
+fn embed_static_assets() -> anyhow::Result<()> {
+    let manifest_dir = PathBuf::from(std::env::var("CARGO_MANIFEST_DIR")?);
+    let out_dir = PathBuf::from(std::env::var("OUT_DIR")?);
+
+    let mut table = String::from("pub static ASSETS: &[Asset] = &[\n");
+    for (index, (route, source, content_type, cache_control)) in STATIC_ASSETS.iter().enumerate() {
+        let source_path = manifest_dir.join(source);
+        println!("cargo:rerun-if-changed={}", source_path.display());
+        let contents = fs::read(&source_path)?;
+        let hash = fnv1a64(&contents);
+
+        let mut encoder = GzEncoder::new(Vec::new(), Compression::best());
+        encoder.write_all(&contents)?;
+        let gzipped = encoder.finish()?;
+
+        // Already-compressed formats (PNG) don't shrink; serve those as-is
+        let gzip = if gzipped.len() < contents.len() {
+            let gzip_path = out_dir.join(format!("asset{index}.gz"));
+            fs::write(&gzip_path, &gzipped)?;
+            format!("Some(include_bytes!({:?}))", gzip_path.display().to_string())
+        } else {
+            "None".to_string()
+        };
+
+        // Strong validators must differ per encoding
+        let etag = format!("\"{hash:016x}\"");
+        let gzip_etag = format!("\"{hash:016x}-gz\"");
+        let identity = source_path.display().to_string();
+        writeln!(
+            table,
+            "    Asset {{ path: {route:?}, content_type: {content_type:?}, cache_control: {cache_control:?}, \
+             etag: {etag:?}, gzip_etag: {gzip_etag:?}, identity: include_bytes!({identity:?}), gzip: {gzip} }},"
+        )?;
+    }
+    table.push_str("];\n");
+
+    fs::write(out_dir.join("static_assets.rs"), table)?;
+    Ok(())
+}
+
+/// Content hash for ETags; stable across builds, no extra dependency
+fn fnv1a64(bytes: &[u8]) -> u64 {
+    bytes.iter().fold(0xcbf2_9ce4_8422_2325, |hash, &byte| {
+        (hash ^ byte as u64).wrapping_mul(0x0000_0100_0000_01b3)
+    })
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+// Template compiler for build scripts
+//
+// Used by build.rs and by host-tests/build.rs, so it sticks to std: the host
+// crate builds offline without the firmware's build dependencies.
+
+use std::fmt::Write as _;
+use std::fs;
+use std::path::Path;
+
+type Result<T> = std::result::Result<T, Box<dyn std::error::Error>>;
+
+/// Templates pre-parsed into segments for network::template_engine: (static name, source)
+pub const COMPILED_TEMPLATES: &[(&str, &str)] = &[
+    ("HOME", "src/templates/home_template.html"),
+];
+
+const PARTIALS_DIR: &str = "src/templates/partials";
+
+/// Parse each template once at build time and write `$OUT_DIR/templates.rs`.
+/// `{{>name}}` partials are inlined from PARTIALS_DIR, so at runtime a
+/// template is just literal text interleaved with `{{variable}}` names.
+pub fn compile_templates(manifest_dir: &Path, out_dir: &Path) -> Result<()> {
+    println!("cargo:rerun-if-changed={}", manifest_dir.join(PARTIALS_DIR).display());
+
+    let mut out = String::new();
+    for (name, source) in COMPILED_TEMPLATES {
+        let source_path = manifest_dir.join(source);
+        println!("cargo:rerun-if-changed={}", source_path.display());
+
+        let mut segments = Vec::new();
+        parse_template(manifest_dir, &fs::read_to_string(&source_path)?, &mut segments, 0)?;
+
+        writeln!(out, "pub static {name}: Template = Template {{ segments: &[")?;
+        for segment in &segments {
+            match segment {
+                ParsedSegment::Text(text) => writeln!(out, "    Segment::Text({text:?}),")?,
+                ParsedSegment::Var(var) => writeln!(out, "    Segment::Var({var:?}),")?,
+            }
+        }
+        writeln!(out, "] }};")?;
+    }
+
+    fs::write(out_dir.join("templates.rs"), out)?;
+    Ok(())
+}
+
+#[derive(Debug, PartialEq)]
+enum ParsedSegment {
+    Text(String),
+    Var(String),
+}
+
+fn parse_template(manifest_dir: &Path, template: &str, segments: &mut Vec<ParsedSegment>, depth: usize) -> Result<()> {
+    if depth >= 8 {
+        return Err("template partials nested too deeply".into());
+    }
+
+    let mut rest = template;
+    while let Some(start) = rest.find("{{") {
+        push_text(segments, &rest[..start]);
+        let Some(len) = rest[start + 2..].find("}}") else {
+            return Err("unterminated placeholder in template".into());
+        };
+        let tag = rest[start + 2..start + 2 + len].trim();
+        rest = &rest[start + 2 + len + 2..];
+
+        if let Some(partial) = tag.strip_prefix('>') {
+            let path = manifest_dir.join(PARTIALS_DIR).join(format!("{}.html", partial.trim()));
+            let contents = fs::read_to_string(&path)
+                .map_err(|e| format!("partial {}: {e}", path.display()))?;
+            parse_template(manifest_dir, &contents, segments, depth + 1)?;
+        } else {
+            segments.push(ParsedSegment::Var(tag.to_string()));
+        }
+    }
+    push_text(segments, rest);
+    Ok(())
+}
+
+/// Append literal text, merging it with a preceding literal
+fn push_text(segments: &mut Vec<ParsedSegment>, text: &str) {
+    if text.is_empty() {
+        return;
+    }
+    match segments.last_mut() {
+        Some(ParsedSegment::Text(previous)) => previous.push_str(text),
+        _ => segments.push(ParsedSegment::Text(text.to_string())),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::path::PathBuf;
+
+    /// Scratch manifest dir holding the given partials
+    fn manifest_with_partials(name: &str, partials: &[(&str, &str)]) -> PathBuf {
+        let dir = std::env::temp_dir().join(format!("build_templates_{}_{name}", std::process::id()));
+        let partials_dir = dir.join(PARTIALS_DIR);
+        fs::create_dir_all(&partials_dir).unwrap();
+        for (partial, contents) in partials {
+            fs::write(partials_dir.join(format!("{partial}.html")), contents).unwrap();
+        }
+        dir
+    }
+
+    fn text(s: &str) -> ParsedSegment {
+        ParsedSegment::Text(s.to_string())
+    }
+
+    fn var(s: &str) -> ParsedSegment {
+        ParsedSegment::Var(s.to_string())
+    }
+
+    #[test]
+    fn test_placeholders_split_literal_text() {
+        let mut segments = Vec::new();
+        parse_template(Path::new("."), "<p>{{ title }}</p>{{count}}{{count}}", &mut segments, 0).unwrap();
+        assert_eq!(segments, [text("<p>"), var("title"), text("</p>"), var("count"), var("count")]);
+
+        let mut segments = Vec::new();
+        assert!(parse_template(Path::new("."), "<p>{{title</p>", &mut segments, 0).is_err());
+    }
+
+    #[test]
+    fn test_partials_are_inlined_and_merged_with_surrounding_text() {
+        let dir = manifest_with_partials("inline", &[
+            ("nav", "<nav>{{>link}}</nav>"),
+            ("link", "<a class=\"{{ active }}\">"),
+            ("loop", "{{>loop}}"),
+        ]);
+
+        let mut segments = Vec::new();
+        parse_template(&dir, "<body>{{> nav }}{{content}}</body>", &mut segments, 0).unwrap();
+        assert_eq!(segments, [
+            text("<body><nav><a class=\""),
+            var("active"),
+            text("\"></nav>"),
+            var("content"),
+            text("</body>"),
+        ]);
+
+        let mut segments = Vec::new();
+        assert!(parse_template(&dir, "{{>missing}}", &mut segments, 0).is_err());
+        assert!(parse_template(&dir, "{{>loop}}", &mut segments, 0).is_err());
+        fs::remove_dir_all(dir).ok();
+    }
+}
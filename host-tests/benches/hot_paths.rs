@@ -0,0 +1,94 @@
+//! Host benchmarks for the firmware hot paths (suite in ../src/bench.rs)
+//!
+//!     cargo +stable bench --target <host triple> --bench hot_paths [-- <filter>]
+//!
+//! Results go to target/bench/hot_paths.json, or $BENCH_OUT. When
+//! $BENCH_BASELINE names an earlier results file, each median is compared
+//! against it and the run fails if any regressed by more than
+//! $BENCH_THRESHOLD percent (default 10). scripts/bench-host.sh keeps the
+//! previous run as the baseline.
+
+use esp32_dashboard_tests::bench::{self, BenchResult, Bencher, Config};
+use std::path::PathBuf;
+use std::process::ExitCode;
+
+const DEFAULT_THRESHOLD_PERCENT: f64 = 10.0;
+
+fn main() -> ExitCode {
+    // cargo passes --bench; anything else that isn't a flag is a name filter
+    let filter = std::env::args().skip(1).find(|arg| !arg.starts_with("--"));
+    let mut bencher = Bencher::new(Config::HOST).with_filter(filter);
+    bench::run_suite(&mut bencher);
+    let results = bencher.into_results();
+    for result in &results {
+        println!("{:<36} {:>12.1} ns/iter  (min {:.1}, max {:.1}, {} x {} iters)",
+                 result.name, result.median_ns, result.min_ns, result.max_ns,
+                 result.samples, result.iters_per_sample);
+    }
+
+    let out = std::env::var_os("BENCH_OUT").map(PathBuf::from).unwrap_or_else(|| {
+        PathBuf::from(env!("CARGO_MANIFEST_DIR")).join("target/bench/hot_paths.json")
+    });
+    if let Some(dir) = out.parent() {
+        let _ = std::fs::create_dir_all(dir);
+    }
+    if let Err(e) = std::fs::write(&out, bench::to_json(&results) + "\n") {
+        eprintln!("writing {}: {e}", out.display());
+        return ExitCode::FAILURE;
+    }
+    println!("\nResults written to {}", out.display());
+
+    let Some(baseline) = std::env::var_os("BENCH_BASELINE").map(PathBuf::from) else {
+        return ExitCode::SUCCESS;
+    };
+    let threshold = std::env::var("BENCH_THRESHOLD").ok()
+        .and_then(|v| v.parse().ok())
+        .unwrap_or(DEFAULT_THRESHOLD_PERCENT);
+    match std::fs::read_to_string(&baseline) {
+        Ok(text) => compare(&results, &text, threshold),
+        Err(e) => {
+            println!("No baseline at {} ({e}); nothing to compare", baseline.display());
+            ExitCode::SUCCESS
+        }
+    }
+}
+
+/// Print the change against `baseline` and fail on regressions over `threshold` percent
+fn compare(results: &[BenchResult], baseline: &str, threshold: f64) -> ExitCode {
+    let baseline: serde_json::Value = match serde_json::from_str(baseline) {
+        Ok(value) => value,
+        Err(e) => {
+            eprintln!("Baseline is not valid JSON: {e}");
+            return ExitCode::FAILURE;
+        }
+    };
+    let previous = |name: &str| {
+        baseline.as_array()?.iter()
+            .find(|entry| entry["name"] == name)?["median_ns"]
+            .as_f64()
+    };
+
+    println!("\n{:<36} {:>12} {:>12} {:>8}", "benchmark", "before ns", "after ns", "change");
+    let mut regressions = 0;
+    for result in results {
+        let Some(before) = previous(result.name) else {
+            println!("{:<36} {:>12} {:>12.1} {:>8}", result.name, "-", result.median_ns, "new");
+            continue;
+        };
+        let change = (result.median_ns - before) / before * 100.0;
+        let flag = if change > threshold {
+            regressions += 1;
+            "  REGRESSED"
+        } else {
+            ""
+        };
+        println!("{:<36} {:>12.1} {:>12.1} {:>+7.1}%{}", result.name, before, result.median_ns, change, flag);
+    }
+
+    if regressions > 0 {
+        eprintln!("\n{regressions} benchmark(s) regressed by more than {threshold}%");
+        ExitCode::FAILURE
+    } else {
+        ExitCode::SUCCESS
+    }
+}
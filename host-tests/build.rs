@@ -0,0 +1,15 @@
+// Compile the firmware's templates for network::template_engine with the same
+// code the firmware build uses
+use std::path::PathBuf;
+
+#[path = "../build_templates.rs"]
+mod build_templates;
+
+fn main() {
+    let manifest_dir = PathBuf::from(std::env::var("CARGO_MANIFEST_DIR").expect("CARGO_MANIFEST_DIR"));
+    let out_dir = PathBuf::from(std::env::var("OUT_DIR").expect("OUT_DIR"));
+    let firmware_dir = manifest_dir.parent().expect("host-tests lives inside the firmware crate");
+    if let Err(e) = build_templates::compile_templates(firmware_dir, &out_dir) {
+        panic!("compiling templates: {e}");
+    }
+}
@@ -0,0 +1,15 @@
+//! Host stand-in for the esp_idf_hal items firmware modules compiled into
+//! the host tests touch.
+
+pub mod cpu {
+    #[derive(Debug, Clone, Copy, PartialEq, Eq)]
+    pub enum Core {
+        Core0 = 0,
+        Core1 = 1,
+    }
+
+    /// Every host thread reports Core 0
+    pub fn core() -> Core {
+        Core::Core0
+    }
+}
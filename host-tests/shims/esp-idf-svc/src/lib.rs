@@ -0,0 +1,31 @@
+//! Host stand-in for esp_idf_svc::io, which re-exports embedded-io's
+//! blocking traits; same shape, so firmware code written against them builds
+//! here unchanged.
+
+pub mod io {
+    use core::fmt::Debug;
+
+    pub trait Error: Debug {}
+
+    impl Error for core::convert::Infallible {}
+
+    pub trait ErrorType {
+        type Error: Error;
+    }
+
+    pub trait Write: ErrorType {
+        fn write(&mut self, buf: &[u8]) -> Result<usize, Self::Error>;
+
+        fn flush(&mut self) -> Result<(), Self::Error>;
+
+        fn write_all(&mut self, mut buf: &[u8]) -> Result<(), Self::Error> {
+            while !buf.is_empty() {
+                match self.write(buf)? {
+                    0 => panic!("write() returned Ok(0)"),
+                    n => buf = &buf[n..],
+                }
+            }
+            Ok(())
+        }
+    }
+}
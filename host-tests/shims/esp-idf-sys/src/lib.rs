@@ -0,0 +1,45 @@
+//! Host stand-in for the esp-idf-sys items used by modules compiled into
+//! host-tests. Heap queries report a fixed, healthy heap.
+#![allow(non_snake_case, non_camel_case_types)]
+
+pub const MALLOC_CAP_INTERNAL: u32 = 1 << 11;
+pub const MALLOC_CAP_SPIRAM: u32 = 1 << 10;
+
+pub type TaskHandle_t = *mut core::ffi::c_void;
+
+const HEAP_SIZE: u32 = 320 * 1024;
+
+pub unsafe fn esp_get_free_heap_size() -> u32 {
+    HEAP_SIZE / 2
+}
+
+pub unsafe fn esp_get_minimum_free_heap_size() -> u32 {
+    HEAP_SIZE / 3
+}
+
+pub unsafe fn heap_caps_get_free_size(_caps: u32) -> usize {
+    (HEAP_SIZE / 2) as usize
+}
+
+pub unsafe fn heap_caps_get_largest_free_block(_caps: u32) -> usize {
+    (HEAP_SIZE / 4) as usize
+}
+
+pub unsafe fn esp_timer_get_time() -> i64 {
+    use std::sync::OnceLock;
+    use std::time::Instant;
+    static START: OnceLock<Instant> = OnceLock::new();
+    START.get_or_init(Instant::now).elapsed().as_micros() as i64
+}
+
+pub unsafe fn xTaskGetCurrentTaskHandle() -> TaskHandle_t {
+    // One "task" per thread: the address of a thread-local is unique per thread
+    thread_local!(static TASK: u8 = const { 0 });
+    TASK.with(|task| task as *const u8 as TaskHandle_t)
+}
+
+pub unsafe fn esp_random() -> u32 {
+    use std::collections::hash_map::RandomState;
+    use std::hash::BuildHasher;
+    RandomState::new().hash_one(0u32) as u32
+}
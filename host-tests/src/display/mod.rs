@@ -0,0 +1,7 @@
+// Pure display modules from ../src/display
+#[path = "../../../src/display/dirty_rect_manager.rs"]
+pub mod dirty_rect_manager;
+#[path = "../../../src/display/font5x7.rs"]
+pub mod font5x7;
+#[path = "../../../src/display/glyph_atlas.rs"]
+pub mod glyph_atlas;
@@ -0,0 +1,25 @@
+// Pure network modules from ../src/network
+#[path = "../../../src/network/binary_protocol.rs"]
+pub mod binary_protocol;
+#[path = "../../../src/network/template_engine.rs"]
+pub mod template_engine;
+
+/// The snapshot type from network/observability.rs; the route registry
+/// behind it needs httpd
+pub mod observability {
+    #[derive(Default, serde::Serialize, Clone)]
+    pub struct RouteSnapshot {
+        pub method: &'static str,
+        pub route: &'static str,
+        pub requests: u32,
+        pub errors: u32,
+        pub total_us: u64,
+        pub p50_us: u32,
+        pub p95_us: u32,
+        pub p99_us: u32,
+        pub max_us: u32,
+        pub bytes_sent: u32,
+        pub heap_delta_max: i32,
+        pub stack_low_water_bytes: u32,
+    }
+}
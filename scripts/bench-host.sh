@@ -0,0 +1,24 @@
+#!/bin/bash
+# Host benchmarks for the render, dirty-rect and encoding hot paths
+# Runs host-tests/benches/hot_paths.rs and compares against the previous run
+#
+# Usage: ./scripts/bench-host.sh [filter]
+#   BENCH_THRESHOLD=5 ./scripts/bench-host.sh     # fail on >5% median regressions
+#   BENCH_BASELINE=old.json ./scripts/bench-host.sh
+
+set -e
+
+cd "$(dirname "$0")/../host-tests"
+
+RESULTS_DIR="target/bench"
+RESULTS="$RESULTS_DIR/hot_paths.json"
+PREVIOUS="$RESULTS_DIR/hot_paths.prev.json"
+
+mkdir -p "$RESULTS_DIR"
+if [ -z "$BENCH_BASELINE" ] && [ -f "$RESULTS" ]; then
+    cp "$RESULTS" "$PREVIOUS"
+    export BENCH_BASELINE="$PREVIOUS"
+fi
+
+HOST_TARGET=$(rustc +stable --version --verbose | grep "host:" | cut -d' ' -f2)
+BENCH_OUT="$RESULTS" cargo +stable bench --target "$HOST_TARGET" --bench hot_paths -- "$@"
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""
+ESP32 OTA Image Packer
+Builds compressed or delta uploads for /ota/update (see src/ota/decoder.rs)
+
+  ota-pack.py id IMAGE               print the image's appended SHA-256
+  ota-pack.py deflate IMAGE OUT      zlib-compress IMAGE
+  ota-pack.py delta BASE IMAGE OUT   patch against BASE, then zlib-compress
+
+A delta only applies on a device running BASE: the device checks the
+X-OTA-Base-SHA256 header against its running image's appended SHA-256.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+PATCH_MAGIC = b"ESPD"
+PATCH_VERSION = 1
+OP_COPY, OP_INSERT, OP_END = 0x00, 0x01, 0x02
+
+# Match search: BASE is indexed every INDEX_STEP bytes by its next KEY_LEN
+# bytes; copies shorter than MIN_COPY cost more than the literals they replace
+KEY_LEN = 16
+INDEX_STEP = 4
+MIN_COPY = 24
+
+
+def image_id(image: bytes) -> str:
+    """The SHA-256 esptool appends to an app image, as the device reports it"""
+    digest = image[-32:]
+    if len(image) < 64 or hashlib.sha256(image[:-32]).digest() != digest:
+        sys.exit("error: image has no appended SHA-256 (build with esptool elf2image)")
+    return digest.hex()
+
+
+def build_patch(base: bytes, image: bytes) -> bytes:
+    """Greedy COPY/INSERT patch of IMAGE against BASE"""
+    index = {}
+    for offset in range(0, len(base) - KEY_LEN + 1, INDEX_STEP):
+        index.setdefault(base[offset:offset + KEY_LEN], offset)
+
+    ops = bytearray(PATCH_MAGIC + struct.pack("<B3xI", PATCH_VERSION, len(image)))
+    literal_start = 0
+    expected = None  # base offset that would continue the previous copy
+    pos = 0
+
+    def flush_literals(end):
+        if end > literal_start:
+            ops.extend(struct.pack("<BI", OP_INSERT, end - literal_start))
+            ops.extend(image[literal_start:end])
+
+    while pos + KEY_LEN <= len(image):
+        key = image[pos:pos + KEY_LEN]
+        candidates = [expected] if expected is not None else []
+        if key in index:
+            candidates.append(index[key])
+
+        best_offset, best_len = None, 0
+        for offset in candidates:
+            length = 0
+            limit = min(len(base) - offset, len(image) - pos)
+            while length < limit and base[offset + length] == image[pos + length]:
+                length += 1
+            if length > best_len:
+                best_offset, best_len = offset, length
+
+        if best_len >= MIN_COPY:
+            flush_literals(pos)
+            ops.extend(struct.pack("<BII", OP_COPY, best_offset, best_len))
+            pos += best_len
+            literal_start = pos
+            expected = best_offset + best_len
+        else:
+            pos += 1
+            if expected is not None:
+                expected += 1
+
+    flush_literals(len(image))
+    ops.append(OP_END)
+    return bytes(ops)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack OTA images for the ESP32-S3 dashboard")
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("id").add_argument("image")
+    deflate = sub.add_parser("deflate")
+    deflate.add_argument("image")
+    deflate.add_argument("out")
+    delta = sub.add_parser("delta")
+    delta.add_argument("base")
+    delta.add_argument("image")
+    delta.add_argument("out")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+
+    if args.command == "id":
+        print(image_id(image))
+        return
+
+    if args.command == "deflate":
+        payload = image
+    else:
+        with open(args.base, "rb") as f:
+            base = f.read()
+        payload = build_patch(base, image)
+        print(f"patch: {len(payload)} bytes before compression", file=sys.stderr)
+
+    packed = zlib.compress(payload, 9)
+    with open(args.out, "wb") as f:
+        f.write(packed)
+    print(f"{args.command}: {len(image)} -> {len(packed)} bytes "
+          f"({100 * len(packed) / len(image):.1f}%)", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
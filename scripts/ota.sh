@@ -14,6 +14,9 @@ NC='\033[0m' # No Color
 # Default values
 FIRMWARE="${FIRMWARE:-target/xtensa-esp32s3-espidf/release/esp32-s3-dashboard}"
 PORT="${PORT:-80}"  # OTA endpoint is on main server port 80
+OTA_ENCODING="${OTA_ENCODING:-auto}"  # auto, delta, deflate or identity
+OTA_CACHE="${OTA_CACHE:-.ota-cache}"  # images uploaded before, the bases for deltas
+PACKER="$(dirname "$0")/ota-pack.py"
 
 # Function to print colored output
 print_color() {
@@ -85,11 +88,35 @@ upload_firmware() {
     print_color "$BLUE" "🔐 Calculating SHA256..."
     local sha256=$(shasum -a 256 "$firmware" | cut -d' ' -f1)
     
+    # Pack the upload: a delta if the device runs an image we cached, else deflate
+    local encoding="identity"
+    local payload="$firmware"
+    local base_sha=""
+    local packed=""
+    if [ "$OTA_ENCODING" != "identity" ] && command -v python3 >/dev/null 2>&1; then
+        local running=$(curl -s "http://${ip}:${PORT}/api/ota/status" 2>/dev/null | grep -o '"running_image":"[0-9a-f]*"' | cut -d'"' -f4)
+        packed=$(mktemp)
+        print_color "$BLUE" "🗜️  Packing image..."
+        if [ "$OTA_ENCODING" != "deflate" ] && [ -n "$running" ] && [ -f "$OTA_CACHE/$running.bin" ]; then
+            python3 "$PACKER" delta "$OTA_CACHE/$running.bin" "$firmware" "$packed" && encoding="delta" && base_sha="$running"
+        elif [ "$OTA_ENCODING" != "delta" ]; then
+            python3 "$PACKER" deflate "$firmware" "$packed" && encoding="deflate"
+        fi
+        local packed_size=$(stat -f%z "$packed" 2>/dev/null || stat -c%s "$packed" 2>/dev/null)
+        if [ "$encoding" != "identity" ] && [ "$packed_size" -lt "$size" ]; then
+            payload="$packed"
+        else
+            encoding="identity"
+        fi
+    fi
+    local payload_size=$(stat -f%z "$payload" 2>/dev/null || stat -c%s "$payload" 2>/dev/null)
+    
     print_color "$BLUE" "\n📡 OTA Update Process"
     echo "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━"
     echo "📍 Target device: $ip"
     echo "📦 Firmware size: ${size_mb} MB ($size bytes)"
     echo "🔐 SHA256: ${sha256:0:16}...${sha256: -16}"
+    echo "🗜️  Upload: $encoding, $payload_size bytes"
     echo "🏷️  Current version: ${old_version:-unknown}"
     echo "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━"
     echo ""
@@ -108,10 +135,13 @@ upload_firmware() {
     
     # Upload with curl and capture response
     response=$(curl -X POST \
-        -H "Content-Length: $size" \
+        -H "Content-Length: $payload_size" \
         -H "X-OTA-Password: esp32" \
         -H "X-SHA256: $sha256" \
-        --data-binary "@$firmware" \
+        -H "X-OTA-Encoding: $encoding" \
+        -H "X-OTA-Image-Size: $size" \
+        ${base_sha:+-H "X-OTA-Base-SHA256: $base_sha"} \
+        --data-binary "@$payload" \
         --connect-timeout 5 \
         --max-time 60 \
         -w "\n|||HTTP_CODE:%{http_code}|||TIME:%{time_total}|||" \
@@ -126,6 +156,16 @@ upload_firmware() {
     upload_time=$(echo "$response" | grep -o "|||TIME:[0-9.]*|||" | sed 's/|||TIME://g' | sed 's/|||//g')
     body=$(echo "$response" | sed 's/|||HTTP_CODE:[0-9]*|||//g' | sed 's/|||TIME:[0-9.]*|||//g')
     
+    # Keep the image as the base for the next delta to this device
+    if [ "$http_code" = "200" ] && command -v python3 >/dev/null 2>&1; then
+        local image_id=$(python3 "$PACKER" id "$firmware" 2>/dev/null)
+        if [ -n "$image_id" ]; then
+            mkdir -p "$OTA_CACHE"
+            cp "$firmware" "$OTA_CACHE/$image_id.bin"
+        fi
+    fi
+    [ -n "$packed" ] && rm -f "$packed"
+    
     # Clean up temporary binary if we created one
     if [[ "$firmware" == *.bin ]] && [[ -f "${firmware%.bin}" ]]; then
         rm -f "$firmware"
@@ -191,6 +231,14 @@ upload_firmware() {
             if (( $(echo "$size_mb > 1.5" | bc -l) )); then
                 print_color "$RED" "   ⚠️  Firmware exceeds partition size!"
             fi
+        elif [ "$http_code" = "409" ]; then
+            print_color "$YELLOW" "📋 Diagnosis: Stale Delta Base"
+            echo "   • The device no longer runs the cached base image"
+            echo "   • Retry with: OTA_ENCODING=deflate $0 $ip"
+        elif [ "$http_code" = "415" ]; then
+            print_color "$YELLOW" "📋 Diagnosis: Encoding Not Supported"
+            echo "   • The device firmware predates compressed updates"
+            echo "   • Retry with: OTA_ENCODING=identity $0 $ip"
         elif [ "$http_code" = "401" ]; then
             print_color "$YELLOW" "📋 Diagnosis: Unauthorized"
             echo "   • Invalid OTA password"
@@ -432,6 +480,9 @@ case "${1:-help}" in
         echo "Environment variables:"
         echo "  FIRMWARE  Path to firmware file (default: target/xtensa-esp32s3-espidf/release/esp32-s3-dashboard)"
         echo "  PORT      Device HTTP port (default: 80)"
+        echo "  OTA_ENCODING  auto, delta, deflate or identity (default: auto - delta when"
+        echo "                the device runs a cached image, otherwise deflate)"
+        echo "  OTA_CACHE     Directory of uploaded images used as delta bases (default: .ota-cache)"
         ;;
     
     *)
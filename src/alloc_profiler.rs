@@ -0,0 +1,472 @@
+// Opt-in allocation profiler (cargo feature `alloc_profiler`)
+//
+// memory_diagnostics and psram report free/largest-block at a point in time,
+// which says the heap is shrinking but not who is holding it. With the
+// feature on, a tracking global allocator wraps the system allocator and
+// keeps, in fixed atomics:
+//   - allocation counts and live blocks per log2 size class
+//   - live and peak bytes per subsystem tag (display, http, sse, ws, logging, ota)
+//   - a sampled series of live/peak bytes and the largest free internal block
+// Each block carries its tag in a small header, so a free is charged back to
+// whoever allocated it even when another task releases it. Tags are set per
+// task with `scope()`; untagged allocations count as "other". The growth of
+// each tag since the first sample is the "top growth" list in /debug/stats,
+// which is what points a multi-day leak at a subsystem.
+//
+// Without the feature, `scope()` is a no-op and `snapshot()` returns None.
+
+use serde::Serialize;
+use std::marker::PhantomData;
+use std::sync::atomic::{AtomicU32, AtomicU8, AtomicUsize, Ordering};
+use std::sync::{Mutex, OnceLock};
+use std::time::Duration;
+use crate::ring_buffer::RingBuffer;
+
+pub const ENABLED: bool = cfg!(feature = "alloc_profiler");
+
+const SAMPLE_INTERVAL: Duration = Duration::from_secs(60);
+/// Samples kept: one day at one per minute would be 1440; an hour is enough
+/// to see the slope and keeps the series at a few KB
+const SERIES_LEN: usize = 60;
+const TOP_GROWTH: usize = 3;
+// Tasks that can hold a tag at once
+const TASK_SLOTS: usize = 16;
+
+/// Subsystem an allocation is charged to
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum Tag {
+    Other,
+    Display,
+    Http,
+    Sse,
+    Ws,
+    Logging,
+    Ota,
+}
+
+pub const TAG_COUNT: usize = 7;
+
+impl Tag {
+    pub const ALL: [Tag; TAG_COUNT] = [Tag::Other, Tag::Display, Tag::Http, Tag::Sse, Tag::Ws, Tag::Logging, Tag::Ota];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            Tag::Other => "other",
+            Tag::Display => "display",
+            Tag::Http => "http",
+            Tag::Sse => "sse",
+            Tag::Ws => "ws",
+            Tag::Logging => "logging",
+            Tag::Ota => "ota",
+        }
+    }
+
+    fn from_u8(value: u8) -> Tag {
+        Tag::ALL.get(value as usize).copied().unwrap_or(Tag::Other)
+    }
+
+    /// Tag for an HTTP route: streams and OTA are reported on their own
+    pub fn for_route(uri: &str) -> Tag {
+        if uri.starts_with("/sse") || uri == "/api/events" {
+            Tag::Sse
+        } else if uri.starts_with("/ws") {
+            Tag::Ws
+        } else if uri.starts_with("/ota") {
+            Tag::Ota
+        } else {
+            Tag::Http
+        }
+    }
+}
+
+// ---- Counters ----
+
+/// log2 size classes: <=16, <=32, ... <=16K, larger
+pub const CLASS_COUNT: usize = 12;
+pub const CLASS_LABELS: [&str; CLASS_COUNT] = [
+    "16", "32", "64", "128", "256", "512", "1024", "2048", "4096", "8192", "16384", "+Inf",
+];
+
+struct TagCounters {
+    live: AtomicU32,
+    peak: AtomicU32,
+    allocs: AtomicU32,
+}
+
+struct ClassCounters {
+    allocs: AtomicU32,
+    live: AtomicU32,
+}
+
+const TAG_ZERO: TagCounters = TagCounters { live: AtomicU32::new(0), peak: AtomicU32::new(0), allocs: AtomicU32::new(0) };
+const CLASS_ZERO: ClassCounters = ClassCounters { allocs: AtomicU32::new(0), live: AtomicU32::new(0) };
+
+static TAGS: [TagCounters; TAG_COUNT] = [TAG_ZERO; TAG_COUNT];
+static CLASSES: [ClassCounters; CLASS_COUNT] = [CLASS_ZERO; CLASS_COUNT];
+static LIVE_BYTES: AtomicU32 = AtomicU32::new(0);
+static PEAK_BYTES: AtomicU32 = AtomicU32::new(0);
+static FAILURES: AtomicU32 = AtomicU32::new(0);
+
+// ---- Per-task tags ----
+//
+// A fixed table of (task handle, tag). The allocator only reads the slot of
+// the task it runs on, and only that task writes it, so plain atomics do.
+
+const SLOT_FREE: AtomicUsize = AtomicUsize::new(0);
+const TAG_OTHER: AtomicU8 = AtomicU8::new(Tag::Other as u8);
+
+static TASK_HANDLES: [AtomicUsize; TASK_SLOTS] = [SLOT_FREE; TASK_SLOTS];
+static TASK_TAGS: [AtomicU8; TASK_SLOTS] = [TAG_OTHER; TASK_SLOTS];
+// Claimed slots; lets untagged code skip the table scan
+static ACTIVE_SLOTS: AtomicU32 = AtomicU32::new(0);
+
+fn current_task() -> usize {
+    unsafe { esp_idf_sys::xTaskGetCurrentTaskHandle() as usize }
+}
+
+fn task_slot(task: usize) -> Option<usize> {
+    TASK_HANDLES.iter().position(|handle| handle.load(Ordering::Relaxed) == task)
+}
+
+/// Charge this task's allocations to `tag` until the guard drops
+pub fn scope(tag: Tag) -> TagScope {
+    let mut guard = TagScope { slot: None, previous: Tag::Other, release: false, _task_bound: PhantomData };
+    if !ENABLED {
+        return guard;
+    }
+    let task = current_task();
+    if let Some(slot) = task_slot(task) {
+        // Nested scope: restore the outer tag on drop
+        guard.previous = Tag::from_u8(TASK_TAGS[slot].swap(tag as u8, Ordering::Relaxed));
+        guard.slot = Some(slot);
+        return guard;
+    }
+    for (slot, handle) in TASK_HANDLES.iter().enumerate() {
+        if handle.compare_exchange(0, task, Ordering::Relaxed, Ordering::Relaxed).is_ok() {
+            TASK_TAGS[slot].store(tag as u8, Ordering::Relaxed);
+            ACTIVE_SLOTS.fetch_add(1, Ordering::Relaxed);
+            guard.slot = Some(slot);
+            guard.release = true;
+            return guard;
+        }
+    }
+    // Table full: this task stays untagged
+    guard
+}
+
+pub struct TagScope {
+    slot: Option<usize>,
+    previous: Tag,
+    release: bool,
+    // The slot belongs to the task that opened the scope
+    _task_bound: PhantomData<*const ()>,
+}
+
+impl Drop for TagScope {
+    fn drop(&mut self) {
+        let Some(slot) = self.slot else { return };
+        if self.release {
+            TASK_HANDLES[slot].store(0, Ordering::Relaxed);
+            ACTIVE_SLOTS.fetch_sub(1, Ordering::Relaxed);
+        } else {
+            TASK_TAGS[slot].store(self.previous as u8, Ordering::Relaxed);
+        }
+    }
+}
+
+// ---- Allocator ----
+
+#[cfg(feature = "alloc_profiler")]
+mod allocator {
+    use super::*;
+    use std::alloc::{GlobalAlloc, Layout, System};
+
+    // Bytes in front of every block; at least the block's alignment
+    const HEADER: usize = 8;
+
+    pub(super) fn size_class(size: usize) -> usize {
+        ((usize::BITS - size.saturating_sub(1).leading_zeros()) as usize)
+            .saturating_sub(4)
+            .min(CLASS_COUNT - 1)
+    }
+
+    fn record_alloc(tag: Tag, size: usize) {
+        let size = size as u32;
+        let counters = &TAGS[tag as usize];
+        let live = counters.live.fetch_add(size, Ordering::Relaxed).wrapping_add(size);
+        counters.peak.fetch_max(live, Ordering::Relaxed);
+        counters.allocs.fetch_add(1, Ordering::Relaxed);
+        let total = LIVE_BYTES.fetch_add(size, Ordering::Relaxed).wrapping_add(size);
+        PEAK_BYTES.fetch_max(total, Ordering::Relaxed);
+        let class = &CLASSES[size_class(size as usize)];
+        class.allocs.fetch_add(1, Ordering::Relaxed);
+        class.live.fetch_add(1, Ordering::Relaxed);
+    }
+
+    fn record_free(tag: Tag, size: usize) {
+        let size = size as u32;
+        TAGS[tag as usize].live.fetch_sub(size, Ordering::Relaxed);
+        LIVE_BYTES.fetch_sub(size, Ordering::Relaxed);
+        CLASSES[size_class(size as usize)].live.fetch_sub(1, Ordering::Relaxed);
+    }
+
+    fn current_tag() -> Tag {
+        if ACTIVE_SLOTS.load(Ordering::Relaxed) == 0 {
+            return Tag::Other;
+        }
+        match task_slot(current_task()) {
+            Some(slot) => Tag::from_u8(TASK_TAGS[slot].load(Ordering::Relaxed)),
+            None => Tag::Other,
+        }
+    }
+
+    struct TrackingAllocator;
+
+    #[global_allocator]
+    static ALLOCATOR: TrackingAllocator = TrackingAllocator;
+
+    fn header_size(layout: &Layout) -> usize {
+        layout.align().max(HEADER)
+    }
+
+    /// Layout of the block including its header
+    fn outer_layout(layout: &Layout, size: usize) -> Option<Layout> {
+        Layout::from_size_align(size.checked_add(header_size(layout))?, layout.align()).ok()
+    }
+
+    impl TrackingAllocator {
+        unsafe fn finish_alloc(&self, base: *mut u8, layout: &Layout) -> *mut u8 {
+            if base.is_null() {
+                FAILURES.fetch_add(1, Ordering::Relaxed);
+                return base;
+            }
+            let tag = current_tag();
+            let ptr = base.add(header_size(layout));
+            ptr.sub(1).write(tag as u8);
+            record_alloc(tag, layout.size());
+            ptr
+        }
+    }
+
+    unsafe impl GlobalAlloc for TrackingAllocator {
+        unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+            match outer_layout(&layout, layout.size()) {
+                Some(outer) => self.finish_alloc(System.alloc(outer), &layout),
+                None => core::ptr::null_mut(),
+            }
+        }
+
+        unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+            match outer_layout(&layout, layout.size()) {
+                Some(outer) => self.finish_alloc(System.alloc_zeroed(outer), &layout),
+                None => core::ptr::null_mut(),
+            }
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+            let tag = Tag::from_u8(ptr.sub(1).read());
+            record_free(tag, layout.size());
+            let outer = Layout::from_size_align_unchecked(layout.size() + header_size(&layout), layout.align());
+            System.dealloc(ptr.sub(header_size(&layout)), outer);
+        }
+
+        unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+            let header = header_size(&layout);
+            let Some(new_outer) = outer_layout(&layout, new_size) else {
+                return core::ptr::null_mut();
+            };
+            let outer = Layout::from_size_align_unchecked(layout.size() + header, layout.align());
+            // The header moves with the block, so the original tag is kept
+            let tag = Tag::from_u8(ptr.sub(1).read());
+            let base = System.realloc(ptr.sub(header), outer, new_outer.size());
+            if base.is_null() {
+                FAILURES.fetch_add(1, Ordering::Relaxed);
+                return base;
+            }
+            record_free(tag, layout.size());
+            record_alloc(tag, new_size);
+            base.add(header)
+        }
+    }
+}
+
+// ---- Time series ----
+
+#[derive(Debug, Clone, Copy, Default, Serialize)]
+pub struct Sample {
+    pub uptime_s: u32,
+    pub live_bytes: u32,
+    pub peak_bytes: u32,
+    pub free_internal: u32,
+    pub largest_free_internal: u32,
+    pub free_psram: u32,
+    #[serde(skip)]
+    by_tag: [u32; TAG_COUNT],
+}
+
+static SERIES: OnceLock<Mutex<RingBuffer<Sample, SERIES_LEN>>> = OnceLock::new();
+// First sample after start_sampler; growth is measured from here
+static BASELINE: OnceLock<Sample> = OnceLock::new();
+
+fn series() -> &'static Mutex<RingBuffer<Sample, SERIES_LEN>> {
+    SERIES.get_or_init(|| Mutex::new(RingBuffer::new()))
+}
+
+fn take_sample() -> Sample {
+    use esp_idf_sys::{heap_caps_get_free_size, heap_caps_get_largest_free_block, MALLOC_CAP_INTERNAL, MALLOC_CAP_SPIRAM};
+    let mut by_tag = [0; TAG_COUNT];
+    for (live, counters) in by_tag.iter_mut().zip(TAGS.iter()) {
+        *live = counters.live.load(Ordering::Relaxed);
+    }
+    unsafe {
+        Sample {
+            uptime_s: (esp_idf_sys::esp_timer_get_time() / 1_000_000) as u32,
+            live_bytes: LIVE_BYTES.load(Ordering::Relaxed),
+            peak_bytes: PEAK_BYTES.load(Ordering::Relaxed),
+            free_internal: heap_caps_get_free_size(MALLOC_CAP_INTERNAL as u32) as u32,
+            largest_free_internal: heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL as u32) as u32,
+            free_psram: heap_caps_get_free_size(MALLOC_CAP_SPIRAM as u32) as u32,
+            by_tag,
+        }
+    }
+}
+
+/// Start the once-a-minute sampler (no-op without the feature)
+pub fn start_sampler() {
+    if !ENABLED {
+        return;
+    }
+    let spawned = std::thread::Builder::new()
+        .name("alloc-prof".to_string())
+        .stack_size(3072)
+        .spawn(|| loop {
+            let sample = take_sample();
+            let _ = BASELINE.set(sample);
+            series().lock().unwrap_or_else(|p| p.into_inner()).push(sample);
+            std::thread::sleep(SAMPLE_INTERVAL);
+        });
+    match spawned {
+        Ok(_) => log::info!("Allocation profiler: sampling every {} s", SAMPLE_INTERVAL.as_secs()),
+        Err(e) => log::warn!("Allocation profiler: sampler not started: {}", e),
+    }
+}
+
+// ---- Snapshot ----
+
+#[derive(Debug, Clone, Serialize)]
+pub struct TagUsage {
+    pub tag: &'static str,
+    pub live_bytes: u32,
+    pub peak_bytes: u32,
+    pub allocations: u32,
+}
+
+#[derive(Debug, Clone, Serialize)]
+pub struct SizeClass {
+    /// Upper bound of the class in bytes
+    pub size: &'static str,
+    pub allocations: u32,
+    pub live: u32,
+}
+
+#[derive(Debug, Clone, Serialize)]
+pub struct Growth {
+    pub tag: &'static str,
+    /// Live bytes gained since the first sample
+    pub since_baseline: i32,
+    /// Live bytes gained across the sampled series
+    pub over_series: i32,
+}
+
+#[derive(Debug, Clone, Serialize)]
+pub struct AllocProfile {
+    pub live_bytes: u32,
+    pub peak_bytes: u32,
+    pub failures: u32,
+    pub largest_free_internal: u32,
+    pub tags: Vec<TagUsage>,
+    pub size_classes: Vec<SizeClass>,
+    pub top_growth: Vec<Growth>,
+    pub series: Vec<Sample>,
+}
+
+/// Current profile, or None when the profiler is compiled out
+pub fn snapshot() -> Option<AllocProfile> {
+    if !ENABLED {
+        return None;
+    }
+    let now = take_sample();
+    let series: Vec<Sample> = series().lock().unwrap_or_else(|p| p.into_inner()).iter().copied().collect();
+    let oldest = series.first().copied().unwrap_or(now);
+    let baseline = BASELINE.get().copied().unwrap_or(oldest);
+
+    let tags = Tag::ALL.iter().zip(TAGS.iter()).map(|(tag, counters)| TagUsage {
+        tag: tag.name(),
+        live_bytes: counters.live.load(Ordering::Relaxed),
+        peak_bytes: counters.peak.load(Ordering::Relaxed),
+        allocations: counters.allocs.load(Ordering::Relaxed),
+    }).collect();
+    let size_classes = CLASS_LABELS.iter().zip(CLASSES.iter()).map(|(size, counters)| SizeClass {
+        size,
+        allocations: counters.allocs.load(Ordering::Relaxed),
+        live: counters.live.load(Ordering::Relaxed),
+    }).collect();
+
+    Some(AllocProfile {
+        live_bytes: now.live_bytes,
+        peak_bytes: now.peak_bytes,
+        failures: FAILURES.load(Ordering::Relaxed),
+        largest_free_internal: now.largest_free_internal,
+        tags,
+        size_classes,
+        top_growth: top_growth(&baseline, &oldest, &now),
+        series,
+    })
+}
+
+/// Tags whose live bytes grew the most since `baseline`
+fn top_growth(baseline: &Sample, oldest: &Sample, now: &Sample) -> Vec<Growth> {
+    let mut growth: Vec<Growth> = Tag::ALL.iter().enumerate().map(|(i, tag)| Growth {
+        tag: tag.name(),
+        since_baseline: now.by_tag[i].wrapping_sub(baseline.by_tag[i]) as i32,
+        over_series: now.by_tag[i].wrapping_sub(oldest.by_tag[i]) as i32,
+    }).filter(|g| g.since_baseline > 0).collect();
+    growth.sort_by(|a, b| b.since_baseline.cmp(&a.since_baseline));
+    growth.truncate(TOP_GROWTH);
+    growth
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[cfg(feature = "alloc_profiler")]
+    #[test]
+    fn test_size_classes_are_log2() {
+        use super::allocator::size_class;
+        assert_eq!(size_class(0), 0);
+        assert_eq!(size_class(16), 0);
+        assert_eq!(size_class(17), 1);
+        assert_eq!(size_class(1024), 6);
+        assert_eq!(size_class(16 * 1024), 10);
+        assert_eq!(size_class(1 << 20), CLASS_COUNT - 1);
+    }
+
+    #[test]
+    fn test_routes_map_to_tags() {
+        assert_eq!(Tag::for_route("/sse/logs"), Tag::Sse);
+        assert_eq!(Tag::for_route("/ota/update"), Tag::Ota);
+        assert_eq!(Tag::for_route("/api/config"), Tag::Http);
+    }
+
+    #[test]
+    fn test_growth_is_ranked_and_positive_only() {
+        let sample = |by_tag: [u32; TAG_COUNT]| Sample { by_tag, ..Default::default() };
+        let baseline = sample([100, 100, 100, 100, 0, 0, 0]);
+        let now = sample([90, 400, 150, 100, 0, 10, 0]);
+        let growth = top_growth(&baseline, &baseline, &now);
+        let tags: Vec<_> = growth.iter().map(|g| (g.tag, g.since_baseline)).collect();
+        assert_eq!(tags, [("display", 300), ("http", 50), ("logging", 10)]);
+    }
+}
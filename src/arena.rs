@@ -0,0 +1,303 @@
+// Per-response arenas and fixed slot pools for the HTTP paths
+//
+// Handlers used to serialize every response into a fresh String and hand it
+// to the socket: thousands of short-lived, odd-sized blocks a day, which is
+// what fragments the internal heap until the SSE heap gate starts rejecting
+// clients. Instead a handful of fixed arenas is carved out once (from PSRAM
+// when present) and leased per response. The serializer appends into the
+// lease, the body is written out, and dropping the lease rewinds the arena,
+// so steady-state responses allocate nothing. A body that outgrows its arena
+// spills into an ordinary Vec and is counted, which shows in /debug/stats
+// when ARENA_SIZE needs to grow.
+//
+// SlotPool is the fixed counterpart for per-connection state: N slots
+// allocated up front, claimed and released without touching the heap.
+
+use serde::Serialize;
+use std::io;
+use std::sync::atomic::{AtomicU32, Ordering};
+use std::sync::{Mutex, MutexGuard, OnceLock};
+use crate::psram::PsramAllocator;
+
+/// Leases that can be live at once: the httpd task, the executor workers
+/// and a couple of streaming threads
+pub const ARENA_COUNT: usize = 6;
+/// Bytes per arena in PSRAM; internal RAM gets the smaller size
+pub const ARENA_SIZE: usize = 16 * 1024;
+const ARENA_SIZE_INTERNAL: usize = 4 * 1024;
+
+static POOL: OnceLock<ArenaPool> = OnceLock::new();
+
+fn pool() -> &'static ArenaPool {
+    POOL.get_or_init(ArenaPool::allocate)
+}
+
+/// Lease an arena for one response
+pub fn lease() -> Lease<'static> {
+    pool().lease()
+}
+
+/// Serialize `value` as JSON into a leased arena
+pub fn to_json<T: Serialize + ?Sized>(value: &T) -> serde_json::Result<Lease<'static>> {
+    let mut lease = lease();
+    serde_json::to_writer(&mut lease, value)?;
+    Ok(lease)
+}
+
+#[derive(Debug, Default, Clone, Serialize)]
+pub struct ArenaStats {
+    pub arenas: u32,
+    pub arena_size: u32,
+    pub in_psram: bool,
+    pub leases: u32,
+    /// Leases that found every arena busy and went to the heap
+    pub exhausted: u32,
+    /// Bodies that outgrew their arena
+    pub spills: u32,
+    pub high_water: u32,
+}
+
+pub fn stats() -> ArenaStats {
+    POOL.get().map(ArenaPool::stats).unwrap_or_default()
+}
+
+pub struct ArenaPool {
+    base: *mut u8,
+    arena_size: usize,
+    count: usize,
+    in_psram: bool,
+    // Bit n set while arena n is leased
+    busy: AtomicU32,
+    leases: AtomicU32,
+    exhausted: AtomicU32,
+    spills: AtomicU32,
+    high_water: AtomicU32,
+}
+
+// Each arena is only touched through the lease that owns its busy bit
+unsafe impl Send for ArenaPool {}
+unsafe impl Sync for ArenaPool {}
+
+impl ArenaPool {
+    fn allocate() -> Self {
+        if PsramAllocator::is_available() {
+            let base = unsafe {
+                esp_idf_sys::heap_caps_malloc(ARENA_COUNT * ARENA_SIZE, esp_idf_sys::MALLOC_CAP_SPIRAM)
+            } as *mut u8;
+            if !base.is_null() {
+                log::info!("Response arenas: {} x {} KB in PSRAM", ARENA_COUNT, ARENA_SIZE / 1024);
+                return Self::new(base, ARENA_SIZE, ARENA_COUNT, true);
+            }
+        }
+        log::warn!("Response arenas: PSRAM unavailable, {} x {} KB internal", ARENA_COUNT, ARENA_SIZE_INTERNAL / 1024);
+        let buffer = vec![0u8; ARENA_COUNT * ARENA_SIZE_INTERNAL].leak();
+        Self::new(buffer.as_mut_ptr(), ARENA_SIZE_INTERNAL, ARENA_COUNT, false)
+    }
+
+    fn new(base: *mut u8, arena_size: usize, count: usize, in_psram: bool) -> Self {
+        assert!(count <= 32);
+        Self {
+            base,
+            arena_size,
+            count,
+            in_psram,
+            busy: AtomicU32::new(0),
+            leases: AtomicU32::new(0),
+            exhausted: AtomicU32::new(0),
+            spills: AtomicU32::new(0),
+            high_water: AtomicU32::new(0),
+        }
+    }
+
+    pub fn lease(&self) -> Lease<'_> {
+        self.leases.fetch_add(1, Ordering::Relaxed);
+        let all = if self.count == 32 { u32::MAX } else { (1u32 << self.count) - 1 };
+        let mut busy = self.busy.load(Ordering::Relaxed);
+        loop {
+            let free = !busy & all;
+            if free == 0 {
+                self.exhausted.fetch_add(1, Ordering::Relaxed);
+                return Lease { pool: self, index: None, len: 0, spill: Vec::new() };
+            }
+            let index = free.trailing_zeros() as usize;
+            match self.busy.compare_exchange_weak(busy, busy | 1 << index, Ordering::Acquire, Ordering::Relaxed) {
+                Ok(_) => return Lease { pool: self, index: Some(index), len: 0, spill: Vec::new() },
+                Err(current) => busy = current,
+            }
+        }
+    }
+
+    fn arena(&self, index: usize) -> *mut u8 {
+        unsafe { self.base.add(index * self.arena_size) }
+    }
+
+    fn stats(&self) -> ArenaStats {
+        ArenaStats {
+            arenas: self.count as u32,
+            arena_size: self.arena_size as u32,
+            in_psram: self.in_psram,
+            leases: self.leases.load(Ordering::Relaxed),
+            exhausted: self.exhausted.load(Ordering::Relaxed),
+            spills: self.spills.load(Ordering::Relaxed),
+            high_water: self.high_water.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// One response's worth of arena; bytes go in through io::Write or
+/// fmt::Write and come out through as_bytes
+pub struct Lease<'a> {
+    pool: &'a ArenaPool,
+    index: Option<usize>,
+    len: usize,
+    // Used once the body no longer fits (or no arena was free)
+    spill: Vec<u8>,
+}
+
+impl Lease<'_> {
+    pub fn as_bytes(&self) -> &[u8] {
+        match self.index {
+            Some(index) if self.spill.is_empty() => unsafe {
+                std::slice::from_raw_parts(self.pool.arena(index), self.len)
+            },
+            _ => &self.spill,
+        }
+    }
+
+    fn append(&mut self, bytes: &[u8]) {
+        match self.index {
+            Some(index) if self.spill.is_empty() => {
+                if self.len + bytes.len() <= self.pool.arena_size {
+                    unsafe {
+                        std::ptr::copy_nonoverlapping(bytes.as_ptr(), self.pool.arena(index).add(self.len), bytes.len());
+                    }
+                    self.len += bytes.len();
+                    return;
+                }
+                self.pool.spills.fetch_add(1, Ordering::Relaxed);
+                let mut spill = Vec::with_capacity((self.len + bytes.len()).next_power_of_two());
+                spill.extend_from_slice(unsafe { std::slice::from_raw_parts(self.pool.arena(index), self.len) });
+                self.spill = spill;
+                self.spill.extend_from_slice(bytes);
+            }
+            _ => self.spill.extend_from_slice(bytes),
+        }
+    }
+}
+
+impl io::Write for Lease<'_> {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        self.append(buf);
+        Ok(buf.len())
+    }
+
+    fn write_all(&mut self, buf: &[u8]) -> io::Result<()> {
+        self.append(buf);
+        Ok(())
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+}
+
+impl std::fmt::Write for Lease<'_> {
+    fn write_str(&mut self, s: &str) -> std::fmt::Result {
+        self.append(s.as_bytes());
+        Ok(())
+    }
+}
+
+impl Drop for Lease<'_> {
+    fn drop(&mut self) {
+        if let Some(index) = self.index {
+            self.pool.high_water.fetch_max(self.as_bytes().len() as u32, Ordering::Relaxed);
+            self.pool.busy.fetch_and(!(1 << index), Ordering::Release);
+        }
+    }
+}
+
+/// N fixed slots for per-connection state
+pub struct SlotPool<T, const N: usize> {
+    slots: Mutex<[Option<T>; N]>,
+}
+
+impl<T, const N: usize> SlotPool<T, N> {
+    pub fn new() -> Self {
+        Self { slots: Mutex::new(core::array::from_fn(|_| None)) }
+    }
+
+    fn slots(&self) -> MutexGuard<'_, [Option<T>; N]> {
+        self.slots.lock().unwrap_or_else(|poisoned| poisoned.into_inner())
+    }
+
+    /// Claim a free slot; hands the value back if the pool is full
+    pub fn insert(&self, value: T) -> Result<usize, T> {
+        let mut slots = self.slots();
+        match slots.iter().position(Option::is_none) {
+            Some(index) => {
+                slots[index] = Some(value);
+                Ok(index)
+            }
+            None => Err(value),
+        }
+    }
+
+    /// Free the first slot matching `pred`; returns what it held
+    pub fn remove_where(&self, pred: impl Fn(&T) -> bool) -> Option<T> {
+        let mut slots = self.slots();
+        let slot = slots.iter_mut().find(|slot| slot.as_ref().is_some_and(&pred))?;
+        slot.take()
+    }
+
+    pub fn len(&self) -> usize {
+        self.slots().iter().filter(|slot| slot.is_some()).count()
+    }
+}
+
+impl<T, const N: usize> Default for SlotPool<T, N> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::Write;
+
+    fn test_pool(arena_size: usize, count: usize) -> ArenaPool {
+        let buffer = vec![0u8; arena_size * count].leak();
+        ArenaPool::new(buffer.as_mut_ptr(), arena_size, count, false)
+    }
+
+    #[test]
+    fn test_leases_rewind_and_spill_when_full() {
+        let pool = test_pool(8, 1);
+        {
+            let mut lease = pool.lease();
+            lease.write_all(b"abcd").unwrap();
+            assert_eq!(lease.as_bytes(), b"abcd");
+            // Only arena is taken: the second lease goes to the heap
+            let mut other = pool.lease();
+            other.write_all(b"xyz").unwrap();
+            assert_eq!(other.as_bytes(), b"xyz");
+            lease.write_all(b"efghij").unwrap();
+            assert_eq!(lease.as_bytes(), b"abcdefghij");
+        }
+        let stats = pool.stats();
+        assert_eq!((stats.leases, stats.exhausted, stats.spills), (2, 1, 1));
+        // Released on drop
+        assert!(pool.lease().index.is_some());
+    }
+
+    #[test]
+    fn test_slot_pool_is_bounded() {
+        let pool: SlotPool<u32, 2> = SlotPool::new();
+        assert_eq!(pool.insert(1), Ok(0));
+        assert_eq!(pool.insert(3), Ok(1));
+        assert_eq!(pool.insert(4), Err(4));
+        assert_eq!(pool.remove_where(|&v| v == 1), Some(1));
+        assert_eq!(pool.len(), 1);
+    }
+}
@@ -0,0 +1,363 @@
+// Micro-benchmarks for the render, dirty-rect and encoding hot paths
+//
+// The same suite runs in two places. host-tests/benches/hot_paths.rs builds
+// these sources for the development machine and writes the results to a JSON
+// file, so a regression shows up in a diff before anything is flashed. On
+// the device, the `bench` feature runs it once after boot (see
+// feature_gates::start_benchmarks) and logs the same JSON, which is what the
+// host numbers have to be checked against: caches, PSRAM and flash wait
+// states change the ranking more than the host can show.
+//
+// Measurement is criterion-style but dependency-free: a warm-up estimates
+// the cost of one iteration, then `samples` batches sized to fill the
+// measurement window are timed, and each batch is reduced to ns/iteration.
+// Only std is used, so the kernels build unchanged on both targets.
+
+use serde::Serialize;
+use std::hint::black_box;
+use std::time::{Duration, Instant};
+
+use crate::display::dirty_rect_manager::DirtyRectManager;
+use crate::display::font5x7::{FONT_HEIGHT, FONT_WIDTH};
+use crate::display::glyph_atlas::GlyphAtlas;
+use crate::metrics::MetricsData;
+use crate::metrics_formatter::{Exposition, MetricsEncoder};
+use crate::network::binary_protocol::{self, MetricsBinaryPacket};
+use crate::network::observability::RouteSnapshot;
+use crate::network::template_engine;
+use crate::ring_buffer::{DurationRingBuffer, RingBuffer};
+
+#[derive(Debug, Clone, Copy)]
+pub struct Config {
+    pub warm_up: Duration,
+    pub measurement: Duration,
+    pub samples: u32,
+    /// Sleep after each benchmark so lower-priority tasks get the core back
+    pub pause: Duration,
+}
+
+impl Config {
+    pub const HOST: Config = Config {
+        warm_up: Duration::from_millis(300),
+        measurement: Duration::from_secs(1),
+        samples: 30,
+        pause: Duration::ZERO,
+    };
+    /// Short enough to finish inside a boot without tripping the task watchdog
+    pub const DEVICE: Config = Config {
+        warm_up: Duration::from_millis(20),
+        measurement: Duration::from_millis(200),
+        samples: 10,
+        pause: Duration::from_millis(20),
+    };
+}
+
+#[derive(Debug, Clone, Serialize)]
+pub struct BenchResult {
+    pub name: &'static str,
+    pub samples: u32,
+    pub iters_per_sample: u64,
+    pub median_ns: f64,
+    pub mean_ns: f64,
+    pub min_ns: f64,
+    pub max_ns: f64,
+}
+
+pub struct Bencher {
+    config: Config,
+    filter: Option<String>,
+    results: Vec<BenchResult>,
+}
+
+impl Bencher {
+    pub fn new(config: Config) -> Self {
+        Self { config, filter: None, results: Vec::new() }
+    }
+
+    /// Only run benchmarks whose name contains `filter`
+    pub fn with_filter(mut self, filter: Option<String>) -> Self {
+        self.filter = filter;
+        self
+    }
+
+    pub fn results(&self) -> &[BenchResult] {
+        &self.results
+    }
+
+    pub fn into_results(self) -> Vec<BenchResult> {
+        self.results
+    }
+
+    /// Time `routine`; whatever it returns is passed through black_box
+    pub fn bench<R>(&mut self, name: &'static str, mut routine: impl FnMut() -> R) {
+        if self.filter.as_deref().is_some_and(|filter| !name.contains(filter)) {
+            return;
+        }
+
+        // Warm-up doubles as the per-iteration estimate
+        let start = Instant::now();
+        let mut warm_iters = 0u64;
+        while start.elapsed() < self.config.warm_up {
+            black_box(routine());
+            warm_iters += 1;
+        }
+        let per_iter_ns = (start.elapsed().as_nanos() as f64 / warm_iters.max(1) as f64).max(1.0);
+        let batch_ns = self.config.measurement.as_nanos() as f64 / self.config.samples as f64;
+        let iters = ((batch_ns / per_iter_ns) as u64).max(1);
+
+        let mut samples = Vec::with_capacity(self.config.samples as usize);
+        for _ in 0..self.config.samples {
+            let start = Instant::now();
+            for _ in 0..iters {
+                black_box(routine());
+            }
+            samples.push(start.elapsed().as_nanos() as f64 / iters as f64);
+        }
+        samples.sort_by(f64::total_cmp);
+
+        let result = BenchResult {
+            name,
+            samples: self.config.samples,
+            iters_per_sample: iters,
+            median_ns: samples[samples.len() / 2],
+            mean_ns: samples.iter().sum::<f64>() / samples.len() as f64,
+            min_ns: samples[0],
+            max_ns: samples[samples.len() - 1],
+        };
+        log::info!("BENCH: {:<32} {:>12.1} ns/iter (min {:.1}, max {:.1})",
+                   result.name, result.median_ns, result.min_ns, result.max_ns);
+        self.results.push(result);
+        if !self.config.pause.is_zero() {
+            std::thread::sleep(self.config.pause);
+        }
+    }
+}
+
+/// Results as the JSON document both runners emit
+pub fn to_json(results: &[BenchResult]) -> String {
+    serde_json::to_string_pretty(results).unwrap_or_default()
+}
+
+/// Run every benchmark in the suite
+pub fn run_suite(bencher: &mut Bencher) {
+    bench_dirty_rects(bencher);
+    bench_text(bencher);
+    bench_ring_buffers(bencher);
+    bench_metrics(bencher);
+    bench_templates(bencher);
+}
+
+// Deterministic pseudo-random rects in a 320x170 panel
+fn scattered_rects(count: usize) -> Vec<(u16, u16, u16, u16)> {
+    let mut state = 0x2545_f491u32;
+    let mut next = move |bound: u32| {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        state % bound
+    };
+    (0..count)
+        .map(|_| (next(300) as u16, next(150) as u16, 4 + next(40) as u16, 4 + next(20) as u16))
+        .collect()
+}
+
+fn bench_dirty_rects(b: &mut Bencher) {
+    // Overruns MAX_DIRTY_RECTS, so the merge-everything fallback is included
+    let scattered = scattered_rects(32);
+    b.bench("dirty_rect/add_rect_scattered", || {
+        let mut manager = DirtyRectManager::new();
+        for &(x, y, w, h) in &scattered {
+            manager.add_rect(x, y, w, h);
+        }
+        manager.get_stats()
+    });
+
+    // A typical UI update: one value field per row, far enough apart not to merge
+    b.bench("dirty_rect/merge_all", || {
+        let mut manager = DirtyRectManager::new();
+        for row in 0..8u16 {
+            manager.add_rect(10, row * 20, 60, 8);
+        }
+        manager.merge_all();
+        manager.get_stats()
+    });
+}
+
+/// Stands in for the LCD bus: takes the pixel stream like a DMA transfer would
+struct MockBus {
+    bytes: u64,
+    checksum: u32,
+}
+
+impl MockBus {
+    fn write_data_bytes(&mut self, bytes: &[u8]) {
+        self.bytes += bytes.len() as u64;
+        self.checksum = bytes.iter().fold(self.checksum, |sum, &byte| sum.rotate_left(5) ^ byte as u32);
+    }
+}
+
+fn bench_text(b: &mut Bencher) {
+    // The opaque draw_text path: compose from the atlas, send as one block
+    let mut atlas = GlyphAtlas::new();
+    let mut pixels = Vec::new();
+    let mut bus = MockBus { bytes: 0, checksum: 0 };
+    for (name, text, scale) in [
+        ("text/draw_text_scale1", "CPU 45% @ 240MHz  RSSI -61dBm", 1u8),
+        ("text/draw_text_scale2", "23.5C  87%", 2u8),
+    ] {
+        let width = text.chars().count() as u16 * ((FONT_WIDTH * scale) as u16 + 1) - 1;
+        let height = (FONT_HEIGHT * scale) as u16;
+        b.bench(name, || {
+            atlas.render_into(&mut pixels, text, 0xFFFF, 0x0000, scale, width, height);
+            let bytes = unsafe { std::slice::from_raw_parts(pixels.as_ptr() as *const u8, pixels.len() * 2) };
+            bus.write_data_bytes(bytes);
+            bus.checksum
+        });
+    }
+    black_box(bus.bytes);
+}
+
+fn bench_ring_buffers(b: &mut Bencher) {
+    let mut ring: RingBuffer<u32, 64> = RingBuffer::new();
+    let mut value = 0u32;
+    b.bench("ring_buffer/push_and_sum", || {
+        value = value.wrapping_add(1);
+        ring.push(value);
+        ring.iter().fold(0u32, |sum, v| sum.wrapping_add(*v))
+    });
+
+    let mut durations: DurationRingBuffer<60> = DurationRingBuffer::new();
+    let mut micros = 0u64;
+    b.bench("ring_buffer/duration_push_average", || {
+        micros = (micros + 977) % 40_000;
+        durations.push(Duration::from_micros(micros));
+        durations.average()
+    });
+}
+
+fn sample_metrics() -> MetricsData {
+    let mut metrics = MetricsData::default();
+    metrics.timestamp = 1_700_000_000;
+    metrics.frame_count = 123_456;
+    metrics.skip_count = 789;
+    metrics.fps_actual = 59.8;
+    metrics.fps_target = 60.0;
+    metrics.cpu_usage = 42;
+    metrics.cpu0_usage = 55;
+    metrics.cpu1_usage = 29;
+    metrics.cpu_freq_mhz = 240;
+    metrics.temperature = 41.5;
+    metrics.heap_free = 180_000;
+    metrics.wifi_rssi = -61;
+    metrics.wifi_connected = true;
+    metrics.battery_voltage_mv = 4012;
+    metrics.battery_percentage = 87;
+    metrics.set_wifi_ssid("HomeNetwork");
+    metrics
+}
+
+fn sample_routes() -> Vec<RouteSnapshot> {
+    ["/", "/health", "/metrics", "/api/metrics", "/api/config", "/api/system", "/debug/stats", "/sse/stats"]
+        .iter()
+        .enumerate()
+        .map(|(i, route)| RouteSnapshot {
+            method: "GET",
+            route,
+            requests: 1000 + i as u32 * 37,
+            total_us: (5000 + i as u64 * 11) * 1000,
+            p50_us: 2047,
+            p95_us: 16383,
+            p99_us: 65535,
+            max_us: 80_000,
+            bytes_sent: 1_000_000,
+            ..Default::default()
+        })
+        .collect()
+}
+
+fn bench_metrics(b: &mut Bencher) {
+    let metrics = sample_metrics();
+    let routes = sample_routes();
+
+    for (name, format) in [
+        ("metrics/prometheus_encode", Exposition::Prometheus),
+        ("metrics/openmetrics_encode", Exposition::OpenMetrics),
+    ] {
+        b.bench(name, || {
+            let mut bytes = 0usize;
+            let _ = MetricsEncoder::new(format, |chunk: &[u8]| {
+                bytes += black_box(chunk).len();
+                Ok::<(), ()>(())
+            })
+            .encode(&metrics, "1.0.0", "ESP32-S3", "T-Display-S3", 86_400, 180_000, 320_000, &routes, None);
+            bytes
+        });
+    }
+
+    b.bench("binary/packet_to_bytes", || MetricsBinaryPacket::from_metrics(&metrics).to_bytes());
+    b.bench("binary/encode_v2", || binary_protocol::encode_v2(&metrics, Some(7), None));
+
+    // The /api/metrics document, serialized into a reused buffer
+    let mut body = Vec::with_capacity(1024);
+    b.bench("json/metrics_document", || {
+        let document = serde_json::json!({
+            "uptime": metrics.timestamp,
+            "fps_actual": metrics.fps_actual,
+            "fps_target": metrics.fps_target,
+            "cpu_usage": metrics.cpu_usage,
+            "cpu0_usage": metrics.cpu0_usage,
+            "cpu1_usage": metrics.cpu1_usage,
+            "cpu_freq_mhz": metrics.cpu_freq_mhz,
+            "temperature": metrics.temperature,
+            "heap_free": metrics.heap_free,
+            "wifi_rssi": metrics.wifi_rssi,
+            "wifi_ssid": metrics.wifi_ssid(),
+            "battery_percentage": metrics.battery_percentage,
+            "battery_voltage_mv": metrics.battery_voltage_mv,
+            "frame_count": metrics.frame_count,
+            "skip_count": metrics.skip_count,
+        });
+        body.clear();
+        let _ = serde_json::to_writer(&mut body, &document);
+        body.len()
+    });
+    b.bench("json/schema", || serde_json::to_vec(&binary_protocol::schema_json()).map(|v| v.len()));
+}
+
+/// Response stand-in for the template benchmark
+struct CountingSink {
+    bytes: usize,
+}
+
+impl esp_idf_svc::io::ErrorType for CountingSink {
+    type Error = core::convert::Infallible;
+}
+
+impl esp_idf_svc::io::Write for CountingSink {
+    fn write(&mut self, buf: &[u8]) -> Result<usize, Self::Error> {
+        self.bytes += black_box(buf).len();
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> Result<(), Self::Error> {
+        Ok(())
+    }
+}
+
+fn bench_templates(b: &mut Bencher) {
+    use core::fmt::Write as _;
+    let metrics = sample_metrics();
+    b.bench("template/home_render", || {
+        let mut sink = CountingSink { bytes: 0 };
+        let _ = template_engine::HOME.render(&mut sink, |out, name| match name {
+            "page_title" | "title" => out.write_str("Home"),
+            "version" => out.write_str("1.0.0"),
+            "free_memory" => write!(out, "{} KB", metrics.heap_free / 1024),
+            "uptime" => write!(out, "{}s", metrics.uptime_seconds),
+            "HOME_ACTIVE" => out.write_str("active"),
+            // Remaining placeholders render empty, like inactive navbar flags
+            _ => Ok(()),
+        });
+        sink.bytes
+    });
+}
@@ -1,58 +1,252 @@
-/// Boot diagnostics with heap monitoring for safe feature rollout
+/// Boot timeline and stage scheduler with heap monitoring
+///
+/// Every boot stage is recorded (start, duration, heap used, core, outcome)
+/// into a timeline that /health reports and crash_persist saves with a panic.
+/// Stages that don't need the main task run on their own thread through
+/// `spawn_stage`, which first waits for the stages named in `after`, so WiFi
+/// association overlaps display and UI bring-up instead of following them.
 use esp_idf_sys::{esp_get_free_heap_size, esp_get_minimum_free_heap_size};
 use log::info;
+use serde::Serialize;
+use std::sync::{Condvar, Mutex, MutexGuard};
+use std::thread::JoinHandle;
+use std::time::Duration;
+
+// Longest a stage thread waits for its dependencies before giving up on them
+const DEPENDENCY_TIMEOUT: Duration = Duration::from_secs(30);
+
+/// One entry of the boot timeline
+#[derive(Debug, Clone, Serialize)]
+pub struct StageRecord {
+    pub name: &'static str,
+    /// Milliseconds since boot when the stage started
+    pub start_ms: u32,
+    /// None while the stage is still running
+    pub duration_ms: Option<u32>,
+    /// Free heap consumed by the stage (negative if it freed memory)
+    pub heap_used: i32,
+    pub core: u8,
+    pub ok: bool,
+}
+
+#[derive(Debug, Clone, Serialize)]
+pub struct TimelineSnapshot {
+    /// Milliseconds since boot at which boot was marked complete
+    pub boot_ms: Option<u32>,
+    pub stages: Vec<StageRecord>,
+}
+
+struct Timeline {
+    stages: Vec<StageRecord>,
+    boot_ms: Option<u32>,
+}
+
+static TIMELINE: Mutex<Timeline> = Mutex::new(Timeline { stages: Vec::new(), boot_ms: None });
+// Signalled whenever a stage finishes
+static STAGE_DONE: Condvar = Condvar::new();
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|poisoned| poisoned.into_inner())
+}
+
+fn now_ms() -> u32 {
+    (unsafe { esp_idf_sys::esp_timer_get_time() } / 1000) as u32
+}
+
+fn current_core() -> u8 {
+    esp_idf_hal::cpu::core() as u8
+}
 
 pub struct BootStage {
     name: &'static str,
+    index: usize,
     heap_before: u32,
     min_heap_before: u32,
+    finished: bool,
 }
 
 impl BootStage {
     pub fn new(name: &'static str) -> Self {
         let heap_before = unsafe { esp_get_free_heap_size() };
         let min_heap_before = unsafe { esp_get_minimum_free_heap_size() };
-        
-        info!("BOOT: Starting {} - Free: {} KB, Min: {} KB", 
+
+        info!("BOOT: Starting {} - Free: {} KB, Min: {} KB",
               name, heap_before / 1024, min_heap_before / 1024);
-        
+
+        let index = {
+            let mut timeline = lock(&TIMELINE);
+            timeline.stages.push(StageRecord {
+                name,
+                start_ms: now_ms(),
+                duration_ms: None,
+                heap_used: 0,
+                core: current_core(),
+                ok: false,
+            });
+            timeline.stages.len() - 1
+        };
+
         Self {
             name,
+            index,
             heap_before,
             min_heap_before,
+            finished: false,
         }
     }
-    
-    pub fn complete(self) {
+
+    pub fn complete(mut self) {
+        self.finish(true);
+    }
+
+    /// Record the stage as failed; dropping an unfinished stage does the same
+    pub fn fail(mut self) {
+        self.finish(false);
+    }
+
+    fn finish(&mut self, ok: bool) {
+        if self.finished {
+            return;
+        }
+        self.finished = true;
+
         let heap_after = unsafe { esp_get_free_heap_size() };
         let min_heap_after = unsafe { esp_get_minimum_free_heap_size() };
-        let used = self.heap_before.saturating_sub(heap_after);
-        
-        info!("BOOT: Completed {} - Used: {} bytes, Free: {} KB, Min: {} KB", 
-              self.name, used, heap_after / 1024, min_heap_after / 1024);
-              
+        let used = self.heap_before as i64 - heap_after as i64;
+
+        let duration_ms = {
+            let mut timeline = lock(&TIMELINE);
+            let record = &mut timeline.stages[self.index];
+            let duration_ms = now_ms().saturating_sub(record.start_ms);
+            record.duration_ms = Some(duration_ms);
+            record.heap_used = used as i32;
+            record.ok = ok;
+            duration_ms
+        };
+        STAGE_DONE.notify_all();
+
+        info!("BOOT: {} {} in {} ms - Used: {} bytes, Free: {} KB, Min: {} KB (was {} KB)",
+              if ok { "Completed" } else { "Failed" }, self.name, duration_ms,
+              used, heap_after / 1024, min_heap_after / 1024, self.min_heap_before / 1024);
+
         // Alert if heap is getting low
         if heap_after < 80 * 1024 {
             log::warn!("BOOT: Low heap warning after {}: {} KB free", self.name, heap_after / 1024);
         }
-        
+
         if min_heap_after < 60 * 1024 {
             log::error!("BOOT: Critical min heap after {}: {} KB", self.name, min_heap_after / 1024);
         }
     }
 }
 
+impl Drop for BootStage {
+    fn drop(&mut self) {
+        self.finish(false);
+    }
+}
+
+/// Block until every stage in `names` has finished (successfully or not).
+/// Returns false on timeout.
+pub fn wait_for(names: &[&str], timeout: Duration) -> bool {
+    let finished = |timeline: &Timeline| names.iter().all(|name| {
+        timeline.stages.iter().any(|stage| stage.name == *name && stage.duration_ms.is_some())
+    });
+    let timeline = lock(&TIMELINE);
+    let (_timeline, result) = STAGE_DONE
+        .wait_timeout_while(timeline, timeout, |timeline| !finished(timeline))
+        .unwrap_or_else(|poisoned| poisoned.into_inner());
+    !result.timed_out()
+}
+
+/// A stage running on its own thread
+pub struct BootTask<T> {
+    name: &'static str,
+    handle: JoinHandle<anyhow::Result<T>>,
+}
+
+impl<T> BootTask<T> {
+    pub fn is_finished(&self) -> bool {
+        self.handle.is_finished()
+    }
+
+    /// Wait for the stage and take its result
+    pub fn join(self) -> anyhow::Result<T> {
+        self.handle.join()
+            .map_err(|_| anyhow::anyhow!("Boot stage '{}' panicked", self.name))?
+    }
+}
+
+/// Run `stage` as boot stage `name` on a new thread once the stages in
+/// `after` have finished
+pub fn spawn_stage<T, F>(name: &'static str, after: &'static [&'static str], stack_size: usize, stage: F)
+    -> anyhow::Result<BootTask<T>>
+where
+    T: Send + 'static,
+    F: FnOnce() -> anyhow::Result<T> + Send + 'static,
+{
+    let handle = std::thread::Builder::new()
+        .name(format!("boot_{}", name))
+        .stack_size(stack_size)
+        .spawn(move || {
+            if !after.is_empty() && !wait_for(after, DEPENDENCY_TIMEOUT) {
+                log::warn!("BOOT: {} starting without {:?} (timed out)", name, after);
+            }
+            let record = BootStage::new(name);
+            let result = stage();
+            match &result {
+                Ok(_) => record.complete(),
+                Err(e) => {
+                    log::warn!("BOOT: {} failed: {:?}", name, e);
+                    record.fail();
+                }
+            }
+            // Stages may subscribe themselves to the task watchdog (the WiFi
+            // scan does); a thread must not exit while subscribed
+            unsafe { esp_idf_sys::esp_task_wdt_delete(std::ptr::null_mut()); }
+            result
+        })?;
+    Ok(BootTask { name, handle })
+}
+
+/// Mark boot as complete and log the timeline
+pub fn boot_complete() {
+    let snapshot = {
+        let mut timeline = lock(&TIMELINE);
+        timeline.boot_ms = Some(now_ms());
+        TimelineSnapshot { boot_ms: timeline.boot_ms, stages: timeline.stages.clone() }
+    };
+    info!("BOOT: Complete at {} ms", snapshot.boot_ms.unwrap_or(0));
+    for stage in &snapshot.stages {
+        info!("BOOT:   {:>6} ms +{:>5} ms core {} {:<14} {}",
+              stage.start_ms, stage.duration_ms.unwrap_or(0), stage.core, stage.name,
+              if stage.ok { "ok" } else if stage.duration_ms.is_some() { "FAILED" } else { "running" });
+    }
+}
+
+/// The timeline so far
+pub fn timeline() -> TimelineSnapshot {
+    let timeline = lock(&TIMELINE);
+    TimelineSnapshot { boot_ms: timeline.boot_ms, stages: timeline.stages.clone() }
+}
+
+/// The timeline, unless it is locked right now (for the panic handler)
+pub fn try_timeline() -> Option<TimelineSnapshot> {
+    let timeline = TIMELINE.try_lock().ok()?;
+    Some(TimelineSnapshot { boot_ms: timeline.boot_ms, stages: timeline.stages.clone() })
+}
+
 /// Check if we have enough heap to enable a feature
 pub fn can_enable_feature(feature_name: &str, required_kb: u32) -> bool {
     let free = unsafe { esp_get_free_heap_size() } / 1024;
     let min = unsafe { esp_get_minimum_free_heap_size() } / 1024;
-    
+
     if free >= required_kb && min >= required_kb - 20 {
-        info!("BOOT: Feature '{}' enabled - {} KB free (required: {} KB)", 
+        info!("BOOT: Feature '{}' enabled - {} KB free (required: {} KB)",
               feature_name, free, required_kb);
         true
     } else {
-        log::warn!("BOOT: Feature '{}' disabled - {} KB free (required: {} KB)", 
+        log::warn!("BOOT: Feature '{}' disabled - {} KB free (required: {} KB)",
                    feature_name, free, required_kb);
         false
     }
@@ -63,4 +257,4 @@ pub fn log_heap_stats(context: &str) {
     let free = unsafe { esp_get_free_heap_size() };
     let min = unsafe { esp_get_minimum_free_heap_size() };
     info!("HEAP [{}]: Free: {} KB, Min: {} KB", context, free / 1024, min / 1024);
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 use anyhow::Result;
 use serde::{Deserialize, Serialize};
 use esp_idf_svc::nvs::{EspDefaultNvsPartition, EspNvs};
+use std::sync::Mutex;
 
 const CONFIG_NAMESPACE: &str = "dashboard";
 const CONFIG_KEY: &str = "config";
@@ -106,8 +107,23 @@ pub fn load_or_default() -> Result<Config> {
 
 // Remove duplicate save function - already exists as method on Config
 
+// The default partition can only be taken once, and EspWifi keeps its handle
+// for the whole run, so every NVS user shares one taken partition
+static NVS_PARTITION: Mutex<Option<EspDefaultNvsPartition>> = Mutex::new(None);
+
+/// Handle to the default NVS partition, usable from any task
+pub fn nvs_partition() -> Result<EspDefaultNvsPartition> {
+    let mut slot = NVS_PARTITION.lock().unwrap_or_else(|poisoned| poisoned.into_inner());
+    if let Some(partition) = slot.as_ref() {
+        return Ok(partition.clone());
+    }
+    let partition = EspDefaultNvsPartition::take()?;
+    *slot = Some(partition.clone());
+    Ok(partition)
+}
+
 fn load_from_nvs() -> Result<Config> {
-    let nvs_partition = EspDefaultNvsPartition::take()?;
+    let nvs_partition = nvs_partition()?;
     let nvs = EspNvs::new(nvs_partition, CONFIG_NAMESPACE, true)?;
     
     let mut buf = vec![0u8; 2048]; // Max config size
@@ -120,7 +136,7 @@ fn load_from_nvs() -> Result<Config> {
 }
 
 fn save_to_nvs(config: &Config) -> Result<()> {
-    let nvs_partition = EspDefaultNvsPartition::take()?;
+    let nvs_partition = nvs_partition()?;
     let mut nvs = EspNvs::new(nvs_partition, CONFIG_NAMESPACE, true)?;
     
     let json = serde_json::to_vec(config)?;
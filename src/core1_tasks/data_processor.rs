@@ -1,10 +1,12 @@
 // Data processing pipeline for Core 1
-// Aggregates sensor and network data, performs filtering, and sends updates to Core 0
+// Aggregates sensor and network data, performs filtering, and sends updates to Core 0.
+// Battery readings come straight from the ADC DMA ring, filtered here, so a
+// power-source change is published without waiting for Core 0's next sample.
 
-use std::sync::mpsc::{Receiver, Sender, TryRecvError};
-use super::{SensorUpdate, NetworkUpdate};
+use super::{SensorUpdate, SensorConsumer, NetworkConsumer, ProcessedProducer};
+use crate::sensors::battery::BatteryMonitor;
 
-#[derive(Debug, Clone)]
+#[derive(Debug, Clone, Copy)]
 pub struct ProcessedData {
     pub temperature: f32,
     pub battery_percentage: u8,
@@ -17,9 +19,10 @@ pub struct ProcessedData {
 
 
 pub struct DataProcessor {
-    sensor_rx: Receiver<SensorUpdate>,
-    network_rx: Receiver<NetworkUpdate>,
-    tx: Sender<ProcessedData>,
+    sensor_rx: SensorConsumer,
+    network_rx: NetworkConsumer,
+    tx: ProcessedProducer,
+    battery: Option<BatteryMonitor>,
     
     // Last known values
     last_sensor: Option<SensorUpdate>,
@@ -28,54 +31,69 @@ pub struct DataProcessor {
 impl DataProcessor {
     
     pub fn new_with_channel(
-        sensor_rx: Receiver<SensorUpdate>,
-        network_rx: Receiver<NetworkUpdate>,
-        tx: Sender<ProcessedData>,
+        sensor_rx: SensorConsumer,
+        network_rx: NetworkConsumer,
+        tx: ProcessedProducer,
+        battery: Option<BatteryMonitor>,
     ) -> Self {
         Self {
             sensor_rx,
             network_rx,
             tx,
+            battery,
             last_sensor: None,
         }
     }
     
     pub fn process(&mut self) {
-        // Process all pending sensor updates
-        loop {
-            match self.sensor_rx.try_recv() {
-                Ok(update) => {
-                    self.last_sensor = Some(update);
-                },
-                Err(TryRecvError::Empty) => break,
-                Err(TryRecvError::Disconnected) => {
-                    log::error!("Sensor channel disconnected");
-                    return;
-                }
+        // Only the newest pending sensor sample matters
+        let fresh = match self.sensor_rx.pop_latest() {
+            Some(update) => {
+                self.last_sensor = Some(update);
+                true
             }
-        }
+            None => false,
+        };
         
         // Drain network updates (not currently used)
-        while let Ok(_) = self.network_rx.try_recv() {
+        while self.network_rx.pop().is_some() {
             // Network data not currently used in ProcessedData
         }
         
-        // Generate processed data if we have sensor data
+        // Filter whatever the ADC converted since the last pass
+        let power_changed = self.battery.as_mut().is_some_and(|battery| battery.poll());
+        
+        // Generate processed data only for new sensor data or a power-source
+        // change - every send wakes Core 0
+        if !fresh && !power_changed {
+            return;
+        }
         if let Some(sensor) = &self.last_sensor {
+            let battery = self.battery.as_ref().and_then(|battery| battery.reading());
+            let power = battery.map(|b| b.power).unwrap_or_default();
             let processed = ProcessedData {
                 temperature: sensor.temperature,
-                battery_percentage: sensor.battery_percentage,
-                battery_voltage: sensor.battery_voltage,
-                is_charging: sensor.is_charging,
-                is_on_usb: sensor.is_on_usb,
+                battery_percentage: battery.map_or(0, |b| b.percentage),
+                battery_voltage: battery.map_or(0, |b| b.voltage_mv),
+                is_charging: power.charging,
+                is_on_usb: power.on_usb,
                 cpu_usage_core0: sensor.cpu_usage_core0,
                 cpu_usage_core1: sensor.cpu_usage_core1,
             };
             
             // Send processed data (will block if channel is full)
-            let _ = self.tx.send(processed);
+            // Never blocks: if Core 0 fell behind, its oldest sample is dropped
+            self.tx.push_overwrite(processed);
+            crate::power::frame_scheduler::wake(crate::power::frame_scheduler::WAKE_SENSOR_DATA);
         }
     }
     
-    
-}
\ No newline at end of file
+    /// Occupancy and drop counters of the rings this processor touches
+    pub fn log_ring_stats(&self) {
+        let sensor = self.sensor_rx.stats();
+        let processed = self.tx.stats();
+        log::info!("CORE1: Rings - sensor {}/{} (high {}, dropped {}), processed {}/{} (high {}, dropped {})",
+            sensor.len, sensor.capacity, sensor.high_water, sensor.dropped,
+            processed.len, processed.capacity, processed.high_water, processed.dropped);
+    }
+}
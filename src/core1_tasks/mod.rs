@@ -2,7 +2,6 @@
 // This module implements sensor monitoring, network monitoring, and data processing
 // on Core 1 to free up Core 0 for UI rendering and user interaction
 
-use std::sync::{Arc, Mutex};
 use std::time::{Duration, Instant};
 use esp_idf_sys::{xTaskCreatePinnedToCore, TaskHandle_t};
 use std::ffi::CString;
@@ -14,53 +13,66 @@ pub mod data_processor;
 
 use network_monitor::NetworkMonitor;
 use data_processor::DataProcessor;
+use crate::ring_buffer::{spsc_ring, RingProducer, RingConsumer};
+use crate::sensors::battery::BatteryMonitor;
+
+/// Ring capacities (powers of two). Sensor samples arrive every few seconds;
+/// the slack only matters if a core stalls, and then the oldest samples go.
+pub const SENSOR_RING_CAPACITY: usize = 8;
+pub const NETWORK_RING_CAPACITY: usize = 4;
+pub const PROCESSED_RING_CAPACITY: usize = 8;
+
+pub type SensorProducer = RingProducer<SensorUpdate, SENSOR_RING_CAPACITY>;
+pub type SensorConsumer = RingConsumer<SensorUpdate, SENSOR_RING_CAPACITY>;
+pub type NetworkProducer = RingProducer<NetworkUpdate, NETWORK_RING_CAPACITY>;
+pub type NetworkConsumer = RingConsumer<NetworkUpdate, NETWORK_RING_CAPACITY>;
+pub type ProcessedProducer = RingProducer<ProcessedData, PROCESSED_RING_CAPACITY>;
+pub type ProcessedConsumer = RingConsumer<ProcessedData, PROCESSED_RING_CAPACITY>;
 
 // SensorUpdate moved here since Core 0 sends sensor data to Core 1
-#[derive(Debug, Clone)]
+#[derive(Debug, Clone, Copy)]
+// Battery state is not part of it: Core 1 reads the battery ADC itself
 pub struct SensorUpdate {
     pub temperature: f32,
-    pub battery_percentage: u8,
-    pub battery_voltage: u16,  // mV
-    pub is_charging: bool,
-    pub is_on_usb: bool,
     pub cpu_usage_core0: u8,
     pub cpu_usage_core1: u8,
 }
 pub use network_monitor::NetworkUpdate;
 
-// Channels for communication between cores
+// Lock-free rings for communication between cores
 pub struct Core1Channels {
-    pub processed_rx: std::sync::mpsc::Receiver<ProcessedData>,
-    pub sensor_tx: std::sync::mpsc::Sender<SensorUpdate>,  // Core 0 sends sensor data to Core 1
+    pub processed_rx: ProcessedConsumer,
+    pub sensor_tx: SensorProducer,  // Core 0 sends sensor data to Core 1
 }
 
-// Shared state between cores
+// Core 1 workers are owned by the Core 1 task once started
 pub struct Core1Manager {
-    network_monitor: Arc<Mutex<NetworkMonitor>>,
-    data_processor: Arc<Mutex<DataProcessor>>,
+    workers: Option<(NetworkMonitor, DataProcessor)>,
     task_handle: Option<TaskHandle_t>,
 }
 
 use data_processor::ProcessedData;
 
 impl Core1Manager {
-    pub fn new() -> Result<(Self, Core1Channels)> {
-        // Create channels for sensor data FROM Core 0
-        let (core0_sensor_tx, core0_sensor_rx) = std::sync::mpsc::channel();
+    /// `battery` is moved to Core 1 and polled by the DataProcessor
+    pub fn new(battery: Option<BatteryMonitor>) -> Result<(Self, Core1Channels)> {
+        // Ring for sensor data FROM Core 0
+        let (core0_sensor_tx, core0_sensor_rx) = spsc_ring();
         
-        // Create channels for network data
-        let (network_tx, network_rx) = std::sync::mpsc::channel();
+        // Ring for network data
+        let (network_tx, network_rx) = spsc_ring();
         
-        // Create channels for processed data TO Core 0
-        let (processed_tx, processed_rx) = std::sync::mpsc::channel();
+        // Ring for processed data TO Core 0
+        let (processed_tx, processed_rx) = spsc_ring();
         
         // Create task components
-        let network_monitor = Arc::new(Mutex::new(NetworkMonitor::new_with_channel(network_tx)));
-        let data_processor = Arc::new(Mutex::new(DataProcessor::new_with_channel(
+        let network_monitor = NetworkMonitor::new_with_channel(network_tx);
+        let data_processor = DataProcessor::new_with_channel(
             core0_sensor_rx,  // Will receive sensor data from Core 0
             network_rx,
-            processed_tx
-        )));
+            processed_tx,
+            battery,
+        );
 
         // Return channels for Core 0 to use
         let channels = Core1Channels {
@@ -70,8 +82,7 @@ impl Core1Manager {
 
         Ok((
             Self {
-                network_monitor,
-                data_processor,
+                workers: Some((network_monitor, data_processor)),
                 task_handle: None,
             },
             channels
@@ -81,9 +92,9 @@ impl Core1Manager {
     pub fn start(&mut self) -> Result<()> {
         log::info!("Starting Core 1 background tasks...");
         
-        // Clone Arc references for the task
-        let network_monitor = self.network_monitor.clone();
-        let data_processor = self.data_processor.clone();
+        // Hand the workers to the task; nothing else touches them, so no locking
+        let workers = self.workers.take()
+            .ok_or_else(|| anyhow::anyhow!("Core 1 tasks already started"))?;
         
         // Create the Core 1 task
         let mut handle: TaskHandle_t = std::ptr::null_mut();
@@ -93,7 +104,7 @@ impl Core1Manager {
                 .expect("CString creation failed - no null bytes in string");
             
             // Prepare FFI-safe task argument wrapper to avoid raw tuple juggling
-            let args = TaskArgs::new((network_monitor, data_processor));
+            let args = TaskArgs::new(workers);
             let ret = xTaskCreatePinnedToCore(
                 Some(core1_task_entry),
                 task_name.as_ptr(),
@@ -119,10 +130,8 @@ impl Core1Manager {
 // Task entry point for Core 1
 unsafe extern "C" fn core1_task_entry(pv_parameters: *mut std::ffi::c_void) {
     // Recover the task components via safe wrapper
-    let (network_monitor, data_processor): (
-        Arc<Mutex<NetworkMonitor>>,
-        Arc<Mutex<DataProcessor>>,
-    ) = unsafe { TaskArgs::<(Arc<Mutex<NetworkMonitor>>, Arc<Mutex<DataProcessor>>)>::from_raw(pv_parameters) };
+    let (mut network_monitor, mut data_processor): (NetworkMonitor, DataProcessor) =
+        unsafe { TaskArgs::<(NetworkMonitor, DataProcessor)>::from_raw(pv_parameters) };
     
     // Force a visible log message
     log::info!("CORE1: Task started on CPU {:?}", esp_idf_hal::cpu::core());
@@ -145,23 +154,22 @@ unsafe extern "C" fn core1_task_entry(pv_parameters: *mut std::ffi::c_void) {
         // Log every 10000 iterations to reduce log spam
         if loop_counter % 10000 == 0 {
             log::info!("CORE1: Heartbeat - iteration {}", loop_counter);
+            data_processor.log_ring_stats();
         }
         
         // Network monitoring (10s interval)
         if now.duration_since(last_network) >= network_interval {
-            if let Ok(mut monitor) = network_monitor.try_lock() {
-                if let Err(e) = monitor.update() {
-                    log::warn!("Network monitor error: {}", e);
-                }
+            let _span = crate::trace::span(crate::trace::CORE1_NETWORK);
+            if let Err(e) = network_monitor.update() {
+                log::warn!("Network monitor error: {}", e);
             }
             last_network = now;
         }
         
         // Data processing (100ms interval) - only process when there's likely new data
         if now.duration_since(last_process) >= process_interval {
-            if let Ok(mut processor) = data_processor.try_lock() {
-                processor.process();
-            }
+            let _span = crate::trace::span(crate::trace::CORE1_PROCESS);
+            data_processor.process();
             last_process = now;
         }
         
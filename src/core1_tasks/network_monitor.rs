@@ -1,21 +1,21 @@
 // Network monitoring task for Core 1
 // Continuously monitors WiFi signal strength, connection state, and network health
 
-use std::sync::mpsc::Sender;
 use anyhow::Result;
+use super::NetworkProducer;
 
-#[derive(Debug, Clone)]
+#[derive(Debug, Clone, Copy)]
 pub struct NetworkUpdate {
     // Currently no fields used - placeholder for future network metrics
 }
 
 pub struct NetworkMonitor {
-    _tx: Sender<NetworkUpdate>,
+    _tx: NetworkProducer,
 }
 
 impl NetworkMonitor {
     
-    pub fn new_with_channel(tx: Sender<NetworkUpdate>) -> Self {
+    pub fn new_with_channel(tx: NetworkProducer) -> Self {
         Self {
             _tx: tx,
         }
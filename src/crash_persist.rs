@@ -1,5 +1,6 @@
 use serde::{Deserialize, Serialize};
-use esp_idf_svc::nvs::{EspDefaultNvsPartition, EspNvs};
+use esp_idf_svc::nvs::EspNvs;
+use crate::config::nvs_partition;
 
 const CRASH_NS: &str = "crash";
 const CRASH_KEY: &str = "last";
@@ -12,6 +13,14 @@ pub struct CrashLogEntry {
     pub msg: String,
 }
 
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct BootStageEntry {
+    pub name: String,
+    pub start_ms: u32,
+    pub duration_ms: Option<u32>,
+    pub ok: bool,
+}
+
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct LastCrash {
     pub panic_reason: String,
@@ -21,6 +30,11 @@ pub struct LastCrash {
     pub heap_min: u32,
     pub psram_free: u32,
     pub log_excerpt: Vec<CrashLogEntry>,
+    // Boot stages of the crashed run; an unfinished stage is where a boot-time crash happened
+    #[serde(default)]
+    pub boot_timeline: Vec<BootStageEntry>,
+    #[serde(default)]
+    pub boot_ms: Option<u32>,
 }
 
 /// Best-effort save of last crash information. Never panics.
@@ -37,7 +51,7 @@ pub fn save_last_crash(panic_reason: &str) {
 
     // Collect a small excerpt of recent logs (non-blocking in logger path)
     let log_excerpt = {
-        let streamer = crate::network::log_streamer::init(None);
+        let streamer = crate::network::log_streamer::init();
         let logs = streamer.get_recent_logs(50);
         logs.into_iter()
             .map(|e| CrashLogEntry {
@@ -49,6 +63,17 @@ pub fn save_last_crash(panic_reason: &str) {
             .collect::<Vec<_>>()
     };
 
+    // try_lock: the panic may have happened inside a timeline update
+    let timeline = crate::boot_diagnostics::try_timeline();
+    let boot_timeline = timeline.iter().flat_map(|timeline| &timeline.stages)
+        .map(|stage| BootStageEntry {
+            name: stage.name.to_string(),
+            start_ms: stage.start_ms,
+            duration_ms: stage.duration_ms,
+            ok: stage.ok,
+        })
+        .collect::<Vec<_>>();
+
     let record = LastCrash {
         panic_reason: panic_reason.to_string(),
         timestamp_unix,
@@ -57,10 +82,12 @@ pub fn save_last_crash(panic_reason: &str) {
         heap_min,
         psram_free,
         log_excerpt,
+        boot_timeline,
+        boot_ms: timeline.and_then(|timeline| timeline.boot_ms),
     };
 
     if let Ok(bytes) = serde_json::to_vec(&record) {
-        if let Ok(nvs_part) = EspDefaultNvsPartition::take() {
+        if let Ok(nvs_part) = nvs_partition() {
             if let Ok(mut nvs) = EspNvs::new(nvs_part, CRASH_NS, true) {
                 let _ = nvs.set_blob(CRASH_KEY, &bytes);
             }
@@ -69,7 +96,7 @@ pub fn save_last_crash(panic_reason: &str) {
 }
 
 pub fn read_last_crash() -> anyhow::Result<Option<LastCrash>> {
-    let nvs_part = match EspDefaultNvsPartition::take() {
+    let nvs_part = match nvs_partition() {
         Ok(p) => p,
         Err(_) => return Ok(None),
     };
@@ -78,7 +105,7 @@ pub fn read_last_crash() -> anyhow::Result<Option<LastCrash>> {
         Err(_) => return Ok(None),
     };
 
-    let mut buf = vec![0u8; 4096];
+    let mut buf = vec![0u8; 8192];
     let data_opt = nvs.get_blob(CRASH_KEY, &mut buf)?;
     let data = match data_opt {
         Some(d) if !d.is_empty() => d,
@@ -91,7 +118,7 @@ pub fn read_last_crash() -> anyhow::Result<Option<LastCrash>> {
 }
 
 pub fn clear_last_crash() -> anyhow::Result<()> {
-    let nvs_part = EspDefaultNvsPartition::take()?;
+    let nvs_part = nvs_partition()?;
     let mut nvs = EspNvs::new(nvs_part, CRASH_NS, true)?;
     // Write minimal empty JSON to logically clear
     nvs.set_blob(CRASH_KEY, b"{}")?;
@@ -0,0 +1,38 @@
+/// Memory diagnostics for the ESP_LCD DMA display path
+/// The LCD_CAM bounce buffers must live in DMA-capable internal RAM,
+/// so track that pool separately from the general heap.
+use esp_idf_sys::*;
+
+/// Log heap state relevant to the display driver
+pub fn print_memory_stats(label: &str) {
+    unsafe {
+        let free = esp_get_free_heap_size();
+        let min = esp_get_minimum_free_heap_size();
+        let internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        let dma_free = heap_caps_get_free_size(MALLOC_CAP_DMA);
+        let dma_largest = heap_caps_get_largest_free_block(MALLOC_CAP_DMA);
+
+        log::info!("[LCD_MEM] {}: free={} KB min={} KB internal={} KB dma={} KB (largest {} KB)",
+            label, free / 1024, min / 1024, internal_free / 1024, dma_free / 1024, dma_largest / 1024);
+    }
+}
+
+/// Log the current task's stack high-water mark
+pub fn print_stack_watermark(label: &str) {
+    let remaining = unsafe { uxTaskGetStackHighWaterMark(std::ptr::null_mut()) };
+    if remaining < 1024 {
+        log::warn!("[LCD_MEM] {}: stack remaining {} bytes (LOW)", label, remaining);
+    } else {
+        log::info!("[LCD_MEM] {}: stack remaining {} bytes", label, remaining);
+    }
+}
+
+/// Warn if DMA-capable memory is too fragmented for new bounce buffers
+pub fn check_dma_capable_memory() {
+    let largest = unsafe { heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL) };
+    if largest < 8 * 1024 {
+        log::warn!("[LCD_MEM] DMA-capable largest block only {} bytes - display transfers may stall", largest);
+    } else {
+        log::info!("[LCD_MEM] DMA-capable largest block: {} KB", largest / 1024);
+    }
+}
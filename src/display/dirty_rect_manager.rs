@@ -1,8 +1,32 @@
 // Enhanced dirty rectangle management for optimized display updates
 
-use super::DirtyRect;
+#[derive(Debug, Clone, Copy)]
+pub struct DirtyRect {
+    pub x: u16,
+    pub y: u16,
+    pub width: u16,
+    pub height: u16,
+}
 
-const MAX_DIRTY_RECTS: usize = 16;
+impl DirtyRect {
+    pub fn new(x: u16, y: u16, width: u16, height: u16) -> Self {
+        Self { x, y, width, height }
+    }
+    
+    pub fn merge(&mut self, other: &DirtyRect) {
+        let x1 = self.x.min(other.x);
+        let y1 = self.y.min(other.y);
+        let x2 = (self.x + self.width).max(other.x + other.width);
+        let y2 = (self.y + self.height).max(other.y + other.height);
+        
+        self.x = x1;
+        self.y = y1;
+        self.width = x2 - x1;
+        self.height = y2 - y1;
+    }
+}
+
+pub const MAX_DIRTY_RECTS: usize = 16;
 const MERGE_THRESHOLD: usize = 10;
 
 /// Manages multiple dirty rectangles with automatic merging
@@ -180,6 +204,11 @@ impl DirtyRectManager {
         self.count = write_idx;
     }
     
+    /// Iterate over the current (already coalesced) dirty rectangles
+    pub fn rects(&self) -> impl Iterator<Item = DirtyRect> + '_ {
+        self.rects[..self.count].iter().flatten().copied()
+    }
+    
     /// Check if there are any dirty rectangles
     pub fn is_empty(&self) -> bool {
         self.count == 0
@@ -0,0 +1,90 @@
+// Double-buffered frame presentation
+//
+// Core 0 draws frame N+1 into the back buffer while the LCD_CAM DMA streams
+// frame N straight out of the front buffer. The buffers trade places in
+// DisplayManager::flush() once the previous transfer has left the wire.
+//
+// The ST7789 TE (tearing effect) pin is not routed on the T-Display-S3, so
+// swaps are paced by a timer locked to the panel refresh instead.
+
+use super::framebuffer::FrameBuffer;
+use esp_idf_hal::delay::{Ets, FreeRtos};
+use std::time::{Duration, Instant};
+
+/// Panel refresh period for FRCTRL2 = 0x0F (60 Hz)
+pub const PANEL_REFRESH_PERIOD: Duration = Duration::from_micros(16_667);
+
+/// When a finished back buffer may be swapped to the front
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum SwapSync {
+    /// As soon as the previous frame has been sent
+    Immediate,
+    /// On a fixed cadence, at most one swap per period
+    Timer(Duration),
+}
+
+pub struct DoubleBuffer {
+    /// Buffer currently owned by the DMA
+    front: FrameBuffer,
+    sync: SwapSync,
+    next_swap: Instant,
+    /// esp_timer time (us) when streaming of the front buffer started
+    transfer_start_us: Option<u32>,
+}
+
+impl DoubleBuffer {
+    /// `front` must already hold what the panel shows
+    pub fn new(front: FrameBuffer, sync: SwapSync) -> Self {
+        Self {
+            front,
+            sync,
+            next_swap: Instant::now(),
+            transfer_start_us: None,
+        }
+    }
+
+    pub fn front(&self) -> &FrameBuffer {
+        &self.front
+    }
+
+    /// Sleep until the next swap slot
+    pub fn wait_for_swap(&mut self) {
+        let period = match self.sync {
+            SwapSync::Immediate => return,
+            SwapSync::Timer(period) => period,
+        };
+
+        let now = Instant::now();
+        if self.next_swap > now {
+            let wait = self.next_swap - now;
+            let ms = wait.as_millis() as u32;
+            if ms > 0 {
+                FreeRtos::delay_ms(ms);
+            }
+            Ets::delay_us(wait.subsec_micros() % 1000);
+        }
+
+        // Stay phase-locked, but don't try to catch up on missed slots
+        self.next_swap += period;
+        let now = Instant::now();
+        if self.next_swap < now {
+            self.next_swap = now + period;
+        }
+    }
+
+    /// Make `rendered` the front buffer and hand back the previous one
+    pub fn swap(&mut self, rendered: FrameBuffer) -> FrameBuffer {
+        std::mem::replace(&mut self.front, rendered)
+    }
+
+    pub fn transfer_started(&mut self, now_us: u32) {
+        self.transfer_start_us = Some(now_us);
+    }
+
+    /// Wire time of the transfer that completed at `done_us`
+    pub fn transfer_finished(&mut self, done_us: u32) -> Option<Duration> {
+        self.transfer_start_us
+            .take()
+            .map(|start| Duration::from_micros(done_us.wrapping_sub(start) as u64))
+    }
+}
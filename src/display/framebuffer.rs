@@ -0,0 +1,159 @@
+// PSRAM-backed RGB565 frame buffer for dirty-rectangle flushing
+//
+// Pixels are stored pre-swapped into the panel's byte order (high byte first),
+// so a run of pixels can be handed to the LCD bus as a plain byte slice.
+// Buffer columns map 1:1 onto controller columns: visible column 0 sits at
+// FRAMEBUFFER_ORIGIN_X, and the padding either side stays black.
+
+use anyhow::Result;
+use esp_idf_sys::*;
+
+/// Buffer size used by DisplayManager - the 320x170 panel, a 64-byte row
+/// stride wider than the 300x168 visible area
+pub const FRAMEBUFFER_WIDTH: u16 = 320;
+pub const FRAMEBUFFER_HEIGHT: u16 = 170;
+
+/// Buffer column holding visible column 0 (the panel's hidden left columns)
+pub const FRAMEBUFFER_ORIGIN_X: u16 = 10;
+
+/// GDMA reads PSRAM in 64-byte blocks
+const DMA_ALIGN_BYTES: usize = 64;
+
+pub struct FrameBuffer {
+    pixels: *mut u16,
+    width: u16,
+    height: u16,
+}
+
+// The buffer is owned by DisplayManager and only touched from its task
+unsafe impl Send for FrameBuffer {}
+
+impl FrameBuffer {
+    /// Allocate a width x height buffer in PSRAM, cleared to black.
+    /// The base address is 64-byte aligned so rows can be streamed by DMA.
+    pub fn new(width: u16, height: u16) -> Result<Self> {
+        if !crate::psram::PsramAllocator::is_available() {
+            anyhow::bail!("PSRAM not available for frame buffer");
+        }
+
+        let len = width as usize * height as usize;
+        let pixels = unsafe {
+            heap_caps_aligned_calloc(DMA_ALIGN_BYTES, len, core::mem::size_of::<u16>(),
+                MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+        } as *mut u16;
+        if pixels.is_null() {
+            anyhow::bail!("Failed to allocate {}x{} frame buffer ({} KB) in PSRAM",
+                width, height, len * 2 / 1024);
+        }
+
+        log::info!("Frame buffer allocated: {}x{} RGB565 ({} KB PSRAM)", width, height, len * 2 / 1024);
+        Ok(Self { pixels, width, height })
+    }
+
+    fn pixels(&self) -> &[u16] {
+        unsafe { std::slice::from_raw_parts(self.pixels, self.width as usize * self.height as usize) }
+    }
+
+    fn pixels_mut(&mut self) -> &mut [u16] {
+        unsafe { std::slice::from_raw_parts_mut(self.pixels, self.width as usize * self.height as usize) }
+    }
+
+    /// Index of visible pixel (x, y)
+    #[inline]
+    fn index(&self, x: u16, y: u16) -> usize {
+        y as usize * self.width as usize + (FRAMEBUFFER_ORIGIN_X + x) as usize
+    }
+
+    /// Set a single pixel (caller clips to the buffer)
+    #[inline]
+    pub fn set_pixel(&mut self, x: u16, y: u16, color: u16) {
+        let index = self.index(x, y);
+        self.pixels_mut()[index] = color.to_be();
+    }
+
+    /// Read back a pixel in native RGB565
+    #[inline]
+    pub fn get_pixel(&self, x: u16, y: u16) -> u16 {
+        u16::from_be(self.pixels()[self.index(x, y)])
+    }
+
+    /// Fill a rectangle (caller clips to the buffer)
+    pub fn fill_rect(&mut self, x: u16, y: u16, w: u16, h: u16, color: u16) {
+        let stride = self.width as usize;
+        let value = color.to_be();
+        let origin = self.index(x, y);
+        let pixels = self.pixels_mut();
+        for row in 0..h as usize {
+            let start = origin + row * stride;
+            pixels[start..start + w as usize].fill(value);
+        }
+    }
+
+    /// Copy a `w` x `h` block of bus-order pixels into the buffer (caller clips)
+    pub fn blit(&mut self, x: u16, y: u16, w: u16, h: u16, block: &[u16]) {
+        let stride = self.width as usize;
+        let w = w as usize;
+        let origin = self.index(x, y);
+        let pixels = self.pixels_mut();
+        for (row, src) in block.chunks_exact(w).take(h as usize).enumerate() {
+            let start = origin + row * stride;
+            pixels[start..start + w].copy_from_slice(src);
+        }
+    }
+
+    /// Move a rectangle's pixels `dx` columns left and fill the vacated
+    /// columns on the right (caller clips, dx < w)
+    pub fn shift_rect_left(&mut self, x: u16, y: u16, w: u16, h: u16, dx: u16, color: u16) {
+        let stride = self.width as usize;
+        let (w, dx) = (w as usize, dx as usize);
+        let value = color.to_be();
+        let origin = self.index(x, y);
+        let pixels = self.pixels_mut();
+        for row in 0..h as usize {
+            let start = origin + row * stride;
+            let row = &mut pixels[start..start + w];
+            row.copy_within(dx.., 0);
+            row[w - dx..].fill(value);
+        }
+    }
+
+    /// Fill the whole buffer
+    pub fn fill(&mut self, color: u16) {
+        let value = color.to_be();
+        self.pixels_mut().fill(value);
+    }
+
+    /// Copy a rectangle from another buffer of the same size (caller clips)
+    pub fn copy_rect_from(&mut self, other: &FrameBuffer, x: u16, y: u16, w: u16, h: u16) {
+        debug_assert!(self.width == other.width && self.height == other.height);
+        let stride = self.width as usize;
+        let origin = self.index(x, y);
+        let src = other.pixels();
+        let dst = self.pixels_mut();
+        for row in 0..h as usize {
+            let start = origin + row * stride;
+            dst[start..start + w as usize].copy_from_slice(&src[start..start + w as usize]);
+        }
+    }
+
+    /// Bytes for `w` pixels of row `y` starting at `x`, in bus order
+    pub fn row_bytes(&self, x: u16, y: u16, w: u16) -> &[u8] {
+        let start = self.index(x, y);
+        let row = &self.pixels()[start..start + w as usize];
+        unsafe { std::slice::from_raw_parts(row.as_ptr() as *const u8, row.len() * 2) }
+    }
+
+    /// Bytes for `h` whole rows from `y`, padding included, in bus order.
+    /// Rows are a 64-byte multiple, so the span is cache-line aligned.
+    pub fn band_bytes(&self, y: u16, h: u16) -> &[u8] {
+        let stride = self.width as usize;
+        let band = &self.pixels()[y as usize * stride..(y + h) as usize * stride];
+        unsafe { std::slice::from_raw_parts(band.as_ptr() as *const u8, band.len() * 2) }
+    }
+}
+
+impl Drop for FrameBuffer {
+    fn drop(&mut self) {
+        unsafe { heap_caps_free(self.pixels as *mut core::ffi::c_void) };
+    }
+}
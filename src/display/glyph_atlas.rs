@@ -0,0 +1,171 @@
+// Pre-expanded RGB565 glyphs for opaque text
+//
+// Each (scale, fg, bg) style keeps its own set of glyph cells, expanded from
+// the 5x7 font on first use. A whole string is composed row by row into a
+// caller-provided buffer so it can be sent as one window and one pixel burst.
+// Pixels are stored in bus byte order, like the frame buffer.
+
+use super::font5x7::{FONT_WIDTH, FONT_HEIGHT, get_char_data};
+
+/// Printable ASCII covered by the font (' '..='~')
+const GLYPH_COUNT: usize = 95;
+
+/// Styles kept before the least recently used one is dropped
+const MAX_STYLES: usize = 6;
+
+struct GlyphStyle {
+    scale: u8,
+    fg: u16,
+    bg: u16,
+    glyphs: Vec<Option<Box<[u16]>>>,
+}
+
+impl GlyphStyle {
+    fn new(scale: u8, fg: u16, bg: u16) -> Self {
+        Self { scale, fg, bg, glyphs: vec![None; GLYPH_COUNT] }
+    }
+
+    /// Cell of FONT_WIDTH*scale x FONT_HEIGHT*scale pixels for `c`
+    fn glyph(&mut self, c: char) -> &[u16] {
+        // Same fallback as get_char_data: unsupported characters render as space
+        let code = c as usize;
+        let slot = if (32..127).contains(&code) { code - 32 } else { 0 };
+        let (scale, fg, bg) = (self.scale, self.fg, self.bg);
+        self.glyphs[slot].get_or_insert_with(|| expand_glyph(c, scale, fg, bg))
+    }
+}
+
+fn expand_glyph(c: char, scale: u8, fg: u16, bg: u16) -> Box<[u16]> {
+    let char_data = get_char_data(c);
+    let scale = scale as usize;
+    let cell_width = FONT_WIDTH as usize * scale;
+    let cell_height = FONT_HEIGHT as usize * scale;
+    let fg = fg.to_be();
+
+    let mut cell = vec![bg.to_be(); cell_width * cell_height].into_boxed_slice();
+    for col in 0..FONT_WIDTH as usize {
+        for row in 0..FONT_HEIGHT as usize {
+            if (char_data[col] >> row) & 1 == 0 {
+                continue;
+            }
+            for dy in 0..scale {
+                let start = (row * scale + dy) * cell_width + col * scale;
+                cell[start..start + scale].fill(fg);
+            }
+        }
+    }
+    cell
+}
+
+/// Whole glyphs at `scale` that fit in `available` pixels. The last glyph
+/// needs no trailing gap, so n glyphs take n*advance-1 pixels.
+pub fn glyphs_that_fit(scale: u8, available: u16) -> u16 {
+    let advance = FONT_WIDTH as u16 * scale as u16 + 1;
+    (available + 1) / advance
+}
+
+pub struct GlyphAtlas {
+    // Most recently used first
+    styles: Vec<GlyphStyle>,
+}
+
+impl GlyphAtlas {
+    pub fn new() -> Self {
+        Self { styles: Vec::with_capacity(MAX_STYLES) }
+    }
+
+    fn style(&mut self, scale: u8, fg: u16, bg: u16) -> &mut GlyphStyle {
+        match self.styles.iter().position(|s| s.scale == scale && s.fg == fg && s.bg == bg) {
+            Some(0) => {}
+            Some(index) => {
+                let style = self.styles.remove(index);
+                self.styles.insert(0, style);
+            }
+            None => {
+                if self.styles.len() == MAX_STYLES {
+                    self.styles.pop();
+                }
+                self.styles.insert(0, GlyphStyle::new(scale, fg, bg));
+            }
+        }
+        &mut self.styles[0]
+    }
+
+    /// Compose `text` into `out` as a `width` x `height` block in bus order.
+    /// Glyphs advance FONT_WIDTH*scale+1 pixels; the gaps and anything past
+    /// the end of the text are filled with `bg`. `height` may clip the glyphs.
+    pub fn render_into(&mut self, out: &mut Vec<u16>, text: &str, fg: u16, bg: u16, scale: u8,
+                       width: u16, height: u16) {
+        let width = width as usize;
+        let cell_width = FONT_WIDTH as usize * scale as usize;
+        let height = (height as usize).min(FONT_HEIGHT as usize * scale as usize);
+        let advance = cell_width + 1;
+
+        out.clear();
+        out.resize(width * height, bg.to_be());
+
+        let style = self.style(scale, fg, bg);
+        for (i, c) in text.chars().enumerate() {
+            let x0 = i * advance;
+            if x0 >= width {
+                break;
+            }
+            let copy_width = cell_width.min(width - x0);
+            let glyph = style.glyph(c);
+            for row in 0..height {
+                let src = row * cell_width;
+                let dst = row * width + x0;
+                out[dst..dst + copy_width].copy_from_slice(&glyph[src..src + copy_width]);
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_render_pads_with_background() {
+        let mut atlas = GlyphAtlas::new();
+        let mut out = Vec::new();
+        atlas.render_into(&mut out, " ", 0xFFFF, 0x1234, 1, 10, 7);
+        assert_eq!(out.len(), 70);
+        assert!(out.iter().all(|&p| p == 0x1234u16.to_be()));
+    }
+
+    #[test]
+    fn test_render_matches_font_bits() {
+        let mut atlas = GlyphAtlas::new();
+        let mut out = Vec::new();
+        atlas.render_into(&mut out, "A", 0xFFFF, 0x0000, 2, 10, 14);
+        let data = get_char_data('A');
+        for col in 0..FONT_WIDTH as usize {
+            for row in 0..FONT_HEIGHT as usize {
+                let lit = (data[col] >> row) & 1 == 1;
+                let pixel = out[(row * 2 + 1) * 10 + col * 2 + 1];
+                assert_eq!(pixel == 0xFFFF, lit);
+            }
+        }
+    }
+
+    #[test]
+    fn test_text_that_exactly_fills_the_width_fits() {
+        // Three scale-2 glyphs: 3 * 11 - 1 pixels
+        assert_eq!(glyphs_that_fit(2, 32), 3);
+        assert_eq!(glyphs_that_fit(2, 31), 2);
+        assert_eq!(glyphs_that_fit(1, 5), 1);
+        assert_eq!(glyphs_that_fit(1, 4), 0);
+    }
+
+    #[test]
+    fn test_styles_are_evicted_lru() {
+        let mut atlas = GlyphAtlas::new();
+        let mut out = Vec::new();
+        for color in 0..(MAX_STYLES as u16 + 2) {
+            atlas.render_into(&mut out, "x", color, 0, 1, 6, 7);
+        }
+        assert_eq!(atlas.styles.len(), MAX_STYLES);
+        assert_eq!(atlas.styles[0].fg, MAX_STYLES as u16 + 1);
+    }
+}
@@ -134,6 +134,7 @@ impl LcdBus {
     
     /// Write multiple pixels efficiently with optimized inner loop
     pub fn write_pixels(&mut self, color: u16, count: u32) -> Result<()> {
+        let _span = crate::trace::span(crate::trace::WRITE_PIXELS);
         // Keep DC high for data
         self.dc.set_high()?;
         
@@ -214,6 +215,11 @@ impl LcdBus {
         Ok(())
     }
     
+    /// Wait for queued transfers to finish (GPIO writes are synchronous)
+    pub fn wait_idle(&mut self) -> Result<()> {
+        Ok(())
+    }
+    
     /// Fast method to set all data pins at once
     #[inline]
     fn set_data_pins_fast(&mut self, data: u8) -> Result<()> {
@@ -0,0 +1,460 @@
+// LCD_CAM i80 (8080 parallel) bus driver for ST7789 using GDMA
+//
+// Drop-in replacement for the GPIO bit-banged `LcdBus`: same write_command /
+// write_data / write_data_bytes / write_pixels surface, but bytes are clocked
+// out by the ESP32-S3 LCD_CAM peripheral through the esp_lcd i80 driver.
+// Pixel data is queued as DMA transactions from a small set of internal-RAM
+// bounce buffers, so the CPU returns immediately and can render the next
+// region while the previous one is still on the wire. Frame buffers in PSRAM
+// can also be streamed in place (write_data_bytes_nocopy) for double buffering.
+
+use anyhow::Result;
+use esp_idf_hal::gpio::{AnyIOPin, Pin, PinDriver, Output};
+use esp_idf_hal::delay::FreeRtos;
+use esp_idf_sys::*;
+use std::sync::atomic::{AtomicU32, Ordering};
+
+/// i80 pixel clock - conservative value matching the LilyGO reference driver
+const PIXEL_CLOCK_HZ: u32 = 10_000_000;
+
+/// Size of each DMA bounce buffer in bytes (2048 RGB565 pixels)
+const BOUNCE_BUFFER_SIZE: usize = 4096;
+
+/// Number of bounce buffers rotated between CPU and DMA
+const BOUNCE_BUFFER_COUNT: usize = 3;
+
+/// Largest single color transaction (24 rows of the 320-px frame buffer stride)
+const MAX_TRANSFER_BYTES: usize = 320 * 2 * 24;
+
+/// Maximum number of queued color transactions inside esp_lcd
+/// (a full-frame zero-copy flush is ceil(168 / 24) = 7 transactions)
+const TRANS_QUEUE_DEPTH: usize = 32;
+
+/// Maximum parameter bytes buffered for a single command
+const MAX_PARAM_BYTES: usize = 64;
+
+/// Give up waiting for the DMA engine after this long
+const DMA_TIMEOUT_US: i64 = 100_000;
+
+// esp_cache_msync flags (esp_cache.h)
+const CACHE_MSYNC_FLAG_DIR_C2M: i32 = 1 << 2;
+
+// ESP32-S3 external RAM data bus window (soc.h SOC_EXTRAM_DATA_LOW/HIGH)
+const EXTRAM_DATA_LOW: usize = 0x3C00_0000;
+const EXTRAM_DATA_HIGH: usize = 0x3E00_0000;
+
+// Memory write commands - everything sent after these is pixel data
+const CMD_RAMWR: u8 = 0x2C;
+const CMD_RAMWRC: u8 = 0x3C;
+
+/// Number of color transactions completed by the LCD_CAM DMA (updated from ISR)
+static TRANSFERS_DONE: AtomicU32 = AtomicU32::new(0);
+
+/// esp_timer time (low 32 bits, us) of the most recent completion
+static LAST_DONE_US: AtomicU32 = AtomicU32::new(0);
+
+/// Called by esp_lcd from the LCD_CAM ISR when a color transaction finishes
+unsafe extern "C" fn on_color_trans_done(
+    _panel_io: esp_lcd_panel_io_handle_t,
+    _edata: *mut esp_lcd_panel_io_event_data_t,
+    _user_ctx: *mut core::ffi::c_void,
+) -> bool {
+    LAST_DONE_US.store(esp_timer_get_time() as u32, Ordering::Relaxed);
+    TRANSFERS_DONE.fetch_add(1, Ordering::Release);
+    false // No higher priority task woken
+}
+
+/// Commands that never take parameters and must reach the panel immediately
+/// (callers delay right after them, e.g. SWRESET/SLPOUT)
+fn is_param_less(cmd: u8) -> bool {
+    matches!(cmd,
+        0x00 | // NOP
+        0x01 | // SWRESET
+        0x10 | // SLPIN
+        0x11 | // SLPOUT
+        0x12 | // PTLON
+        0x13 | // NORON
+        0x20 | // INVOFF
+        0x21 | // INVON
+        0x28 | // DISPOFF
+        0x29 | // DISPON
+        0x38 | // IDMOFF
+        0x39   // IDMON
+    )
+}
+
+/// DMA-capable bounce buffer in internal RAM
+struct DmaBuffer {
+    ptr: *mut u8,
+    /// Sequence number of the last transaction queued from this buffer
+    last_seq: u32,
+    /// Solid color currently stored in the buffer (lets fills reuse it in flight)
+    fill_color: Option<u16>,
+}
+
+impl DmaBuffer {
+    fn new() -> Result<Self> {
+        let ptr = unsafe {
+            heap_caps_malloc(BOUNCE_BUFFER_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL)
+        } as *mut u8;
+        if ptr.is_null() {
+            anyhow::bail!("Failed to allocate {} byte LCD DMA buffer", BOUNCE_BUFFER_SIZE);
+        }
+        Ok(Self { ptr, last_seq: 0, fill_color: None })
+    }
+
+    fn as_mut_slice(&mut self) -> &mut [u8] {
+        unsafe { std::slice::from_raw_parts_mut(self.ptr, BOUNCE_BUFFER_SIZE) }
+    }
+}
+
+impl Drop for DmaBuffer {
+    fn drop(&mut self) {
+        unsafe { heap_caps_free(self.ptr as *mut core::ffi::c_void) };
+    }
+}
+
+/// Hardware-accelerated 8-bit parallel LCD bus driver for ST7789
+pub struct LcdCamBus {
+    bus: esp_lcd_i80_bus_handle_t,
+    io: esp_lcd_panel_io_handle_t,
+    rst: PinDriver<'static, AnyIOPin, Output>,
+    // Pins are owned by the LCD_CAM peripheral; hold them so nothing else claims them
+    _pins: Vec<AnyIOPin>,
+    buffers: [DmaBuffer; BOUNCE_BUFFER_COUNT],
+    next_buffer: usize,
+    /// Number of color transactions queued so far
+    submitted: u32,
+    /// Command waiting for its parameters
+    pending_cmd: Option<u8>,
+    params: [u8; MAX_PARAM_BYTES],
+    param_len: usize,
+    /// Command to use for the next pixel transaction (RAMWR first, then RAMWRC)
+    mem_cmd: Option<u8>,
+}
+
+// The raw esp_lcd handles are only ever used from the task that owns the bus
+unsafe impl Send for LcdCamBus {}
+
+impl LcdCamBus {
+    pub fn new(
+        d0: impl Into<AnyIOPin> + 'static,
+        d1: impl Into<AnyIOPin> + 'static,
+        d2: impl Into<AnyIOPin> + 'static,
+        d3: impl Into<AnyIOPin> + 'static,
+        d4: impl Into<AnyIOPin> + 'static,
+        d5: impl Into<AnyIOPin> + 'static,
+        d6: impl Into<AnyIOPin> + 'static,
+        d7: impl Into<AnyIOPin> + 'static,
+        wr: impl Into<AnyIOPin> + 'static,
+        dc: impl Into<AnyIOPin> + 'static,
+        cs: impl Into<AnyIOPin> + 'static,
+        rst: impl Into<AnyIOPin> + 'static,
+    ) -> Result<Self> {
+        let data_pins: [AnyIOPin; 8] = [
+            d0.into(), d1.into(), d2.into(), d3.into(),
+            d4.into(), d5.into(), d6.into(), d7.into(),
+        ];
+        let wr: AnyIOPin = wr.into();
+        let dc: AnyIOPin = dc.into();
+        let cs: AnyIOPin = cs.into();
+
+        // Create the i80 bus on the LCD_CAM peripheral
+        let mut bus_config = esp_lcd_i80_bus_config_t::default();
+        bus_config.dc_gpio_num = dc.pin();
+        bus_config.wr_gpio_num = wr.pin();
+        bus_config.clk_src = soc_periph_lcd_clk_src_t_LCD_CLK_SRC_DEFAULT;
+        for gpio in bus_config.data_gpio_nums.iter_mut() {
+            *gpio = -1;
+        }
+        for (i, pin) in data_pins.iter().enumerate() {
+            bus_config.data_gpio_nums[i] = pin.pin();
+        }
+        bus_config.bus_width = 8;
+        bus_config.max_transfer_bytes = MAX_TRANSFER_BYTES;
+        bus_config.psram_trans_align = 64;
+        bus_config.sram_trans_align = 4;
+
+        let mut bus: esp_lcd_i80_bus_handle_t = std::ptr::null_mut();
+        let result = unsafe { esp_lcd_new_i80_bus(&bus_config, &mut bus) };
+        if result != ESP_OK {
+            anyhow::bail!("esp_lcd_new_i80_bus failed: {}", result);
+        }
+
+        // Attach the panel IO (handles CS, DC levels and the transaction queue)
+        let mut io_config = esp_lcd_panel_io_i80_config_t::default();
+        io_config.cs_gpio_num = cs.pin();
+        io_config.pclk_hz = PIXEL_CLOCK_HZ;
+        io_config.trans_queue_depth = TRANS_QUEUE_DEPTH;
+        io_config.on_color_trans_done = Some(on_color_trans_done);
+        io_config.user_ctx = std::ptr::null_mut();
+        io_config.lcd_cmd_bits = 8;
+        io_config.lcd_param_bits = 8;
+        io_config.dc_levels.set_dc_idle_level(0);
+        io_config.dc_levels.set_dc_cmd_level(0);
+        io_config.dc_levels.set_dc_dummy_level(0);
+        io_config.dc_levels.set_dc_data_level(1);
+
+        let mut io: esp_lcd_panel_io_handle_t = std::ptr::null_mut();
+        let result = unsafe { esp_lcd_new_panel_io_i80(bus, &io_config, &mut io) };
+        if result != ESP_OK {
+            unsafe { esp_lcd_del_i80_bus(bus) };
+            anyhow::bail!("esp_lcd_new_panel_io_i80 failed: {}", result);
+        }
+
+        let mut rst = PinDriver::output(rst.into())?;
+        rst.set_high()?; // RST inactive
+
+        let mut pins: Vec<AnyIOPin> = data_pins.into_iter().collect();
+        pins.push(wr);
+        pins.push(dc);
+        pins.push(cs);
+
+        // Start sequence numbers where the ISR counter currently is
+        let done = TRANSFERS_DONE.load(Ordering::Acquire);
+        let mut buffers = [DmaBuffer::new()?, DmaBuffer::new()?, DmaBuffer::new()?];
+        for buffer in buffers.iter_mut() {
+            buffer.last_seq = done;
+        }
+
+        log::info!("LCD_CAM i80 bus ready: {} MHz, {}x{} byte DMA buffers",
+            PIXEL_CLOCK_HZ / 1_000_000, BOUNCE_BUFFER_COUNT, BOUNCE_BUFFER_SIZE);
+
+        // Small delay to ensure stable state
+        FreeRtos::delay_ms(10);
+
+        Ok(Self {
+            bus,
+            io,
+            rst,
+            _pins: pins,
+            buffers,
+            next_buffer: 0,
+            submitted: done,
+            pending_cmd: None,
+            params: [0; MAX_PARAM_BYTES],
+            param_len: 0,
+            mem_cmd: None,
+        })
+    }
+
+    /// Perform hardware reset
+    pub fn reset(&mut self) -> Result<()> {
+        self.wait_idle()?;
+        self.rst.set_high()?;
+        FreeRtos::delay_ms(10);
+        self.rst.set_low()?;
+        FreeRtos::delay_ms(10);
+        self.rst.set_high()?;
+        FreeRtos::delay_ms(120);
+        Ok(())
+    }
+
+    /// Write a command byte
+    pub fn write_command(&mut self, cmd: u8) -> Result<()> {
+        self.flush_pending()?;
+        self.mem_cmd = None;
+
+        if cmd == CMD_RAMWR || cmd == CMD_RAMWRC {
+            // Sent together with the first pixel transaction
+            self.mem_cmd = Some(cmd);
+        } else if is_param_less(cmd) {
+            self.send_param(cmd as i32, &[])?;
+        } else {
+            // Parameters follow through write_data*
+            self.pending_cmd = Some(cmd);
+        }
+        Ok(())
+    }
+
+    /// Write a data byte
+    pub fn write_data(&mut self, data: u8) -> Result<()> {
+        self.write_data_bytes(&[data])
+    }
+
+    /// Write multiple data bytes efficiently
+    pub fn write_data_bytes(&mut self, data: &[u8]) -> Result<()> {
+        if self.mem_cmd.is_some() {
+            return self.stream_bytes(data);
+        }
+
+        if self.pending_cmd.is_none() {
+            log::warn!("LCD_CAM: dropping {} data bytes sent without a command", data.len());
+            return Ok(());
+        }
+
+        let space = MAX_PARAM_BYTES - self.param_len;
+        if data.len() > space {
+            log::warn!("LCD_CAM: parameter overflow, truncating {} bytes", data.len() - space);
+        }
+        let count = data.len().min(space);
+        self.params[self.param_len..self.param_len + count].copy_from_slice(&data[..count]);
+        self.param_len += count;
+        Ok(())
+    }
+
+    /// Write a 16-bit value as two bytes
+    pub fn write_data_16(&mut self, data: u16) -> Result<()> {
+        self.write_data_bytes(&data.to_be_bytes())
+    }
+
+    /// Write multiple pixels of the same color (queued to DMA, returns early)
+    pub fn write_pixels(&mut self, color: u16, count: u32) -> Result<()> {
+        let _span = crate::trace::span(crate::trace::WRITE_PIXELS);
+        self.flush_pending()?;
+
+        let mut remaining = count as usize * 2;
+        if remaining == 0 {
+            return Ok(());
+        }
+
+        // Reuse a buffer that already holds this color, even if it is still in flight
+        let index = match self.buffers.iter().position(|b| b.fill_color == Some(color)) {
+            Some(index) => index,
+            None => {
+                let index = self.take_buffer()?;
+                let [high, low] = color.to_be_bytes();
+                let buffer = &mut self.buffers[index];
+                for pair in buffer.as_mut_slice().chunks_exact_mut(2) {
+                    pair[0] = high;
+                    pair[1] = low;
+                }
+                buffer.fill_color = Some(color);
+                index
+            }
+        };
+
+        while remaining > 0 {
+            let len = remaining.min(BOUNCE_BUFFER_SIZE);
+            self.queue_color(index, len)?;
+            remaining -= len;
+        }
+        Ok(())
+    }
+
+    /// Queue pixel bytes straight from caller memory (e.g. a PSRAM frame buffer)
+    /// without copying through the bounce buffers.
+    ///
+    /// # Safety
+    /// `data` must stay allocated and unmodified until `wait_idle` returns.
+    /// PSRAM data must be 64-byte aligned in address and length; the cache
+    /// writeback rejects anything else.
+    pub unsafe fn write_data_bytes_nocopy(&mut self, data: &[u8]) -> Result<()> {
+        if self.mem_cmd.is_none() {
+            return self.write_data_bytes(data);
+        }
+        self.flush_pending()?;
+
+        for chunk in data.chunks(MAX_TRANSFER_BYTES) {
+            let ptr = chunk.as_ptr() as *mut core::ffi::c_void;
+            if (EXTRAM_DATA_LOW..EXTRAM_DATA_HIGH).contains(&(ptr as usize)) {
+                // DMA reads PSRAM behind the cache - write back what the CPU drew
+                let result = esp_cache_msync(ptr, chunk.len(), CACHE_MSYNC_FLAG_DIR_C2M);
+                if result != ESP_OK {
+                    anyhow::bail!("LCD_CAM cache writeback failed: {}", result);
+                }
+            }
+            self.queue_raw(ptr, chunk.len())?;
+        }
+        Ok(())
+    }
+
+    /// esp_timer time (low 32 bits, us) when the last transaction completed
+    pub fn last_completion_us() -> u32 {
+        LAST_DONE_US.load(Ordering::Relaxed)
+    }
+
+    /// Block until every queued DMA transaction has been clocked out
+    pub fn wait_idle(&mut self) -> Result<()> {
+        self.flush_pending()?;
+        let target = self.submitted;
+        Self::wait_for(target)
+    }
+
+    /// Send a buffered command with its parameters
+    fn flush_pending(&mut self) -> Result<()> {
+        if let Some(cmd) = self.pending_cmd.take() {
+            let len = self.param_len;
+            self.param_len = 0;
+            let params = self.params;
+            self.send_param(cmd as i32, &params[..len])?;
+        }
+        Ok(())
+    }
+
+    /// Blocking command + parameter transfer (esp_lcd orders it after queued pixels)
+    fn send_param(&mut self, cmd: i32, params: &[u8]) -> Result<()> {
+        let ptr = if params.is_empty() {
+            std::ptr::null()
+        } else {
+            params.as_ptr() as *const core::ffi::c_void
+        };
+        let result = unsafe { esp_lcd_panel_io_tx_param(self.io, cmd, ptr, params.len()) };
+        if result != ESP_OK {
+            anyhow::bail!("LCD_CAM tx_param 0x{:02X} failed: {}", cmd, result);
+        }
+        Ok(())
+    }
+
+    /// Copy arbitrary pixel bytes into bounce buffers and queue them
+    fn stream_bytes(&mut self, data: &[u8]) -> Result<()> {
+        for chunk in data.chunks(BOUNCE_BUFFER_SIZE) {
+            let index = self.take_buffer()?;
+            let buffer = &mut self.buffers[index];
+            buffer.as_mut_slice()[..chunk.len()].copy_from_slice(chunk);
+            buffer.fill_color = None;
+            self.queue_color(index, chunk.len())?;
+        }
+        Ok(())
+    }
+
+    /// Pick the next bounce buffer, waiting until the DMA is done with it
+    fn take_buffer(&mut self) -> Result<usize> {
+        let index = self.next_buffer;
+        self.next_buffer = (self.next_buffer + 1) % BOUNCE_BUFFER_COUNT;
+        Self::wait_for(self.buffers[index].last_seq)?;
+        self.buffers[index].fill_color = None;
+        Ok(index)
+    }
+
+    /// Queue a color transaction; the first one after RAMWR carries the command
+    fn queue_color(&mut self, index: usize, len: usize) -> Result<()> {
+        let ptr = self.buffers[index].ptr as *const core::ffi::c_void;
+        self.queue_raw(ptr, len)?;
+        self.buffers[index].last_seq = self.submitted;
+        Ok(())
+    }
+
+    /// Queue `len` bytes at `ptr` as one color transaction
+    fn queue_raw(&mut self, ptr: *const core::ffi::c_void, len: usize) -> Result<()> {
+        let cmd = self.mem_cmd.replace(CMD_RAMWRC).unwrap_or(CMD_RAMWRC);
+        let result = unsafe { esp_lcd_panel_io_tx_color(self.io, cmd as i32, ptr, len) };
+        if result != ESP_OK {
+            anyhow::bail!("LCD_CAM tx_color failed: {}", result);
+        }
+        self.submitted = self.submitted.wrapping_add(1);
+        Ok(())
+    }
+
+    /// Spin until the ISR has completed transaction `seq`
+    fn wait_for(seq: u32) -> Result<()> {
+        let start = unsafe { esp_timer_get_time() };
+        while (TRANSFERS_DONE.load(Ordering::Acquire).wrapping_sub(seq) as i32) < 0 {
+            if unsafe { esp_timer_get_time() } - start > DMA_TIMEOUT_US {
+                anyhow::bail!("LCD_CAM DMA transfer timed out");
+            }
+            core::hint::spin_loop();
+        }
+        Ok(())
+    }
+}
+
+impl Drop for LcdCamBus {
+    fn drop(&mut self) {
+        let _ = self.wait_idle();
+        unsafe {
+            esp_lcd_panel_io_del(self.io);
+            esp_lcd_del_i80_bus(self.bus);
+        }
+    }
+}
@@ -1,18 +1,35 @@
 pub mod colors;
 pub mod font5x7;
 pub mod lcd_bus;
+#[cfg(feature = "esp_lcd_driver")]
+pub mod lcd_cam_bus; // LCD_CAM i80 + GDMA transport
+#[cfg(feature = "esp_lcd_driver")]
+pub mod diagnostics;
 pub mod dirty_rect_manager; // Enhanced dirty rectangle management
+pub mod framebuffer; // Optional PSRAM frame buffer
+pub mod glyph_atlas; // Pre-expanded glyphs for opaque text
+pub mod screen_mirror; // Frame buffer read-back for screenshots
+#[cfg(feature = "esp_lcd_driver")]
+pub mod double_buffer; // Front/back buffers streamed by DMA
 
 // Color type not used - colors are defined as u16 constants
 
 use anyhow::Result;
 use self::font5x7::{FONT_WIDTH, FONT_HEIGHT, get_char_data};
+#[cfg(not(feature = "esp_lcd_driver"))]
 use self::lcd_bus::LcdBus;
+#[cfg(feature = "esp_lcd_driver")]
+use self::lcd_cam_bus::LcdCamBus as LcdBus;
 // use self::perf_metrics::DisplayMetrics;
-use self::dirty_rect_manager::DirtyRectManager;
+pub use self::dirty_rect_manager::DirtyRect;
+use self::dirty_rect_manager::{DirtyRectManager, MAX_DIRTY_RECTS};
+use self::framebuffer::{FrameBuffer, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, FRAMEBUFFER_ORIGIN_X};
+use self::glyph_atlas::{glyphs_that_fit, GlyphAtlas};
+#[cfg(feature = "esp_lcd_driver")]
+use self::double_buffer::{DoubleBuffer, SwapSync};
 use esp_idf_hal::gpio::{AnyIOPin, PinDriver, Output};
 use esp_idf_hal::delay::FreeRtos;
-use std::time::Instant;
+use std::time::{Duration, Instant};
 
 
 // Display boundaries - Discovered values from Arduino testing
@@ -20,6 +37,13 @@ const DISPLAY_X_START: u16 = 10;   // Left boundary offset
 const DISPLAY_Y_START: u16 = 36;   // Top boundary offset
 const DISPLAY_WIDTH: u16 = 300;    // Actual visible width
 const DISPLAY_HEIGHT: u16 = 168;   // Actual visible height
+// Last CASET column the controller addresses; windows must end at or before
+// it once DISPLAY_X_START is added, so no window may span the 320-pixel stride
+const PANEL_LAST_COLUMN: u16 = 319;
+const MAX_WINDOW_X_END: u16 = PANEL_LAST_COLUMN + 1 - DISPLAY_X_START;
+
+// Frame buffer columns are controller columns
+const _: () = assert!(FRAMEBUFFER_ORIGIN_X == DISPLAY_X_START && FRAMEBUFFER_WIDTH == PANEL_LAST_COLUMN + 1);
 
 // Controller dimensions - ST7789 expects these
 const CONTROLLER_WIDTH: u16 = 480;
@@ -27,34 +51,6 @@ const CONTROLLER_HEIGHT: u16 = 320;
 
 // Controller dimensions removed - not used
 
-// Dirty rectangle tracking for optimized rendering
-#[derive(Debug, Clone, Copy)]
-pub struct DirtyRect {
-    pub x: u16,
-    pub y: u16,
-    pub width: u16,
-    pub height: u16,
-}
-
-impl DirtyRect {
-    pub fn new(x: u16, y: u16, width: u16, height: u16) -> Self {
-        Self { x, y, width, height }
-    }
-    
-    pub fn merge(&mut self, other: &DirtyRect) {
-        let x1 = self.x.min(other.x);
-        let y1 = self.y.min(other.y);
-        let x2 = (self.x + self.width).max(other.x + other.width);
-        let y2 = (self.y + self.height).max(other.y + other.height);
-        
-        self.x = x1;
-        self.y = y1;
-        self.width = x2 - x1;
-        self.height = y2 - y1;
-    }
-    
-}
-
 // ST7789 Commands
 const CMD_NOP: u8 = 0x00;
 const CMD_SWRESET: u8 = 0x01;
@@ -76,7 +72,6 @@ const CMD_VDVS: u8 = 0xC4;
 const CMD_FRCTRL2: u8 = 0xC6;
 const CMD_PWRCTRL1: u8 = 0xD0;
 
-#[cfg(not(feature = "esp_lcd_driver"))]
 pub struct DisplayManager {
     lcd_bus: LcdBus,
     backlight_pin: Option<PinDriver<'static, AnyIOPin, Output>>, // Keep backlight alive
@@ -86,10 +81,37 @@ pub struct DisplayManager {
     height: u16,
     last_activity: Instant,
     dirty_rect_manager: DirtyRectManager,
+    // When present, draw calls render here and flush() pushes dirty rects
+    framebuffer: Option<FrameBuffer>,
+    // Front buffer being streamed while `framebuffer` is drawn into
+    #[cfg(feature = "esp_lcd_driver")]
+    double_buffer: Option<DoubleBuffer>,
+    flush_timing: FlushTiming,
+    // Input-to-photon tracking (esp_timer us, low 32 bits): the oldest input
+    // not yet in a flushed frame, the one riding the double-buffered transfer
+    // in flight, and the last latency measured
+    input_pending_us: Option<u32>,
+    #[cfg(feature = "esp_lcd_driver")]
+    input_in_flight_us: Option<u32>,
+    input_latency_us: Option<u32>,
+    glyph_atlas: GlyphAtlas,
+    // Reused block for composing opaque text
+    text_pixels: Vec<u16>,
+    // Cleared while a widget draws and reports its own bounds
+    track_dirty: bool,
     // metrics: DisplayMetrics, // Performance tracking
 }
 
-#[cfg(not(feature = "esp_lcd_driver"))]
+/// Timing of the most recent flush that pushed pixels
+#[derive(Debug, Clone, Copy, Default)]
+pub struct FlushTiming {
+    /// Time the pixels took to reach the panel
+    pub transfer: Duration,
+    /// Time the caller was blocked in flush() (less than `transfer` when
+    /// double buffering overlaps the transfer with rendering)
+    pub blocked: Duration,
+}
+
 impl DisplayManager {
     pub fn new(
         d0: impl Into<AnyIOPin> + 'static,
@@ -137,6 +159,17 @@ impl DisplayManager {
             height: DISPLAY_HEIGHT,
             last_activity: Instant::now(),
             dirty_rect_manager: DirtyRectManager::new(),
+            framebuffer: None,
+            #[cfg(feature = "esp_lcd_driver")]
+            double_buffer: None,
+            flush_timing: FlushTiming::default(),
+            input_pending_us: None,
+            #[cfg(feature = "esp_lcd_driver")]
+            input_in_flight_us: None,
+            input_latency_us: None,
+            glyph_atlas: GlyphAtlas::new(),
+            text_pixels: Vec::new(),
+            track_dirty: true,
             // metrics: DisplayMetrics::new(),
         };
         
@@ -277,26 +310,89 @@ impl DisplayManager {
 
     fn set_window(&mut self, x0: u16, y0: u16, x1: u16, y1: u16) -> Result<()> {
         // Apply display boundaries offsets
-        let x0_offset = x0 + DISPLAY_X_START;
-        let x1_offset = x1 + DISPLAY_X_START;
-        let y0_offset = y0 + DISPLAY_Y_START;
-        let y1_offset = y1 + DISPLAY_Y_START;
-        
+        self.set_controller_window(x0 + DISPLAY_X_START, y0 + DISPLAY_Y_START,
+                                   x1 + DISPLAY_X_START, y1 + DISPLAY_Y_START)
+    }
+
+    /// Set the address window in controller coordinates
+    fn set_controller_window(&mut self, x0: u16, y0: u16, x1: u16, y1: u16) -> Result<()> {
         // Column address set
         self.lcd_bus.write_command(CMD_CASET)?;
-        self.lcd_bus.write_data_16(x0_offset)?;
-        self.lcd_bus.write_data_16(x1_offset)?;
+        self.lcd_bus.write_data_16(x0)?;
+        self.lcd_bus.write_data_16(x1)?;
 
         // Row address set
         self.lcd_bus.write_command(CMD_RASET)?;
-        self.lcd_bus.write_data_16(y0_offset)?;
-        self.lcd_bus.write_data_16(y1_offset)?;
+        self.lcd_bus.write_data_16(y0)?;
+        self.lcd_bus.write_data_16(y1)?;
 
         // Note: RAMWR command removed from here - must be sent before each pixel write
         Ok(())
     }
 
+    /// Switch to frame buffer mode: draw calls render into PSRAM and
+    /// flush() pushes only the dirty rectangles to the panel
+    pub fn enable_framebuffer(&mut self) -> Result<()> {
+        if self.framebuffer.is_some() {
+            return Ok(());
+        }
+        
+        // Start from a black screen so the buffer and the panel agree
+        let mut framebuffer = FrameBuffer::new(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT)?;
+        framebuffer.fill(colors::BLACK);
+        self.framebuffer = Some(framebuffer);
+        self.dirty_rect_manager.clear();
+        self.dirty_rect_manager.add_rect(0, 0, self.width, self.height);
+        self.flush()
+    }
+    
+    /// Add a second frame buffer so rendering overlaps the DMA transfer
+    /// of the previous frame
+    #[cfg(feature = "esp_lcd_driver")]
+    pub fn enable_double_buffering(&mut self, sync: SwapSync) -> Result<()> {
+        if self.double_buffer.is_some() {
+            return Ok(());
+        }
+        self.enable_framebuffer()?;
+        self.flush()?;
+        
+        // The front buffer starts as a copy of what the panel shows
+        let mut front = FrameBuffer::new(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT)?;
+        if let Some(ref fb) = self.framebuffer {
+            front.copy_rect_from(fb, 0, 0, self.width, self.height);
+        }
+        self.double_buffer = Some(DoubleBuffer::new(front, sync));
+        log::info!("Double buffering enabled ({:?})", sync);
+        Ok(())
+    }
+    
+    /// Return to direct drawing and release the PSRAM buffer(s)
+    pub fn disable_framebuffer(&mut self) -> Result<()> {
+        if self.framebuffer.is_some() {
+            self.flush()?;
+            // The DMA may still be reading the front buffer
+            self.lcd_bus.wait_idle()?;
+            #[cfg(feature = "esp_lcd_driver")]
+            {
+                self.double_buffer = None;
+            }
+            self.framebuffer = None;
+        }
+        Ok(())
+    }
+    
+    pub fn is_framebuffer_enabled(&self) -> bool {
+        self.framebuffer.is_some()
+    }
+
     pub fn clear(&mut self, color: u16) -> Result<()> {
+        if let Some(ref mut fb) = self.framebuffer {
+            // Visible area only - the stride padding stays black
+            fb.fill_rect(0, 0, self.width, self.height, color);
+            self.mark_dirty(0, 0, self.width, self.height);
+            return Ok(());
+        }
+        
         // Direct clear - original implementation
         self.set_window(0, 0, self.width - 1, self.height - 1)?;
         
@@ -308,7 +404,7 @@ impl DisplayManager {
         self.lcd_bus.write_pixels(color, total_pixels)?;
         
         // Mark entire screen as dirty
-        self.dirty_rect_manager.add_rect(0, 0, self.width, self.height);
+        self.mark_dirty(0, 0, self.width, self.height);
         
         Ok(())
     }
@@ -343,6 +439,12 @@ impl DisplayManager {
             return Ok(());
         }
 
+        if let Some(ref mut fb) = self.framebuffer {
+            fb.set_pixel(x, y, color);
+            self.mark_dirty(x, y, 1, 1);
+            return Ok(());
+        }
+
         // Direct pixel write - original implementation
         self.set_window(x, y, x, y)?;
         // CRITICAL: Must send RAMWR before pixel data
@@ -350,13 +452,14 @@ impl DisplayManager {
         self.lcd_bus.write_data_16(color)?;
         
         // Track dirty region
-        self.dirty_rect_manager.add_rect(x, y, 1, 1);
+        self.mark_dirty(x, y, 1, 1);
         
         Ok(())
     }
 
     pub fn fill_rect(&mut self, x: u16, y: u16, w: u16, h: u16, color: u16) -> Result<()> {
-        if x >= self.width || y >= self.height {
+        let _span = crate::trace::span(crate::trace::FILL_RECT);
+        if x >= self.width || y >= self.height || w == 0 || h == 0 {
             return Ok(());
         }
 
@@ -365,6 +468,12 @@ impl DisplayManager {
         let actual_width = x1 - x + 1;
         let actual_height = y1 - y + 1;
 
+        if let Some(ref mut fb) = self.framebuffer {
+            fb.fill_rect(x, y, actual_width, actual_height, color);
+            self.mark_dirty(x, y, actual_width, actual_height);
+            return Ok(());
+        }
+
         // Direct fill - original implementation
         self.set_window(x, y, x1, y1)?;
         
@@ -376,11 +485,34 @@ impl DisplayManager {
         self.lcd_bus.write_pixels(color, total_pixels)?;
         
         // Track dirty region
-        self.dirty_rect_manager.add_rect(x, y, actual_width, actual_height);
+        self.mark_dirty(x, y, actual_width, actual_height);
         
         Ok(())
     }
 
+    /// Scroll a region `dx` pixels left, filling the vacated columns with
+    /// `color`. Only possible with the frame buffer, since panel RAM cannot be
+    /// read back over the i80 bus; returns false without touching anything
+    /// otherwise.
+    pub fn scroll_left(&mut self, x: u16, y: u16, w: u16, h: u16, dx: u16, color: u16) -> Result<bool> {
+        let Some(ref mut fb) = self.framebuffer else {
+            return Ok(false);
+        };
+        if x >= self.width || y >= self.height || w == 0 || h == 0 {
+            return Ok(true);
+        }
+
+        let w = w.min(self.width - x);
+        let h = h.min(self.height - y);
+        if dx >= w {
+            fb.fill_rect(x, y, w, h, color);
+        } else {
+            fb.shift_rect_left(x, y, w, h, dx, color);
+        }
+        self.mark_dirty(x, y, w, h);
+        Ok(true)
+    }
+
     pub fn draw_line(&mut self, x0: u16, y0: u16, x1: u16, y1: u16, color: u16) -> Result<()> {
         // Calculate bounding box for the line
         let min_x = x0.min(x1);
@@ -415,7 +547,7 @@ impl DisplayManager {
         }
         
         // Track the entire line's bounding box as dirty
-        self.dirty_rect_manager.add_rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+        self.mark_dirty(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
 
         Ok(())
     }
@@ -427,7 +559,7 @@ impl DisplayManager {
         self.draw_line(x + w - 1, y, x + w - 1, y + h - 1, color)?;
         
         // The entire rectangle area is dirty
-        self.dirty_rect_manager.add_rect(x, y, w, h);
+        self.mark_dirty(x, y, w, h);
         
         Ok(())
     }
@@ -456,7 +588,25 @@ impl DisplayManager {
         Ok(())
     }
     
-    // mark_dirty and clear_dirty_rects removed - dirty rect tracking not implemented
+    /// Record a region touched by a draw primitive
+    fn mark_dirty(&mut self, x: u16, y: u16, w: u16, h: u16) {
+        if self.track_dirty {
+            self.dirty_rect_manager.add_rect(x, y, w, h);
+        }
+    }
+    
+    /// Run a widget's drawing code with per-primitive dirty tracking
+    /// suspended, then record the widget's bounds as a single rect
+    pub fn draw_widget<F>(&mut self, bounds: DirtyRect, draw: F) -> Result<()>
+    where
+        F: FnOnce(&mut Self) -> Result<()>,
+    {
+        let was_tracking = std::mem::replace(&mut self.track_dirty, false);
+        let result = draw(self);
+        self.track_dirty = was_tracking;
+        self.mark_dirty(bounds.x, bounds.y, bounds.width, bounds.height);
+        result
+    }
 
     
     pub fn ensure_display_on(&mut self) -> Result<()> {
@@ -518,7 +668,7 @@ impl DisplayManager {
         // Mark the entire character area as dirty
         let char_width = FONT_WIDTH * scale;
         let char_height = FONT_HEIGHT * scale;
-        self.dirty_rect_manager.add_rect(x, y, char_width as u16, char_height as u16);
+        self.mark_dirty(x, y, char_width as u16, char_height as u16);
         
         Ok(())
     }
@@ -528,25 +678,65 @@ impl DisplayManager {
         let char_width = (FONT_WIDTH * scale + 1) as u16; // +1 for spacing
         let start_x = x;
         
-        for c in text.chars() {
-            if cursor_x + char_width > self.width {
-                break; // Don't draw beyond screen
+        // Only whole characters that fit on screen are drawn
+        let room = glyphs_that_fit(scale, self.width.saturating_sub(x));
+        
+        // Opaque text goes out as one block from the glyph atlas
+        if let Some(bg) = bg_color {
+            let fits = (text.chars().count() as u16).min(room);
+            if fits == 0 {
+                return Ok(());
             }
-            
+            return self.draw_text_field(x, y, fits * char_width - 1, text, color, bg, scale);
+        }
+        
+        for c in text.chars().take(room as usize) {
             self.draw_char(cursor_x, y, c, color, bg_color, scale)?;
             cursor_x += char_width;
         }
         
         // Mark the entire text area as dirty
         if cursor_x > start_x {
-            let text_width = cursor_x - start_x;
+            let text_width = (cursor_x - start_x).min(self.width - start_x);
             let text_height = (FONT_HEIGHT * scale) as u16;
-            self.dirty_rect_manager.add_rect(start_x, y, text_width, text_height);
+            self.mark_dirty(start_x, y, text_width, text_height);
         }
         
         Ok(())
     }
 
+    /// Draw opaque text padded with `bg` to `field_width` pixels, as a single
+    /// window and pixel burst. Replaces a clearing fill_rect + draw_text pair.
+    pub fn draw_text_field(&mut self, x: u16, y: u16, field_width: u16, text: &str, color: u16, bg: u16, scale: u8) -> Result<()> {
+        if x >= self.width || y >= self.height || field_width == 0 {
+            return Ok(());
+        }
+        let w = field_width.min(self.width - x);
+        let h = ((FONT_HEIGHT * scale) as u16).min(self.height - y);
+        
+        let mut pixels = std::mem::take(&mut self.text_pixels);
+        self.glyph_atlas.render_into(&mut pixels, text, color, bg, scale, w, h);
+        
+        let result = if let Some(ref mut fb) = self.framebuffer {
+            fb.blit(x, y, w, h, &pixels);
+            Ok(())
+        } else {
+            self.blit_direct(x, y, w, h, &pixels)
+        };
+        self.text_pixels = pixels;
+        
+        self.mark_dirty(x, y, w, h);
+        result
+    }
+    
+    /// Send a bus-order pixel block straight to the panel
+    fn blit_direct(&mut self, x: u16, y: u16, w: u16, h: u16, pixels: &[u16]) -> Result<()> {
+        self.set_window(x, y, x + w - 1, y + h - 1)?;
+        self.lcd_bus.write_command(CMD_RAMWR)?;
+        let bytes = unsafe { std::slice::from_raw_parts(pixels.as_ptr() as *const u8, pixels.len() * 2) };
+        self.lcd_bus.write_data_bytes(bytes)
+    }
+
     pub fn draw_text_centered(&mut self, y: u16, text: &str, color: u16, bg_color: Option<u16>, scale: u8) -> Result<()> {
         let char_width = (FONT_WIDTH * scale + 1) as u16;
         let text_width = text.len() as u16 * char_width;
@@ -587,7 +777,7 @@ impl DisplayManager {
         }
         
         // Mark the circle's bounding box as dirty
-        self.dirty_rect_manager.add_rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+        self.mark_dirty(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
 
         Ok(())
     }
@@ -621,7 +811,7 @@ impl DisplayManager {
         let max_x = (cx as i32 + r as i32).min(self.width as i32 - 1) as u16;
         let min_y = (cy as i32 - r as i32).max(0) as u16;
         let max_y = (cy as i32 + r as i32).min(self.height as i32 - 1) as u16;
-        self.dirty_rect_manager.add_rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+        self.mark_dirty(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
         
         Ok(())
     }
@@ -639,17 +829,234 @@ impl DisplayManager {
     }
     
     pub fn flush(&mut self) -> Result<()> {
+        let _span = crate::trace::span(crate::trace::DISPLAY_FLUSH);
+        if screen_mirror::active() {
+            self.update_mirror();
+        }
+        if self.dirty_rect_manager.is_empty() {
+            return self.finish_flush();
+        }
+        
+        let start = Instant::now();
+        self.flush_timing.transfer = Duration::ZERO;
+        
+        #[cfg(feature = "esp_lcd_driver")]
+        let result = if self.double_buffer.is_some() {
+            self.present_double_buffered()
+        } else {
+            self.flush_synchronous().inspect(|_| self.input_presented())
+        };
+        #[cfg(not(feature = "esp_lcd_driver"))]
+        let result = self.flush_synchronous().inspect(|_| self.input_presented());
+        
+        self.flush_timing.blocked = start.elapsed();
+        if self.flush_timing.transfer.is_zero() {
+            // Synchronous flush (or first double-buffered frame): all time was on the wire
+            self.flush_timing.transfer = self.flush_timing.blocked;
+        }
+        result
+    }
+    
+    /// Hand the frame about to be shown to attached screen viewers
+    fn update_mirror(&self) {
+        let Some(ref fb) = self.framebuffer else {
+            return;
+        };
+        let mut rects = [(0, 0, 0, 0); MAX_DIRTY_RECTS];
+        let mut rect_count = 0;
+        for rect in self.dirty_rect_manager.rects() {
+            if let Some(clipped) = self.clip_dirty_rect(&rect) {
+                rects[rect_count] = clipped;
+                rect_count += 1;
+            }
+        }
+        screen_mirror::publish(fb, self.width, self.height, &rects[..rect_count]);
+    }
+    
+    /// The UI has reacted to an input whose edge arrived at `at_us`
+    /// (esp_timer); the next flush with dirty regions carries the response
+    pub fn note_input(&mut self, at_us: i64) {
+        self.input_pending_us.get_or_insert(at_us as u32);
+    }
+    
+    /// Input-to-photon latency measured since the last call, in us. With
+    /// double buffering it is known one flush later, once the frame is off the wire.
+    pub fn take_input_latency_us(&mut self) -> Option<u32> {
+        self.input_latency_us.take()
+    }
+    
+    /// A synchronous flush has returned, so its pixels are on the panel
+    fn input_presented(&mut self) {
+        if let Some(at) = self.input_pending_us.take() {
+            let now = unsafe { esp_idf_sys::esp_timer_get_time() } as u32;
+            self.input_latency_us = Some(now.wrapping_sub(at));
+        }
+    }
+    
+    /// Timing of the most recent flush that had dirty regions
+    pub fn flush_timing(&self) -> FlushTiming {
+        self.flush_timing
+    }
+    
+    /// Nothing dirty - only make sure queued DMA work is done in single-buffer modes
+    fn finish_flush(&mut self) -> Result<()> {
+        #[cfg(feature = "esp_lcd_driver")]
+        if self.double_buffer.is_some() {
+            return Ok(());
+        }
+        self.lcd_bus.wait_idle()
+    }
+    
+    fn flush_synchronous(&mut self) -> Result<()> {
+        if self.framebuffer.is_some() {
+            return self.flush_framebuffer();
+        }
+        
         // Non-frame buffer path - just track dirty regions
-        if !self.dirty_rect_manager.is_empty() {
-            // Get statistics for debugging
-            let (rect_count, merge_count, _update_count) = self.dirty_rect_manager.get_stats();
-            if rect_count > 5 {
-                log::debug!("Dirty rectangles: {} (merges: {})", rect_count, merge_count);
+        // Get statistics for debugging
+        let (rect_count, merge_count, _update_count) = self.dirty_rect_manager.get_stats();
+        if rect_count > 5 {
+            log::debug!("Dirty rectangles: {} (merges: {})", rect_count, merge_count);
+        }
+        
+        // Pixels already went out with each draw call
+        self.dirty_rect_manager.clear();
+        
+        // Wait for any queued DMA pixel transfers to finish
+        self.lcd_bus.wait_idle()?;
+        Ok(())
+    }
+    
+    /// Copy the rects out so the bus can be borrowed while pushing
+    fn take_dirty_rects(&mut self) -> ([DirtyRect; MAX_DIRTY_RECTS], usize) {
+        let mut rects = [DirtyRect::new(0, 0, 0, 0); MAX_DIRTY_RECTS];
+        let mut rect_count = 0;
+        for rect in self.dirty_rect_manager.rects() {
+            rects[rect_count] = rect;
+            rect_count += 1;
+        }
+        self.dirty_rect_manager.clear();
+        (rects, rect_count)
+    }
+    
+    /// Clip a dirty rect to the visible area as (x, y, w, h)
+    fn clip_dirty_rect(&self, rect: &DirtyRect) -> Option<(u16, u16, u16, u16)> {
+        // Dirty rects are not clipped when recorded (e.g. draw_rect)
+        if rect.x >= self.width || rect.y >= self.height || rect.width == 0 || rect.height == 0 {
+            return None;
+        }
+        let x1 = (rect.x + rect.width).min(self.width);
+        let y1 = (rect.y + rect.height).min(self.height);
+        Some((rect.x, rect.y, x1 - rect.x, y1 - rect.y))
+    }
+    
+    /// Push each dirty rectangle from the frame buffer, one window per rect
+    fn flush_framebuffer(&mut self) -> Result<()> {
+        let (rects, rect_count) = self.take_dirty_rects();
+        
+        for rect in &rects[..rect_count] {
+            let Some((x, y, w, h)) = self.clip_dirty_rect(rect) else {
+                continue;
+            };
+            let w = w.min(MAX_WINDOW_X_END - x);
+            
+            self.set_window(x, y, x + w - 1, y + h - 1)?;
+            self.lcd_bus.write_command(CMD_RAMWR)?;
+            
+            if let Some(ref fb) = self.framebuffer {
+                for row in y..y + h {
+                    self.lcd_bus.write_data_bytes(fb.row_bytes(x, row, w))?;
+                }
             }
+        }
+        
+        if rect_count > 5 {
+            log::debug!("Frame buffer flush: {} rects", rect_count);
+        }
+        
+        self.lcd_bus.wait_idle()?;
+        Ok(())
+    }
+    
+    /// Swap buffers and start streaming the finished frame; returns while the
+    /// DMA is still sending it so the caller can render the next one
+    #[cfg(feature = "esp_lcd_driver")]
+    fn present_double_buffered(&mut self) -> Result<()> {
+        // Frame N-1 must be off the wire before its buffer becomes the draw target
+        self.lcd_bus.wait_idle()?;
+        
+        let (rects, rect_count) = self.take_dirty_rects();
+        let (mut pipeline, rendered) = match (self.double_buffer.take(), self.framebuffer.take()) {
+            (Some(pipeline), Some(rendered)) => (pipeline, rendered),
+            (pipeline, rendered) => {
+                self.double_buffer = pipeline;
+                self.framebuffer = rendered;
+                return Ok(());
+            }
+        };
+        
+        if let Some(transfer) = pipeline.transfer_finished(LcdBus::last_completion_us()) {
+            self.flush_timing.transfer = transfer;
+        }
+        if let Some(at) = self.input_in_flight_us.take() {
+            self.input_latency_us = Some(LcdBus::last_completion_us().wrapping_sub(at));
+        }
+        
+        pipeline.wait_for_swap();
+        let mut back = pipeline.swap(rendered);
+        pipeline.transfer_started(unsafe { esp_idf_sys::esp_timer_get_time() } as u32);
+        self.input_in_flight_us = self.input_pending_us.take();
+        let result = self.stream_front_buffer(pipeline.front(), &rects[..rect_count]);
+        
+        // Bring the new back buffer up to date while the DMA reads the front
+        for rect in &rects[..rect_count] {
+            if let Some((x, y, w, h)) = self.clip_dirty_rect(rect) {
+                back.copy_rect_from(pipeline.front(), x, y, w, h);
+            }
+        }
+        
+        self.framebuffer = Some(back);
+        self.double_buffer = Some(pipeline);
+        result
+    }
+    
+    /// Queue the dirty rows straight from PSRAM, one transfer per band
+    #[cfg(feature = "esp_lcd_driver")]
+    fn stream_front_buffer(&mut self, front: &FrameBuffer, rects: &[DirtyRect]) -> Result<()> {
+        // Whole buffer rows are contiguous and cache-line aligned, so each
+        // band of dirty rows streams in place as a single window; the padding
+        // columns either side of the visible area land on the hidden columns
+        let mut bands = [(0u16, 0u16); MAX_DIRTY_RECTS];
+        let mut band_count = 0;
+        for rect in rects {
+            if let Some((_, y, _, h)) = self.clip_dirty_rect(rect) {
+                bands[band_count] = (y, y + h);
+                band_count += 1;
+            }
+        }
+        
+        // Overlapping and touching rects share their rows
+        let bands = &mut bands[..band_count];
+        bands.sort_unstable();
+        let mut merged = 0;
+        for i in 0..bands.len() {
+            if merged > 0 && bands[i].0 <= bands[merged - 1].1 {
+                bands[merged - 1].1 = bands[merged - 1].1.max(bands[i].1);
+            } else {
+                bands[merged] = bands[i];
+                merged += 1;
+            }
+        }
+        
+        for &(y0, y1) in &bands[..merged] {
+            self.set_controller_window(0, y0 + DISPLAY_Y_START, PANEL_LAST_COLUMN, y1 - 1 + DISPLAY_Y_START)?;
+            self.lcd_bus.write_command(CMD_RAMWR)?;
             
-            // For now, we'll still do a full refresh but track what changed
-            // In the future, we can optimize to only update the dirty regions
-            self.dirty_rect_manager.clear();
+            // SAFETY: the front buffer is not written again until the next
+            // present has waited for the bus to go idle
+            unsafe {
+                self.lcd_bus.write_data_bytes_nocopy(front.band_bytes(y0, y1 - y0))?;
+            }
         }
         Ok(())
     }
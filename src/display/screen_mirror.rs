@@ -0,0 +1,158 @@
+// Read-back copy of the frame buffer for screenshots and live view
+//
+// DisplayManager lives on the main task, so HTTP handlers cannot read its
+// frame buffer directly. While at least one viewer is attached, flush() copies
+// every dirty rectangle into a PSRAM mirror and widens each viewer's pending
+// region. Viewers read the mirror back one row at a time, so however slow the
+// client, the UI never waits on more than a single row copy. With no viewers
+// the flush hook is one atomic load.
+
+use anyhow::Result;
+use std::sync::atomic::{AtomicU32, Ordering};
+use std::sync::{Condvar, Mutex, MutexGuard, OnceLock};
+use std::time::Duration;
+use super::framebuffer::{FrameBuffer, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT};
+use super::DirtyRect;
+
+/// Concurrent viewers, each holding one streaming socket
+pub const MAX_VIEWERS: usize = crate::network::server_config::MAX_STREAMING_SOCKETS as usize;
+
+static VIEWERS: AtomicU32 = AtomicU32::new(0);
+static MIRROR: OnceLock<Mirror> = OnceLock::new();
+
+struct Mirror {
+    state: Mutex<State>,
+    changed: Condvar,
+}
+
+#[derive(Clone, Copy, Default)]
+struct Slot {
+    in_use: bool,
+    // Waiting for the mirror's first full copy
+    awaiting_keyframe: bool,
+    // Region changed since the viewer last took it
+    pending: Option<DirtyRect>,
+}
+
+struct State {
+    // Allocated by the first viewer, freed by the last
+    frame: Option<FrameBuffer>,
+    width: u16,
+    height: u16,
+    // Set when a new viewer needs the whole screen copied on the next flush
+    needs_full: bool,
+    slots: [Slot; MAX_VIEWERS],
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|poisoned| poisoned.into_inner())
+}
+
+fn mirror() -> &'static Mirror {
+    MIRROR.get_or_init(|| Mirror {
+        state: Mutex::new(State {
+            frame: None,
+            width: 0,
+            height: 0,
+            needs_full: false,
+            slots: [Slot::default(); MAX_VIEWERS],
+        }),
+        changed: Condvar::new(),
+    })
+}
+
+/// Whether flush() has to feed the mirror
+#[inline]
+pub fn active() -> bool {
+    VIEWERS.load(Ordering::Relaxed) > 0
+}
+
+/// Copy the clipped dirty rects `(x, y, w, h)` of the frame about to be shown.
+/// Called from DisplayManager::flush() before the rects are cleared.
+pub(crate) fn publish(source: &FrameBuffer, width: u16, height: u16, rects: &[(u16, u16, u16, u16)]) {
+    let Some(mirror) = MIRROR.get() else { return };
+    let mut state = lock(&mirror.state);
+    let State { frame, slots, needs_full, .. } = &mut *state;
+    let Some(frame) = frame.as_mut() else { return };
+
+    let full = DirtyRect::new(0, 0, width, height);
+    if *needs_full {
+        frame.copy_rect_from(source, 0, 0, width, height);
+        for slot in slots.iter_mut().filter(|slot| slot.in_use && slot.awaiting_keyframe) {
+            slot.awaiting_keyframe = false;
+            slot.pending = Some(full);
+        }
+        *needs_full = false;
+    }
+    for &(x, y, w, h) in rects {
+        frame.copy_rect_from(source, x, y, w, h);
+        let rect = DirtyRect::new(x, y, w, h);
+        for slot in slots.iter_mut().filter(|slot| slot.in_use && !slot.awaiting_keyframe) {
+            match slot.pending {
+                Some(ref mut pending) => pending.merge(&rect),
+                None => slot.pending = Some(rect),
+            }
+        }
+    }
+    state.width = width;
+    state.height = height;
+    drop(state);
+    mirror.changed.notify_all();
+}
+
+/// Attach a viewer; its first region is the whole screen
+pub fn subscribe() -> Result<Viewer> {
+    let mirror = mirror();
+    let mut state = lock(&mirror.state);
+    let Some(index) = state.slots.iter().position(|slot| !slot.in_use) else {
+        anyhow::bail!("All {} screen viewer slots are in use", MAX_VIEWERS);
+    };
+    if state.frame.is_none() {
+        state.frame = Some(FrameBuffer::new(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT)?);
+    }
+    state.slots[index] = Slot { in_use: true, awaiting_keyframe: true, pending: None };
+    state.needs_full = true;
+    VIEWERS.fetch_add(1, Ordering::Relaxed);
+    Ok(Viewer { index })
+}
+
+pub struct Viewer {
+    index: usize,
+}
+
+impl Viewer {
+    /// Take the region changed since the last call, waiting up to `timeout`
+    /// for the display to flush one. None means nothing changed, or the
+    /// display has no frame buffer to read back.
+    pub fn wait_changed(&self, timeout: Duration) -> Option<DirtyRect> {
+        let mirror = mirror();
+        let state = lock(&mirror.state);
+        let (mut state, _) = mirror.changed
+            .wait_timeout_while(state, timeout, |state| state.slots[self.index].pending.is_none())
+            .unwrap_or_else(|poisoned| poisoned.into_inner());
+        state.slots[self.index].pending.take()
+    }
+
+    /// Copy `out.len() / 2` pixels of row `y` from column `x`, in bus order
+    /// (big-endian RGB565). Rows are read one lock at a time, so a region
+    /// may mix two frames; the newer frame's rects are pending again and
+    /// repair it on the next delta.
+    pub fn read_row(&self, x: u16, y: u16, out: &mut [u8]) {
+        let state = lock(&mirror().state);
+        if let Some(ref frame) = state.frame {
+            out.copy_from_slice(frame.row_bytes(x, y, (out.len() / 2) as u16));
+        }
+    }
+}
+
+impl Drop for Viewer {
+    fn drop(&mut self) {
+        let mut state = lock(&mirror().state);
+        state.slots[self.index] = Slot::default();
+        if VIEWERS.fetch_sub(1, Ordering::Relaxed) == 1 {
+            // Give the PSRAM back; the next viewer starts from a full copy
+            state.frame = None;
+            state.needs_full = false;
+        }
+    }
+}
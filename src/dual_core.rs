@@ -1,9 +1,17 @@
 // Dual-core processing implementation for ESP32-S3
 // Distributes work across both Xtensa LX7 cores for maximum performance
+//
+// Jobs go to a pinned executor with one worker per core. Each worker owns a
+// deque per JobClass and serves them by weighted round robin, so display and
+// network jobs stay responsive while background hashing or compression still
+// makes progress. Unpinned jobs are queued on Core 1; the Core 0 worker runs
+// at idle priority and steals them when the main loop leaves the core idle.
 
 use esp_idf_sys::*;
-use std::sync::{Arc, Mutex};
-use std::sync::mpsc::{channel, Sender, Receiver};
+use std::collections::VecDeque;
+use std::sync::{Mutex, MutexGuard, OnceLock};
+use std::sync::atomic::{AtomicBool, AtomicPtr, Ordering};
+use std::sync::mpsc::{sync_channel, Receiver};
 use log::*;
 
 // Core affinity constants
@@ -12,64 +20,339 @@ pub const CORE_1: i32 = 1;
 
 // Task priorities (higher number = higher priority)
 pub const PRIORITY_NORMAL: u8 = 10;
-pub const _PRIORITY_LOW: u8 = 5;
+pub const PRIORITY_LOW: u8 = 5;
+/// Same as the FreeRTOS idle task: only runs when nothing else wants the core
+pub const PRIORITY_IDLE: u8 = 0;
 
 // Stack sizes
 pub const _STACK_SIZE_LARGE: usize = 8192;
 pub const STACK_SIZE_NORMAL: usize = 4096;
 pub const _STACK_SIZE_SMALL: usize = 2048;
+/// Workers run offloaded HTTP handlers (/metrics, history, logs, backup),
+/// which format floats, serialize JSON and carry a 512 B encoder scratch
+/// buffer; the httpd task they replace has 24 KB
+const WORKER_STACK_SIZE: usize = 12 * 1024;
 
-/// Work item that can be processed on either core
+/// How long an idle worker sleeps before looking for work to steal
+const IDLE_POLL_TICKS: TickType_t = (100 * configTICK_RATE_HZ / 1000) as TickType_t;
+
+/// Scheduling class of a job
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum JobClass {
+    Display,
+    Network,
+    Background,
+}
+
+const CLASS_COUNT: usize = 3;
+
+/// Jobs taken from each class per round, in class order
+const CLASS_WEIGHTS: [u8; CLASS_COUNT] = [4, 2, 1];
+
+/// Kind of work, used for the scheduling class and per-kind statistics
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
 pub enum WorkItem {
-    _UpdateSensors,
-    _RenderDisplay,
-    _ProcessNetwork,
-    _HandleOta,
+    UpdateSensors,
+    RenderDisplay,
+    ProcessNetwork,
+    HandleOta,
+}
+
+impl WorkItem {
+    pub const COUNT: usize = 4;
+    pub const ALL: [WorkItem; Self::COUNT] = [
+        WorkItem::UpdateSensors,
+        WorkItem::RenderDisplay,
+        WorkItem::ProcessNetwork,
+        WorkItem::HandleOta,
+    ];
+
+    pub fn class(self) -> JobClass {
+        match self {
+            WorkItem::RenderDisplay => JobClass::Display,
+            WorkItem::UpdateSensors | WorkItem::ProcessNetwork => JobClass::Network,
+            WorkItem::HandleOta => JobClass::Background,
+        }
+    }
+
+    pub fn name(self) -> &'static str {
+        match self {
+            WorkItem::UpdateSensors => "sensors",
+            WorkItem::RenderDisplay => "display",
+            WorkItem::ProcessNetwork => "network",
+            WorkItem::HandleOta => "ota",
+        }
+    }
+}
+
+/// Number of log2 buckets; the last one collects everything from ~4 s up
+pub const LATENCY_BUCKETS: usize = 24;
+
+/// Log2 histogram of job latencies. Bucket n counts values below 2^n us.
+#[derive(Debug, Default, Clone, Copy)]
+pub struct LatencyHistogram {
+    pub buckets: [u32; LATENCY_BUCKETS],
+    pub count: u32,
+    pub max_us: u32,
+}
+
+impl LatencyHistogram {
+    pub fn record(&mut self, us: u32) {
+        let bucket = (u32::BITS - us.leading_zeros()) as usize;
+        self.buckets[bucket.min(LATENCY_BUCKETS - 1)] += 1;
+        self.count = self.count.saturating_add(1);
+        self.max_us = self.max_us.max(us);
+    }
+
+    /// Upper bound of the bucket holding the given percentile (0-100)
+    pub fn percentile_us(&self, percentile: u32) -> u32 {
+        if self.count == 0 {
+            return 0;
+        }
+        let rank = (self.count as u64 * percentile.min(100) as u64).div_ceil(100).max(1);
+        let mut seen = 0u64;
+        for (bucket, &n) in self.buckets.iter().enumerate() {
+            seen += n as u64;
+            if seen >= rank {
+                let upper = (1u64 << bucket) - 1;
+                return upper.min(self.max_us as u64) as u32;
+            }
+        }
+        self.max_us
+    }
+}
+
+struct Job {
+    item: WorkItem,
+    // Pinned jobs never migrate, so they run in submission order per class
+    pinned: bool,
+    queued_at_us: i64,
+    run: Box<dyn FnOnce() + Send>,
+}
+
+struct Worker {
+    queues: [Mutex<VecDeque<Job>>; CLASS_COUNT],
+    task: AtomicPtr<tskTaskControlBlock>,
+    busy: AtomicBool,
+}
+
+impl Worker {
+    fn new() -> Self {
+        Self {
+            queues: std::array::from_fn(|_| Mutex::new(VecDeque::new())),
+            task: AtomicPtr::new(std::ptr::null_mut()),
+            busy: AtomicBool::new(false),
+        }
+    }
+
+    fn notify(&self) {
+        let task = self.task.load(Ordering::Acquire);
+        if !task.is_null() {
+            unsafe {
+                xTaskGenericNotify(task, 0, 1, eNotifyAction_eSetBits, std::ptr::null_mut());
+            }
+        }
+    }
+}
+
+/// Result of a job submitted with spawn()
+pub struct JobHandle<R> {
+    result: Receiver<R>,
+}
+
+impl<R> JobHandle<R> {
+    /// Block until the job has run. Must not be called from a job pinned
+    /// to the same core, which would wait on itself.
+    pub fn wait(self) -> Option<R> {
+        self.result.recv().ok()
+    }
+}
+
+static PROCESSOR: OnceLock<DualCoreProcessor> = OnceLock::new();
+
+/// The running processor, None until DualCoreProcessor::init() was called
+pub fn processor() -> Option<&'static DualCoreProcessor> {
+    PROCESSOR.get()
 }
 
 /// Dual-core work distributor
 pub struct DualCoreProcessor {
-    _work_sender: Sender<WorkItem>,
-    stats: Arc<Mutex<ProcessorStats>>,
+    workers: [Worker; 2],
+    stats: Mutex<ProcessorStats>,
 }
 
-#[derive(Debug, Default)]
+#[derive(Debug, Default, Clone)]
 pub struct ProcessorStats {
     pub core0_tasks: u32,
     pub core1_tasks: u32,
     pub total_tasks: u32,
     pub avg_task_time_us: u32,
+    /// Jobs the Core 0 worker took from Core 1 or vice versa
+    pub steals: u32,
+    /// Submit-to-completion latency, indexed by WorkItem
+    pub latency: [LatencyHistogram; WorkItem::COUNT],
+}
+
+impl ProcessorStats {
+    pub fn latency_of(&self, item: WorkItem) -> &LatencyHistogram {
+        &self.latency[item as usize]
+    }
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|poisoned| poisoned.into_inner())
 }
 
 impl DualCoreProcessor {
-    /// Create a new dual-core processor
-    pub fn new() -> Self {
-        let (tx, rx) = channel::<WorkItem>();
-        let stats = Arc::new(Mutex::new(ProcessorStats::default()));
-        
-        // Start worker on Core 1 (Core 0 runs main task)
-        let stats_clone = stats.clone();
-        let rx = Arc::new(Mutex::new(rx));
-        
-        Self::spawn_worker(rx, stats_clone, CORE_1);
-        
-        Self {
-            _work_sender: tx,
-            stats,
+    /// Start the workers on both cores. Later calls return the running instance.
+    pub fn init() -> &'static Self {
+        let mut created = false;
+        let processor = PROCESSOR.get_or_init(|| {
+            created = true;
+            Self {
+                workers: [Worker::new(), Worker::new()],
+                stats: Mutex::new(ProcessorStats::default()),
+            }
+        });
+
+        if created {
+            // Core 0 runs the main loop, so its worker only soaks up idle time
+            processor.spawn_worker(CORE_0, PRIORITY_IDLE);
+            processor.spawn_worker(CORE_1, PRIORITY_LOW);
         }
+        processor
     }
-    
-    
+
     /// Get current processor statistics
     pub fn get_stats(&self) -> ProcessorStats {
-        self.stats.lock()
-            .map(|stats| ProcessorStats {
-                core0_tasks: stats.core0_tasks,
-                core1_tasks: stats.core1_tasks,
-                total_tasks: stats.total_tasks,
-                avg_task_time_us: stats.avg_task_time_us,
-            })
-            .unwrap_or_default()
+        lock(&self.stats).clone()
+    }
+
+    /// Queue a job on Core 1; an idle Core 0 may steal it
+    pub fn submit<F>(&self, item: WorkItem, job: F)
+    where
+        F: FnOnce() + Send + 'static,
+    {
+        self.enqueue(CORE_1 as usize, false, item, Box::new(job));
+    }
+
+    /// Queue a job that must run on `core`. Pinned jobs of one class run in
+    /// the order they were submitted.
+    pub fn submit_pinned<F>(&self, item: WorkItem, core: i32, job: F)
+    where
+        F: FnOnce() + Send + 'static,
+    {
+        self.enqueue(core as usize & 1, true, item, Box::new(job));
+    }
+
+    /// Like submit(), returning a handle to the job's result
+    pub fn spawn<R, F>(&self, item: WorkItem, job: F) -> JobHandle<R>
+    where
+        R: Send + 'static,
+        F: FnOnce() -> R + Send + 'static,
+    {
+        let (tx, rx) = sync_channel(1);
+        self.submit(item, move || { let _ = tx.send(job()); });
+        JobHandle { result: rx }
+    }
+
+    /// Like submit_pinned(), returning a handle to the job's result
+    pub fn spawn_pinned<R, F>(&self, item: WorkItem, core: i32, job: F) -> JobHandle<R>
+    where
+        R: Send + 'static,
+        F: FnOnce() -> R + Send + 'static,
+    {
+        let (tx, rx) = sync_channel(1);
+        self.submit_pinned(item, core, move || { let _ = tx.send(job()); });
+        JobHandle { result: rx }
+    }
+
+    fn enqueue(&self, core: usize, pinned: bool, item: WorkItem, run: Box<dyn FnOnce() + Send>) {
+        let job = Job {
+            item,
+            pinned,
+            queued_at_us: unsafe { esp_timer_get_time() },
+            run,
+        };
+        let home = &self.workers[core];
+        lock(&home.queues[item.class() as usize]).push_back(job);
+        home.notify();
+
+        // Let the other worker steal it rather than wait behind a long job
+        if !pinned && home.busy.load(Ordering::Acquire) {
+            self.workers[core ^ 1].notify();
+        }
+    }
+
+    /// Next job for `core`: weighted round robin over its own queues, then
+    /// the oldest unpinned job of the other core. Returns whether it was stolen.
+    fn next_job(&self, core: usize, credits: &mut [u8; CLASS_COUNT]) -> Option<(Job, bool)> {
+        for _ in 0..2 {
+            for class in 0..CLASS_COUNT {
+                if credits[class] == 0 {
+                    continue;
+                }
+                if let Some(job) = lock(&self.workers[core].queues[class]).pop_front() {
+                    credits[class] -= 1;
+                    return Some((job, false));
+                }
+            }
+            // Every class with work left has used its share; start a new round
+            *credits = CLASS_WEIGHTS;
+        }
+
+        for queue in &self.workers[core ^ 1].queues {
+            let mut queue = lock(queue);
+            if let Some(index) = queue.iter().position(|job| !job.pinned) {
+                return queue.remove(index).map(|job| (job, true));
+            }
+        }
+        None
+    }
+
+    fn record(&self, core: usize, item: WorkItem, latency_us: i64, run_us: i64, stolen: bool) {
+        let mut stats = lock(&self.stats);
+        if core == CORE_0 as usize {
+            stats.core0_tasks += 1;
+        } else {
+            stats.core1_tasks += 1;
+        }
+        if stolen {
+            stats.steals += 1;
+        }
+        stats.total_tasks += 1;
+
+        // Running average over all jobs
+        let total = stats.total_tasks as u64;
+        stats.avg_task_time_us =
+            ((stats.avg_task_time_us as u64 * (total - 1) + run_us.max(0) as u64) / total) as u32;
+        stats.latency[item as usize].record(latency_us.clamp(0, u32::MAX as i64) as u32);
+    }
+
+    fn run_worker(&self, core: usize) {
+        let worker = &self.workers[core];
+        worker.task.store(unsafe { xTaskGetCurrentTaskHandle() }, Ordering::Release);
+        info!("Worker task started on core {}", Self::current_core());
+
+        let mut credits = CLASS_WEIGHTS;
+        loop {
+            match self.next_job(core, &mut credits) {
+                Some((job, stolen)) => {
+                    worker.busy.store(true, Ordering::Release);
+                    let started = unsafe { esp_timer_get_time() };
+                    (job.run)();
+                    let finished = unsafe { esp_timer_get_time() };
+                    self.record(core, job.item, finished - job.queued_at_us, finished - started, stolen);
+                }
+                None => {
+                    worker.busy.store(false, Ordering::Release);
+                    // A notification sent since the last wait returns immediately
+                    unsafe {
+                        xTaskGenericNotifyWait(0, 0, u32::MAX, std::ptr::null_mut(), IDLE_POLL_TICKS);
+                    }
+                }
+            }
+        }
     }
     
     /// Get the current core ID
@@ -126,87 +409,19 @@ impl DualCoreProcessor {
         Ok(task_handle)
     }
     
-    /// Spawn a worker task on a specific core
-    fn spawn_worker(
-        receiver: Arc<Mutex<Receiver<WorkItem>>>,
-        stats: Arc<Mutex<ProcessorStats>>,
-        core: i32,
-    ) {
-        let worker_fn = move || {
-            info!("Worker task started on core {}", Self::current_core());
-            
-            loop {
-                // Try to receive work
-                let work_item = {
-                    if let Ok(rx) = receiver.lock() {
-                        match rx.recv() {
-                            Ok(item) => Some(item),
-                            Err(_) => {
-                                warn!("Work channel closed, worker exiting");
-                                break;
-                            }
-                        }
-                    } else {
-                        None
-                    }
-                };
-                
-                if let Some(work) = work_item {
-                    let start_time = unsafe { esp_timer_get_time() };
-                    
-                    // Process work item
-                    match work {
-                        WorkItem::_UpdateSensors => {
-                            debug!("Processing sensor update on core {}", Self::current_core());
-                            // Sensor update logic would go here
-                        }
-                        WorkItem::_RenderDisplay => {
-                            debug!("Processing display render on core {}", Self::current_core());
-                            // Display rendering logic would go here
-                        }
-                        WorkItem::_ProcessNetwork => {
-                            debug!("Processing network task on core {}", Self::current_core());
-                            // Network processing logic would go here
-                        }
-                        WorkItem::_HandleOta => {
-                            debug!("Processing OTA task on core {}", Self::current_core());
-                            // OTA handling logic would go here
-                        }
-                    }
-                    
-                    let elapsed_us = unsafe { esp_timer_get_time() - start_time };
-                    
-                    // Update statistics
-                    if let Ok(mut stats) = stats.lock() {
-                        if Self::current_core() == CORE_0 {
-                            stats.core0_tasks += 1;
-                        } else {
-                            stats.core1_tasks += 1;
-                        }
-                        
-                        // Update average (simple moving average)
-                        stats.avg_task_time_us = 
-                            (stats.avg_task_time_us * (stats.total_tasks - 1) + elapsed_us as u32) 
-                            / stats.total_tasks;
-                    }
-                }
-                
-                // Small delay to prevent busy waiting
-                unsafe { vTaskDelay(1); }
-            }
-        };
-        
+    /// Spawn the worker task for a core
+    fn spawn_worker(&'static self, core: i32, priority: u8) {
+        let name = if core == CORE_0 { "worker0" } else { "worker1" };
         if let Err(e) = Self::create_pinned_task(
-            "worker",
-            worker_fn,
+            name,
+            move || self.run_worker(core as usize),
             core,
-            PRIORITY_NORMAL,
-            STACK_SIZE_NORMAL,
+            priority,
+            WORKER_STACK_SIZE,
         ) {
             error!("Failed to create worker task: {}", e);
         }
     }
-    
 }
 
 /// CPU load monitoring using FreeRTOS idle task statistics
@@ -238,4 +453,20 @@ mod tests {
         let core = DualCoreProcessor::current_core();
         assert!(core == CORE_0 || core == CORE_1);
     }
-}
\ No newline at end of file
+    
+    #[test]
+    fn test_latency_percentiles() {
+        let mut histogram = LatencyHistogram::default();
+        assert_eq!(histogram.percentile_us(50), 0);
+
+        for us in [0, 10, 20, 30, 40, 50, 60, 70, 80, 5000] {
+            histogram.record(us);
+        }
+        assert_eq!(histogram.count, 10);
+        assert_eq!(histogram.max_us, 5000);
+        // 40, 50 and 60 share the 32-63 us bucket
+        assert_eq!(histogram.percentile_us(50), 63);
+        // The outlier is capped at the recorded maximum, not its bucket bound
+        assert_eq!(histogram.percentile_us(100), 5000);
+    }
+}
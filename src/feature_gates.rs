@@ -6,6 +6,8 @@ use log::{info, warn};
 pub const STATIC_FILES_MIN_HEAP_KB: u32 = 100;  // 100KB minimum for static files
 pub const SSE_MIN_HEAP_KB: u32 = 80;            // 80KB minimum for SSE
 pub const SSE_PER_CLIENT_KB: u32 = 10;          // 10KB per SSE client
+#[cfg(feature = "bench")]
+pub const BENCH_MIN_HEAP_KB: u32 = 60;          // 60KB for the benchmark buffers
 
 #[derive(Debug, Clone, Copy)]
 pub struct FeatureStatus {
@@ -44,4 +46,27 @@ impl FeatureStatus {
     }
     
     // Removed: verbose status logger
-}
\ No newline at end of file
+}
+
+/// Run the benchmark suite (src/bench.rs) on its own thread and log the
+/// results as one `BENCH_JSON` line, the format the host runner writes
+#[cfg(feature = "bench")]
+pub fn start_benchmarks() {
+    let free_kb = unsafe { esp_get_free_heap_size() } / 1024;
+    if free_kb < BENCH_MIN_HEAP_KB {
+        warn!("FEATURES: Benchmarks - DISABLED (need {} KB, have {} KB)",
+              BENCH_MIN_HEAP_KB, free_kb);
+        return;
+    }
+    let spawned = std::thread::Builder::new()
+        .name("bench".to_string())
+        .stack_size(12 * 1024)
+        .spawn(|| {
+            let mut bencher = crate::bench::Bencher::new(crate::bench::Config::DEVICE);
+            crate::bench::run_suite(&mut bencher);
+            info!("BENCH_JSON {}", serde_json::to_string(bencher.results()).unwrap_or_default());
+        });
+    if let Err(e) = spawned {
+        warn!("FEATURES: Benchmarks not started: {}", e);
+    }
+}
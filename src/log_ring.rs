@@ -0,0 +1,345 @@
+// Lock-free ring of binary log records shared by telnet and the log APIs
+//
+// The logger used to format a String per record and push it through two
+// mutex-guarded buffers. Now it writes one fixed-size record into this ring
+// and nothing else: writers claim a slot with a single fetch_add, so any task
+// on either core can log without locking or allocating. A record keeps the
+// level, timestamp and the &'static module path; a message without arguments
+// is kept as its &'static format string, anything else is formatted straight
+// into the record's inline buffer. Text lines are only built when telnet,
+// /api/logs or /api/logs/recent read the ring.
+//
+// Each slot carries a stamp (sequence + 1 once written, 0 while a writer is
+// inside it) and stores its record as atomic words, like the metrics
+// snapshot lock. Readers copy a slot word by word and keep it only if the
+// stamp matched both before and after the copy, so a record overwritten
+// mid-read is skipped rather than returned torn.
+
+use log::Level;
+use std::fmt;
+use std::sync::atomic::{fence, AtomicU32, Ordering};
+use std::sync::OnceLock;
+
+/// Records kept; a power of two so sequence numbers map to slots by masking
+pub const LOG_RING_CAPACITY: usize = 1024;
+
+/// Message bytes stored per record; longer messages are cut at a char boundary
+pub const MESSAGE_CAPACITY: usize = 160;
+
+// Stamp of a slot that is empty or being written
+const BUSY: u32 = 0;
+
+static RING: OnceLock<LogRing> = OnceLock::new();
+
+/// The global ring, allocated on first use (~200 KB, which malloc places in PSRAM)
+pub fn ring() -> &'static LogRing {
+    RING.get_or_init(|| LogRing::new(LOG_RING_CAPACITY))
+}
+
+// repr(C) with explicit padding so a record is exactly its words
+#[derive(Clone, Copy)]
+#[repr(C)]
+struct Record {
+    timestamp_ms: u64,
+    module: Option<&'static str>,
+    // Set when the message had no arguments; `text` is unused then
+    format: Option<&'static str>,
+    level: u8,
+    len: u8,
+    truncated: bool,
+    _pad: [u8; 5],
+    text: [u8; MESSAGE_CAPACITY],
+}
+
+const RECORD_WORDS: usize = core::mem::size_of::<Record>() / 4;
+
+// No hidden padding: every byte of a record belongs to a field
+const _: () = assert!(
+    core::mem::size_of::<Record>()
+        == 8 + 2 * core::mem::size_of::<Option<&'static str>>() + 8 + MESSAGE_CAPACITY
+);
+const _: () = assert!(core::mem::size_of::<Record>() % 4 == 0);
+
+impl Record {
+    const EMPTY: Record = Record {
+        timestamp_ms: 0,
+        module: None,
+        format: None,
+        level: Level::Info as u8,
+        len: 0,
+        truncated: false,
+        _pad: [0; 5],
+        text: [0; MESSAGE_CAPACITY],
+    };
+}
+
+struct Slot {
+    stamp: AtomicU32,
+    // The record as words, so a reader racing a writer is never a data race
+    words: [AtomicU32; RECORD_WORDS],
+}
+
+/// Multi-producer ring that overwrites its oldest record when full
+pub struct LogRing {
+    slots: Box<[Slot]>,
+    mask: u32,
+    // Sequence number of the next record to be claimed
+    head: AtomicU32,
+}
+
+impl LogRing {
+    pub fn new(capacity: usize) -> Self {
+        assert!(capacity.is_power_of_two(), "LogRing capacity must be a power of two");
+        Self {
+            slots: (0..capacity)
+                .map(|_| Slot { stamp: AtomicU32::new(BUSY), words: std::array::from_fn(|_| AtomicU32::new(0)) })
+                .collect(),
+            mask: capacity as u32 - 1,
+            head: AtomicU32::new(0),
+        }
+    }
+
+    /// Append a record, overwriting the oldest. Never blocks or allocates.
+    pub fn push(&self, timestamp_ms: u64, level: Level, module: Option<&'static str>, args: fmt::Arguments) {
+        let mut record = Record::EMPTY;
+        record.timestamp_ms = timestamp_ms;
+        record.level = level as u8;
+        record.module = module;
+        record.format = args.as_str();
+        if record.format.is_none() {
+            let mut writer = TextWriter { buf: &mut record.text, len: 0, truncated: false };
+            let _ = fmt::write(&mut writer, args);
+            let (len, truncated) = (writer.len, writer.truncated);
+            record.len = len as u8;
+            record.truncated = truncated;
+        }
+        // SAFETY: Record is repr(C) without padding (asserted above)
+        let words: [u32; RECORD_WORDS] = unsafe { core::mem::transmute_copy(&record) };
+
+        let seq = self.head.fetch_add(1, Ordering::Relaxed);
+        let slot = &self.slots[(seq & self.mask) as usize];
+        slot.stamp.store(BUSY, Ordering::Relaxed);
+        fence(Ordering::Release);
+        for (cell, word) in slot.words.iter().zip(words) {
+            cell.store(word, Ordering::Relaxed);
+        }
+        slot.stamp.store(seq.wrapping_add(1), Ordering::Release);
+    }
+
+    /// Sequence number the next record will get
+    pub fn head(&self) -> u32 {
+        self.head.load(Ordering::Acquire)
+    }
+
+    /// Oldest sequence number that can still be in the ring
+    fn oldest(&self, head: u32) -> u32 {
+        head.saturating_sub(self.slots.len() as u32)
+    }
+
+    fn load(&self, seq: u32) -> Result<LogLine, Miss> {
+        let expected = seq.wrapping_add(1);
+        if expected == BUSY {
+            return Err(Miss::Gone);
+        }
+        let slot = &self.slots[(seq & self.mask) as usize];
+        if slot.stamp.load(Ordering::Acquire) != expected {
+            // Still being written, unless a later lap has taken the slot over
+            let lapped = self.head().wrapping_sub(seq) > self.mask + 1;
+            return Err(if lapped { Miss::Gone } else { Miss::Pending });
+        }
+        let mut words = [0u32; RECORD_WORDS];
+        for (word, cell) in words.iter_mut().zip(&slot.words) {
+            *word = cell.load(Ordering::Relaxed);
+        }
+        fence(Ordering::Acquire);
+        if slot.stamp.load(Ordering::Relaxed) != expected {
+            return Err(Miss::Gone);
+        }
+        // SAFETY: an unchanged stamp means the words are one complete record
+        // written by push from a valid Record
+        let record = unsafe { core::mem::transmute::<_, Record>(words) };
+        Ok(LogLine { seq, record })
+    }
+
+    /// Up to `max` records from sequence `from` onwards, oldest first.
+    /// Records already overwritten are skipped; the read stops at a record
+    /// still being written, and the returned cursor is where the next read
+    /// should start.
+    pub fn read(&self, from: u32, max: usize) -> LogRead {
+        let head = self.head();
+        let oldest = self.oldest(head);
+        let start = if head.wrapping_sub(from) > head.wrapping_sub(oldest) { oldest } else { from };
+        let mut lines = Vec::with_capacity(head.wrapping_sub(start).min(max as u32) as usize);
+        let mut seq = start;
+        while seq != head && lines.len() < max {
+            match self.load(seq) {
+                Ok(line) => lines.push(line),
+                Err(Miss::Pending) => break,
+                Err(Miss::Gone) => {}
+            }
+            seq = seq.wrapping_add(1);
+        }
+        let missed = seq.wrapping_sub(from).wrapping_sub(lines.len() as u32);
+        LogRead { lines, next: seq, missed }
+    }
+
+    /// The newest `count` records, oldest first
+    pub fn recent(&self, count: usize) -> Vec<LogLine> {
+        let head = self.head();
+        let from = head.wrapping_sub(count.min(self.slots.len()) as u32);
+        self.read(from, count).lines
+    }
+}
+
+/// Result of `LogRing::read`
+pub struct LogRead {
+    pub lines: Vec<LogLine>,
+    /// Cursor for the next read
+    pub next: u32,
+    /// Records between the requested cursor and `next` that were overwritten
+    pub missed: u32,
+}
+
+enum Miss {
+    // Claimed by a writer that has not finished yet
+    Pending,
+    // Overwritten by a newer record
+    Gone,
+}
+
+/// A copied record; formatting happens only when a reader asks for text
+#[derive(Clone, Copy)]
+pub struct LogLine {
+    pub seq: u32,
+    record: Record,
+}
+
+impl LogLine {
+    /// Milliseconds since boot
+    pub fn timestamp_ms(&self) -> u64 {
+        self.record.timestamp_ms
+    }
+
+    pub fn level(&self) -> Level {
+        match self.record.level {
+            1 => Level::Error,
+            2 => Level::Warn,
+            3 => Level::Info,
+            4 => Level::Debug,
+            _ => Level::Trace,
+        }
+    }
+
+    /// Last segment of the module path
+    pub fn module(&self) -> &'static str {
+        self.record.module
+            .and_then(|path| path.rsplit("::").next())
+            .unwrap_or("unknown")
+    }
+
+    pub fn message(&self) -> &str {
+        match self.record.format {
+            Some(format) => format,
+            None => std::str::from_utf8(&self.record.text[..self.record.len as usize]).unwrap_or(""),
+        }
+    }
+
+    /// Whether `message()` was cut to fit the record
+    pub fn truncated(&self) -> bool {
+        self.record.truncated
+    }
+}
+
+/// fmt::Write into a fixed buffer, dropping whatever does not fit
+struct TextWriter<'a> {
+    buf: &'a mut [u8],
+    len: usize,
+    truncated: bool,
+}
+
+impl fmt::Write for TextWriter<'_> {
+    fn write_str(&mut self, s: &str) -> fmt::Result {
+        if self.truncated {
+            return Ok(());
+        }
+        let room = self.buf.len() - self.len;
+        let mut take = s.len().min(room);
+        while !s.is_char_boundary(take) {
+            take -= 1;
+        }
+        self.buf[self.len..self.len + take].copy_from_slice(&s.as_bytes()[..take]);
+        self.len += take;
+        self.truncated = take < s.len();
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::Arc;
+    use std::thread;
+
+    #[test]
+    fn test_log_ring_records_and_wraps() {
+        let ring = LogRing::new(8);
+        ring.push(5, Level::Warn, Some("app::wifi"), format_args!("static message"));
+        let value = 42;
+        ring.push(6, Level::Info, None, format_args!("value={value}"));
+
+        let lines = ring.recent(10);
+        assert_eq!(lines.len(), 2);
+        assert_eq!(lines[0].message(), "static message");
+        assert_eq!(lines[0].module(), "wifi");
+        assert_eq!(lines[0].level(), Level::Warn);
+        assert_eq!(lines[1].message(), "value=42");
+        assert_eq!(lines[1].module(), "unknown");
+
+        let long = "é".repeat(MESSAGE_CAPACITY);
+        ring.push(7, Level::Error, None, format_args!("{long}"));
+        let line = ring.recent(1)[0];
+        assert!(line.truncated());
+        assert_eq!(line.message().len(), MESSAGE_CAPACITY);
+
+        for i in 0..20 {
+            ring.push(i, Level::Debug, None, format_args!("line {i}"));
+        }
+        let read = ring.read(0, 100);
+        assert_eq!(read.lines.len(), 8);
+        assert_eq!(read.lines[0].message(), "line 12");
+        assert_eq!(read.next, 23);
+        assert_eq!(read.missed, 15);
+        assert_eq!(ring.read(read.next, 100).lines.len(), 0);
+    }
+
+    #[test]
+    fn test_log_ring_concurrent_writers() {
+        let ring = Arc::new(LogRing::new(256));
+        let writers: Vec<_> = (0..4)
+            .map(|w| {
+                let ring = ring.clone();
+                thread::spawn(move || {
+                    for i in 0..1000 {
+                        ring.push(i, Level::Info, None, format_args!("writer {w} line {i}"));
+                    }
+                })
+            })
+            .collect();
+        let mut cursor = 0;
+        let mut seen = 0;
+        while seen < 100 {
+            let read = ring.read(cursor, 64);
+            for line in &read.lines {
+                assert!(line.message().starts_with("writer "), "torn record: {:?}", line.message());
+            }
+            seen += read.lines.len();
+            cursor = read.next;
+            thread::yield_now();
+        }
+        for writer in writers {
+            writer.join().unwrap();
+        }
+        assert_eq!(ring.head(), 4000);
+        assert_eq!(ring.recent(1000).len(), 256);
+    }
+}
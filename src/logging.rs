@@ -1,8 +1,9 @@
 use log::{Level, LevelFilter, Metadata, Record};
 use std::sync::{Arc, OnceLock};
 use std::time::SystemTime;
+use std::fmt;
 use crate::network::telnet_server::TelnetLogServer;
-use crate::network::log_streamer;
+use crate::log_ring;
 
 static TELNET_SERVER: OnceLock<Arc<TelnetLogServer>> = OnceLock::new();
 static BOOT_TIME: OnceLock<SystemTime> = OnceLock::new();
@@ -17,7 +18,39 @@ mod colors {
     pub const GRAY: &str = "\x1b[90m";
 }
 
-/// Enhanced logger that prints colored, timestamped lines and forwards to telnet/log streamer
+/// Milliseconds since the logger started
+pub fn uptime_ms() -> u64 {
+    let boot_time = BOOT_TIME.get_or_init(|| SystemTime::now());
+    let elapsed = SystemTime::now()
+        .duration_since(*boot_time)
+        .unwrap_or_default();
+    elapsed.as_secs().saturating_mul(1000) + elapsed.subsec_millis() as u64
+}
+
+/// Compact uptime column: " 12.345s", "12m05s", " 3h20m"
+pub struct Uptime(pub u64);
+
+impl fmt::Display for Uptime {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        let seconds = self.0 / 1000;
+        let millis = self.0 % 1000;
+        if seconds < 60 {
+            write!(f, "{:>3}.{:03}s", seconds, millis)
+        } else if seconds < 3600 {
+            write!(f, "{:>2}m{:02}s", seconds / 60, seconds % 60)
+        } else {
+            write!(f, "{:>2}h{:02}m", seconds / 3600, (seconds % 3600) / 60)
+        }
+    }
+}
+
+/// Module column: last path segment, at most 12 characters
+pub fn module_label(module_path: &str) -> &str {
+    let module = module_path.rsplit("::").next().unwrap_or("unknown");
+    if module.len() > 12 { &module[..12] } else { module }
+}
+
+/// Enhanced logger that prints colored, timestamped lines and records them in the log ring
 struct EnhancedLogger;
 
 impl log::Log for EnhancedLogger {
@@ -29,63 +62,27 @@ impl log::Log for EnhancedLogger {
         if !self.enabled(record.metadata()) {
             return;
         }
-
-        // Time since boot
-        let boot_time = BOOT_TIME.get_or_init(|| SystemTime::now());
-        let elapsed = SystemTime::now()
-            .duration_since(*boot_time)
-            .unwrap_or_default();
-        let seconds = elapsed.as_secs();
-        let millis = elapsed.subsec_millis();
-        let ts_compact = if seconds < 60 {
-            format!("{:>3}.{:03}s", seconds, millis)
-        } else if seconds < 3600 {
-            let minutes = seconds / 60;
-            let secs = seconds % 60;
-            format!("{:>2}m{:02}s", minutes, secs)
-        } else {
-            let hours = seconds / 3600;
-            let mins = (seconds % 3600) / 60;
-            format!("{:>2}h{:02}m", hours, mins)
+        let _alloc_tag = crate::alloc_profiler::scope(crate::alloc_profiler::Tag::Logging);
+
+        let ts_ms = uptime_ms();
+        let (color, level_char) = match record.level() {
+            Level::Error => (colors::BRIGHT_RED, 'E'),
+            Level::Warn => (colors::BRIGHT_YELLOW, 'W'),
+            Level::Info => (colors::BRIGHT_GREEN, 'I'),
+            Level::Debug => (colors::BRIGHT_BLUE, 'D'),
+            Level::Trace => (colors::GRAY, 'T'),
         };
-        let ts_ms = seconds.saturating_mul(1000) + millis as u64;
-
-        // Level, color and module
-        let (color, level_str, level_char) = match record.level() {
-            Level::Error => (colors::BRIGHT_RED, "ERROR", 'E'),
-            Level::Warn => (colors::BRIGHT_YELLOW, "WARN ", 'W'),
-            Level::Info => (colors::BRIGHT_GREEN, "INFO ", 'I'),
-            Level::Debug => (colors::BRIGHT_BLUE, "DEBUG", 'D'),
-            Level::Trace => (colors::GRAY, "TRACE", 'T'),
-        };
-        let module = record
-            .module_path()
-            .unwrap_or("unknown")
-            .split("::")
-            .last()
-            .unwrap_or("unknown");
-        let module_display = if module.len() > 12 { &module[..12] } else { module };
-
-        // Message
-        let message = format!("{}", record.args());
-
-        // Console output (serial). ANSI colors are fine over serial; telnet gets plain text below.
+        let module = module_label(record.module_path().unwrap_or("unknown"));
+
+        // Console output (serial). ANSI colors are fine over serial; telnet gets plain text
+        // when it formats the ring.
         println!(
             "{}{} [{}] {:>12} | {}{}",
-            color, ts_compact, level_char, module_display, message, colors::RESET
+            color, Uptime(ts_ms), level_char, module, record.args(), colors::RESET
         );
 
-        // Telnet (no colors)
-        if let Some(server) = TELNET_SERVER.get() {
-            let telnet_msg = format!(
-                "{} [{}] {:>12} | {}",
-                ts_compact, level_str, module_display, message
-            );
-            server.log_message(level_str, &telnet_msg);
-        }
-
-        // Append to in-memory log streamer (non-blocking; drop on contention)
-        log_streamer::append(level_str, Some(module), &message, ts_ms);
+        // One binary record for telnet and the log APIs; formatted when they read it
+        log_ring::ring().push(ts_ms, record.level(), record.module_path_static(), *record.args());
     }
 
     fn flush(&self) {}
@@ -96,6 +93,8 @@ static LOGGER: EnhancedLogger = EnhancedLogger;
 /// Initialize the enhanced logger with colors and timestamps
 pub fn init_logger() -> Result<(), log::SetLoggerError> {
     let _ = BOOT_TIME.set(SystemTime::now());
+    // Allocate the ring before the first record instead of inside it
+    log_ring::ring();
     log::set_logger(&LOGGER)?;
     log::set_max_level(LevelFilter::Debug);
 
@@ -32,6 +32,7 @@ mod memory_diagnostics;
 mod diagnostics;
 mod crash_diagnostics;
 mod crash_persist;
+mod boot_diagnostics;
 mod ui;
 mod version;
 mod dual_core;
@@ -41,9 +42,15 @@ mod core1_tasks;
 mod logging;
 mod metrics;
 mod metrics_formatter;
-mod metrics_rwlock;
+mod metrics_store;
 mod feature_gates;
-// mod ring_buffer;  // TODO: Integrate ring buffer optimization
+#[cfg(feature = "bench")]
+mod bench;
+mod ring_buffer;
+mod log_ring;
+mod arena;
+mod alloc_profiler;
+mod trace;
 mod templates;
 mod power;
 
@@ -53,9 +60,10 @@ use crate::network::{NetworkManager, telnet_server::TelnetLogServer};
 use crate::ota::OtaManager;
 use crate::ui::UiManager;
 use crate::system::{ShutdownManager, ShutdownSignal};
-use crate::dual_core::{DualCoreProcessor, CpuMonitor};
+use crate::dual_core::{DualCoreProcessor, CpuMonitor, WorkItem};
 use crate::performance::PerformanceMetrics;
-use crate::power::{PowerManager, PowerConfig};
+use crate::power::{PowerManager, PowerConfig, PowerMode};
+use crate::power::frame_scheduler::{FrameScheduler, WAKE_BUTTON, WAKE_OTA};
 
 // Global error storage for web server initialization (safe)
 use std::sync::OnceLock;
@@ -138,7 +146,7 @@ fn main() -> Result<()> {
     }
 
     // Initialize in-memory log streamer early so logs are captured from boot
-    crate::network::log_streamer::init(None);
+    crate::network::log_streamer::init();
 
     // Start periodic crash/health diagnostics
     crate::crash_diagnostics::init();
@@ -154,49 +162,14 @@ fn main() -> Result<()> {
     // Initialize and log PSRAM info
     let psram_info = crate::psram::PsramAllocator::get_info();
     psram_info.log_info();
+    // After PSRAM is up, so the span rings land there
+    trace::init();
     
     // Check reset reason and log it
     let reset_reason_str = crate::system::reset::get_reset_reason();
     log::info!("Boot reason: {}", reset_reason_str);
-    
-    let reset_reason = unsafe { esp_idf_sys::esp_reset_reason() };
-    let is_ota_restart = match reset_reason {
-        esp_idf_sys::esp_reset_reason_t_ESP_RST_SW => {
-            log::info!("Software reset detected - checking if from OTA");
-            true
-        }
-        esp_idf_sys::esp_reset_reason_t_ESP_RST_POWERON => {
-            log::info!("Power-on reset detected - could be RTC reset or actual power cycle");
-            // RTC reset often shows as POWERON, so check if we have WiFi config
-            // If we have config, it's likely an RTC reset from OTA
-            true  // Treat as potential OTA restart
-        }
-        esp_idf_sys::esp_reset_reason_t_ESP_RST_PANIC => {
-            log::warn!("Panic reset detected");
-            false
-        }
-        _ => {
-            log::info!("Other reset reason: {:?}", reset_reason);
-            false
-        }
-    };
-    
-    // Add delay after OTA restart to let system stabilize
-    if is_ota_restart {
-        log::info!("Waiting for system to stabilize after OTA...");
-        esp_idf_hal::delay::FreeRtos::delay_ms(3000);
-        
-        // Handle post-OTA WiFi reconnection
-        log::info!("Initiating post-OTA WiFi reconnection sequence...");
-        if let Err(e) = crate::network::wifi_reconnect::handle_post_ota_wifi() {
-            log::warn!("Post-OTA WiFi handling failed: {:?}", e);
-            // Continue anyway, as the normal WiFi connection logic will retry
-        }
-        
-        // Additional delay to ensure WiFi is ready
-        log::info!("Waiting for WiFi to settle...");
-        esp_idf_hal::delay::FreeRtos::delay_ms(2000);
-    }
+    // No settle delay after an OTA restart: WiFi comes up in its own boot
+    // stage below and the reconnect manager handles post-OTA association
     
     // Reconfigure watchdog timeout to 5 seconds
     unsafe {
@@ -247,7 +220,9 @@ fn main() -> Result<()> {
     let timer_service = EspTaskTimerService::new()?;
 
     // Load configuration
+    let stage = boot_diagnostics::BootStage::new("config");
     let config = Arc::new(Mutex::new(config::load_or_default()?));
+    stage.complete();
     info!("Configuration loaded");
     
     // Log WiFi credentials (safely)
@@ -283,16 +258,22 @@ fn main() -> Result<()> {
         }
     }
     
-    // Initialize display
-    info!("Initializing display...");
+    // WiFi association is the slowest part of boot, so it runs as its own
+    // stage while display, UI and sensors come up on this task
+    let wifi_task = {
+        let modem = peripherals.modem;
+        let config = config.clone();
+        boot_diagnostics::spawn_stage("wifi", &[], 8192, move || {
+            bring_up_network(modem, sys_loop, timer_service, config)
+        })?
+    };
     
-    // Initialize display pins and power sequence
+    // Initialize display
+    let stage = boot_diagnostics::BootStage::new("display");
     info!("Initializing display with proper pin management...");
     
-    // CRITICAL: Wait for power to stabilize before initializing display
-    use esp_idf_hal::delay::FreeRtos;
-    FreeRtos::delay_ms(500);  // Longer delay for power stability
-    
+    // No settle delay here: DisplayManager::new powers the panel first and
+    // its reset sequence (SWRESET + SLPOUT, 270 ms) is the wait it needs
     let mut display_manager = DisplayManager::new(
         peripherals.pins.gpio39, // D0
         peripherals.pins.gpio40, // D1
@@ -312,6 +293,21 @@ fn main() -> Result<()> {
     )?;
     info!("Display initialized - LCD power and backlight pins kept alive");
     
+    // Optional PSRAM frame buffer - falls back to direct drawing if allocation fails
+    #[cfg(feature = "psram_framebuffer")]
+    if let Err(e) = display_manager.enable_framebuffer() {
+        log::warn!("Frame buffer unavailable, using direct drawing: {:?}", e);
+    }
+    
+    // Render the next frame while DMA streams the previous one
+    #[cfg(feature = "double_buffer")]
+    if let Err(e) = display_manager.enable_double_buffering(
+        display::double_buffer::SwapSync::Timer(display::double_buffer::PANEL_REFRESH_PERIOD),
+    ) {
+        log::warn!("Double buffering unavailable: {:?}", e);
+    }
+    stage.complete();
+    
     // Initialize metrics system AFTER display is working
     crate::metrics::init_metrics();
     info!("Metrics system initialized");
@@ -328,172 +324,45 @@ fn main() -> Result<()> {
         info!("ESP_LCD: Fast initialization path - skipping all boot animations");
         
         // Simple startup screen
+        let stage = boot_diagnostics::BootStage::new("splash");
         display_manager.clear(colors::BLACK)?;
         display_manager.draw_text_centered(80, "ESP_LCD DMA", colors::GREEN, None, 2)?;
         display_manager.draw_text_centered(100, "Starting...", colors::WHITE, None, 1)?;
         display_manager.flush()?;
+        stage.complete();
         
         // Quick init of all components
+        let stage = boot_diagnostics::BootStage::new("ui");
         let ui_manager = UiManager::new(&mut display_manager)?;
+        stage.complete();
         info!("UI manager created");
         
+        let stage = boot_diagnostics::BootStage::new("sensors");
         let battery_pin = peripherals.pins.gpio4;
         let adc1 = peripherals.adc1;
-        let sensor_manager = sensors::SensorManager::new(adc1, battery_pin)?;
+        let mut sensor_manager = sensors::SensorManager::new(adc1, battery_pin)?;
+        stage.complete();
         info!("Sensors initialized");
         
+        let stage = boot_diagnostics::BootStage::new("buttons");
         let button1 = peripherals.pins.gpio0;
         let button2 = peripherals.pins.gpio14;
         let button_manager = system::ButtonManager::new(button1, button2)?;
+        stage.complete();
         info!("Buttons initialized");
         
-        // Mount SPIFFS filesystem
-        {
-            use esp_idf_svc::fs::{self, StorageImpl};
-            let spiffs_config = fs::SpiffsConfig {
-                base_path: "/spiffs".to_owned(),
-                partition_label: Some("storage".to_owned()),
-                max_files: 5,
-                format_if_mount_failed: true,
-            };
-            let _spiffs = fs::SpiffsSingleton::mount(spiffs_config)?;
-            info!("SPIFFS filesystem mounted at /spiffs");
-        }
-        
-        let network_config = config.lock().map_err(|e| anyhow::anyhow!("Failed to lock config: {}", e))?;
-        let mut network_manager = NetworkManager::new(
-            peripherals.modem,
-            sys_loop,
-            timer_service,
-            network_config.wifi_ssid.clone(),
-            network_config.wifi_password.clone(),
-            config.clone(),
-        )?;
-        drop(network_config);
-        info!("Network initialized");
-        
-        // Quick connect attempt
-        let wifi_result = match network_manager.connect() {
-            Ok(_) => {
-                info!("WiFi connected");
-                Ok(network_manager)
-            }
-            Err(e) => {
-                log::warn!("WiFi failed: {:?}", e);
-                Err(network_manager)
-            }
-        };
-        
-        let (mut network_manager, wifi_connected) = match wifi_result {
-            Ok(mgr) => (mgr, true),
-            Err(mgr) => (mgr, false),
-        };
-        
-        // Wait for IP assignment if WiFi connected
-        if wifi_connected {
-            log::info!("Waiting for IP address assignment...");
-            let mut ip_wait = 0;
-            while !network_manager.is_connected() && ip_wait < 100 {
-                esp_idf_hal::delay::FreeRtos::delay_ms(100);
-                ip_wait += 1;
-            }
-            
-            if network_manager.is_connected() {
-                log::info!("IP address obtained: {:?}", network_manager.get_ip());
-                
-                // CRITICAL: Wait for WiFi to fully stabilize before starting services
-                // This prevents the 0x6374c0 disconnection error that occurs when
-                // servers start too quickly after connection
-                log::info!("Waiting for WiFi to stabilize before starting services...");
-                esp_idf_hal::delay::FreeRtos::delay_ms(3000);
-                log::info!("WiFi stabilization complete");
-            } else {
-                log::warn!("Failed to obtain IP address after 10 seconds");
-            }
-        }
-        
-        // Initialize OTA
-        let ota_manager = match ota::OtaManager::new() {
-            Ok(manager) => Some(Arc::new(Mutex::new(manager))),
-            Err(e) => {
-                log::warn!("OTA init failed: {:?}", e);
-                None
-            }
-        };
+        // SPIFFS is mounted on first use by the history archive (sensors::history)
         
-        // Start telnet server first so we can capture web server errors
-        let telnet_server = if network_manager.is_connected() {
-            let mut server = TelnetLogServer::new(23);
-            server.set_shutdown_signal(shutdown_signal.clone());
-            let server = Arc::new(server);
-            logging::set_telnet_server(Arc::clone(&server));
-            match Arc::clone(&server).start() {
-                Ok(_) => {
-                    log::info!("Telnet server started successfully on port 23");
-                    log::info!("ESP32-S3 Dashboard {} initialized", crate::version::DISPLAY_VERSION);
-                    log::info!("Web interface available at http://{}/", network_manager.get_ip().unwrap_or_default());
-                    
-                    // Check for stored web server error
-                    if let Ok(slot) = web_server_error().lock() {
-                        if let Some(ref error) = *slot {
-                            log::error!("STORED WEB SERVER ERROR: {}", error);
-                            log::error!("The web server failed to start earlier!");
-                            log::error!("This prevents OTA updates from working!");
-                        }
-                    }
-                    
-                    Some(server)
-                }
-                Err(e) => {
-                    log::error!("Failed to start telnet server: {:?}", e);
-                    None
-                }
-            }
-        } else {
-            log::info!("Skipping telnet server - no network connection");
-            None
-        };
+        let ota_manager = init_ota_manager();
         
-        // Small delay to ensure telnet is ready
-        esp_idf_hal::delay::FreeRtos::delay_ms(100);
+        let network_manager = wait_for_network(wifi_task, || Ok(()))?;
         
-        // Log before attempting web server start
-        log::info!("Attempting to start web server...");
-        log::info!("Network connected: {}", network_manager.is_connected());
-        log::info!("Device IP: {:?}", network_manager.get_ip());
-        
-        // Start web server after telnet so errors are logged
-        let web_server = if network_manager.is_connected() {
-            log::info!("Network is connected, starting web server with retries...");
-            network::simple_retry::try_start_web_server_with_retries(
-                config.clone(),
-                ota_manager.clone(),
-                true,  // network is connected
-                10     // wait up to 10 seconds
-            )
-        } else {
-            log::info!("Network not ready, attempting web server with extended timeout...");
-            let server = network::simple_retry::try_start_web_server_with_retries(
-                config.clone(),
-                ota_manager.clone(),
-                false, // network not connected yet
-                30     // wait up to 30 seconds
-            );
-            
-            // Also spawn background retry if initial attempt fails
-            if server.is_none() {
-                log::info!("Spawning background web server retry task...");
-                network::simple_retry::spawn_web_server_retry_task(
-                    config.clone(),
-                    ota_manager.clone()
-                );
-            }
-            
-            server
-        };
+        let (web_server, telnet_server) = start_network_services(
+            &network_manager, &config, &ota_manager, &shutdown_signal);
         
         // Start Core 1 tasks
-        let (mut core1_manager, core1_channels) = core1_tasks::Core1Manager::new()?;
+        let (mut core1_manager, core1_channels) =
+            core1_tasks::Core1Manager::new(sensor_manager.take_battery_monitor())?;
         core1_manager.start()?;
         info!("Core 1 tasks started");
         
@@ -501,6 +370,10 @@ fn main() -> Result<()> {
         display_manager.clear(colors::BLACK)?;
         display_manager.flush()?;
         
+        boot_diagnostics::boot_complete();
+        alloc_profiler::start_sampler();
+        #[cfg(feature = "bench")]
+        feature_gates::start_benchmarks();
         info!("ESP_LCD: Fast init complete, entering main loop");
         
         // Print initial memory stats
@@ -536,50 +409,18 @@ fn main() -> Result<()> {
         let mut boot_manager = BootManager::new();
         
         // Show initial boot screen
+        let stage = boot_diagnostics::BootStage::new("splash");
         boot_manager.set_stage(BootStage::DisplayInit);
         log::info!("Boot: Setting stage to DisplayInit");
         boot_manager.render_boot_screen(&mut display_manager)?;
         display_manager.flush()?;
+        stage.complete();
         log::info!("Boot: Initial boot screen rendered");
-        
-        // Animate for a moment while display stabilizes
-        for i in 0..10 {
-            boot_manager.render_boot_screen(&mut display_manager)?;
-            display_manager.flush()?;
-            
-            // Reset watchdog every few frames
-            if i % 3 == 0 {
-                unsafe { esp_idf_sys::esp_task_wdt_reset(); }
-            }
-            
-            // Yield so TCPIP/HTTPD tasks can run
-            esp_idf_hal::delay::FreeRtos::delay_ms(50);
-        }
     }
     
     // Create boot manager for both paths
     let mut boot_manager = BootManager::new();
     
-    // Memory initialization with progress
-    #[cfg(not(feature = "esp_lcd_driver"))]
-    {
-        boot_manager.set_stage(BootStage::MemoryInit);
-        log::info!("Boot: Setting stage to MemoryInit");
-        for i in 0..5 {
-            boot_manager.render_boot_screen(&mut display_manager)?;
-            display_manager.flush()?;
-            
-            // Reset watchdog
-            if i % 2 == 0 {
-                unsafe { esp_idf_sys::esp_task_wdt_reset(); }
-            }
-            
-            // Yield so TCPIP/HTTPD tasks can run
-            esp_idf_hal::delay::FreeRtos::delay_ms(100);
-        }
-        log::info!("Boot: Memory init animation complete");
-    }
-    
     // Initialize UI
     info!("Creating UI manager...");
     #[cfg(not(feature = "esp_lcd_driver"))]
@@ -589,7 +430,9 @@ fn main() -> Result<()> {
         display_manager.flush()?;
     }
     
+    let stage = boot_diagnostics::BootStage::new("ui");
     let ui_manager = UiManager::new(&mut display_manager)?;
+    stage.complete();
     info!("UI manager created");
 
     // Initialize sensors
@@ -597,234 +440,36 @@ fn main() -> Result<()> {
     log::info!("Boot: Setting stage to SensorInit");
     boot_manager.render_boot_screen(&mut display_manager)?;
     display_manager.flush()?;
-    log::info!("Boot: Sensor init screen rendered");
     
+    let stage = boot_diagnostics::BootStage::new("sensors");
     let battery_pin = peripherals.pins.gpio4;
     let adc1 = peripherals.adc1;
-    let sensor_manager = sensors::SensorManager::new(adc1, battery_pin)?;
-    
-    // Animate progress
-    for i in 0..3 {
-        boot_manager.render_boot_screen(&mut display_manager)?;
-        display_manager.flush()?;
-        
-        // Reset watchdog
-        if i == 1 {
-            unsafe { esp_idf_sys::esp_task_wdt_reset(); }
-        }
-        
-        // Yield so TCPIP/HTTPD tasks can run
-        esp_idf_hal::delay::FreeRtos::delay_ms(50);
-    }
+    let mut sensor_manager = sensors::SensorManager::new(adc1, battery_pin)?;
+    stage.complete();
 
     // Initialize buttons
+    let stage = boot_diagnostics::BootStage::new("buttons");
     let button1 = peripherals.pins.gpio0;
     let button2 = peripherals.pins.gpio14;
     let button_manager = system::ButtonManager::new(button1, button2)?;
+    stage.complete();
+
+    // Initialize OTA manager - always create wrapper even if manager fails
+    let ota_manager = init_ota_manager();
 
-    // Initialize network (WiFi + OTA)
-    info!("Initializing network...");
+    // Keep the boot screen animating until the WiFi stage finishes
     boot_manager.set_stage(BootStage::NetworkInit);
     log::info!("Boot: Setting stage to NetworkInit");
-    boot_manager.render_boot_screen(&mut display_manager)?;
-    display_manager.flush()?;
-    log::info!("Boot: Network init screen rendered - display should still be visible");
-    
-    let network_config = config.lock().map_err(|e| anyhow::anyhow!("Failed to lock config: {}", e))?;
-    let mut network_manager = NetworkManager::new(
-        peripherals.modem,
-        sys_loop,
-        timer_service,
-        network_config.wifi_ssid.clone(),
-        network_config.wifi_password.clone(),
-        config.clone(),
-    )?;
-    drop(network_config);
-    
-    // Connect to WiFi
-    log::info!("Connecting to WiFi...");
-    match network_manager.connect() {
-        Ok(_) => {
-            log::info!("WiFi connected successfully!");
-            
-            // Wait for IP assignment (up to 10 seconds)
-            log::info!("Waiting for IP address...");
-            let mut ip_wait = 0;
-            while !network_manager.is_connected() && ip_wait < 100 {
-                esp_idf_hal::delay::FreeRtos::delay_ms(100);
-                ip_wait += 1;
-            }
-            
-            if network_manager.is_connected() {
-                log::info!("IP address obtained: {:?}", network_manager.get_ip());
-            } else {
-                log::warn!("Failed to obtain IP address after 10 seconds");
-            }
-        }
-        Err(e) => {
-            log::warn!("WiFi connection failed: {:?}", e);
-            log::info!("Continuing without WiFi - auto-reconnect will retry");
-        }
-    }
-    
-    // Keep animating during network init
-    log::info!("Boot: Keeping display alive during network stage");
-    for i in 0..10 {
+    let network_manager = wait_for_network(wifi_task, || {
         boot_manager.render_boot_screen(&mut display_manager)?;
         display_manager.flush()?;
         display_manager.update_auto_dim(true)?; // Keep display alive during boot
-        
         // Extra safety - ensure power pins stay high
-        display_manager.ensure_display_on()?;
-        
-        // Reset watchdog
-        if i % 2 == 0 {
-            unsafe { esp_idf_sys::esp_task_wdt_reset(); }
-        }
-        
-        if i % 5 == 0 {
-            log::info!("Boot: Display still active during network init loop {}", i);
-        }
-        // Yield so TCPIP/HTTPD tasks can run
-        esp_idf_hal::delay::FreeRtos::delay_ms(50);
-    }
-    log::info!("Boot: Network animation complete, display should still be on");
-
-    // Try to connect to WiFi with display keep-alive
-    info!("Attempting WiFi connection...");
-    
-    // Connect to WiFi with periodic display updates to prevent timeout
-    let wifi_result = {
-        let mut network_manager = network_manager; // Make it mutable for connection
-        
-        // Try to connect - this is a blocking operation
-        match network_manager.connect() {
-            Ok(_) => {
-                info!("WiFi connected successfully");
-                Ok(network_manager)
-            }
-            Err(e) => {
-                log::warn!("WiFi connection failed: {:?}", e);
-                log::warn!("Continuing without network connectivity");
-                Err(network_manager)
-            }
-        }
-    };
-    
-    // Extract network manager back and track connection status
-    let (network_manager, wifi_connected) = match wifi_result {
-        Ok(mgr) => (mgr, true),
-        Err(mgr) => (mgr, false),
-    };
-    
-    // Wait for IP assignment if WiFi connected
-    if wifi_connected {
-        log::info!("Waiting for IP address assignment...");
-        let mut ip_wait = 0;
-        while !network_manager.is_connected() && ip_wait < 100 {
-            esp_idf_hal::delay::FreeRtos::delay_ms(100);
-            ip_wait += 1;
-        }
-        
-        if network_manager.is_connected() {
-            log::info!("IP address obtained: {:?}", network_manager.get_ip());
-        } else {
-            log::warn!("Failed to obtain IP address after 10 seconds");
-        }
-    }
+        display_manager.ensure_display_on()
+    })?;
 
-    // Initialize OTA manager - always create wrapper even if manager fails
-    log::info!("Initializing OTA manager...");
-    let ota_manager = match ota::OtaManager::new() {
-        Ok(manager) => {
-            log::info!("OTA manager created successfully");
-            Some(Arc::new(Mutex::new(manager)))
-        }
-        Err(e) => {
-            log::warn!("OTA manager creation failed: {:?}", e);
-            log::warn!("OTA will be available once device is on OTA partition.");
-            // Still create the wrapper so endpoints can be registered
-            // The actual OTA operation will fail gracefully
-            None
-        }
-    };
-
-    // Log before attempting web server start
-    log::info!("Normal boot path - attempting to start web server...");
-    log::info!("Network connected: {}", network_manager.is_connected());
-    log::info!("Device IP: {:?}", network_manager.get_ip());
-    
-    // Start web server with OTA support if we have network
-    let web_server = if network_manager.is_connected() {
-        log::info!("Network is connected, starting web server...");
-        match network::web_server::WebConfigServer::new_with_ota(config.clone(), ota_manager.clone()) {
-            Ok(server) => {
-                log::info!("Web configuration server started on port 80 with OTA support");
-                Some(server)
-            }
-            Err(e) => {
-                let error_msg = format!("Web server failed: {}", e);
-                log::error!("Failed to start web server: {:?}", e);
-                log::error!("Web server error details: {}", e);
-                log::error!("This error prevents OTA updates from working");
-                
-                // Store error globally
-                if let Ok(mut slot) = web_server_error().lock() {
-                    *slot = Some(error_msg.clone());
-                }
-                
-                // Log multiple times to ensure it's captured
-                for _ in 0..3 {
-                    esp_idf_hal::delay::FreeRtos::delay_ms(100);
-                    log::error!("WEB SERVER FAILED TO START: {}", e);
-                }
-                None
-            }
-        }
-    } else {
-        log::info!("Skipping web server - no network connection");
-        None
-    };
-    
-    // Start telnet log server if we have network
-    let telnet_server = if network_manager.is_connected() {
-        let mut server = TelnetLogServer::new(23);
-        server.set_shutdown_signal(shutdown_signal.clone());
-        let server = Arc::new(server);
-        
-        // Set the telnet server in our custom logger
-        logging::set_telnet_server(Arc::clone(&server));
-        
-        match Arc::clone(&server).start() {
-            Ok(_) => {
-                log::info!("Telnet log server started on port 23");
-                log::info!("Connect with: telnet {} 23", network_manager.get_ip().unwrap_or_default());
-                
-                // Log some initial messages to populate the buffer
-                log::info!("ESP32-S3 Dashboard {} initialized", crate::version::DISPLAY_VERSION);
-                log::info!("Web interface available at http://{}/", network_manager.get_ip().unwrap_or_default());
-                log::info!("Logs can be viewed at http://{}/logs", network_manager.get_ip().unwrap_or_default());
-                
-                // Check for stored web server error
-                if let Ok(slot) = web_server_error().lock() {
-                    if let Some(ref error) = *slot {
-                        log::error!("STORED WEB SERVER ERROR: {}", error);
-                        log::error!("The web server failed to start earlier!");
-                        log::error!("This prevents OTA updates from working!");
-                    }
-                }
-                
-                Some(server)
-            }
-            Err(e) => {
-                log::error!("Failed to start telnet server: {:?}", e);
-                None
-            }
-        }
-    } else {
-        log::info!("Skipping telnet server - no network connection");
-        None
-    };
+    let (web_server, telnet_server) = start_network_services(
+        &network_manager, &config, &ota_manager, &shutdown_signal);
 
     // Complete boot sequence
     boot_manager.set_stage(BootStage::Complete);
@@ -859,43 +504,25 @@ fn main() -> Result<()> {
     display_manager.clear(colors::BLACK)?;
     display_manager.flush()?;
     
-    // Test frame buffer by drawing test pattern
-    info!("Testing frame buffer with color rectangles...");
-    
-    // Draw test rectangles using frame buffer
-    display_manager.fill_rect(10, 10, 50, 50, 0xF800)?; // Red
-    display_manager.fill_rect(70, 10, 50, 50, 0x07E0)?; // Green  
-    display_manager.fill_rect(130, 10, 50, 50, 0x001F)?; // Blue
-    display_manager.fill_rect(190, 10, 50, 50, 0xFFFF)?; // White
-    display_manager.flush()?;
-    
-    info!("Test pattern drawn - checking for corruption...");
-    // Yield so TCPIP/HTTPD tasks can run
-    esp_idf_hal::delay::FreeRtos::delay_ms(2000);
-    
-    // Clear and test with different pattern
-    display_manager.clear(colors::BLACK)?;
-    display_manager.fill_rect(0, 0, 300, 10, 0xF800)?; // Red stripe at top
-    display_manager.fill_rect(0, 158, 300, 10, 0x001F)?; // Blue stripe at bottom
-    display_manager.flush()?;
-    
-    // Yield so TCPIP/HTTPD tasks can run
-    esp_idf_hal::delay::FreeRtos::delay_ms(2000);
-    
     // Start main application loop
     info!("Starting main loop - UI should now be visible");
     
     // Ensure backlight is on before entering main loop
     display_manager.update_auto_dim(true)?; // Keep display on during startup
     
-    info!("Entering run_app function now...");
-    
     // Run the main app with crash recovery
     // Initialize Core 1 tasks
-    let (mut core1_manager, core1_channels) = core1_tasks::Core1Manager::new()?;
+    let (mut core1_manager, core1_channels) =
+        core1_tasks::Core1Manager::new(sensor_manager.take_battery_monitor())?;
     core1_manager.start()?;
     info!("Core 1 background tasks started");
     
+    boot_diagnostics::boot_complete();
+    alloc_profiler::start_sampler();
+    #[cfg(feature = "bench")]
+    feature_gates::start_benchmarks();
+    info!("Entering run_app function now...");
+    
     match run_app(
         ui_manager,
         display_manager,
@@ -923,6 +550,153 @@ fn main() -> Result<()> {
     Ok(())
 }
 
+/// Boot stage "wifi": create the network manager and try to associate.
+/// A failed connection is not a failed stage; auto-reconnect keeps trying.
+fn bring_up_network(
+    modem: esp_idf_hal::modem::Modem,
+    sys_loop: EspSystemEventLoop,
+    timer_service: EspTaskTimerService,
+    config: Arc<Mutex<config::Config>>,
+) -> Result<NetworkManager> {
+    let (ssid, password) = {
+        let cfg = config.lock().map_err(|e| anyhow::anyhow!("Failed to lock config: {}", e))?;
+        (cfg.wifi_ssid.clone(), cfg.wifi_password.clone())
+    };
+    let mut network_manager = NetworkManager::new(modem, sys_loop, timer_service, ssid, password, config)?;
+
+    log::info!("Connecting to WiFi...");
+    match network_manager.connect() {
+        Ok(_) => {
+            // Wait for IP assignment (up to 10 seconds)
+            log::info!("Waiting for IP address...");
+            let mut ip_wait = 0;
+            while !network_manager.is_connected() && ip_wait < 100 {
+                esp_idf_hal::delay::FreeRtos::delay_ms(100);
+                ip_wait += 1;
+            }
+            
+            if network_manager.is_connected() {
+                log::info!("IP address obtained: {:?}", network_manager.get_ip());
+            } else {
+                log::warn!("Failed to obtain IP address after 10 seconds");
+            }
+        }
+        Err(e) => {
+            log::warn!("WiFi connection failed: {:?}", e);
+            log::info!("Continuing without WiFi - auto-reconnect will retry");
+        }
+    }
+    Ok(network_manager)
+}
+
+/// Wait for the WiFi stage, calling `tick` every 50 ms so the boot screen
+/// keeps animating and the watchdog is fed
+fn wait_for_network(
+    wifi_task: boot_diagnostics::BootTask<NetworkManager>,
+    mut tick: impl FnMut() -> Result<()>,
+) -> Result<NetworkManager> {
+    while !wifi_task.is_finished() {
+        tick()?;
+        unsafe { esp_idf_sys::esp_task_wdt_reset(); }
+        // Yield so the WiFi and TCPIP tasks can run
+        esp_idf_hal::delay::FreeRtos::delay_ms(50);
+    }
+    wifi_task.join()
+}
+
+fn init_ota_manager() -> Option<Arc<Mutex<OtaManager>>> {
+    let stage = boot_diagnostics::BootStage::new("ota");
+    let ota_manager = match ota::OtaManager::new() {
+        Ok(manager) => {
+            log::info!("OTA manager created successfully");
+            Some(Arc::new(Mutex::new(manager)))
+        }
+        Err(e) => {
+            log::warn!("OTA manager creation failed: {:?}", e);
+            log::warn!("OTA will be available once device is on OTA partition.");
+            // Endpoints are still registered; the actual OTA operation fails gracefully
+            None
+        }
+    };
+    stage.complete();
+    ota_manager
+}
+
+/// Start the web and telnet servers once WiFi is up. The web server only
+/// registers its core routes here; the rest follow after the first frame.
+fn start_network_services(
+    network_manager: &NetworkManager,
+    config: &Arc<Mutex<config::Config>>,
+    ota_manager: &Option<Arc<Mutex<OtaManager>>>,
+    shutdown_signal: &ShutdownSignal,
+) -> (Option<network::web_server::WebConfigServer>, Option<Arc<TelnetLogServer>>) {
+    if !network_manager.is_connected() {
+        log::info!("Skipping web and telnet servers - no network connection");
+        return (None, None);
+    }
+    log::info!("Device IP: {:?}", network_manager.get_ip());
+
+    let stage = boot_diagnostics::BootStage::new("web_server");
+    let web_server = match network::web_server::WebConfigServer::new_with_ota(config.clone(), ota_manager.clone()) {
+        Ok(server) => {
+            log::info!("Web configuration server started on port 80 with OTA support");
+            stage.complete();
+            Some(server)
+        }
+        Err(e) => {
+            log::error!("Failed to start web server: {:?}", e);
+            log::error!("This error prevents OTA updates from working");
+            
+            // Store error globally
+            if let Ok(mut slot) = web_server_error().lock() {
+                *slot = Some(format!("Web server failed: {}", e));
+            }
+            stage.fail();
+            None
+        }
+    };
+    
+    // Start telnet log server
+    let stage = boot_diagnostics::BootStage::new("telnet");
+    let mut server = TelnetLogServer::new(23);
+    server.set_shutdown_signal(shutdown_signal.clone());
+    let server = Arc::new(server);
+    
+    // Set the telnet server in our custom logger
+    logging::set_telnet_server(Arc::clone(&server));
+    
+    let telnet_server = match Arc::clone(&server).start() {
+        Ok(_) => {
+            stage.complete();
+            log::info!("Telnet log server started on port 23");
+            log::info!("Connect with: telnet {} 23", network_manager.get_ip().unwrap_or_default());
+            
+            // Log some initial messages to populate the buffer
+            log::info!("ESP32-S3 Dashboard {} initialized", crate::version::DISPLAY_VERSION);
+            log::info!("Web interface available at http://{}/", network_manager.get_ip().unwrap_or_default());
+            log::info!("Logs can be viewed at http://{}/logs", network_manager.get_ip().unwrap_or_default());
+            
+            // Check for stored web server error
+            if let Ok(slot) = web_server_error().lock() {
+                if let Some(ref error) = *slot {
+                    log::error!("STORED WEB SERVER ERROR: {}", error);
+                    log::error!("The web server failed to start earlier!");
+                    log::error!("This prevents OTA updates from working!");
+                }
+            }
+            
+            Some(server)
+        }
+        Err(e) => {
+            log::error!("Failed to start telnet server: {:?}", e);
+            stage.fail();
+            None
+        }
+    };
+    
+    (web_server, telnet_server)
+}
+
 fn run_app(
     mut ui_manager: UiManager,
     mut display_manager: DisplayManager,
@@ -930,7 +704,7 @@ fn run_app(
     mut button_manager: system::ButtonManager,
     network_manager: NetworkManager,
     _config: Arc<Mutex<config::Config>>,
-    _web_server: Option<network::web_server::WebConfigServer>,
+    mut web_server: Option<network::web_server::WebConfigServer>,
     ota_manager: Option<Arc<Mutex<OtaManager>>>,
     _telnet_server: Option<Arc<TelnetLogServer>>,
     core1_channels: core1_tasks::Core1Channels,
@@ -940,7 +714,7 @@ fn run_app(
     use std::time::{Duration, Instant};
 
     // Initialize dual-core processor
-    let dual_core = DualCoreProcessor::new();
+    let dual_core = DualCoreProcessor::init();
     let mut cpu_monitor = CpuMonitor::new();
     
     // Initialize power manager with custom config
@@ -980,6 +754,9 @@ fn run_app(
     // Display hardware limitation: ~10 FPS max with parallel GPIO
     const DISPLAY_MAX_FPS: f32 = 10.0;
     let _target_frame_time = Duration::from_millis(100); // ~10 FPS
+    // Sleeps between events instead of a fixed frame period; DISPLAY_MAX_FPS stays the ceiling
+    let mut frame_scheduler = FrameScheduler::new(DISPLAY_MAX_FPS);
+    let mut wake_reasons = 0u32;
     // Sensor update interval currently unused; network status is refreshed separately
     // let mut last_sensor_update = Instant::now();
     // let sensor_update_interval = Duration::from_secs(10);
@@ -1008,15 +785,11 @@ fn run_app(
     let startup_grace_period = Duration::from_secs(20); // 20 seconds grace period
     let mut last_cpu1_usage = 0u8;
     
-    // Button polling optimization - only check every 20ms
-    let mut last_button_check = Instant::now();
-    let button_check_interval = Duration::from_millis(20);
-    
-    // Button test metrics
+    // Button metrics; latency runs from the ISR edge to the flushed frame
     let button_test_start = Instant::now();
     let mut button_events_count = 0u32;
-    let mut max_response_time = Duration::ZERO;
-    let mut total_response_time = Duration::ZERO;
+    let mut input_latency = crate::dual_core::LatencyHistogram::default();
+    let mut input_latency_total_us = 0u64;
     
     // Memory diagnostics tracking (ESP_LCD only)
     #[cfg(feature = "esp_lcd_driver")]
@@ -1036,9 +809,9 @@ fn run_app(
     // Sensor reading stays on Core 0 but we'll minimize the work
     let mut last_sensor_reading = Instant::now();
     let sensor_reading_interval = Duration::from_secs(5); // Read sensors every 5 seconds
-    let sensor_tx = core1_channels.sensor_tx.clone();
+    let sensor_tx = &core1_channels.sensor_tx;
     
-    loop {
+    'main: loop {
         // Check for shutdown signal
         if shutdown_signal.is_shutdown_requested() {
             log::info!("Shutdown requested, exiting main loop...");
@@ -1051,113 +824,68 @@ fn run_app(
         // Send sensor data to Core 1 for processing
         if last_sensor_reading.elapsed() >= sensor_reading_interval {
             // Sample sensors quickly on Core 0
-            if let Ok(sensor_result) = sensor_manager.sample() {
+            // (battery is sampled by Core 1 from the ADC DMA ring)
+            let sample_span = trace::span(trace::SENSOR_SAMPLE);
+            let sample = sensor_manager.sample_temperature();
+            drop(sample_span);
+            if let Ok(temperature) = sample {
                 let (cpu0_usage, cpu1_usage) = cpu_monitor.get_cpu_usage();
                 
                 // Send to Core 1 for processing
                 let sensor_update = core1_tasks::SensorUpdate {
-                    temperature: sensor_result._temperature,
-                    battery_percentage: sensor_result._battery_percentage,
-                    battery_voltage: sensor_result._battery_voltage,
-                    is_charging: sensor_result._is_charging,
-                    is_on_usb: sensor_result._is_on_usb,
+                    temperature,
                     cpu_usage_core0: cpu0_usage,
                     cpu_usage_core1: cpu1_usage,
                 };
                 
-                // Non-blocking send to Core 1
-                if let Err(_) = sensor_tx.send(sensor_update.clone()) {
-                    log::warn!("Core 1 sensor queue full, skipping update");
+                // Non-blocking send to Core 1; a stalled Core 1 loses the oldest sample
+                if sensor_tx.push_overwrite(sensor_update) {
+                    log::warn!("Core 1 sensor ring full, dropped oldest sample ({} total)",
+                        sensor_tx.stats().dropped);
                 }
             }
             last_sensor_reading = Instant::now();
         }
 
-        // Handle button input with debounce (only check every 20ms)
-        if last_button_check.elapsed() >= button_check_interval {
-            let poll_start = Instant::now();
-            if let Some(event) = button_manager.poll() {
-                let response_time = poll_start.elapsed();
-                log::info!("[BUTTON_TEST] Button event detected: {:?}, Poll latency: {:.2}ms, Time since last check: {:.2}ms", 
-                    event, 
-                    response_time.as_secs_f32() * 1000.0,
-                    last_button_check.elapsed().as_secs_f32() * 1000.0
-                );
+        // Drain button input - on an edge interrupt, or when a debounce lockout
+        // or long press comes due
+        let mut input_event = false;
+        if wake_reasons & WAKE_BUTTON != 0 || button_manager.next_deadline().is_some_and(|at| at <= Instant::now()) {
+            while let Some(input) = button_manager.poll() {
+                let event = input.event;
+                log::info!("[BUTTON] {:?}, {:.2}ms after the edge", event, input.age().as_secs_f32() * 1000.0);
                 
                 // Check for shutdown trigger
                 if event == system::ButtonEvent::BothButtonsLongPress {
                     log::warn!("Shutdown triggered by button combination!");
                     if let Ok(mut mgr) = shutdown_manager.lock() { mgr.shutdown()?; }
-                    break;
+                    break 'main;
                 }
                 
-                let ui_start = Instant::now();
                 ui_manager.handle_button_event(event)?;
-                let ui_time = ui_start.elapsed();
+                input_event = true;
+                if event.affects_display() {
+                    display_manager.note_input(input.timestamp_us);
+                }
                 
                 // Reset activity timer on button press
                 display_manager.reset_activity_timer();
                 power_manager.activity_detected();
                 
-                let total_time = response_time + ui_time;
                 button_events_count += 1;
-                total_response_time += total_time;
-                if total_time > max_response_time {
-                    max_response_time = total_time;
-                }
-                
-                log::info!("[BUTTON_TEST] UI response time: {:.2}ms, Total response time: {:.2}ms", 
-                    ui_time.as_secs_f32() * 1000.0,
-                    total_time.as_secs_f32() * 1000.0
-                );
-                
-                // Update metrics for Prometheus/Grafana
-                let avg_response = if button_events_count > 0 {
-                    total_response_time / button_events_count
-                } else {
-                    Duration::ZERO
-                };
                 let test_duration = button_test_start.elapsed();
                 let events_per_sec = if test_duration.as_secs_f32() > 0.0 {
                     button_events_count as f32 / test_duration.as_secs_f32()
                 } else {
                     0.0
                 };
-                
-                // Update metrics
-                {
-                    let mut metrics = match crate::metrics::metrics().lock() {
-                        Ok(m) => m,
-                        Err(e) => {
-                            log::error!("Failed to lock metrics: {}", e);
-                            continue;
-                        }
-                    };
-                    metrics.update_button_metrics(
-                        avg_response.as_secs_f32() * 1000.0,
-                        max_response_time.as_secs_f32() * 1000.0,
-                        button_events_count as u64,
-                        events_per_sec
-                    );
-                }
-                
-                // Print summary every 10 button presses
-                if button_events_count % 10 == 0 {
-                    log::warn!("[BUTTON_TEST_SUMMARY] After {} events in {:.1}s: Avg response: {:.2}ms, Max: {:.2}ms, Events/sec: {:.1}", 
-                        button_events_count,
-                        test_duration.as_secs_f32(),
-                        avg_response.as_secs_f32() * 1000.0,
-                        max_response_time.as_secs_f32() * 1000.0,
-                        events_per_sec
-                    );
-                }
+                crate::metrics::metrics().update_button_metrics(button_events_count as u64, events_per_sec);
             }
-            last_button_check = Instant::now();
         }
 
         // Check for updates from Core 1
         // Process data from Core 1 (non-blocking)
-        if let Ok(processed_data) = core1_channels.processed_rx.try_recv() {
+        if let Some(processed_data) = core1_channels.processed_rx.pop() {
             // Core 1 now receives proper sensor data from Core 0, no override needed
             // Rate-limited debug logging to reduce spam
             use std::sync::atomic::{AtomicU32, Ordering};
@@ -1184,15 +912,9 @@ fn run_app(
                 processed_data.cpu_usage_core1
             );
             
-            // Update temperature and battery in metrics
+            // Update temperature and battery in metrics (sensor history samples them from there)
             {
-                let mut metrics = match crate::metrics::metrics().lock() {
-                    Ok(m) => m,
-                    Err(e) => {
-                        log::error!("Failed to lock metrics: {}", e);
-                        continue;
-                    }
-                };
+                let metrics = crate::metrics::metrics();
                 metrics.update_temperature(processed_data.temperature);
                 metrics.update_battery(
                     processed_data.battery_voltage,
@@ -1201,14 +923,6 @@ fn run_app(
                 );
             }
             
-            // Update sensor history
-            if let Some(history) = crate::sensors::history::get() {
-                if let Ok(hist) = history.lock() {
-                    hist.add_temperature(processed_data.temperature);
-                    hist.add_battery(processed_data.battery_percentage as f32);
-                }
-            }
-            
             // TEMPORARILY DISABLED: Update power manager with sensor data (skip during startup grace period)
             // if startup_time.elapsed() > startup_grace_period {
             //     power_manager.update(&sensors::SensorData {
@@ -1241,11 +955,15 @@ fn run_app(
             last_network_update = Instant::now();
         }
         
-        // Update OTA status periodically (if OTA is available)
-        if last_ota_check.elapsed() >= ota_check_interval {
+        // Update OTA status periodically or when the OTA writer reports progress
+        if wake_reasons & WAKE_OTA != 0 || last_ota_check.elapsed() >= ota_check_interval {
             if let Some(ref ota_mgr) = ota_manager {
-                let ota_status = match ota_mgr.lock() {
+                let ota_status = match ota_mgr.try_lock() {
                     Ok(mgr) => mgr.get_status(),
+                    // Held by the upload handler for the whole transfer
+                    Err(std::sync::TryLockError::WouldBlock) => {
+                        crate::ota::OtaStatus::Downloading { progress: crate::ota::pipeline::progress() }
+                    }
                     Err(e) => {
                         log::error!("Failed to lock OTA manager: {}", e);
                         continue;
@@ -1289,28 +1007,59 @@ fn run_app(
             }
         }
 
-        // Update and render UI
-        ui_manager.update()?;
-        
-        let render_start = Instant::now();
-        let rendered = ui_manager.render(&mut display_manager)?;
-        let render_time = render_start.elapsed();
+        // Scale the frame rate with the power mode; a dark display needs almost none
+        let display_mode = if should_display_on { power_manager.get_mode() } else { PowerMode::Sleep };
+        frame_scheduler.set_power_mode(display_mode);
+        // Modem power save follows the same mode and any open sessions
+        network::wifi_reconnect::apply_link_policy(display_mode);
         
-        // Track whether frame was actually rendered or skipped
-        if rendered {
-            perf_metrics.record_render_time(render_time);
+        // Update and render UI - input renders immediately, anything else waits
+        // for the frame period
+        if input_event || frame_scheduler.frame_due() {
+            let _alloc_tag = alloc_profiler::scope(alloc_profiler::Tag::Display);
+            let _frame_span = trace::span(trace::FRAME);
+            ui_manager.update()?;
             
-            display_manager.update_auto_dim(should_display_on)?;
+            let render_start = Instant::now();
+            let rendered = ui_manager.render(&mut display_manager)?;
+            let render_time = render_start.elapsed();
             
-            // Flush to display
-            let flush_start = Instant::now();
-            display_manager.flush()?;
-            let flush_time = flush_start.elapsed();
-            perf_metrics.record_flush_time(flush_time);
+            // Track whether frame was actually rendered or skipped
+            if rendered {
+                perf_metrics.record_render_time(render_time);
+                
+                display_manager.update_auto_dim(should_display_on)?;
+                
+                // Flush to display - with double buffering this returns while
+                // the frame is still streaming, so transfer and wait differ
+                display_manager.flush()?;
+                let flush_timing = display_manager.flush_timing();
+                perf_metrics.record_flush_time(flush_timing.transfer);
+                perf_metrics.record_flush_wait(flush_timing.blocked);
+                frame_scheduler.frame_rendered();
+                
+                if let Some(latency_us) = display_manager.take_input_latency_us() {
+                    input_latency.record(latency_us);
+                    input_latency_total_us += latency_us as u64;
+                    let avg_ms = input_latency_total_us as f32 / input_latency.count as f32 / 1000.0;
+                    crate::metrics::metrics().update_button_latency(&input_latency, avg_ms);
+                    log::info!("[BUTTON] input-to-photon {:.2}ms (p95 {:.1}ms over {})",
+                        latency_us as f32 / 1000.0, input_latency.percentile_us(95) as f32 / 1000.0, input_latency.count);
+                }
+                
+                // The first frame is on screen; now register the routes boot deferred
+                if let Some(server) = web_server.as_mut() {
+                    if let Err(e) = server.register_deferred_routes() {
+                        log::error!("Failed to register deferred web routes: {:?}", e);
+                    }
+                }
+            } else {
+                // Frame was skipped by UI manager
+                perf_metrics.fps_tracker.frame_skipped();
+                
+                display_manager.update_auto_dim(should_display_on)?;
+            }
         } else {
-            // Frame was skipped by UI manager
-            perf_metrics.fps_tracker.frame_skipped();
-            
             display_manager.update_auto_dim(should_display_on)?;
         }
         
@@ -1319,9 +1068,6 @@ fn run_app(
         let loop_time = frame_start.elapsed();
         perf_metrics.fps_tracker.frame_rendered(loop_time);
 
-        // Frame timing and telemetry
-        let frame_time = frame_start.elapsed();
-        
         // Update memory stats periodically
         perf_metrics.update_memory_stats();
         
@@ -1389,16 +1135,31 @@ fn run_app(
                 let cpu0_str = if cpu0_usage == 0 { "N/A".to_string() } else { format!("{}%", cpu0_usage) };
                 let cpu1_str = if cpu1_usage == 0 { "N/A".to_string() } else { format!("{}%", cpu1_usage) };
                 
-                let cores_msg = format!("[CORES] CPU0: {} | CPU1: {} | Tasks: C0={} C1={} Total={} | Avg: {}μs",
+                let cores_msg = format!("[CORES] CPU0: {} | CPU1: {} | Tasks: C0={} C1={} Total={} | Avg: {}μs | Steals: {}",
                     cpu0_str,
                     cpu1_str,
                     core_stats.core0_tasks,
                     core_stats.core1_tasks,
                     core_stats.total_tasks,
-                    core_stats.avg_task_time_us
+                    core_stats.avg_task_time_us,
+                    core_stats.steals
                 );
                 log::info!("{}", cores_msg);
                 
+                // Job latency per work kind that has run at least once
+                let mut jobs_msg = String::from("[JOBS]");
+                for item in WorkItem::ALL {
+                    let latency = core_stats.latency_of(item);
+                    if latency.count > 0 {
+                        jobs_msg.push_str(&format!(" {}: n={} p50={}μs p99={}μs max={}μs |",
+                            item.name(), latency.count, latency.percentile_us(50),
+                            latency.percentile_us(99), latency.max_us));
+                    }
+                }
+                if jobs_msg.len() > "[JOBS]".len() {
+                    log::info!("{}", jobs_msg.trim_end_matches(" |"));
+                }
+                
                 // Update last logged values
                 last_logged_fps = fps_stats.current_fps;
                 last_logged_cpu0 = cpu0_usage;
@@ -1416,13 +1177,7 @@ fn run_app(
             
             // Update global metrics
             {
-                let mut metrics = match crate::metrics::metrics().lock() {
-                    Ok(m) => m,
-                    Err(e) => {
-                        log::error!("Failed to lock metrics: {}", e);
-                        continue;
-                    }
-                };
+                let metrics = crate::metrics::metrics();
                 
                 // FPS and performance metrics
                 metrics.update_fps(fps_stats.current_fps, DISPLAY_MAX_FPS); // realistic target based on hardware
@@ -1430,6 +1185,9 @@ fn run_app(
                 // Frame skip metrics
                 metrics.update_frame_stats(fps_stats.total_frames, fps_stats.skipped_frames);
                 
+                // Share of the last second the main loop spent asleep
+                metrics.update_idle(frame_scheduler.take_idle_percent());
+                
                 // Debug log what we're storing
                 if fps_stats.current_fps > 100.0 {
                     log::warn!("[METRICS] Unrealistic FPS being stored: {:.1} (frames: {}, skipped: {})", 
@@ -1443,14 +1201,15 @@ fn run_app(
                 // Timing metrics
                 let render_ms = (perf_metrics.last_render_time.as_secs_f32() * 1000.0) as u32;
                 let flush_ms = (perf_metrics.last_flush_time.as_secs_f32() * 1000.0) as u32;
-                metrics.update_timings(render_ms, flush_ms);
+                let flush_wait_ms = (perf_metrics.last_flush_wait.as_secs_f32() * 1000.0) as u32;
+                metrics.update_timings(render_ms, flush_ms, flush_wait_ms);
                 
                 // WiFi signal strength and connection status
                 let rssi = network_manager.get_signal_strength();
                 metrics.update_wifi_signal(rssi);
                 metrics.update_wifi_status(
                     network_manager.is_connected(),
-                    network_manager.get_ssid().to_string()
+                    network_manager.get_ssid()
                 );
                 
                 // Display brightness (static for now, but available for future use)
@@ -1478,6 +1237,10 @@ fn run_app(
                 // Note: Temperature and battery are updated from Core 1 data elsewhere
                 // HTTP connection metrics are updated by the web server
                 // Telnet connection metrics are updated by the telnet server
+                
+                // One consistent snapshot per tick for every exporter
+                metrics.publish();
+                crate::network::telemetry_hub::notify_tick();
             }
             
             // Reset report timer
@@ -1493,16 +1256,22 @@ fn run_app(
             last_memory_check = Instant::now();
         }
         
-        // Frame rate limiting – align to hardware (~10 FPS) and avoid busy-waiting
-        const ENABLE_FPS_CAP: bool = true; // Set to true for production, false for benchmarking
-        if ENABLE_FPS_CAP {
-            let target_frame = Duration::from_millis(100); // ~10 FPS
-            if frame_time < target_frame {
-                let wait_time = target_frame - frame_time;
-                // Fully yield the CPU to other tasks (TCP/IP, HTTPD)
-                esp_idf_hal::delay::FreeRtos::delay_ms(wait_time.as_millis() as u32);
-            }
+        // Sleep until the next event or the earliest deadline - the UI's own
+        // (animation, clocks; never before the frame period ends) or a timer above
+        frame_scheduler.schedule(ui_manager.next_frame_deadline().max(frame_scheduler.next_frame_at()));
+        frame_scheduler.schedule(last_sensor_reading + sensor_reading_interval);
+        frame_scheduler.schedule(last_network_update + network_update_interval);
+        frame_scheduler.schedule(last_ota_check + ota_check_interval);
+        frame_scheduler.schedule(last_watchdog_reset + watchdog_reset_interval);
+        frame_scheduler.schedule(last_fps_report + Duration::from_secs(1));
+        if let Some(at) = button_manager.next_deadline() {
+            frame_scheduler.schedule(at);
         }
+        #[cfg(feature = "esp_lcd_driver")]
+        frame_scheduler.schedule(last_memory_check + memory_check_interval);
+        
+        // Fully yields the CPU to other tasks (TCP/IP, HTTPD) and the idle task
+        wake_reasons = frame_scheduler.wait();
     }
     
     // Graceful shutdown
@@ -1,23 +1,155 @@
+use crate::alloc_profiler::AllocProfile;
 use crate::metrics::MetricsData;
-use std::fmt::Write;
+use crate::network::observability::RouteSnapshot;
+use std::fmt::{self, Write};
 
-/// Efficient metrics formatter for Prometheus format
-pub struct MetricsFormatter {
-    buffer: String,
+// Bytes gathered before a chunk goes out; lives on the scraping task's stack
+const SCRATCH_BYTES: usize = 512;
+
+/// Text format negotiated with the scraper
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Exposition {
+    /// Prometheus text format 0.0.4
+    Prometheus,
+    /// OpenMetrics 1.0 text: counters end in `_total`, no blank lines, `# EOF`
+    OpenMetrics,
 }
 
-impl MetricsFormatter {
-    /// Create a new formatter with pre-allocated buffer
-    pub fn new() -> Self {
-        Self {
-            // Pre-allocate based on typical metrics size (~2KB)
-            buffer: String::with_capacity(2048),
+impl Exposition {
+    /// Pick the format from an Accept header (Prometheus sends
+    /// `application/openmetrics-text` first when it supports it)
+    pub fn negotiate(accept: Option<&str>) -> Self {
+        match accept {
+            Some(accept) if accept.split(',').any(|media| {
+                let mut params = media.split(';').map(str::trim);
+                params.next() == Some("application/openmetrics-text")
+                    && !params.any(|param| param == "q=0")
+            }) => Exposition::OpenMetrics,
+            _ => Exposition::Prometheus,
         }
     }
 
-    /// Format all metrics into Prometheus format
-    pub fn format_metrics(
-        &mut self,
+    pub fn content_type(self) -> &'static str {
+        match self {
+            Exposition::Prometheus => "text/plain; version=0.0.4; charset=utf-8",
+            Exposition::OpenMetrics => "application/openmetrics-text; version=1.0.0; charset=utf-8",
+        }
+    }
+}
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum Kind {
+    Gauge,
+    Counter,
+    Summary,
+}
+
+/// A metric family; `header` is the complete Prometheus HELP/TYPE preamble
+struct Family {
+    name: &'static str,
+    help: &'static str,
+    kind: Kind,
+    header: &'static str,
+}
+
+macro_rules! family {
+    ($const:ident, gauge, $name:literal, $help:literal) => {
+        family!(@ $const, Gauge, "gauge", $name, $help);
+    };
+    ($const:ident, counter, $name:literal, $help:literal) => {
+        family!(@ $const, Counter, "counter", $name, $help);
+    };
+    ($const:ident, summary, $name:literal, $help:literal) => {
+        family!(@ $const, Summary, "summary", $name, $help);
+    };
+    (@ $const:ident, $kind:ident, $type:literal, $name:literal, $help:literal) => {
+        const $const: Family = Family {
+            name: $name,
+            help: $help,
+            kind: Kind::$kind,
+            header: concat!("# HELP ", $name, " ", $help, "\n# TYPE ", $name, " ", $type, "\n"),
+        };
+    };
+}
+
+family!(DEVICE_INFO, gauge, "esp32_device_info", "Device information");
+family!(UPTIME, counter, "esp32_uptime_seconds", "Total uptime in seconds");
+family!(HEAP_FREE, gauge, "esp32_heap_free_bytes", "Current free heap memory in bytes");
+family!(HEAP_TOTAL, gauge, "esp32_heap_total_bytes", "Total heap memory in bytes");
+family!(FPS_ACTUAL, gauge, "esp32_fps_actual", "Current actual frames per second");
+family!(FPS_TARGET, gauge, "esp32_fps_target", "Target frames per second");
+family!(CPU_USAGE, gauge, "esp32_cpu_usage_percent", "CPU usage percentage (average)");
+family!(CPU0_USAGE, gauge, "esp32_cpu0_usage_percent", "CPU Core 0 usage percentage");
+family!(CPU1_USAGE, gauge, "esp32_cpu1_usage_percent", "CPU Core 1 usage percentage");
+family!(CPU_FREQ, gauge, "esp32_cpu_freq_mhz", "CPU frequency in MHz");
+family!(TEMPERATURE, gauge, "esp32_temperature_celsius", "Internal temperature in Celsius");
+family!(WIFI_RSSI, gauge, "esp32_wifi_rssi_dbm", "WiFi signal strength in dBm");
+family!(WIFI_CONNECTED, gauge, "esp32_wifi_connected", "WiFi connection status (0=disconnected, 1=connected)");
+family!(BRIGHTNESS, gauge, "esp32_display_brightness", "Display brightness level (0-255)");
+family!(BATTERY_VOLTAGE, gauge, "esp32_battery_voltage_mv", "Battery voltage in millivolts");
+family!(BATTERY_PERCENTAGE, gauge, "esp32_battery_percentage", "Battery charge percentage");
+family!(BATTERY_CHARGING, gauge, "esp32_battery_charging", "Battery charging status (0=not charging, 1=charging)");
+family!(RENDER_TIME, gauge, "esp32_render_time_milliseconds", "Display render time in milliseconds");
+family!(FLUSH_TIME, gauge, "esp32_flush_time_milliseconds", "Display flush time in milliseconds");
+family!(FLUSH_WAIT, gauge, "esp32_flush_wait_milliseconds", "Time the render loop was blocked by display flush in milliseconds");
+family!(LOOP_IDLE, gauge, "esp32_main_loop_idle_percent", "Share of time the main loop spent sleeping between events");
+family!(SKIP_RATE, gauge, "esp32_frame_skip_rate_percent", "Percentage of frames skipped");
+family!(FRAMES, counter, "esp32_total_frames_count", "Total number of frames processed");
+family!(SKIPPED_FRAMES, counter, "esp32_skipped_frames_count", "Number of frames skipped");
+family!(PSRAM_FREE, gauge, "esp32_psram_free_bytes", "Free PSRAM memory in bytes");
+family!(PSRAM_TOTAL, gauge, "esp32_psram_total_bytes", "Total PSRAM memory in bytes");
+family!(PSRAM_USED, gauge, "esp32_psram_used_percent", "PSRAM usage percentage");
+family!(BUTTON_AVG, gauge, "esp32_button_avg_response_ms", "Average button response time in milliseconds");
+family!(BUTTON_MAX, gauge, "esp32_button_max_response_ms", "Maximum button response time in milliseconds");
+family!(BUTTON_EVENTS, counter, "esp32_button_events_total", "Total button events");
+family!(BUTTON_RATE, gauge, "esp32_button_events_per_second", "Button events per second");
+family!(BUTTON_LATENCY, summary, "esp32_button_input_to_photon_seconds", "Button edge to the flushed frame showing the response");
+family!(HTTP_ACTIVE, gauge, "esp32_http_connections_active", "Currently active HTTP connections");
+family!(HTTP_TOTAL, counter, "esp32_http_connections_total", "Total HTTP connections handled");
+family!(TELNET_ACTIVE, gauge, "esp32_telnet_connections_active", "Currently active telnet connections");
+family!(TELNET_TOTAL, counter, "esp32_telnet_connections_total", "Total telnet connections handled");
+family!(WIFI_DISCONNECTS, counter, "esp32_wifi_disconnects_total", "Total WiFi disconnections");
+family!(WIFI_RECONNECTS, counter, "esp32_wifi_reconnects_total", "Total WiFi reconnections");
+family!(SESSION_UPTIME, counter, "esp32_session_uptime_seconds", "Current session uptime in seconds");
+family!(HTTP_DURATION, summary, "esp32_http_request_duration_seconds", "HTTP handler latency per route");
+family!(HTTP_MAX, gauge, "esp32_http_request_max_seconds", "Slowest request per route");
+family!(HTTP_ERRORS, counter, "esp32_http_request_errors_total", "Failed requests per route");
+family!(HTTP_BYTES, counter, "esp32_http_response_bytes_total", "Bytes sent per route");
+family!(HTTP_HEAP_DELTA, gauge, "esp32_http_request_heap_delta_max_bytes", "Largest free-heap drop across one request");
+family!(HTTP_STACK, gauge, "esp32_http_httpd_stack_low_water_bytes", "Lowest httpd stack watermark after a request");
+family!(ALLOC_LIVE, gauge, "esp32_heap_tagged_live_bytes", "Live heap bytes per subsystem tag");
+family!(ALLOC_PEAK, gauge, "esp32_heap_tagged_peak_bytes", "Peak live heap bytes per subsystem tag");
+family!(ALLOC_COUNT, counter, "esp32_heap_tagged_allocations_total", "Allocations per subsystem tag");
+family!(ALLOC_CLASS_COUNT, counter, "esp32_heap_size_class_allocations_total", "Allocations per log2 size class");
+family!(ALLOC_CLASS_LIVE, gauge, "esp32_heap_size_class_live_blocks", "Live blocks per log2 size class");
+family!(ALLOC_FAILURES, counter, "esp32_heap_allocation_failures_total", "Allocations the heap could not satisfy");
+family!(ALLOC_LARGEST_FREE, gauge, "esp32_heap_largest_free_block_bytes", "Largest free internal heap block");
+
+/// Streaming encoder for the /metrics exposition.
+///
+/// Text is formatted into a small fixed scratch buffer and handed to `sink`
+/// (normally one chunk of the HTTP response) whenever the buffer fills, so a
+/// scrape allocates nothing however many routes are reported.
+pub struct MetricsEncoder<F, E> {
+    format: Exposition,
+    sink: F,
+    scratch: [u8; SCRATCH_BYTES],
+    len: usize,
+    // First sink error; once set, further output is dropped
+    error: Option<E>,
+}
+
+impl<F, E> MetricsEncoder<F, E>
+where
+    F: FnMut(&[u8]) -> Result<(), E>,
+{
+    pub fn new(format: Exposition, sink: F) -> Self {
+        Self { format, sink, scratch: [0; SCRATCH_BYTES], len: 0, error: None }
+    }
+
+    /// Encode all metrics and flush the remainder to the sink
+    pub fn encode(
+        mut self,
         metrics_data: &MetricsData,
         version: &str,
         board_type: &str,
@@ -25,64 +157,79 @@ impl MetricsFormatter {
         uptime_seconds: u64,
         heap_free: u32,
         heap_total: u32,
-    ) -> Result<String, std::fmt::Error> {
-        self.buffer.clear();
+        routes: &[RouteSnapshot],
+        allocations: Option<&AllocProfile>,
+    ) -> Result<(), E> {
+        // A formatting error here only ever means the sink failed
+        let _ = self.write_all(metrics_data, version, board_type, chip_model,
+                               uptime_seconds, heap_free, heap_total, routes, allocations);
+        self.flush();
+        match self.error {
+            Some(e) => Err(e),
+            None => Ok(()),
+        }
+    }
 
+    fn write_all(
+        &mut self,
+        metrics_data: &MetricsData,
+        version: &str,
+        board_type: &str,
+        chip_model: &str,
+        uptime_seconds: u64,
+        heap_free: u32,
+        heap_total: u32,
+        routes: &[RouteSnapshot],
+        allocations: Option<&AllocProfile>,
+    ) -> fmt::Result {
         // Device info
-        self.write_metric(
-            "esp32_device_info",
-            "Device information",
-            "gauge",
-            &format!("version=\"{}\",board=\"{}\",model=\"{}\"", version, board_type, chip_model),
-            1.0,
-        )?;
+        self.family(&DEVICE_INFO)?;
+        self.sample(&DEVICE_INFO, &[("version", version), ("board", board_type), ("model", chip_model)], 1.0)?;
+        self.end_family()?;
 
         // System metrics
-        self.write_simple_metric("esp32_uptime_seconds", "Total uptime in seconds", "counter", uptime_seconds as f64)?;
-        self.write_simple_metric("esp32_heap_free_bytes", "Current free heap memory in bytes", "gauge", heap_free as f64)?;
-        self.write_simple_metric("esp32_heap_total_bytes", "Total heap memory in bytes", "gauge", heap_total as f64)?;
+        self.simple(&UPTIME, uptime_seconds as f64)?;
+        self.simple(&HEAP_FREE, heap_free as f64)?;
+        self.simple(&HEAP_TOTAL, heap_total as f64)?;
 
         // Performance metrics
-        self.write_simple_metric("esp32_fps_actual", "Current actual frames per second", "gauge", metrics_data.fps_actual as f64)?;
-        self.write_simple_metric("esp32_fps_target", "Target frames per second", "gauge", metrics_data.fps_target as f64)?;
+        self.simple(&FPS_ACTUAL, metrics_data.fps_actual as f64)?;
+        self.simple(&FPS_TARGET, metrics_data.fps_target as f64)?;
 
         // CPU metrics
-        self.write_simple_metric("esp32_cpu_usage_percent", "CPU usage percentage (average)", "gauge", metrics_data.cpu_usage as f64)?;
-        self.write_simple_metric("esp32_cpu0_usage_percent", "CPU Core 0 usage percentage", "gauge", metrics_data.cpu0_usage as f64)?;
-        self.write_simple_metric("esp32_cpu1_usage_percent", "CPU Core 1 usage percentage", "gauge", metrics_data.cpu1_usage as f64)?;
-        self.write_simple_metric("esp32_cpu_freq_mhz", "CPU frequency in MHz", "gauge", metrics_data.cpu_freq_mhz as f64)?;
+        self.simple(&CPU_USAGE, metrics_data.cpu_usage as f64)?;
+        self.simple(&CPU0_USAGE, metrics_data.cpu0_usage as f64)?;
+        self.simple(&CPU1_USAGE, metrics_data.cpu1_usage as f64)?;
+        self.simple(&CPU_FREQ, metrics_data.cpu_freq_mhz as f64)?;
 
         // Temperature
-        self.write_simple_metric("esp32_temperature_celsius", "Internal temperature in Celsius", "gauge", metrics_data.temperature as f64)?;
+        self.simple(&TEMPERATURE, metrics_data.temperature as f64)?;
 
         // WiFi metrics
-        self.write_simple_metric("esp32_wifi_rssi_dbm", "WiFi signal strength in dBm", "gauge", metrics_data.wifi_rssi as f64)?;
-        
-        let wifi_ssid = if metrics_data.wifi_connected { 
-            &metrics_data.wifi_ssid 
-        } else { 
-            "_disconnected" 
+        self.simple(&WIFI_RSSI, metrics_data.wifi_rssi as f64)?;
+
+        let wifi_ssid = if metrics_data.wifi_connected {
+            metrics_data.wifi_ssid()
+        } else {
+            "_disconnected"
         };
-        self.write_metric(
-            "esp32_wifi_connected",
-            "WiFi connection status (0=disconnected, 1=connected)",
-            "gauge",
-            &format!("ssid=\"{}\"", wifi_ssid),
-            if metrics_data.wifi_connected { 1.0 } else { 0.0 },
-        )?;
+        self.family(&WIFI_CONNECTED)?;
+        self.sample(&WIFI_CONNECTED, &[("ssid", wifi_ssid)], if metrics_data.wifi_connected { 1.0 } else { 0.0 })?;
+        self.end_family()?;
 
         // Display metrics
-        self.write_simple_metric("esp32_display_brightness", "Display brightness level (0-255)", "gauge", metrics_data.display_brightness as f64)?;
+        self.simple(&BRIGHTNESS, metrics_data.display_brightness as f64)?;
 
         // Battery metrics
-        self.write_simple_metric("esp32_battery_voltage_mv", "Battery voltage in millivolts", "gauge", metrics_data.battery_voltage_mv as f64)?;
-        self.write_simple_metric("esp32_battery_percentage", "Battery charge percentage", "gauge", metrics_data.battery_percentage as f64)?;
-        self.write_simple_metric("esp32_battery_charging", "Battery charging status (0=not charging, 1=charging)", "gauge", 
-            if metrics_data.battery_charging { 1.0 } else { 0.0 })?;
+        self.simple(&BATTERY_VOLTAGE, metrics_data.battery_voltage_mv as f64)?;
+        self.simple(&BATTERY_PERCENTAGE, metrics_data.battery_percentage as f64)?;
+        self.simple(&BATTERY_CHARGING, if metrics_data.battery_charging { 1.0 } else { 0.0 })?;
 
         // Timing metrics
-        self.write_simple_metric("esp32_render_time_milliseconds", "Display render time in milliseconds", "gauge", metrics_data.render_time_ms as f64)?;
-        self.write_simple_metric("esp32_flush_time_milliseconds", "Display flush time in milliseconds", "gauge", metrics_data.flush_time_ms as f64)?;
+        self.simple(&RENDER_TIME, metrics_data.render_time_ms as f64)?;
+        self.simple(&FLUSH_TIME, metrics_data.flush_time_ms as f64)?;
+        self.simple(&FLUSH_WAIT, metrics_data.flush_wait_time_ms as f64)?;
+        self.simple(&LOOP_IDLE, metrics_data.main_loop_idle_percent as f64)?;
 
         // Frame statistics
         let skip_rate = if metrics_data.frame_count > 0 {
@@ -90,56 +237,242 @@ impl MetricsFormatter {
         } else {
             0.0
         };
-        self.write_simple_metric("esp32_frame_skip_rate_percent", "Percentage of frames skipped", "gauge", skip_rate)?;
-        self.write_simple_metric("esp32_total_frames_count", "Total number of frames processed", "counter", metrics_data.frame_count as f64)?;
-        self.write_simple_metric("esp32_skipped_frames_count", "Number of frames skipped", "counter", metrics_data.skip_count as f64)?;
+        self.simple(&SKIP_RATE, skip_rate)?;
+        self.simple(&FRAMES, metrics_data.frame_count as f64)?;
+        self.simple(&SKIPPED_FRAMES, metrics_data.skip_count as f64)?;
 
         // PSRAM metrics
-        self.write_simple_metric("esp32_psram_free_bytes", "Free PSRAM memory in bytes", "gauge", metrics_data.psram_free as f64)?;
-        self.write_simple_metric("esp32_psram_total_bytes", "Total PSRAM memory in bytes", "gauge", metrics_data.psram_total as f64)?;
-        
+        self.simple(&PSRAM_FREE, metrics_data.psram_free as f64)?;
+        self.simple(&PSRAM_TOTAL, metrics_data.psram_total as f64)?;
+
         let psram_usage = if metrics_data.psram_total > 0 {
             (metrics_data.psram_total - metrics_data.psram_free) as f64 / metrics_data.psram_total as f64 * 100.0
         } else {
             0.0
         };
-        self.write_simple_metric("esp32_psram_used_percent", "PSRAM usage percentage", "gauge", psram_usage)?;
+        self.simple(&PSRAM_USED, psram_usage)?;
 
         // Button metrics (if available)
         if metrics_data.button_events_total > 0 {
-            self.write_simple_metric("esp32_button_avg_response_ms", "Average button response time in milliseconds", "gauge", metrics_data.button_avg_response_ms as f64)?;
-            self.write_simple_metric("esp32_button_max_response_ms", "Maximum button response time in milliseconds", "gauge", metrics_data.button_max_response_ms as f64)?;
-            self.write_simple_metric("esp32_button_events_total", "Total button events", "counter", metrics_data.button_events_total as f64)?;
-            self.write_simple_metric("esp32_button_events_per_second", "Button events per second", "gauge", metrics_data.button_events_per_second as f64)?;
+            self.simple(&BUTTON_AVG, metrics_data.button_avg_response_ms as f64)?;
+            self.simple(&BUTTON_MAX, metrics_data.button_max_response_ms as f64)?;
+            self.simple(&BUTTON_EVENTS, metrics_data.button_events_total as f64)?;
+            self.simple(&BUTTON_RATE, metrics_data.button_events_per_second as f64)?;
+        }
+        if metrics_data.button_response_samples > 0 {
+            self.write_button_latency(metrics_data)?;
         }
-        
+
         // Connection monitoring metrics
-        self.write_simple_metric("esp32_http_connections_active", "Currently active HTTP connections", "gauge", metrics_data.http_connections_active as f64)?;
-        self.write_simple_metric("esp32_http_connections_total", "Total HTTP connections handled", "counter", metrics_data.http_connections_total as f64)?;
-        self.write_simple_metric("esp32_telnet_connections_active", "Currently active telnet connections", "gauge", metrics_data.telnet_connections_active as f64)?;
-        self.write_simple_metric("esp32_telnet_connections_total", "Total telnet connections handled", "counter", metrics_data.telnet_connections_total as f64)?;
-        self.write_simple_metric("esp32_wifi_disconnects_total", "Total WiFi disconnections", "counter", metrics_data.wifi_disconnects as f64)?;
-        self.write_simple_metric("esp32_wifi_reconnects_total", "Total WiFi reconnections", "counter", metrics_data.wifi_reconnects as f64)?;
-        self.write_simple_metric("esp32_session_uptime_seconds", "Current session uptime in seconds", "counter", metrics_data.uptime_seconds as f64)?;
-
-        Ok(self.buffer.clone())
-    }
-
-    /// Write a simple metric without labels
-    fn write_simple_metric(&mut self, name: &str, help: &str, metric_type: &str, value: f64) -> Result<(), std::fmt::Error> {
-        writeln!(&mut self.buffer, "# HELP {} {}", name, help)?;
-        writeln!(&mut self.buffer, "# TYPE {} {}", name, metric_type)?;
-        writeln!(&mut self.buffer, "{} {}", name, value)?;
-        writeln!(&mut self.buffer)?;
+        self.simple(&HTTP_ACTIVE, metrics_data.http_connections_active as f64)?;
+        self.simple(&HTTP_TOTAL, metrics_data.http_connections_total as f64)?;
+        self.simple(&TELNET_ACTIVE, metrics_data.telnet_connections_active as f64)?;
+        self.simple(&TELNET_TOTAL, metrics_data.telnet_connections_total as f64)?;
+        self.simple(&WIFI_DISCONNECTS, metrics_data.wifi_disconnects as f64)?;
+        self.simple(&WIFI_RECONNECTS, metrics_data.wifi_reconnects as f64)?;
+        self.simple(&SESSION_UPTIME, metrics_data.uptime_seconds as f64)?;
+
+        // Per-route HTTP profiler
+        self.write_http_routes(routes)?;
+
+        // Allocation profiler (alloc_profiler builds only)
+        if let Some(profile) = allocations {
+            self.write_allocations(profile)?;
+        }
+
+        if self.format == Exposition::OpenMetrics {
+            self.write_str("# EOF\n")?;
+        }
         Ok(())
     }
 
-    /// Write a metric with labels
-    fn write_metric(&mut self, name: &str, help: &str, metric_type: &str, labels: &str, value: f64) -> Result<(), std::fmt::Error> {
-        writeln!(&mut self.buffer, "# HELP {} {}", name, help)?;
-        writeln!(&mut self.buffer, "# TYPE {} {}", name, metric_type)?;
-        writeln!(&mut self.buffer, "{}{{{}}} {}", name, labels, value)?;
-        writeln!(&mut self.buffer)?;
+    /// Write per-route latency summaries and request accounting
+    fn write_http_routes(&mut self, routes: &[RouteSnapshot]) -> fmt::Result {
+        if routes.is_empty() {
+            return Ok(());
+        }
+
+        // Quantiles are log2 bucket upper bounds, capped at the observed maximum
+        self.family(&HTTP_DURATION)?;
+        for route in routes {
+            for (quantile, us) in [("0.5", route.p50_us), ("0.95", route.p95_us), ("0.99", route.p99_us)] {
+                self.sample(&HTTP_DURATION, &[("method", route.method), ("route", route.route), ("quantile", quantile)],
+                            us as f64 / 1_000_000.0)?;
+            }
+            let labels = [("method", route.method), ("route", route.route)];
+            self.suffixed_sample(&HTTP_DURATION, "_sum", &labels, route.total_us as f64 / 1_000_000.0)?;
+            self.suffixed_sample(&HTTP_DURATION, "_count", &labels, route.requests as f64)?;
+        }
+        self.end_family()?;
+
+        self.route_family(&HTTP_MAX, routes, |route| route.max_us as f64 / 1_000_000.0)?;
+        self.route_family(&HTTP_ERRORS, routes, |route| route.errors as f64)?;
+        self.route_family(&HTTP_BYTES, routes, |route| route.bytes_sent as f64)?;
+        self.route_family(&HTTP_HEAP_DELTA, routes, |route| route.heap_delta_max as f64)?;
+        self.route_family(&HTTP_STACK, routes, |route| route.stack_low_water_bytes as f64)
+    }
+
+    /// Input-to-photon summary; quantiles are log2 bucket upper bounds
+    fn write_button_latency(&mut self, metrics_data: &MetricsData) -> fmt::Result {
+        self.family(&BUTTON_LATENCY)?;
+        for (quantile, ms) in [("0.5", metrics_data.button_p50_response_ms),
+                               ("0.95", metrics_data.button_p95_response_ms),
+                               ("0.99", metrics_data.button_p99_response_ms)] {
+            self.sample(&BUTTON_LATENCY, &[("quantile", quantile)], ms as f64 / 1000.0)?;
+        }
+        let samples = metrics_data.button_response_samples as f64;
+        self.suffixed_sample(&BUTTON_LATENCY, "_sum", &[], metrics_data.button_avg_response_ms as f64 / 1000.0 * samples)?;
+        self.suffixed_sample(&BUTTON_LATENCY, "_count", &[], samples)?;
+        self.end_family()
+    }
+
+    /// Per-tag and per-size-class heap accounting
+    fn write_allocations(&mut self, profile: &AllocProfile) -> fmt::Result {
+        self.family(&ALLOC_LIVE)?;
+        for usage in &profile.tags {
+            self.sample(&ALLOC_LIVE, &[("tag", usage.tag)], usage.live_bytes as f64)?;
+        }
+        self.end_family()?;
+        self.family(&ALLOC_PEAK)?;
+        for usage in &profile.tags {
+            self.sample(&ALLOC_PEAK, &[("tag", usage.tag)], usage.peak_bytes as f64)?;
+        }
+        self.end_family()?;
+        self.family(&ALLOC_COUNT)?;
+        for usage in &profile.tags {
+            self.sample(&ALLOC_COUNT, &[("tag", usage.tag)], usage.allocations as f64)?;
+        }
+        self.end_family()?;
+
+        self.family(&ALLOC_CLASS_COUNT)?;
+        for class in &profile.size_classes {
+            self.sample(&ALLOC_CLASS_COUNT, &[("size", class.size)], class.allocations as f64)?;
+        }
+        self.end_family()?;
+        self.family(&ALLOC_CLASS_LIVE)?;
+        for class in &profile.size_classes {
+            self.sample(&ALLOC_CLASS_LIVE, &[("size", class.size)], class.live as f64)?;
+        }
+        self.end_family()?;
+
+        self.simple(&ALLOC_FAILURES, profile.failures as f64)?;
+        self.simple(&ALLOC_LARGEST_FREE, profile.largest_free_internal as f64)
+    }
+
+    /// One metric family with a sample per route
+    fn route_family(&mut self, family: &Family, routes: &[RouteSnapshot], value: impl Fn(&RouteSnapshot) -> f64) -> fmt::Result {
+        self.family(family)?;
+        for route in routes {
+            self.sample(family, &[("method", route.method), ("route", route.route)], value(route))?;
+        }
+        self.end_family()
+    }
+
+    /// A family with a single unlabelled sample
+    fn simple(&mut self, family: &Family, value: f64) -> fmt::Result {
+        self.family(family)?;
+        self.sample(family, &[], value)?;
+        self.end_family()
+    }
+
+    /// HELP/TYPE preamble
+    fn family(&mut self, family: &Family) -> fmt::Result {
+        match self.format {
+            Exposition::Prometheus => self.write_str(family.header),
+            Exposition::OpenMetrics => {
+                // OpenMetrics names the counter family without its `_total` suffix
+                let (name, kind) = match family.kind {
+                    Kind::Gauge => (family.name, "gauge"),
+                    Kind::Counter => (family.name.strip_suffix("_total").unwrap_or(family.name), "counter"),
+                    Kind::Summary => (family.name, "summary"),
+                };
+                for part in ["# HELP ", name, " ", family.help, "\n# TYPE ", name, " ", kind, "\n"] {
+                    self.write_str(part)?;
+                }
+                Ok(())
+            }
+        }
+    }
+
+    fn end_family(&mut self) -> fmt::Result {
+        // OpenMetrics does not allow blank lines
+        match self.format {
+            Exposition::Prometheus => self.write_str("\n"),
+            Exposition::OpenMetrics => Ok(()),
+        }
+    }
+
+    fn sample(&mut self, family: &Family, labels: &[(&str, &str)], value: f64) -> fmt::Result {
+        let suffix = match (self.format, family.kind) {
+            (Exposition::OpenMetrics, Kind::Counter) if !family.name.ends_with("_total") => "_total",
+            _ => "",
+        };
+        self.suffixed_sample(family, suffix, labels, value)
+    }
+
+    fn suffixed_sample(&mut self, family: &Family, suffix: &str, labels: &[(&str, &str)], value: f64) -> fmt::Result {
+        self.write_str(family.name)?;
+        self.write_str(suffix)?;
+        if !labels.is_empty() {
+            self.write_char('{')?;
+            for (i, (name, value)) in labels.iter().enumerate() {
+                if i > 0 {
+                    self.write_char(',')?;
+                }
+                self.write_str(name)?;
+                self.write_str("=\"")?;
+                self.write_label_value(value)?;
+                self.write_char('"')?;
+            }
+            self.write_char('}')?;
+        }
+        writeln!(self, " {}", value)
+    }
+
+    /// Label value with `\`, `"` and newlines escaped
+    fn write_label_value(&mut self, value: &str) -> fmt::Result {
+        for part in value.split_inclusive(['\\', '"', '\n']) {
+            let (text, special) = match part.as_bytes().last() {
+                Some(b'\\') => (&part[..part.len() - 1], "\\\\"),
+                Some(b'"') => (&part[..part.len() - 1], "\\\""),
+                Some(b'\n') => (&part[..part.len() - 1], "\\n"),
+                _ => (part, ""),
+            };
+            self.write_str(text)?;
+            self.write_str(special)?;
+        }
+        Ok(())
+    }
+
+    fn flush(&mut self) {
+        if self.len > 0 && self.error.is_none() {
+            if let Err(e) = (self.sink)(&self.scratch[..self.len]) {
+                self.error = Some(e);
+            }
+        }
+        self.len = 0;
+    }
+}
+
+impl<F, E> fmt::Write for MetricsEncoder<F, E>
+where
+    F: FnMut(&[u8]) -> Result<(), E>,
+{
+    fn write_str(&mut self, s: &str) -> fmt::Result {
+        let mut bytes = s.as_bytes();
+        while !bytes.is_empty() {
+            if self.error.is_some() {
+                return Err(fmt::Error);
+            }
+            if self.len == SCRATCH_BYTES {
+                self.flush();
+                continue;
+            }
+            let take = bytes.len().min(SCRATCH_BYTES - self.len);
+            self.scratch[self.len..self.len + take].copy_from_slice(&bytes[..take]);
+            self.len += take;
+            bytes = &bytes[take..];
+        }
         Ok(())
     }
 }
@@ -148,31 +481,55 @@ impl MetricsFormatter {
 mod tests {
     use super::*;
 
+    fn encode(format: Exposition, metrics: &MetricsData, routes: &[RouteSnapshot]) -> (String, usize) {
+        let mut output = Vec::new();
+        let mut chunks = 0;
+        MetricsEncoder::new(format, |chunk: &[u8]| {
+            assert!(chunk.len() <= SCRATCH_BYTES);
+            output.extend_from_slice(chunk);
+            chunks += 1;
+            Ok::<(), ()>(())
+        })
+        .encode(metrics, "1.0.0", "ESP32-S3", "T-Display", 100, 1024, 2048, routes, None)
+        .expect("metrics encoding should succeed");
+        (String::from_utf8(output).expect("exposition is UTF-8"), chunks)
+    }
+
     #[test]
     fn test_metrics_formatting() {
-        let mut formatter = MetricsFormatter::new();
-        let metrics = MetricsData {
-            cpu_usage: 50,
-            fps_actual: 30.5,
-            wifi_connected: true,
-            wifi_ssid: "TestNetwork".to_string(),
-            ..Default::default()
-        };
+        let mut metrics = MetricsData::default();
+        metrics.cpu_usage = 50;
+        metrics.fps_actual = 30.5;
+        metrics.wifi_connected = true;
+        metrics.set_wifi_ssid("Test \"Network\"");
+        metrics.button_response_samples = 4;
+        metrics.button_p95_response_ms = 31.5;
+        let routes = [RouteSnapshot { method: "GET", route: "/health", requests: 2, total_us: 6_500, p50_us: 4095, ..Default::default() }];
+
+        let (output, chunks) = encode(Exposition::Prometheus, &metrics, &routes);
+        assert!(chunks > 1);
+        assert!(output.contains("# HELP esp32_device_info Device information\n# TYPE esp32_device_info gauge\n"));
+        assert!(output.contains("esp32_cpu_usage_percent 50\n"));
+        assert!(output.contains("esp32_fps_actual 30.5\n"));
+        assert!(output.contains("esp32_wifi_connected{ssid=\"Test \\\"Network\\\"\"} 1\n"));
+        assert!(output.contains("esp32_http_request_duration_seconds{method=\"GET\",route=\"/health\",quantile=\"0.5\"} 0.004095"));
+        assert!(output.contains("esp32_http_request_duration_seconds_sum{method=\"GET\",route=\"/health\"} 0.0065\n"));
+        assert!(output.contains("esp32_http_request_duration_seconds_count{method=\"GET\",route=\"/health\"} 2"));
+        assert!(output.contains("esp32_button_input_to_photon_seconds{quantile=\"0.95\"} 0.0315\n"));
+        assert!(output.contains("esp32_button_input_to_photon_seconds_count 4\n"));
 
-        let result = formatter.format_metrics(
-            &metrics,
-            "1.0.0",
-            "ESP32-S3",
-            "T-Display",
-            100,
-            1024,
-            2048,
-        );
-
-        assert!(result.is_ok());
-        let output = result.expect("metrics formatting should succeed");
-        assert!(output.contains("esp32_device_info"));
-        assert!(output.contains("esp32_cpu_usage_percent 50"));
-        assert!(output.contains("esp32_fps_actual 30.5"));
-    }
-}
\ No newline at end of file
+        let (output, _) = encode(Exposition::OpenMetrics, &metrics, &routes);
+        assert!(output.contains("# TYPE esp32_uptime_seconds counter\nesp32_uptime_seconds_total 100\n"));
+        assert!(output.contains("# TYPE esp32_wifi_disconnects counter\nesp32_wifi_disconnects_total 0\n"));
+        assert!(!output.contains("\n\n"));
+        assert!(output.ends_with("\n# EOF\n"));
+    }
+
+    #[test]
+    fn test_exposition_negotiation() {
+        assert_eq!(Exposition::negotiate(None), Exposition::Prometheus);
+        assert_eq!(Exposition::negotiate(Some("text/plain;version=0.0.4;q=0.5,*/*;q=0.1")), Exposition::Prometheus);
+        assert_eq!(Exposition::negotiate(Some("application/openmetrics-text;version=1.0.0,text/plain;q=0.5")),
+                   Exposition::OpenMetrics);
+    }
+}
@@ -0,0 +1,380 @@
+// Lock-free metrics storage
+//
+// Every field is an atomic, so writers on any task update single values
+// without locking or allocating. Readers never see the atomics directly:
+// the main loop publishes one consistent `MetricsData` per metrics tick into
+// a sequence lock, and every exporter (Prometheus, JSON, binary, SSE) copies
+// that cached snapshot out without blocking the publisher.
+
+use std::sync::{Arc, Mutex, OnceLock};
+use std::sync::atomic::{fence, AtomicU32, AtomicU16, AtomicU8, AtomicBool, Ordering};
+use crate::dual_core::LatencyHistogram;
+use crate::metrics::MetricsData;
+
+// Global metrics instance - use OnceLock for safe one-time initialization
+static METRICS: OnceLock<Arc<MetricsStore>> = OnceLock::new();
+
+// Initialize metrics
+pub fn init_metrics() {
+    METRICS.get_or_init(|| Arc::new(MetricsStore::new()));
+}
+
+// Get the metrics instance, initializing on demand if mis-ordered
+pub fn metrics() -> &'static Arc<MetricsStore> {
+    METRICS.get_or_init(|| Arc::new(MetricsStore::new()))
+}
+
+const SNAPSHOT_WORDS: usize = core::mem::size_of::<MetricsData>() / 4;
+
+/// Sequence lock holding the published snapshot. There is a single writer
+/// (`MetricsStore::publish`); readers retry if a publish overlapped their copy.
+struct SnapshotLock {
+    seq: AtomicU32,
+    // The snapshot as words, so a racing copy is never a data race
+    words: [AtomicU32; SNAPSHOT_WORDS],
+}
+
+impl SnapshotLock {
+    fn new() -> Self {
+        Self {
+            seq: AtomicU32::new(0),
+            words: std::array::from_fn(|_| AtomicU32::new(0)),
+        }
+    }
+
+    fn write(&self, data: &MetricsData) {
+        // SAFETY: MetricsData is repr(C) without padding (asserted in metrics.rs)
+        let words: [u32; SNAPSHOT_WORDS] = unsafe { core::mem::transmute_copy(data) };
+
+        let seq = self.seq.load(Ordering::Relaxed);
+        self.seq.store(seq.wrapping_add(1), Ordering::Relaxed);
+        fence(Ordering::Release);
+        for (slot, word) in self.words.iter().zip(words) {
+            slot.store(word, Ordering::Relaxed);
+        }
+        self.seq.store(seq.wrapping_add(2), Ordering::Release);
+    }
+
+    fn read(&self) -> MetricsData {
+        loop {
+            let before = self.seq.load(Ordering::Acquire);
+            if before & 1 == 0 {
+                let mut words = [0u32; SNAPSHOT_WORDS];
+                for (word, slot) in words.iter_mut().zip(&self.words) {
+                    *word = slot.load(Ordering::Relaxed);
+                }
+                fence(Ordering::Acquire);
+                if self.seq.load(Ordering::Relaxed) == before {
+                    // SAFETY: an unchanged sequence means the words are one
+                    // complete snapshot written from a valid MetricsData
+                    return unsafe { core::mem::transmute::<_, MetricsData>(words) };
+                }
+            }
+            // The publisher may be a lower-priority task on this core, so
+            // block for a tick rather than spin
+            esp_idf_hal::delay::FreeRtos::delay_ms(1);
+        }
+    }
+}
+
+/// Lock-free metrics storage
+pub struct MetricsStore {
+    cpu_usage: AtomicU8,
+    cpu_freq_mhz: AtomicU16,
+    cpu0_usage: AtomicU8,
+    cpu1_usage: AtomicU8,
+    temperature: AtomicF32,
+    
+    // WiFi
+    wifi_rssi: AtomicI8,
+    wifi_connected: AtomicBool,
+    // Only touched when the SSID changes and on publish
+    wifi_ssid: Mutex<heapless::String<32>>,
+    
+    // Display
+    display_brightness: AtomicU8,
+    
+    // Battery
+    battery_voltage_mv: AtomicU16,
+    battery_percentage: AtomicU8,
+    battery_charging: AtomicBool,
+    
+    // Performance counters (using u32 for compatibility)
+    fps_actual: AtomicF32,
+    fps_target: AtomicF32,
+    render_time_ms: AtomicU32,
+    flush_time_ms: AtomicU32,
+    flush_wait_time_ms: AtomicU32,
+    frame_count: AtomicU32,
+    main_loop_idle_percent: AtomicU8,
+    skip_count: AtomicU32,
+    
+    // PSRAM
+    psram_free: AtomicU32,
+    psram_total: AtomicU32,
+    
+    // Button metrics
+    button_avg_response_ms: AtomicF32,
+    button_max_response_ms: AtomicF32,
+    button_p50_response_ms: AtomicF32,
+    button_p95_response_ms: AtomicF32,
+    button_p99_response_ms: AtomicF32,
+    button_response_samples: AtomicU32,
+    button_events_total: AtomicU32,
+    button_events_per_second: AtomicF32,
+    
+    // Connection monitoring
+    http_connections_active: AtomicU32,
+    http_connections_total: AtomicU32,
+    telnet_connections_active: AtomicU32,
+    telnet_connections_total: AtomicU32,
+    wifi_disconnects: AtomicU32,
+    wifi_reconnects: AtomicU32,
+    uptime_seconds: AtomicU32,
+    
+    snapshot: SnapshotLock,
+}
+
+// Custom atomic for i8 since std doesn't provide AtomicI8
+struct AtomicI8(AtomicU8);
+
+impl AtomicI8 {
+    fn new(val: i8) -> Self {
+        Self(AtomicU8::new(val as u8))
+    }
+    
+    fn store(&self, val: i8, ordering: Ordering) {
+        self.0.store(val as u8, ordering);
+    }
+    
+    fn load(&self, ordering: Ordering) -> i8 {
+        self.0.load(ordering) as i8
+    }
+}
+
+// f32 stored as its bit pattern
+struct AtomicF32(AtomicU32);
+
+impl AtomicF32 {
+    fn new(val: f32) -> Self {
+        Self(AtomicU32::new(val.to_bits()))
+    }
+    
+    fn store(&self, val: f32, ordering: Ordering) {
+        self.0.store(val.to_bits(), ordering);
+    }
+    
+    fn load(&self, ordering: Ordering) -> f32 {
+        f32::from_bits(self.0.load(ordering))
+    }
+}
+
+impl MetricsStore {
+    pub fn new() -> Self {
+        let store = Self {
+            cpu_usage: AtomicU8::new(0),
+            cpu_freq_mhz: AtomicU16::new(240),
+            cpu0_usage: AtomicU8::new(0),
+            cpu1_usage: AtomicU8::new(0),
+            temperature: AtomicF32::new(0.0),
+            wifi_rssi: AtomicI8::new(0),
+            wifi_connected: AtomicBool::new(false),
+            wifi_ssid: Mutex::new(heapless::String::new()),
+            display_brightness: AtomicU8::new(255),
+            battery_voltage_mv: AtomicU16::new(0),
+            battery_percentage: AtomicU8::new(0),
+            battery_charging: AtomicBool::new(false),
+            fps_actual: AtomicF32::new(0.0),
+            fps_target: AtomicF32::new(30.0),
+            render_time_ms: AtomicU32::new(0),
+            flush_time_ms: AtomicU32::new(0),
+            flush_wait_time_ms: AtomicU32::new(0),
+            frame_count: AtomicU32::new(0),
+            main_loop_idle_percent: AtomicU8::new(0),
+            skip_count: AtomicU32::new(0),
+            psram_free: AtomicU32::new(0),
+            psram_total: AtomicU32::new(0),
+            button_avg_response_ms: AtomicF32::new(0.0),
+            button_max_response_ms: AtomicF32::new(0.0),
+            button_p50_response_ms: AtomicF32::new(0.0),
+            button_p95_response_ms: AtomicF32::new(0.0),
+            button_p99_response_ms: AtomicF32::new(0.0),
+            button_response_samples: AtomicU32::new(0),
+            button_events_total: AtomicU32::new(0),
+            button_events_per_second: AtomicF32::new(0.0),
+            http_connections_active: AtomicU32::new(0),
+            http_connections_total: AtomicU32::new(0),
+            telnet_connections_active: AtomicU32::new(0),
+            telnet_connections_total: AtomicU32::new(0),
+            wifi_disconnects: AtomicU32::new(0),
+            wifi_reconnects: AtomicU32::new(0),
+            uptime_seconds: AtomicU32::new(0),
+            snapshot: SnapshotLock::new(),
+        };
+        // Readers get the defaults until the first tick publishes
+        store.publish();
+        store
+    }
+    
+    pub fn update_cpu(&self, usage: u8, freq_mhz: u16) {
+        self.cpu_usage.store(usage, Ordering::Relaxed);
+        self.cpu_freq_mhz.store(freq_mhz, Ordering::Relaxed);
+    }
+    
+    pub fn update_cpu_cores(&self, cpu0: u8, cpu1: u8) {
+        self.cpu0_usage.store(cpu0, Ordering::Relaxed);
+        self.cpu1_usage.store(cpu1, Ordering::Relaxed);
+        // Also update overall CPU usage as average
+        self.cpu_usage.store(((cpu0 as u16 + cpu1 as u16) / 2) as u8, Ordering::Relaxed);
+    }
+    
+    pub fn update_temperature(&self, temp: f32) {
+        self.temperature.store(temp, Ordering::Relaxed);
+    }
+    
+    pub fn update_wifi_signal(&self, rssi: i8) {
+        self.wifi_rssi.store(rssi, Ordering::Relaxed);
+    }
+    
+    pub fn update_wifi_status(&self, connected: bool, ssid: &str) {
+        self.wifi_connected.store(connected, Ordering::Relaxed);
+        if let Ok(mut current) = self.wifi_ssid.lock() {
+            if current.as_str() != ssid {
+                current.clear();
+                // SSIDs are at most 32 bytes; cut longer input at a char boundary
+                for c in ssid.chars() {
+                    if current.push(c).is_err() {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    
+    pub fn update_display(&self, brightness: u8) {
+        self.display_brightness.store(brightness, Ordering::Relaxed);
+    }
+    
+    pub fn update_battery(&self, voltage_mv: u16, percentage: u8, is_charging: bool) {
+        self.battery_voltage_mv.store(voltage_mv, Ordering::Relaxed);
+        self.battery_percentage.store(percentage, Ordering::Relaxed);
+        self.battery_charging.store(is_charging, Ordering::Relaxed);
+    }
+    
+    /// `flush_ms` is panel transfer time, `flush_wait_ms` the time the render
+    /// loop was blocked by it - the difference is overlapped with rendering
+    pub fn update_timings(&self, render_ms: u32, flush_ms: u32, flush_wait_ms: u32) {
+        self.render_time_ms.store(render_ms, Ordering::Relaxed);
+        self.flush_time_ms.store(flush_ms, Ordering::Relaxed);
+        self.flush_wait_time_ms.store(flush_wait_ms, Ordering::Relaxed);
+    }
+    
+    pub fn update_fps(&self, actual: f32, target: f32) {
+        self.fps_actual.store(actual, Ordering::Relaxed);
+        self.fps_target.store(target, Ordering::Relaxed);
+    }
+    
+    pub fn update_frame_stats(&self, total: u64, skipped: u64) {
+        self.frame_count.store(total as u32, Ordering::Relaxed);
+        self.skip_count.store(skipped as u32, Ordering::Relaxed);
+    }
+    
+    /// Share of wall time the main loop spent asleep in the frame scheduler
+    pub fn update_idle(&self, idle_percent: u8) {
+        self.main_loop_idle_percent.store(idle_percent, Ordering::Relaxed);
+    }
+    
+    pub fn update_psram(&self, free: u32, total: u32) {
+        self.psram_free.store(free, Ordering::Relaxed);
+        self.psram_total.store(total, Ordering::Relaxed);
+    }
+    
+    pub fn update_button_metrics(&self, total_events: u64, events_per_sec: f32) {
+        self.button_events_total.store(total_events as u32, Ordering::Relaxed);
+        self.button_events_per_second.store(events_per_sec, Ordering::Relaxed);
+    }
+    
+    /// Input-to-photon latency; percentiles are log2 bucket upper bounds
+    pub fn update_button_latency(&self, latency: &LatencyHistogram, avg_ms: f32) {
+        let ms = |us: u32| us as f32 / 1000.0;
+        self.button_avg_response_ms.store(avg_ms, Ordering::Relaxed);
+        self.button_max_response_ms.store(ms(latency.max_us), Ordering::Relaxed);
+        self.button_p50_response_ms.store(ms(latency.percentile_us(50)), Ordering::Relaxed);
+        self.button_p95_response_ms.store(ms(latency.percentile_us(95)), Ordering::Relaxed);
+        self.button_p99_response_ms.store(ms(latency.percentile_us(99)), Ordering::Relaxed);
+        self.button_response_samples.store(latency.count, Ordering::Relaxed);
+    }
+    
+    pub fn update_telnet_connections(&self, active: u32, total: u64) {
+        self.telnet_connections_active.store(active, Ordering::Relaxed);
+        self.telnet_connections_total.store(total as u32, Ordering::Relaxed);
+    }
+    
+    pub fn update_wifi_reconnects(&self, disconnects: u32, reconnects: u32) {
+        self.wifi_disconnects.store(disconnects, Ordering::Relaxed);
+        self.wifi_reconnects.store(reconnects, Ordering::Relaxed);
+    }
+    
+    pub fn update_uptime(&self, seconds: u64) {
+        self.uptime_seconds.store(seconds as u32, Ordering::Relaxed);
+    }
+    
+    /// Gather the current field values into the shared snapshot. Called once
+    /// per metrics tick by the main loop, which is the only publisher.
+    pub fn publish(&self) {
+        let mut data = MetricsData {
+            timestamp: std::time::SystemTime::now()
+                .duration_since(std::time::UNIX_EPOCH)
+                .unwrap_or_default()
+                .as_secs(),
+            heap_free: unsafe { esp_idf_sys::esp_get_free_heap_size() },
+            cpu_usage: self.cpu_usage.load(Ordering::Relaxed),
+            cpu_freq_mhz: self.cpu_freq_mhz.load(Ordering::Relaxed),
+            cpu0_usage: self.cpu0_usage.load(Ordering::Relaxed),
+            cpu1_usage: self.cpu1_usage.load(Ordering::Relaxed),
+            temperature: self.temperature.load(Ordering::Relaxed),
+            wifi_rssi: self.wifi_rssi.load(Ordering::Relaxed),
+            wifi_connected: self.wifi_connected.load(Ordering::Relaxed),
+            display_brightness: self.display_brightness.load(Ordering::Relaxed),
+            fps_actual: self.fps_actual.load(Ordering::Relaxed),
+            fps_target: self.fps_target.load(Ordering::Relaxed),
+            render_time_ms: self.render_time_ms.load(Ordering::Relaxed),
+            flush_time_ms: self.flush_time_ms.load(Ordering::Relaxed),
+            flush_wait_time_ms: self.flush_wait_time_ms.load(Ordering::Relaxed),
+            main_loop_idle_percent: self.main_loop_idle_percent.load(Ordering::Relaxed),
+            battery_voltage_mv: self.battery_voltage_mv.load(Ordering::Relaxed),
+            battery_percentage: self.battery_percentage.load(Ordering::Relaxed),
+            battery_charging: self.battery_charging.load(Ordering::Relaxed),
+            frame_count: self.frame_count.load(Ordering::Relaxed) as u64,
+            skip_count: self.skip_count.load(Ordering::Relaxed) as u64,
+            psram_free: self.psram_free.load(Ordering::Relaxed),
+            psram_total: self.psram_total.load(Ordering::Relaxed),
+            button_avg_response_ms: self.button_avg_response_ms.load(Ordering::Relaxed),
+            button_max_response_ms: self.button_max_response_ms.load(Ordering::Relaxed),
+            button_p50_response_ms: self.button_p50_response_ms.load(Ordering::Relaxed),
+            button_p95_response_ms: self.button_p95_response_ms.load(Ordering::Relaxed),
+            button_p99_response_ms: self.button_p99_response_ms.load(Ordering::Relaxed),
+            button_response_samples: self.button_response_samples.load(Ordering::Relaxed),
+            button_events_total: self.button_events_total.load(Ordering::Relaxed) as u64,
+            button_events_per_second: self.button_events_per_second.load(Ordering::Relaxed),
+            http_connections_active: self.http_connections_active.load(Ordering::Relaxed),
+            http_connections_total: self.http_connections_total.load(Ordering::Relaxed) as u64,
+            telnet_connections_active: self.telnet_connections_active.load(Ordering::Relaxed),
+            telnet_connections_total: self.telnet_connections_total.load(Ordering::Relaxed) as u64,
+            wifi_disconnects: self.wifi_disconnects.load(Ordering::Relaxed),
+            wifi_reconnects: self.wifi_reconnects.load(Ordering::Relaxed),
+            uptime_seconds: self.uptime_seconds.load(Ordering::Relaxed) as u64,
+            ..Default::default()
+        };
+        if let Ok(ssid) = self.wifi_ssid.lock() {
+            data.set_wifi_ssid(&ssid);
+        }
+        self.snapshot.write(&data);
+    }
+    
+    /// Copy of the snapshot from the last publish; never allocates or blocks
+    /// the publisher
+    pub fn snapshot(&self) -> MetricsData {
+        self.snapshot.read()
+    }
+}
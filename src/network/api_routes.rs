@@ -1,94 +1,60 @@
 use anyhow::Result;
+use std::fmt::Write as _;
 use esp_idf_svc::http::server::{EspHttpServer, Method};
 use esp_idf_svc::io::Write;
 use std::sync::{Arc, Mutex};
 use crate::config::Config;
-use crate::sensors::history::SensorHistory;
+use crate::sensors::history::{self, SensorHistory, SERIES};
+use crate::sensors::timeseries::{self, TIERS};
+use crate::dual_core::WorkItem;
+use crate::network::async_handler::{self, AsyncRequest, Dispatch};
 use crate::network::validators;
 use crate::network::error_handler::ErrorResponse;
+use crate::network::observability::ProfiledHandlers;
 
 pub fn register_api_v1_routes(
     server: &mut EspHttpServer<'static>,
     config: Arc<Mutex<Config>>,
-    sensor_history: Arc<Mutex<SensorHistory>>,
+    sensor_history: Arc<SensorHistory>,
 ) -> Result<()> {
     
-    // GET /api/v1/sensors/temperature/history?hours=24
-    let history_clone = sensor_history.clone();
-    server.fn_handler("/api/v1/sensors/temperature/history", Method::Get, move |req| {
-        let instr = crate::network::server_config::RequestInstrumentation::capture(None);
-        let hours = req.uri()
-            .split('?')
-            .nth(1)
-            .and_then(|query| query.split('&').find(|p| p.starts_with("hours=")))
-            .and_then(|p| p.strip_prefix("hours="))
-            .and_then(|h| h.parse::<u32>().ok())
-            .unwrap_or(24);
-
-        let history = match history_clone.lock() {
-            Ok(h) => h,
-            Err(e) => {
-                return ErrorResponse::bad_request(format!("history lock failed: {}", e)).send(req);
-            }
-        };
-        let data = history.get_temperature_history(hours);
-        
-        let response = serde_json::json!({
-            "hours": hours,
-            "data": data,
-            "unit": "celsius"
-        });
-
-        let json = serde_json::to_string(&response)?;
-        let mut http_response = req.into_response(
-            200,
-            Some("OK"),
-            &[("Content-Type", "application/json")]
-        )?;
-        http_response.write_all(json.as_bytes())?;
-        instr.log_completion("/api/v1/sensors/temperature/history", 200);
-        Ok(()) as Result<(), Box<dyn std::error::Error>>
-    })?;
-
-    // GET /api/v1/sensors/battery/history?hours=24
-    let history_clone2 = sensor_history.clone();
-    server.fn_handler("/api/v1/sensors/battery/history", Method::Get, move |req| {
-        let instr = crate::network::server_config::RequestInstrumentation::capture(None);
-        let hours = req.uri()
-            .split('?')
-            .nth(1)
-            .and_then(|query| query.split('&').find(|p| p.starts_with("hours=")))
-            .and_then(|p| p.strip_prefix("hours="))
-            .and_then(|h| h.parse::<u32>().ok())
-            .unwrap_or(24);
+    // GET /api/v1/sensors/{temperature,battery}/history?hours=24
+    // Optional: from/to (Unix seconds), resolution=1s|1m|1h|auto, max_points
+    for (uri, name) in [
+        (c"/api/v1/sensors/temperature/history", "temperature"),
+        (c"/api/v1/sensors/battery/history", "battery"),
+    ] {
+        let history = sensor_history.clone();
+        async_handler::register(server, uri, Method::Get, Dispatch::Executor(WorkItem::ProcessNetwork),
+                                move |req| send_history(req, &history, name))?;
+    }
 
-        let history = match history_clone2.lock() {
-            Ok(h) => h,
-            Err(e) => {
-                return ErrorResponse::bad_request(format!("history lock failed: {}", e)).send(req);
+    // GET /api/v1/history?series=fps&hours=1 - any recorded series, same
+    // parameters as above; without `series`, the list of series
+    let history = sensor_history.clone();
+    async_handler::register(server, c"/api/v1/history", Method::Get, Dispatch::Executor(WorkItem::ProcessNetwork),
+                            move |req| {
+        match req.query_param("series").map(str::to_string) {
+            Some(name) => send_history(req, &history, &name),
+            None => {
+                let series: Vec<_> = SERIES.iter()
+                    .map(|s| serde_json::json!({ "name": s.name, "unit": s.unit }))
+                    .collect();
+                let resolutions: Vec<_> = TIERS.iter().map(|tier| tier.name).collect();
+                let json = crate::arena::to_json(&serde_json::json!({
+                    "series": series,
+                    "resolutions": resolutions,
+                    "store": history.stats(),
+                }))?;
+                req.start_response(200, &[("Content-Type", "application/json")])?;
+                req.write_all(json.as_bytes())?;
+                Ok(())
             }
-        };
-        let data = history.get_battery_history(hours);
-        
-        let response = serde_json::json!({
-            "hours": hours,
-            "data": data,
-            "unit": "percentage"
-        });
-
-        let json = serde_json::to_string(&response)?;
-        let mut http_response = req.into_response(
-            200,
-            Some("OK"),
-            &[("Content-Type", "application/json")]
-        )?;
-        http_response.write_all(json.as_bytes())?;
-        instr.log_completion("/api/v1/sensors/battery/history", 200);
-        Ok(()) as Result<(), Box<dyn std::error::Error>>
+        }
     })?;
 
     // GET /api/v1/system/processes
-    server.fn_handler("/api/v1/system/processes", Method::Get, move |req| {
+    server.profiled_handler("/api/v1/system/processes", Method::Get, move |req| {
         let instr = crate::network::server_config::RequestInstrumentation::capture(None);
         let mut processes = Vec::new();
         
@@ -116,7 +82,7 @@ pub fn register_api_v1_routes(
             "note": "Currently showing only current task info"
         });
 
-        let json = serde_json::to_string(&response)?;
+        let json = crate::arena::to_json(&response)?;
         let mut http_response = req.into_response(
             200,
             Some("OK"),
@@ -127,38 +93,12 @@ pub fn register_api_v1_routes(
         Ok(()) as Result<(), Box<dyn std::error::Error>>
     })?;
 
-    // POST /api/v1/display/screenshot
-    server.fn_handler("/api/v1/display/screenshot", Method::Post, move |req| {
-        let instr = crate::network::server_config::RequestInstrumentation::capture(None);
-        // For now, return a placeholder response
-        // TODO: Implement actual screenshot capture once display module supports it
-        
-        let response = serde_json::json!({
-            "format": "rgb565",
-            "width": 320,
-            "height": 170,
-            "data": "", // Empty for now
-            "timestamp": std::time::SystemTime::now()
-                .duration_since(std::time::UNIX_EPOCH)
-                .unwrap_or_default()
-                .as_secs(),
-            "message": "Screenshot capture not yet implemented"
-        });
-
-        let json = serde_json::to_string(&response)?;
-        let mut http_response = req.into_response(
-            200,
-            Some("OK"),
-            &[("Content-Type", "application/json")]
-        )?;
-        http_response.write_all(json.as_bytes())?;
-        instr.log_completion("/api/v1/display/screenshot", 200);
-        Ok(()) as Result<(), Box<dyn std::error::Error>>
-    })?;
+    // GET|POST /api/v1/display/screenshot, GET /api/v1/display/stream
+    crate::network::screen_stream::register_routes(server)?;
 
     // PATCH /api/v1/config/:field
     let config_clone = config.clone();
-    server.fn_handler("/api/v1/config/*", Method::Patch, move |mut req| {
+    server.profiled_handler("/api/v1/config/*", Method::Patch, move |mut req| {
         let instr = crate::network::server_config::RequestInstrumentation::capture(None);
         // Extract field name from URL (before any mutable borrows)
         let uri = req.uri().to_string();
@@ -228,7 +168,7 @@ pub fn register_api_v1_routes(
             "status": "updated"
         });
 
-        let json = serde_json::to_string(&response)?;
+        let json = crate::arena::to_json(&response)?;
         let mut http_response = req.into_response(
             200,
             Some("OK"),
@@ -240,7 +180,7 @@ pub fn register_api_v1_routes(
     })?;
 
     // POST /api/v1/debug/log-level {"level":"trace|debug|info|warn|error|off"} (also supports ?level=)
-    server.fn_handler("/api/v1/debug/log-level", Method::Post, move |mut req| {
+    server.profiled_handler("/api/v1/debug/log-level", Method::Post, move |mut req| {
         let instr = crate::network::server_config::RequestInstrumentation::capture(None);
         // Read body
         let mut buf = [0u8; 64];
@@ -265,7 +205,7 @@ pub fn register_api_v1_routes(
                 "ok": true,
                 "level": level_str,
             });
-            let json = serde_json::to_string(&resp)?;
+            let json = crate::arena::to_json(&resp)?;
             let mut http_response = req.into_response(200, Some("OK"), &[("Content-Type", "application/json")])?;
             http_response.write_all(json.as_bytes())?;
             instr.log_completion("/api/v1/debug/log-level", 200);
@@ -276,7 +216,7 @@ pub fn register_api_v1_routes(
     })?;
 
     // GET /api/v1/logs/recent?count=50
-    server.fn_handler("/api/v1/logs/recent", Method::Get, move |req| {
+    server.profiled_handler("/api/v1/logs/recent", Method::Get, move |req| {
         let instr = crate::network::server_config::RequestInstrumentation::capture(None);
         let count = req.uri()
             .split('?')
@@ -287,9 +227,9 @@ pub fn register_api_v1_routes(
             .map(|n| n.min(500))
             .unwrap_or(50);
 
-        let streamer = crate::network::log_streamer::init(None);
+        let streamer = crate::network::log_streamer::init();
         let logs = streamer.get_recent_logs(count);
-        let json = serde_json::to_string(&logs)?;
+        let json = crate::arena::to_json(&logs)?;
         let mut http_response = req.into_response(200, Some("OK"), &[("Content-Type", "application/json")])?;
         http_response.write_all(json.as_bytes())?;
         instr.log_completion("/api/v1/logs/recent", 200);
@@ -297,7 +237,7 @@ pub fn register_api_v1_routes(
     })?;
 
     // GET /api/v1/diagnostics/health
-    server.fn_handler("/api/v1/diagnostics/health", Method::Get, move |req| {
+    server.profiled_handler("/api/v1/diagnostics/health", Method::Get, move |req| {
         let instr = crate::network::server_config::RequestInstrumentation::capture(None);
         let heap_free = unsafe { esp_idf_sys::esp_get_free_heap_size() };
         let heap_min = unsafe { esp_idf_sys::esp_get_minimum_free_heap_size() };
@@ -345,7 +285,7 @@ pub fn register_api_v1_routes(
                 .as_secs()
         });
 
-        let json = serde_json::to_string(&health)?;
+        let json = crate::arena::to_json(&health)?;
         let mut http_response = req.into_response(
             200,
             Some("OK"),
@@ -357,11 +297,11 @@ pub fn register_api_v1_routes(
     })?;
 
     // GET /api/v1/diagnostics/last-crash
-    server.fn_handler("/api/v1/diagnostics/last-crash", Method::Get, move |req| {
+    server.profiled_handler("/api/v1/diagnostics/last-crash", Method::Get, move |req| {
         let instr = crate::network::server_config::RequestInstrumentation::capture(None);
         match crate::crash_persist::read_last_crash() {
             Ok(Some(record)) => {
-                let json = serde_json::to_string(&record)?;
+                let json = crate::arena::to_json(&record)?;
                 let mut http_response = req.into_response(200, Some("OK"), &[("Content-Type", "application/json")])?;
                 http_response.write_all(json.as_bytes())?;
                 instr.log_completion("/api/v1/diagnostics/last-crash", 200);
@@ -378,7 +318,7 @@ pub fn register_api_v1_routes(
     })?;
 
     // DELETE /api/v1/diagnostics/last-crash
-    server.fn_handler("/api/v1/diagnostics/last-crash", Method::Delete, move |req| {
+    server.profiled_handler("/api/v1/diagnostics/last-crash", Method::Delete, move |req| {
         let instr = crate::network::server_config::RequestInstrumentation::capture(None);
         match crate::crash_persist::clear_last_crash() {
             Ok(()) => {
@@ -394,9 +334,9 @@ pub fn register_api_v1_routes(
     // NOTE: /api/v1/power/voltage removed (voltage monitor disabled)
 
     // GET /api/v1/status/errors — analyze recent logs for httpd/network error patterns
-    server.fn_handler("/api/v1/status/errors", Method::Get, move |req| {
+    server.profiled_handler("/api/v1/status/errors", Method::Get, move |req| {
         let instr = crate::network::server_config::RequestInstrumentation::capture(None);
-        let logs = crate::network::log_streamer::init(None).get_recent_logs(500);
+        let logs = crate::network::log_streamer::init().get_recent_logs(500);
         let mut send_err_11 = 0u32;
         let mut send_err_104 = 0u32;
         let mut recv_err_10 = 0u32; // any 10x
@@ -421,11 +361,73 @@ pub fn register_api_v1_routes(
             "window": 500,
         });
         let mut http_response = req.into_response(200, Some("OK"), &[("Content-Type", "application/json")])?;
-        http_response.write_all(serde_json::to_string(&payload)?.as_bytes())?;
+        http_response.write_all(crate::arena::to_json(&payload)?.as_bytes())?;
         instr.log_completion("/api/v1/status/errors", 200);
         Ok(()) as Result<(), Box<dyn std::error::Error>>
     })?;
 
     log::info!("API v1 routes registered");
     Ok(())
-}
\ No newline at end of file
+}
+/// Stream one series as {"series", "unit", "resolution", "data": [{timestamp, value, min, max}]}
+fn send_history(req: &mut AsyncRequest, sensor_history: &SensorHistory, name: &str) -> Result<()> {
+    let Some(series) = SensorHistory::series(name) else {
+        req.send_status(404, "Unknown series")?;
+        return Ok(());
+    };
+    let param = |key| req.query_param(key).and_then(|value| value.parse::<u32>().ok());
+    let now = std::time::SystemTime::now()
+        .duration_since(std::time::UNIX_EPOCH)
+        .unwrap_or_default()
+        .as_secs() as u32;
+    let hours = param("hours").unwrap_or(24);
+    let to = param("to").unwrap_or(now);
+    let from = param("from").unwrap_or_else(|| to.saturating_sub(hours.saturating_mul(3600)));
+    let max_points = param("max_points").unwrap_or(history::DEFAULT_MAX_POINTS);
+    if from > to {
+        req.send_status(400, "from is after to")?;
+        return Ok(());
+    }
+    let tier = match req.query_param("resolution") {
+        None | Some("auto") => history::tier_for_span(to - from, max_points),
+        Some(resolution) => match timeseries::tier_by_name(resolution) {
+            Some(tier) if history::tier_covers_span(tier, to - from) => tier,
+            Some(_) => {
+                req.send_status(400, "Range too long for this resolution")?;
+                return Ok(());
+            }
+            None => {
+                req.send_status(400, "resolution must be 1s, 1m, 1h or auto")?;
+                return Ok(());
+            }
+        },
+    };
+
+    let def = &SERIES[series];
+    let decimals = def.decimals();
+    req.start_response(200, &[("Content-Type", "application/json")])?;
+    let mut out = String::with_capacity(1536);
+    let _ = write!(out, "{{\"series\":\"{}\",\"unit\":\"{}\",\"hours\":{},\"from\":{},\"to\":{},\"resolution\":\"{}\",\"data\":[",
+                   def.name, def.unit, hours, from, to, TIERS[tier].name);
+
+    // Points are written as they are decoded, a chunk at a time
+    let mut first = true;
+    let mut sent = Ok(());
+    sensor_history.query(series, tier, from, to, max_points, |point| {
+        if sent.is_err() || !(point.value.is_finite() && point.min.is_finite() && point.max.is_finite()) {
+            return;
+        }
+        let _ = write!(out, "{}{{\"timestamp\":{},\"value\":{:.*},\"min\":{:.*},\"max\":{:.*}}}",
+                       if first { "" } else { "," }, point.timestamp,
+                       decimals, point.value, decimals, point.min, decimals, point.max);
+        first = false;
+        if out.len() >= 1024 {
+            sent = req.write_all(out.as_bytes());
+            out.clear();
+        }
+    });
+    sent?;
+    out.push_str("]}");
+    req.write_all(out.as_bytes())?;
+    Ok(())
+}
@@ -0,0 +1,268 @@
+// Offloaded HTTP handlers
+//
+// The httpd task serves every request in turn, so one slow handler (a large
+// /metrics scrape, a log dump, an SSE stream) stalls /health and the
+// dashboard behind it. Routes registered here detach their request with
+// httpd_req_async_handler_begin() and return at once; the response is
+// produced on the DualCoreProcessor or, for streams, on a thread of its own.
+
+use anyhow::Result;
+use core::ffi::{c_char, c_void, CStr};
+use esp_idf_svc::handle::RawHandle;
+use esp_idf_svc::http::server::EspHttpServer;
+use esp_idf_svc::http::Method;
+use esp_idf_svc::io::{EspIOError, ErrorType, Write};
+use esp_idf_sys::*;
+use log::warn;
+use std::ffi::CString;
+use crate::alloc_profiler;
+use crate::dual_core::{self, WorkItem};
+use crate::trace;
+use super::observability::{self, RouteStats};
+
+/// Where an offloaded handler runs
+#[derive(Clone, Copy)]
+pub enum Dispatch {
+    /// A job on the DualCoreProcessor; for bounded work
+    Executor(WorkItem),
+    /// A dedicated thread with this stack size; for long-lived streams that
+    /// would otherwise occupy an executor core
+    Thread(usize),
+}
+
+type Handler = Box<dyn Fn(&mut AsyncRequest) -> Result<()> + Send + Sync>;
+
+struct Route {
+    dispatch: Dispatch,
+    stats: &'static RouteStats,
+    tag: alloc_profiler::Tag,
+    span: trace::SpanId,
+    handler: Handler,
+}
+
+/// A request detached from the httpd task, answered with chunked writes
+pub struct AsyncRequest {
+    req: *mut httpd_req_t,
+    // False when running inline on the httpd task (the async fallback)
+    detached: bool,
+    started: bool,
+    finished: bool,
+    bytes_sent: u32,
+    // httpd keeps pointers to header strings until the first chunk is sent
+    header_storage: Vec<CString>,
+}
+
+// The detached request is owned by exactly one AsyncRequest until completion
+unsafe impl Send for AsyncRequest {}
+
+impl AsyncRequest {
+    fn new(req: *mut httpd_req_t, detached: bool) -> Self {
+        Self { req, detached, started: false, finished: false, bytes_sent: 0, header_storage: Vec::new() }
+    }
+
+    /// Request path including the query string
+    pub fn uri(&self) -> &str {
+        unsafe { CStr::from_ptr((*self.req).uri.as_ptr()) }.to_str().unwrap_or("")
+    }
+
+    /// Value of `key` in the query string
+    pub fn query_param(&self, key: &str) -> Option<&str> {
+        let (_, query) = self.uri().split_once('?')?;
+        query.split('&')
+            .filter_map(|pair| pair.split_once('='))
+            .find(|(name, _)| *name == key)
+            .map(|(_, value)| value)
+    }
+
+    /// Value of request header `name`
+    pub fn header(&self, name: &str) -> Option<String> {
+        let name = CString::new(name).ok()?;
+        unsafe {
+            let len = httpd_req_get_hdr_value_len(self.req, name.as_ptr());
+            if len == 0 {
+                return None;
+            }
+            let mut value = vec![0u8; len + 1];
+            esp!(httpd_req_get_hdr_value_str(self.req, name.as_ptr(), value.as_mut_ptr() as *mut c_char, value.len())).ok()?;
+            value.truncate(len);
+            String::from_utf8(value).ok()
+        }
+    }
+
+    /// Set status and headers; must precede the first write. Without a call
+    /// the response goes out as 200 with no extra headers.
+    pub fn start_response(&mut self, status: u16, headers: &[(&str, &str)]) -> Result<(), EspIOError> {
+        if self.started {
+            return Ok(());
+        }
+        self.started = true;
+        unsafe {
+            esp!(httpd_resp_set_status(self.req, status_line(status).as_ptr()))?;
+            for (name, value) in headers {
+                let (Ok(name), Ok(value)) = (CString::new(*name), CString::new(*value)) else { continue };
+                if name.as_bytes().eq_ignore_ascii_case(b"Content-Type") {
+                    esp!(httpd_resp_set_type(self.req, value.as_ptr()))?;
+                } else {
+                    esp!(httpd_resp_set_hdr(self.req, name.as_ptr(), value.as_ptr()))?;
+                    self.header_storage.push(name);
+                }
+                self.header_storage.push(value);
+            }
+        }
+        Ok(())
+    }
+
+    /// Status and a short plain-text body
+    pub fn send_status(&mut self, status: u16, message: &str) -> Result<(), EspIOError> {
+        self.start_response(status, &[("Content-Type", "text/plain")])?;
+        self.write_all(message.as_bytes())
+    }
+
+    fn send_chunk(&mut self, buf: *const c_char, len: usize) -> Result<(), EspIOError> {
+        esp!(unsafe { httpd_resp_send_chunk(self.req, buf, len as _) })?;
+        Ok(())
+    }
+
+    /// Send the terminating chunk and hand the session back to httpd
+    fn finish(&mut self) {
+        if self.finished {
+            return;
+        }
+        self.finished = true;
+        let _ = self.start_response(200, &[]);
+        let _ = self.send_chunk(core::ptr::null(), 0);
+        if self.detached {
+            unsafe { httpd_req_async_handler_complete(self.req) };
+        }
+    }
+}
+
+impl Drop for AsyncRequest {
+    fn drop(&mut self) {
+        // Dropped before the handler ran, e.g. no thread could be spawned
+        if !self.started {
+            let _ = self.send_status(503, "Service Unavailable");
+        }
+        self.finish();
+    }
+}
+
+impl ErrorType for AsyncRequest {
+    type Error = EspIOError;
+}
+
+impl Write for AsyncRequest {
+    fn write(&mut self, buf: &[u8]) -> Result<usize, Self::Error> {
+        if buf.is_empty() {
+            return Ok(0);
+        }
+        self.start_response(200, &[])?;
+        self.send_chunk(buf.as_ptr() as *const c_char, buf.len())?;
+        self.bytes_sent = self.bytes_sent.saturating_add(buf.len() as u32);
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> Result<(), Self::Error> {
+        // httpd_resp_send_chunk writes through to the socket
+        Ok(())
+    }
+}
+
+fn status_line(status: u16) -> &'static CStr {
+    match status {
+        200 => c"200 OK",
+        204 => c"204 No Content",
+        304 => c"304 Not Modified",
+        400 => c"400 Bad Request",
+        404 => c"404 Not Found",
+        413 => c"413 Payload Too Large",
+        503 => c"503 Service Unavailable",
+        _ => c"500 Internal Server Error",
+    }
+}
+
+/// Register `handler` for `uri` so it runs off the httpd task.
+/// `uri` must not also be registered through fn_handler.
+pub fn register<F>(server: &mut EspHttpServer<'static>, uri: &'static CStr, method: Method, dispatch: Dispatch, handler: F) -> Result<()>
+where
+    F: Fn(&mut AsyncRequest) -> Result<()> + Send + Sync + 'static,
+{
+    let route: &'static Route = Box::leak(Box::new(Route {
+        dispatch,
+        stats: observability::register_route(method, uri.to_str()?),
+        tag: alloc_profiler::Tag::for_route(uri.to_str()?),
+        span: trace::register(uri.to_str()?, "http"),
+        handler: Box::new(handler),
+    }));
+    let descriptor = httpd_uri_t {
+        uri: uri.as_ptr(),
+        method: http_method(method),
+        handler: Some(trampoline),
+        user_ctx: route as *const Route as *mut c_void,
+        ..unsafe { core::mem::zeroed() }
+    };
+    esp!(unsafe { httpd_register_uri_handler(server.handle(), &descriptor) })?;
+    Ok(())
+}
+
+fn http_method(method: Method) -> httpd_method_t {
+    (match method {
+        Method::Post => http_method_HTTP_POST,
+        Method::Put => http_method_HTTP_PUT,
+        Method::Delete => http_method_HTTP_DELETE,
+        Method::Patch => http_method_HTTP_PATCH,
+        _ => http_method_HTTP_GET,
+    }) as _
+}
+
+unsafe extern "C" fn trampoline(req: *mut httpd_req_t) -> esp_err_t {
+    let route = &*((*req).user_ctx as *const Route);
+    let start_us = observability::begin_request();
+
+    let mut detached: *mut httpd_req_t = core::ptr::null_mut();
+    if httpd_req_async_handler_begin(req, &mut detached) != ESP_OK {
+        // Out of memory for the copy: answer inline rather than drop the client
+        run(route, AsyncRequest::new(req, false), start_us);
+        return ESP_OK;
+    }
+
+    let request = AsyncRequest::new(detached, true);
+    match route.dispatch {
+        Dispatch::Executor(item) => match dual_core::processor() {
+            Some(processor) => processor.submit(item, move || run(route, request, start_us)),
+            None => run(route, request, start_us),
+        },
+        Dispatch::Thread(stack_size) => {
+            // The closure owns the request; if spawning fails, dropping it
+            // answers 503 and completes the session
+            let spawned = std::thread::Builder::new()
+                .name("http-stream".to_string())
+                .stack_size(stack_size)
+                .spawn(move || run(route, request, start_us));
+            if let Err(e) = spawned {
+                warn!("HTTP: no thread for streamed route: {}", e);
+            }
+        }
+    }
+    ESP_OK
+}
+
+fn run(route: &'static Route, mut request: AsyncRequest, start_us: u64) {
+    let _alloc_tag = alloc_profiler::scope(route.tag);
+    let _span = trace::span(route.span);
+    let heap_before = unsafe { esp_get_free_heap_size() };
+    let result = (route.handler)(&mut request);
+    if let Err(ref e) = result {
+        warn!("HTTP: offloaded handler failed: {}", e);
+        if !request.started {
+            let _ = request.send_status(500, "Internal Server Error");
+        }
+    }
+    request.finish();
+
+    let elapsed_us = observability::end_request(start_us);
+    let heap_delta = heap_before as i32 - unsafe { esp_get_free_heap_size() } as i32;
+    // Stack of the task that ran the handler, not the httpd task
+    let stack_remaining = unsafe { uxTaskGetStackHighWaterMark(core::ptr::null_mut()) };
+    route.stats.record(elapsed_us, result.is_ok(), request.bytes_sent, heap_delta, stack_remaining);
+}
@@ -67,13 +67,326 @@ impl MetricsBinaryPacket {
 }
 
 
+// Protocol v2: delta-encoded frames
+//
+//   u8      version (2)
+//   u8      flags, FLAG_KEYFRAME
+//   u16 LE  schema id
+//   varint  sequence number of this frame
+//   varint  base sequence (delta frames only)
+//   varint  presence bitmap, bit n = field n follows
+//   varint  zigzag value per present field, in field order
+//
+// Keyframes carry absolute values and omit zero fields. Delta frames carry
+// only the fields that changed since the base frame the client acked. Values
+// are integers; `FieldDef::scale` says what to divide by.
+
+pub const V2_VERSION: u8 = 2;
+pub const FLAG_KEYFRAME: u8 = 1 << 0;
+
+/// Bump whenever V2_FIELDS changes
+pub const SCHEMA_ID: u16 = 1;
+
+/// Every frame whose sequence crosses a multiple of this is a keyframe
+pub const KEYFRAME_INTERVAL: u32 = 30;
+
+/// Frames kept for clients to delta against
+const HISTORY_DEPTH: usize = 16;
+
+pub struct FieldDef {
+    pub name: &'static str,
+    pub scale: u16,
+}
+
+const fn field(name: &'static str, scale: u16) -> FieldDef {
+    FieldDef { name, scale }
+}
+
+/// v2 fields in wire order; must match `field_values`
+pub const V2_FIELDS: [FieldDef; 32] = [
+    field("timestamp", 1),
+    field("temperature", 10),
+    field("battery_percentage", 1),
+    field("battery_voltage_mv", 1),
+    field("battery_charging", 1),
+    field("fps_actual", 10),
+    field("fps_target", 1),
+    field("cpu_usage", 1),
+    field("cpu0_usage", 1),
+    field("cpu1_usage", 1),
+    field("cpu_freq_mhz", 1),
+    field("heap_free", 1),
+    field("heap_min_free", 1),
+    field("wifi_rssi", 1),
+    field("wifi_connected", 1),
+    field("display_brightness", 1),
+    field("frame_count", 1),
+    field("skip_count", 1),
+    field("render_time_ms", 1),
+    field("flush_time_ms", 1),
+    field("flush_wait_time_ms", 1),
+    field("main_loop_idle_percent", 1),
+    field("psram_free", 1),
+    field("psram_total", 1),
+    field("button_avg_response_ms", 100),
+    field("button_max_response_ms", 100),
+    field("button_events_total", 1),
+    field("wifi_disconnects", 1),
+    field("wifi_reconnects", 1),
+    field("http_connections_active", 1),
+    field("telnet_connections_active", 1),
+    field("uptime_seconds", 1),
+];
+
+pub const V2_FIELD_COUNT: usize = V2_FIELDS.len();
+
+pub type FieldValues = [i64; V2_FIELD_COUNT];
+
+/// Scaled integer values of a snapshot, in V2_FIELDS order
+pub fn field_values(metrics: &crate::metrics::MetricsData, heap_min_free: u32) -> FieldValues {
+    let scaled = |value: f32, scale: i64| (value * scale as f32).round() as i64;
+    [
+        metrics.timestamp as i64,
+        scaled(metrics.temperature, 10),
+        metrics.battery_percentage as i64,
+        metrics.battery_voltage_mv as i64,
+        metrics.battery_charging as i64,
+        scaled(metrics.fps_actual, 10),
+        scaled(metrics.fps_target, 1),
+        metrics.cpu_usage as i64,
+        metrics.cpu0_usage as i64,
+        metrics.cpu1_usage as i64,
+        metrics.cpu_freq_mhz as i64,
+        metrics.heap_free as i64,
+        heap_min_free as i64,
+        metrics.wifi_rssi as i64,
+        metrics.wifi_connected as i64,
+        metrics.display_brightness as i64,
+        metrics.frame_count as i64,
+        metrics.skip_count as i64,
+        metrics.render_time_ms as i64,
+        metrics.flush_time_ms as i64,
+        metrics.flush_wait_time_ms as i64,
+        metrics.main_loop_idle_percent as i64,
+        metrics.psram_free as i64,
+        metrics.psram_total as i64,
+        scaled(metrics.button_avg_response_ms, 100),
+        scaled(metrics.button_max_response_ms, 100),
+        metrics.button_events_total as i64,
+        metrics.wifi_disconnects as i64,
+        metrics.wifi_reconnects as i64,
+        metrics.http_connections_active as i64,
+        metrics.telnet_connections_active as i64,
+        metrics.uptime_seconds as i64,
+    ]
+}
+
+/// Schema description served to clients negotiating v2
+pub fn schema_json() -> serde_json::Value {
+    let fields: Vec<_> = V2_FIELDS.iter().enumerate()
+        .map(|(id, f)| serde_json::json!({ "id": id, "name": f.name, "scale": f.scale }))
+        .collect();
+    serde_json::json!({
+        "version": V2_VERSION,
+        "schema_id": SCHEMA_ID,
+        "keyframe_interval": KEYFRAME_INTERVAL,
+        "fields": fields,
+    })
+}
+
+fn write_varint(out: &mut Vec<u8>, mut value: u64) {
+    while value >= 0x80 {
+        out.push(value as u8 | 0x80);
+        value >>= 7;
+    }
+    out.push(value as u8);
+}
+
+fn zigzag(value: i64) -> u64 {
+    ((value << 1) ^ (value >> 63)) as u64
+}
+
+/// Sequence-numbered history of published values shared by all v2 clients
+pub struct DeltaEncoder {
+    history: std::collections::VecDeque<(u32, FieldValues)>,
+    next_seq: u32,
+}
+
+impl DeltaEncoder {
+    pub fn new() -> Self {
+        Self {
+            history: std::collections::VecDeque::with_capacity(HISTORY_DEPTH),
+            next_seq: 1,
+        }
+    }
+
+    /// Record `values` as a new frame unless they match the newest one;
+    /// returns the sequence number clients will ack
+    pub fn record(&mut self, values: &FieldValues) -> u32 {
+        if let Some((seq, newest)) = self.history.back() {
+            if newest == values {
+                return *seq;
+            }
+        }
+        let seq = self.next_seq;
+        self.next_seq = self.next_seq.wrapping_add(1).max(1);
+        if self.history.len() == HISTORY_DEPTH {
+            self.history.pop_front();
+        }
+        self.history.push_back((seq, *values));
+        seq
+    }
+
+    /// Encode the newest frame for a client that acked `ack` under `schema`.
+    /// Falls back to a keyframe when the base is unknown or stale.
+    pub fn encode(&self, ack: Option<u32>, schema: Option<u16>, out: &mut Vec<u8>) {
+        let Some((seq, current)) = self.history.back() else {
+            return;
+        };
+        let base = ack
+            .filter(|_| schema == Some(SCHEMA_ID))
+            .filter(|ack| ack / KEYFRAME_INTERVAL == seq / KEYFRAME_INTERVAL)
+            .and_then(|ack| self.history.iter().find(|(s, _)| *s == ack));
+
+        out.push(V2_VERSION);
+        out.push(if base.is_some() { 0 } else { FLAG_KEYFRAME });
+        out.extend_from_slice(&SCHEMA_ID.to_le_bytes());
+        write_varint(out, *seq as u64);
+
+        let zero = [0i64; V2_FIELD_COUNT];
+        let reference = match base {
+            Some((base_seq, values)) => {
+                write_varint(out, *base_seq as u64);
+                values
+            }
+            None => &zero,
+        };
+
+        let mut presence = 0u64;
+        for (i, (now, then)) in current.iter().zip(reference).enumerate() {
+            if now != then {
+                presence |= 1 << i;
+            }
+        }
+        write_varint(out, presence);
+        for (now, then) in current.iter().zip(reference) {
+            if now != then {
+                write_varint(out, zigzag(now.wrapping_sub(*then)));
+            }
+        }
+    }
+}
+
+static V2_ENCODER: std::sync::OnceLock<std::sync::Mutex<DeltaEncoder>> = std::sync::OnceLock::new();
+
+/// Encode the latest snapshot as a v2 frame for a client that acked `ack`
+pub fn encode_v2(metrics: &crate::metrics::MetricsData, ack: Option<u32>, schema: Option<u16>) -> Vec<u8> {
+    let heap_min_free = unsafe { esp_idf_sys::esp_get_minimum_free_heap_size() };
+    let values = field_values(metrics, heap_min_free);
+
+    let mut out = Vec::with_capacity(16);
+    let encoder = V2_ENCODER.get_or_init(|| std::sync::Mutex::new(DeltaEncoder::new()));
+    let mut encoder = encoder.lock().unwrap_or_else(|e| e.into_inner());
+    encoder.record(&values);
+    encoder.encode(ack, schema, &mut out);
+    out
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
 
     #[test]
     fn test_metrics_packet_size() {
-        assert_eq!(MetricsBinaryPacket::SIZE, 63);
+        // Packed: exactly the sum of the field sizes
+        assert_eq!(MetricsBinaryPacket::SIZE, 46);
     }
 
-}
\ No newline at end of file
+    // Reference decoder for the v2 format
+    fn decode_v2(frame: &[u8], previous: &std::collections::HashMap<u32, FieldValues>) -> (u32, FieldValues) {
+        fn varint(data: &[u8], pos: &mut usize) -> u64 {
+            let mut value = 0u64;
+            let mut shift = 0;
+            loop {
+                let byte = data[*pos];
+                *pos += 1;
+                value |= ((byte & 0x7f) as u64) << shift;
+                if byte & 0x80 == 0 {
+                    return value;
+                }
+                shift += 7;
+            }
+        }
+
+        assert_eq!(frame[0], V2_VERSION);
+        assert_eq!(u16::from_le_bytes([frame[2], frame[3]]), SCHEMA_ID);
+        let mut pos = 4;
+        let seq = varint(frame, &mut pos) as u32;
+        let mut values = if frame[1] & FLAG_KEYFRAME != 0 {
+            [0; V2_FIELD_COUNT]
+        } else {
+            previous[&(varint(frame, &mut pos) as u32)]
+        };
+        let presence = varint(frame, &mut pos);
+        for (i, value) in values.iter_mut().enumerate() {
+            if presence & (1 << i) != 0 {
+                let raw = varint(frame, &mut pos);
+                *value += (raw >> 1) as i64 ^ -((raw & 1) as i64);
+            }
+        }
+        assert_eq!(pos, frame.len());
+        (seq, values)
+    }
+
+    #[test]
+    fn test_v2_delta_roundtrip() {
+        let mut encoder = DeltaEncoder::new();
+        let mut decoded = std::collections::HashMap::new();
+
+        let mut values = [0i64; V2_FIELD_COUNT];
+        values[0] = 1_700_000_000;
+        values[1] = 235;
+        values[13] = -67;
+        let seq = encoder.record(&values);
+
+        // No ack: keyframe with absolute values
+        let mut frame = Vec::new();
+        encoder.encode(None, Some(SCHEMA_ID), &mut frame);
+        assert_eq!(frame[1] & FLAG_KEYFRAME, FLAG_KEYFRAME);
+        let (got_seq, got) = decode_v2(&frame, &decoded);
+        assert_eq!((got_seq, got), (seq, values));
+        decoded.insert(got_seq, got);
+
+        // Acked: only the two changed fields travel
+        values[0] += 1;
+        values[13] = -70;
+        encoder.record(&values);
+        frame.clear();
+        encoder.encode(Some(seq), Some(SCHEMA_ID), &mut frame);
+        assert_eq!(frame[1] & FLAG_KEYFRAME, 0);
+        assert!(frame.len() < 12, "delta frame is {} bytes", frame.len());
+        assert_eq!(decode_v2(&frame, &decoded).1, values);
+
+        // Unknown schema falls back to a keyframe
+        frame.clear();
+        encoder.encode(Some(seq), Some(SCHEMA_ID + 1), &mut frame);
+        assert_eq!(frame[1] & FLAG_KEYFRAME, FLAG_KEYFRAME);
+    }
+
+    #[test]
+    fn test_v2_periodic_keyframe() {
+        let mut encoder = DeltaEncoder::new();
+        let mut values = [0i64; V2_FIELD_COUNT];
+        let mut last = 0;
+        for tick in 1..KEYFRAME_INTERVAL as i64 {
+            values[0] = tick;
+            last = encoder.record(&values);
+        }
+        // Sequence KEYFRAME_INTERVAL starts a new keyframe period
+        values[0] += 1;
+        assert_eq!(encoder.record(&values), KEYFRAME_INTERVAL);
+        let mut frame = Vec::new();
+        encoder.encode(Some(last), Some(SCHEMA_ID), &mut frame);
+        assert_eq!(frame[1] & FLAG_KEYFRAME, FLAG_KEYFRAME);
+    }
+}
@@ -4,6 +4,7 @@ use esp_idf_svc::io::Write;
 use std::fs;
 use std::path::PathBuf;
 use crate::network::error_handler::ErrorResponse;
+use crate::network::observability::ProfiledHandlers;
 use crate::network::validators;
 
 const MAX_FILE_SIZE: usize = 256 * 1024; // 256KB for ESP32
@@ -12,7 +13,7 @@ const BASE_PATH: &str = "/spiffs"; // or "/littlefs" based on your partition
 
 pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
     // GET /api/files - List files
-    server.fn_handler("/api/files", Method::Get, |req| {
+    server.profiled_handler("/api/files", Method::Get, |req| {
         let path = req.uri()
             .split('?')
             .nth(1)
@@ -55,7 +56,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
             "files": files,
         });
 
-        let json = serde_json::to_string(&response)?;
+        let json = crate::arena::to_json(&response)?;
         let mut http_response = req.into_response(
             200,
             Some("OK"),
@@ -66,7 +67,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
     })?;
 
     // GET /api/files/content - Read file content
-    server.fn_handler("/api/files/content", Method::Get, |req| {
+    server.profiled_handler("/api/files/content", Method::Get, |req| {
         let filename = req.uri()
             .split('?')
             .nth(1)
@@ -109,7 +110,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
             "type": extension,
         });
 
-        let json = serde_json::to_string(&response)?;
+        let json = crate::arena::to_json(&response)?;
         let mut http_response = req.into_response(
             200,
             Some("OK"),
@@ -120,7 +121,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
     })?;
 
     // PUT /api/files/content - Save file content
-    server.fn_handler("/api/files/content", Method::Put, |mut req| {
+    server.profiled_handler("/api/files/content", Method::Put, |mut req| {
         let uri = req.uri().to_string();
         let filename = uri
             .split('?')
@@ -176,7 +177,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
             "size": content.len(),
         });
 
-        let json = serde_json::to_string(&response)?;
+        let json = crate::arena::to_json(&response)?;
         let mut http_response = req.into_response(
             200,
             Some("OK"),
@@ -187,7 +188,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
     })?;
 
     // POST /api/files/upload - Upload file
-    server.fn_handler("/api/files/upload", Method::Post, |mut req| {
+    server.profiled_handler("/api/files/upload", Method::Post, |mut req| {
         let filename = req.header("X-Filename")
             .ok_or_else(|| anyhow::anyhow!("Missing X-Filename header"))?
             .to_string();
@@ -236,7 +237,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
             "path": format!("/data/uploads/{}", filename),
         });
 
-        let json = serde_json::to_string(&response)?;
+        let json = crate::arena::to_json(&response)?;
         let mut http_response = req.into_response(
             200,
             Some("OK"),
@@ -247,7 +248,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
     })?;
 
     // DELETE /api/files - Delete file
-    server.fn_handler("/api/files", Method::Delete, |req| {
+    server.profiled_handler("/api/files", Method::Delete, |req| {
         let filename = req.uri()
             .split('?')
             .nth(1)
@@ -283,7 +284,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
             "filename": filename,
         });
 
-        let json = serde_json::to_string(&response)?;
+        let json = crate::arena::to_json(&response)?;
         let mut http_response = req.into_response(
             200,
             Some("OK"),
@@ -294,7 +295,7 @@ pub fn register_file_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
     })?;
 
     // File manager UI page (inject shared navbar if missing)
-    server.fn_handler("/files", Method::Get, |req| {
+    server.profiled_handler("/files", Method::Get, |req| {
         let template = include_str!("../templates/files.html");
         let mut navbar = include_str!("../templates/partials/navbar.html").to_string();
         navbar = navbar
@@ -1,8 +1,5 @@
-use std::sync::{Arc, Mutex, OnceLock};
-use std::collections::VecDeque;
-
-// Keep memory use bounded. Target ~2K entries by default; adjust if PSRAM abundant.
-const MAX_LOG_LINES: usize = 2000;
+use std::sync::{Arc, OnceLock};
+use crate::log_ring::{self, LogLine};
 
 #[derive(Debug, Clone, serde::Serialize)]
 pub struct LogEntry {
@@ -12,60 +9,37 @@ pub struct LogEntry {
     pub module: Option<String>,
 }
 
-
-pub struct LogStreamer {
-    buffer: Arc<Mutex<VecDeque<LogEntry>>>,
-}
-
-impl LogStreamer {
-    pub fn new(_telnet_buffer: Option<Arc<Mutex<VecDeque<String>>>>) -> Self {
+impl From<&LogLine> for LogEntry {
+    fn from(line: &LogLine) -> Self {
+        let mut message = line.message().to_string();
+        if line.truncated() {
+            message.push('…');
+        }
         Self {
-            buffer: Arc::new(Mutex::new(VecDeque::with_capacity(MAX_LOG_LINES))),
+            timestamp: line.timestamp_ms(),
+            level: line.level().as_str().to_string(),
+            message,
+            module: Some(line.module().to_string()),
         }
     }
+}
 
-    /// Non-blocking append; if the mutex is contended, drop the entry.
-    pub fn try_append(&self, entry: LogEntry) {
-        // Avoid blocking logging path; if we cannot get the lock immediately, drop.
-        if let Ok(mut guard) = self.buffer.try_lock() {
-            // Apply backpressure under heap pressure (temporarily disabled)
-            let cap = MAX_LOG_LINES;
-            if guard.len() >= cap {
-                guard.pop_front();
-            }
-            guard.push_back(entry);
-        }
-    }
+/// Read side of the log ring for the HTTP APIs; records are only turned into
+/// LogEntry values here, when a client asks for them
+pub struct LogStreamer;
 
+impl LogStreamer {
     pub fn get_recent_logs(&self, count: usize) -> Vec<LogEntry> {
-        let buffer = match self.buffer.lock() {
-            Ok(b) => b,
-            Err(_) => return Vec::new(),
-        };
-        buffer.iter()
-            .rev()
-            .take(count)
-            .rev()
-            .cloned()
+        log_ring::ring()
+            .recent(count)
+            .iter()
+            .map(LogEntry::from)
             .collect()
     }
 }
 
 static LOG_STREAMER: OnceLock<Arc<LogStreamer>> = OnceLock::new();
 
-pub fn init(telnet_buffer: Option<Arc<Mutex<VecDeque<String>>>>) -> Arc<LogStreamer> {
-    LOG_STREAMER.get_or_init(|| Arc::new(LogStreamer::new(telnet_buffer))).clone()
+pub fn init() -> Arc<LogStreamer> {
+    LOG_STREAMER.get_or_init(|| Arc::new(LogStreamer)).clone()
 }
-
-/// Append a log entry to the global buffer (non-blocking). Safe to call from logger.
-pub fn append(level: &str, module: Option<&str>, message: &str, timestamp_ms: u64) {
-    if let Some(streamer) = LOG_STREAMER.get() {
-        let entry = LogEntry {
-            timestamp: timestamp_ms,
-            level: level.to_string(),
-            message: message.to_string(),
-            module: module.map(|m| m.to_string()),
-        };
-        streamer.try_append(entry);
-    }
-}
\ No newline at end of file
@@ -6,12 +6,14 @@ pub mod web_server;
 pub mod telnet_server;
 // pub mod sse_broadcaster; // legacy SSE, replaced by sse_v2
 pub mod sse_v2;
+pub mod telemetry_hub;
 pub mod api_routes;
 pub mod error_handler;
 pub mod error_wrapper;
 pub mod validators;
 pub mod log_streamer;
 pub mod file_manager;
+pub mod static_assets;
 // pub mod compression; // removed (unused)
 pub mod binary_protocol;
 pub mod http_config;
@@ -22,6 +24,8 @@ pub mod streaming_dashboard;
 pub mod template_engine;
 pub mod templated_home;
 pub mod observability;
+pub mod async_handler;
+pub mod screen_stream;
 
 use anyhow::Result;
 use esp_idf_hal::modem::Modem;
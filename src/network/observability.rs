@@ -1,34 +1,27 @@
-use core::sync::atomic::{AtomicU32, Ordering};
+use core::fmt::Debug;
+use core::sync::atomic::{AtomicI32, AtomicU32, Ordering};
 use esp_idf_hal::delay::FreeRtos; // used elsewhere; keep if needed
+use esp_idf_svc::http::server::{EspHttpConnection, EspHttpServer, Request};
+use esp_idf_svc::http::Method;
+use esp_idf_sys::EspError;
+use embedded_svc::http::server::Connection as _;
 use serde::Serialize;
 use std::collections::VecDeque;
 use std::sync::{Mutex, OnceLock};
+use crate::dual_core::{LatencyHistogram, LATENCY_BUCKETS};
 
 // Lightweight, fixed-memory observability with near-zero hot-path overhead
 
-#[derive(Copy, Clone, Debug)]
-pub enum Endpoint {
-    Ping,
-    Health,
-}
-
-#[derive(Default, Serialize, Clone)]
-pub struct HttpEndpointStats {
-    pub total: u32,
-    pub ok_2xx: u32,
-    pub err_4xx_5xx: u32,
-    pub total_duration_ms: u32,
-    pub p95_hint_ms: u32, // simple max-of-recent hint (not exact)
-}
-
 #[derive(Default, Serialize, Clone)]
 pub struct HttpStatsSnapshot {
     pub active_requests: u32,
     pub active_high_watermark: u32,
     pub total_requests: u32,
     pub httpd_stack_low_water_bytes: u32,
-    pub ping: HttpEndpointStats,
-    pub health: HttpEndpointStats,
+    pub routes: Vec<RouteSnapshot>,
+    pub arenas: crate::arena::ArenaStats,
+    /// Present when built with the alloc_profiler feature
+    pub allocations: Option<crate::alloc_profiler::AllocProfile>,
 }
 
 static ACTIVE_REQUESTS: AtomicU32 = AtomicU32::new(0);
@@ -37,18 +30,14 @@ static TOTAL_REQUESTS: AtomicU32 = AtomicU32::new(0);
 // Track the minimum observed remaining stack watermark (bytes) during request handling
 // Initialize high; first observation will drop this down
 static HTTPD_STACK_LOW_WATER_BYTES: AtomicU32 = AtomicU32::new(u32::MAX);
+// Bytes handed to lwIP by the httpd send override, per socket. lwIP numbers
+// its sockets contiguously, so fd modulo the socket count never collides.
+const SOCKET_SLOTS: usize = esp_idf_sys::CONFIG_LWIP_MAX_SOCKETS as usize;
+static SOCKET_BYTES_SENT: [AtomicU32; SOCKET_SLOTS] = [ZERO; SOCKET_SLOTS];
 
-static PING_TOTAL: AtomicU32 = AtomicU32::new(0);
-static PING_OK: AtomicU32 = AtomicU32::new(0);
-static PING_ERR: AtomicU32 = AtomicU32::new(0);
-static PING_DUR_MS: AtomicU32 = AtomicU32::new(0);
-static PING_P95HINT_MS: AtomicU32 = AtomicU32::new(0);
-
-static HEALTH_TOTAL: AtomicU32 = AtomicU32::new(0);
-static HEALTH_OK: AtomicU32 = AtomicU32::new(0);
-static HEALTH_ERR: AtomicU32 = AtomicU32::new(0);
-static HEALTH_DUR_MS: AtomicU32 = AtomicU32::new(0);
-static HEALTH_P95HINT_MS: AtomicU32 = AtomicU32::new(0);
+fn socket_bytes_sent(sockfd: core::ffi::c_int) -> &'static AtomicU32 {
+    &SOCKET_BYTES_SENT[sockfd as usize % SOCKET_SLOTS]
+}
 
 #[inline]
 pub fn begin_request() -> u64 {
@@ -68,43 +57,14 @@ pub fn begin_request() -> u64 {
     now_us
 }
 
+/// Close a request opened by begin_request; returns its duration in microseconds
 #[inline]
-pub fn end_request(start_us: u64, ep: Endpoint, status: u16) {
+pub fn end_request(start_us: u64) -> u32 {
     let end_us = unsafe { esp_idf_sys::esp_timer_get_time() as u64 };
-    let dur_ms = ((end_us - start_us) / 1000) as u32;
     ACTIVE_REQUESTS.fetch_sub(1, Ordering::Relaxed);
-
-    let is_ok = (200..300).contains(&status);
     // Count every completed request
     TOTAL_REQUESTS.fetch_add(1, Ordering::Relaxed);
-    match ep {
-        Endpoint::Ping => {
-            PING_TOTAL.fetch_add(1, Ordering::Relaxed);
-            if is_ok { PING_OK.fetch_add(1, Ordering::Relaxed); } else { PING_ERR.fetch_add(1, Ordering::Relaxed); }
-            PING_DUR_MS.fetch_add(dur_ms, Ordering::Relaxed);
-            // simple max-of-recent hint
-            let mut cur = PING_P95HINT_MS.load(Ordering::Relaxed);
-            while dur_ms > cur {
-                match PING_P95HINT_MS.compare_exchange(cur, dur_ms, Ordering::Relaxed, Ordering::Relaxed) {
-                    Ok(_) => break,
-                    Err(v) => cur = v,
-                }
-            }
-        }
-        Endpoint::Health => {
-            HEALTH_TOTAL.fetch_add(1, Ordering::Relaxed);
-            if is_ok { HEALTH_OK.fetch_add(1, Ordering::Relaxed); } else { HEALTH_ERR.fetch_add(1, Ordering::Relaxed); }
-            HEALTH_DUR_MS.fetch_add(dur_ms, Ordering::Relaxed);
-            let mut cur = HEALTH_P95HINT_MS.load(Ordering::Relaxed);
-            while dur_ms > cur {
-                match HEALTH_P95HINT_MS.compare_exchange(cur, dur_ms, Ordering::Relaxed, Ordering::Relaxed) {
-                    Ok(_) => break,
-                    Err(v) => cur = v,
-                }
-            }
-        }
-        _ => {}
-    }
+    end_us.saturating_sub(start_us).min(u32::MAX as u64) as u32
 }
 
 pub fn http_snapshot() -> HttpStatsSnapshot {
@@ -112,24 +72,226 @@ pub fn http_snapshot() -> HttpStatsSnapshot {
         active_requests: ACTIVE_REQUESTS.load(Ordering::Relaxed),
         active_high_watermark: ACTIVE_HIGH_WATERMARK.load(Ordering::Relaxed),
         total_requests: TOTAL_REQUESTS.load(Ordering::Relaxed),
-        httpd_stack_low_water_bytes: HTTPD_STACK_LOW_WATER_BYTES.load(Ordering::Relaxed),
-        ping: HttpEndpointStats {
-            total: PING_TOTAL.load(Ordering::Relaxed),
-            ok_2xx: PING_OK.load(Ordering::Relaxed),
-            err_4xx_5xx: PING_ERR.load(Ordering::Relaxed),
-            total_duration_ms: PING_DUR_MS.load(Ordering::Relaxed),
-            p95_hint_ms: PING_P95HINT_MS.load(Ordering::Relaxed),
-        },
-        health: HttpEndpointStats {
-            total: HEALTH_TOTAL.load(Ordering::Relaxed),
-            ok_2xx: HEALTH_OK.load(Ordering::Relaxed),
-            err_4xx_5xx: HEALTH_ERR.load(Ordering::Relaxed),
-            total_duration_ms: HEALTH_DUR_MS.load(Ordering::Relaxed),
-            p95_hint_ms: HEALTH_P95HINT_MS.load(Ordering::Relaxed),
-        },
+        httpd_stack_low_water_bytes: httpd_stack_low_water_bytes(),
+        routes: route_snapshots(),
+        arenas: crate::arena::stats(),
+        allocations: crate::alloc_profiler::snapshot(),
     }
 }
 
+#[inline]
+pub fn httpd_stack_low_water_bytes() -> u32 {
+    HTTPD_STACK_LOW_WATER_BYTES.load(Ordering::Relaxed)
+}
+
+// ---- Per-route profiler ----
+//
+// Every handler registered through ProfiledHandlers gets a fixed block of
+// atomics, allocated once at registration: a log2 latency histogram (same
+// buckets as the job executor's), bytes sent, and the worst heap delta and
+// stack watermark seen. The hot path is a handful of relaxed atomic ops.
+
+pub(crate) struct RouteStats {
+    method: &'static str,
+    route: &'static str,
+    requests: AtomicU32,
+    errors: AtomicU32,
+    // Total latency in microseconds; the low word wraps into total_us_high
+    total_us: AtomicU32,
+    total_us_high: AtomicU32,
+    max_us: AtomicU32,
+    latency: [AtomicU32; LATENCY_BUCKETS],
+    bytes_sent: AtomicU32,
+    // Free heap lost across one request (positive = retained allocations)
+    heap_delta_max: AtomicI32,
+    stack_low_water: AtomicU32,
+}
+
+#[derive(Default, Serialize, Clone)]
+pub struct RouteSnapshot {
+    pub method: &'static str,
+    pub route: &'static str,
+    pub requests: u32,
+    pub errors: u32,
+    pub total_us: u64,
+    pub p50_us: u32,
+    pub p95_us: u32,
+    pub p99_us: u32,
+    pub max_us: u32,
+    pub bytes_sent: u32,
+    pub heap_delta_max: i32,
+    pub stack_low_water_bytes: u32,
+}
+
+// Append-only; entries are leaked at registration and live for the server's lifetime
+static ROUTES: Mutex<Vec<&'static RouteStats>> = Mutex::new(Vec::new());
+
+impl RouteStats {
+    pub(crate) fn record(&self, elapsed_us: u32, ok: bool, bytes_sent: u32, heap_delta: i32, stack_remaining: u32) {
+        self.requests.fetch_add(1, Ordering::Relaxed);
+        if !ok {
+            self.errors.fetch_add(1, Ordering::Relaxed);
+        }
+        let total = self.total_us.fetch_add(elapsed_us, Ordering::Relaxed);
+        if total.checked_add(elapsed_us).is_none() {
+            self.total_us_high.fetch_add(1, Ordering::Relaxed);
+        }
+        self.max_us.fetch_max(elapsed_us, Ordering::Relaxed);
+        let bucket = (u32::BITS - elapsed_us.leading_zeros()) as usize;
+        self.latency[bucket.min(LATENCY_BUCKETS - 1)].fetch_add(1, Ordering::Relaxed);
+        self.bytes_sent.fetch_add(bytes_sent, Ordering::Relaxed);
+        self.heap_delta_max.fetch_max(heap_delta, Ordering::Relaxed);
+        self.stack_low_water.fetch_min(stack_remaining, Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> RouteSnapshot {
+        let mut histogram = LatencyHistogram::default();
+        for (bucket, count) in histogram.buckets.iter_mut().zip(&self.latency) {
+            *bucket = count.load(Ordering::Relaxed);
+        }
+        histogram.count = histogram.buckets.iter().sum();
+        histogram.max_us = self.max_us.load(Ordering::Relaxed);
+
+        RouteSnapshot {
+            method: self.method,
+            route: self.route,
+            requests: self.requests.load(Ordering::Relaxed),
+            errors: self.errors.load(Ordering::Relaxed),
+            total_us: (self.total_us_high.load(Ordering::Relaxed) as u64) << 32
+                | self.total_us.load(Ordering::Relaxed) as u64,
+            p50_us: histogram.percentile_us(50),
+            p95_us: histogram.percentile_us(95),
+            p99_us: histogram.percentile_us(99),
+            max_us: histogram.max_us,
+            bytes_sent: self.bytes_sent.load(Ordering::Relaxed),
+            heap_delta_max: self.heap_delta_max.load(Ordering::Relaxed),
+            stack_low_water_bytes: self.stack_low_water.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// Routes that served at least one request
+pub fn route_snapshots() -> Vec<RouteSnapshot> {
+    let routes = ROUTES.lock().unwrap_or_else(|poisoned| poisoned.into_inner());
+    routes.iter()
+        .filter(|stats| stats.requests.load(Ordering::Relaxed) > 0)
+        .map(|stats| stats.snapshot())
+        .collect()
+}
+
+pub(crate) fn register_route(method: Method, route: &'static str) -> &'static RouteStats {
+    let stats: &'static RouteStats = Box::leak(Box::new(RouteStats {
+        method: method_name(method),
+        route,
+        requests: AtomicU32::new(0),
+        errors: AtomicU32::new(0),
+        total_us: AtomicU32::new(0),
+        total_us_high: AtomicU32::new(0),
+        max_us: AtomicU32::new(0),
+        latency: core::array::from_fn(|_| AtomicU32::new(0)),
+        bytes_sent: AtomicU32::new(0),
+        heap_delta_max: AtomicI32::new(i32::MIN),
+        stack_low_water: AtomicU32::new(u32::MAX),
+    }));
+    ROUTES.lock().unwrap_or_else(|poisoned| poisoned.into_inner()).push(stats);
+    stats
+}
+
+fn method_name(method: Method) -> &'static str {
+    match method {
+        Method::Get => "GET",
+        Method::Post => "POST",
+        Method::Put => "PUT",
+        Method::Patch => "PATCH",
+        Method::Delete => "DELETE",
+        Method::Head => "HEAD",
+        Method::Options => "OPTIONS",
+        _ => "OTHER",
+    }
+}
+
+/// Registration that feeds the per-route profiler
+pub trait ProfiledHandlers {
+    /// `fn_handler` plus latency, bytes, heap and stack accounting for `uri`
+    fn profiled_handler<E, F>(&mut self, uri: &'static str, method: Method, handler: F) -> Result<&mut Self, EspError>
+    where
+        F: for<'r> Fn(Request<&mut EspHttpConnection<'r>>) -> Result<(), E> + Send + 'static,
+        E: Debug;
+}
+
+impl<'a> ProfiledHandlers for EspHttpServer<'a> {
+    fn profiled_handler<E, F>(&mut self, uri: &'static str, method: Method, handler: F) -> Result<&mut Self, EspError>
+    where
+        F: for<'r> Fn(Request<&mut EspHttpConnection<'r>>) -> Result<(), E> + Send + 'static,
+        E: Debug,
+    {
+        let stats = register_route(method, uri);
+        let tag = crate::alloc_profiler::Tag::for_route(uri);
+        let span_id = crate::trace::register(uri, "http");
+        self.fn_handler(uri, method, move |mut req| {
+            let _alloc_tag = crate::alloc_profiler::scope(tag);
+            let _span = crate::trace::span(span_id);
+            let sockfd = count_bytes_sent(req.connection());
+            let bytes_before = sockfd.map_or(0, |fd| socket_bytes_sent(fd).load(Ordering::Relaxed));
+            let heap_before = unsafe { esp_idf_sys::esp_get_free_heap_size() };
+            let start_us = begin_request();
+
+            let result = handler(req);
+
+            let elapsed_us = end_request(start_us);
+            let heap_delta = heap_before as i32 - unsafe { esp_idf_sys::esp_get_free_heap_size() } as i32;
+            let bytes_sent = sockfd.map_or(0, |fd| socket_bytes_sent(fd).load(Ordering::Relaxed).wrapping_sub(bytes_before));
+            let stack_remaining = unsafe { esp_idf_sys::uxTaskGetStackHighWaterMark(core::ptr::null_mut()) };
+            record_httpd_stack_low_water(stack_remaining);
+            stats.record(elapsed_us, result.is_ok(), bytes_sent, heap_delta, stack_remaining);
+            if result.is_err() {
+                record_http_error(uri, 500, elapsed_us / 1000);
+            }
+            result
+        })
+    }
+}
+
+/// Route this session's socket writes through counting_send and return the
+/// socket they are counted under. Idempotent, so keep-alive sessions simply
+/// re-install the same override.
+fn count_bytes_sent(connection: &mut EspHttpConnection<'_>) -> Option<core::ffi::c_int> {
+    let raw = connection.raw_connection().ok()?;
+    let req = raw.handle() as *const esp_idf_sys::httpd_req_t as *mut esp_idf_sys::httpd_req_t;
+    unsafe {
+        let sockfd = esp_idf_sys::httpd_req_to_sockfd(req);
+        if sockfd < 0 {
+            return None;
+        }
+        esp_idf_sys::httpd_sess_set_send_override((*req).handle, sockfd, Some(counting_send));
+        Some(sockfd)
+    }
+}
+
+/// Mirror of httpd's default send function that also counts bytes
+unsafe extern "C" fn counting_send(
+    _hd: esp_idf_sys::httpd_handle_t,
+    sockfd: core::ffi::c_int,
+    buf: *const core::ffi::c_char,
+    buf_len: usize,
+    flags: core::ffi::c_int,
+) -> core::ffi::c_int {
+    if buf.is_null() {
+        return esp_idf_sys::HTTPD_SOCK_ERR_INVALID;
+    }
+    let sent = esp_idf_sys::lwip_send(sockfd, buf as *const core::ffi::c_void, buf_len, flags);
+    if sent < 0 {
+        let errno = *esp_idf_sys::__errno() as u32;
+        return if errno == esp_idf_sys::EAGAIN || errno == esp_idf_sys::EINTR {
+            esp_idf_sys::HTTPD_SOCK_ERR_TIMEOUT
+        } else {
+            esp_idf_sys::HTTPD_SOCK_ERR_FAIL
+        };
+    }
+    socket_bytes_sent(sockfd).fetch_add(sent as u32, Ordering::Relaxed);
+    sent as core::ffi::c_int
+}
+
 // ---- Event rings (try_lock; drop on contention) ----
 
 #[derive(Serialize, Clone, Default)]
@@ -173,6 +335,70 @@ pub fn record_wifi_event(kind: &'static str, reason: u32, rssi_dbm: i32, channel
     }
 }
 
+// ---- WiFi reconnect latency ----
+//
+// Time from losing the link to having an IP again, one log2 histogram per
+// path: straight to the cached AP, or through a scan. Same bucketing as the
+// other latency histograms but in milliseconds, since a reconnect through
+// backoff can take minutes.
+
+const ZERO: AtomicU32 = AtomicU32::new(0);
+static RECONNECT_CACHED: [AtomicU32; LATENCY_BUCKETS] = [ZERO; LATENCY_BUCKETS];
+static RECONNECT_SCAN: [AtomicU32; LATENCY_BUCKETS] = [ZERO; LATENCY_BUCKETS];
+static RECONNECT_CACHED_MAX_MS: AtomicU32 = AtomicU32::new(0);
+static RECONNECT_SCAN_MAX_MS: AtomicU32 = AtomicU32::new(0);
+
+#[derive(Serialize, Clone, Default)]
+pub struct ReconnectLatency {
+    pub count: u32,
+    pub p50_ms: u32,
+    pub p95_ms: u32,
+    pub max_ms: u32,
+}
+
+#[derive(Serialize, Clone, Default)]
+pub struct WifiReconnectSnapshot {
+    pub cached: ReconnectLatency,
+    pub scan: ReconnectLatency,
+}
+
+/// A lost link came back after `latency_ms`; logged to the WiFi event ring
+/// as "reconnected_cached" or "reconnected_scan" with the latency as reason
+pub fn record_wifi_reconnect(cached: bool, latency_ms: u32, rssi_dbm: i32, channel: u32) {
+    let (buckets, max_ms, kind) = if cached {
+        (&RECONNECT_CACHED, &RECONNECT_CACHED_MAX_MS, "reconnected_cached")
+    } else {
+        (&RECONNECT_SCAN, &RECONNECT_SCAN_MAX_MS, "reconnected_scan")
+    };
+    let bucket = (u32::BITS - latency_ms.leading_zeros()) as usize;
+    buckets[bucket.min(LATENCY_BUCKETS - 1)].fetch_add(1, Ordering::Relaxed);
+    max_ms.fetch_max(latency_ms, Ordering::Relaxed);
+    record_wifi_event(kind, latency_ms, rssi_dbm, channel);
+}
+
+fn reconnect_latency(buckets: &[AtomicU32; LATENCY_BUCKETS], max_ms: &AtomicU32) -> ReconnectLatency {
+    let mut histogram = LatencyHistogram::default();
+    for (bucket, count) in histogram.buckets.iter_mut().zip(buckets) {
+        *bucket = count.load(Ordering::Relaxed);
+    }
+    histogram.count = histogram.buckets.iter().sum();
+    // Units are milliseconds throughout
+    histogram.max_us = max_ms.load(Ordering::Relaxed);
+    ReconnectLatency {
+        count: histogram.count,
+        p50_ms: histogram.percentile_us(50),
+        p95_ms: histogram.percentile_us(95),
+        max_ms: histogram.max_us,
+    }
+}
+
+pub fn wifi_reconnect_snapshot() -> WifiReconnectSnapshot {
+    WifiReconnectSnapshot {
+        cached: reconnect_latency(&RECONNECT_CACHED, &RECONNECT_CACHED_MAX_MS),
+        scan: reconnect_latency(&RECONNECT_SCAN, &RECONNECT_SCAN_MAX_MS),
+    }
+}
+
 #[inline]
 pub fn record_http_error(path: &'static str, status: u16, dur_ms: u32) {
     let ts_ms = unsafe { (esp_idf_sys::esp_timer_get_time() / 1000) as u64 };
@@ -0,0 +1,308 @@
+// Screenshots and a live view of the display
+//
+// Pixels come from the display's read-back mirror one row at a time and are
+// encoded straight into the chunked response, so no image is ever held in
+// RAM. The live stream sends a keyframe, then only the region that changed
+// since the previous frame, paced by a frame-rate and a bandwidth cap.
+//
+// Frame wire format (all integers little-endian):
+//   "S5", flags (bit 0: keyframe), 0, x u16, y u16, w u16, h u16, seq u32
+//   then h rows, each run-length coded until it covers w pixels:
+//     0x00-0x7F  n+1 literal pixels follow, big-endian RGB565
+//     0x80-0xFF  the next pixel repeats (n & 0x7F) + 1 times
+// A frame with w = h = 0 is a heartbeat.
+
+use anyhow::Result;
+use esp_idf_svc::http::server::{EspHttpServer, Method};
+use esp_idf_svc::io::Write;
+use std::time::{Duration, Instant};
+use crate::display::screen_mirror::{self, Viewer};
+use crate::display::DirtyRect;
+use crate::display::framebuffer::FRAMEBUFFER_WIDTH;
+use super::async_handler::{self, AsyncRequest, Dispatch};
+use super::server_config::StableServerConfig;
+
+const HEADER_LEN: usize = 16;
+const FLAG_KEYFRAME: u8 = 1 << 0;
+const MAX_RUN: usize = 128;
+
+/// Largest encoded row: all literals, one tag byte per MAX_RUN pixels
+const MAX_ROW_LEN: usize = FRAMEBUFFER_WIDTH as usize * 2 + (FRAMEBUFFER_WIDTH as usize).div_ceil(MAX_RUN);
+
+/// Encoded bytes gathered before a chunk goes out
+const CHUNK_SIZE: usize = 1536;
+
+const STREAM_STACK_SIZE: usize = 6144; // row and chunk buffers live on the stack
+const DEFAULT_FPS: u32 = 5;
+const MAX_FPS: u32 = 15;
+const DEFAULT_KBPS: u32 = 256;
+const MIN_KBPS: u32 = 16;
+const HEARTBEAT_INTERVAL: Duration = Duration::from_secs(5);
+const STREAM_TIMEOUT: Duration = Duration::from_secs(600);
+/// How long a screenshot waits for the display's next flush
+const FIRST_FRAME_TIMEOUT: Duration = Duration::from_secs(2);
+
+pub fn register_routes(server: &mut EspHttpServer<'static>) -> Result<()> {
+    // GET for <img src>, POST kept for existing API clients. A screenshot
+    // can wait up to FIRST_FRAME_TIMEOUT for the next flush, so it gets its
+    // own thread instead of holding an executor worker for that long.
+    for method in [Method::Get, Method::Post] {
+        async_handler::register(server, c"/api/v1/display/screenshot", method,
+                                Dispatch::Thread(STREAM_STACK_SIZE), handle_screenshot)?;
+    }
+    async_handler::register(server, c"/api/v1/display/stream", Method::Get,
+                            Dispatch::Thread(STREAM_STACK_SIZE), handle_stream)?;
+    Ok(())
+}
+
+/// One frame as BMP (default, viewable anywhere) or `?format=rle`
+fn handle_screenshot(req: &mut AsyncRequest) -> Result<()> {
+    let rle = req.query_param("format") == Some("rle");
+    let Some((viewer, rect)) = attach(req)? else {
+        return Ok(());
+    };
+
+    let content_type = if rle { "application/octet-stream" } else { "image/bmp" };
+    req.start_response(200, &[
+        ("Content-Type", content_type),
+        ("Cache-Control", "no-store"),
+        StableServerConfig::connection_header(),
+    ])?;
+    if rle {
+        send_frame(req, &viewer, rect, FLAG_KEYFRAME, 0)?;
+    } else {
+        send_bmp(req, &viewer, rect)?;
+    }
+    Ok(())
+}
+
+/// Live view: keyframe, then changed regions, `?fps=` and `?kbps=` capped
+fn handle_stream(req: &mut AsyncRequest) -> Result<()> {
+    let fps = req.query_param("fps").and_then(|v| v.parse().ok()).unwrap_or(DEFAULT_FPS).clamp(1, MAX_FPS);
+    let kbps = req.query_param("kbps").and_then(|v| v.parse().ok()).unwrap_or(DEFAULT_KBPS).max(MIN_KBPS);
+    let Some(_slot) = StableServerConfig::acquire_stream_slot() else {
+        req.send_status(503, "Too many streams")?;
+        return Ok(());
+    };
+    let Some((viewer, first)) = attach(req)? else {
+        return Ok(());
+    };
+
+    req.start_response(200, &[
+        ("Content-Type", "application/octet-stream"),
+        ("Cache-Control", "no-store"),
+        ("X-Frame-Rate", &fps.to_string()),
+    ])?;
+    log::info!("Screen stream: started ({} fps, {} kB/s)", fps, kbps);
+
+    let frame_period = Duration::from_secs(1) / fps;
+    let bytes_per_sec = kbps as u64 * 1024;
+    let started = Instant::now();
+    let (mut seq, mut last_sent, mut region) = (0u32, Instant::now(), Some(first));
+    let mut flags = FLAG_KEYFRAME;
+
+    while started.elapsed() < STREAM_TIMEOUT {
+        let frame_start = Instant::now();
+        let bytes = match region.take() {
+            Some(rect) => send_frame(req, &viewer, rect, flags, seq)?,
+            None if last_sent.elapsed() >= HEARTBEAT_INTERVAL => send_heartbeat(req, seq)?,
+            None => {
+                region = viewer.wait_changed(HEARTBEAT_INTERVAL.saturating_sub(last_sent.elapsed()));
+                continue;
+            }
+        };
+        seq = seq.wrapping_add(1);
+        flags = 0;
+        last_sent = Instant::now();
+
+        // Whichever cap is tighter sets the gap; changes made meanwhile are
+        // merged into a single region by the mirror
+        let budget = Duration::from_micros(bytes as u64 * 1_000_000 / bytes_per_sec);
+        let gap = frame_period.max(budget).saturating_sub(frame_start.elapsed());
+        std::thread::sleep(gap);
+        region = viewer.wait_changed(Duration::ZERO);
+    }
+    log::info!("Screen stream: closed after {} frames", seq);
+    Ok(())
+}
+
+/// Attach to the mirror and wait for its first full copy; answers the
+/// request itself and returns None when no frame can be read back
+fn attach(req: &mut AsyncRequest) -> Result<Option<(Viewer, DirtyRect)>> {
+    let viewer = match screen_mirror::subscribe() {
+        Ok(viewer) => viewer,
+        Err(e) => {
+            log::warn!("Screen: {}", e);
+            req.send_status(503, "Screen capture unavailable")?;
+            return Ok(None);
+        }
+    };
+    match viewer.wait_changed(FIRST_FRAME_TIMEOUT) {
+        Some(rect) => Ok(Some((viewer, rect))),
+        None => {
+            // Only frame buffer mode keeps pixels to read back
+            req.send_status(503, "Display has no frame buffer")?;
+            Ok(None)
+        }
+    }
+}
+
+fn frame_header(flags: u8, rect: &DirtyRect, seq: u32) -> [u8; HEADER_LEN] {
+    let mut header = [0u8; HEADER_LEN];
+    header[..2].copy_from_slice(b"S5");
+    header[2] = flags;
+    for (i, value) in [rect.x, rect.y, rect.width, rect.height].into_iter().enumerate() {
+        header[4 + i * 2..6 + i * 2].copy_from_slice(&value.to_le_bytes());
+    }
+    header[12..].copy_from_slice(&seq.to_le_bytes());
+    header
+}
+
+fn send_heartbeat(req: &mut AsyncRequest, seq: u32) -> Result<usize> {
+    req.write_all(&frame_header(0, &DirtyRect::new(0, 0, 0, 0), seq))?;
+    Ok(HEADER_LEN)
+}
+
+/// Encode `rect` row by row into CHUNK_SIZE chunks; returns bytes sent
+fn send_frame(req: &mut AsyncRequest, viewer: &Viewer, rect: DirtyRect, flags: u8, seq: u32) -> Result<usize> {
+    let mut row = [0u8; FRAMEBUFFER_WIDTH as usize * 2];
+    let mut chunk = [0u8; CHUNK_SIZE];
+    chunk[..HEADER_LEN].copy_from_slice(&frame_header(flags, &rect, seq));
+    let (mut len, mut sent) = (HEADER_LEN, 0);
+
+    let row = &mut row[..rect.width as usize * 2];
+    for y in rect.y..rect.y + rect.height {
+        if len + MAX_ROW_LEN > CHUNK_SIZE {
+            req.write_all(&chunk[..len])?;
+            sent += len;
+            len = 0;
+        }
+        viewer.read_row(rect.x, y, row);
+        len += encode_row(row, &mut chunk[len..]);
+    }
+    req.write_all(&chunk[..len])?;
+    Ok(sent + len)
+}
+
+/// 16-bit BI_BITFIELDS bitmap, rows bottom-up as BMP requires
+fn send_bmp(req: &mut AsyncRequest, viewer: &Viewer, rect: DirtyRect) -> Result<()> {
+    let (width, height) = (rect.width as usize, rect.height as usize);
+    let stride = (width * 2 + 3) & !3;
+    let pixel_offset = 14 + 40 + 12;
+
+    let mut header = [0u8; 14 + 40 + 12];
+    header[..2].copy_from_slice(b"BM");
+    header[2..6].copy_from_slice(&((pixel_offset + stride * height) as u32).to_le_bytes());
+    header[10..14].copy_from_slice(&(pixel_offset as u32).to_le_bytes());
+    header[14..18].copy_from_slice(&40u32.to_le_bytes());
+    header[18..22].copy_from_slice(&(width as i32).to_le_bytes());
+    header[22..26].copy_from_slice(&(height as i32).to_le_bytes());
+    header[26..28].copy_from_slice(&1u16.to_le_bytes()); // planes
+    header[28..30].copy_from_slice(&16u16.to_le_bytes()); // bits per pixel
+    header[30..34].copy_from_slice(&3u32.to_le_bytes()); // BI_BITFIELDS
+    header[34..38].copy_from_slice(&((stride * height) as u32).to_le_bytes());
+    for (i, mask) in [0xF800u32, 0x07E0, 0x001F].into_iter().enumerate() {
+        header[54 + i * 4..58 + i * 4].copy_from_slice(&mask.to_le_bytes());
+    }
+    req.write_all(&header)?;
+
+    let mut row = [0u8; FRAMEBUFFER_WIDTH as usize * 2 + 2];
+    let row = &mut row[..stride];
+    for y in (rect.y..rect.y + rect.height).rev() {
+        viewer.read_row(rect.x, y, &mut row[..width * 2]);
+        // Bus order is big-endian; BMP wants little-endian pixels
+        for pixel in row[..width * 2].chunks_exact_mut(2) {
+            pixel.swap(0, 1);
+        }
+        req.write_all(row)?;
+    }
+    Ok(())
+}
+
+/// Run-length code one row of big-endian RGB565 pixels into `out`, which
+/// must hold MAX_ROW_LEN bytes; returns the encoded length
+fn encode_row(row: &[u8], out: &mut [u8]) -> usize {
+    let pixels = row.len() / 2;
+    let pixel = |i: usize| [row[i * 2], row[i * 2 + 1]];
+    let mut len = 0;
+    let mut i = 0;
+    // Start of literals not yet written
+    let mut literal_start = 0;
+
+    let flush_literals = |out: &mut [u8], len: &mut usize, from: usize, to: usize| {
+        let mut from = from;
+        while from < to {
+            let count = (to - from).min(MAX_RUN);
+            out[*len] = (count - 1) as u8;
+            out[*len + 1..*len + 1 + count * 2].copy_from_slice(&row[from * 2..(from + count) * 2]);
+            *len += 1 + count * 2;
+            from += count;
+        }
+    };
+
+    while i < pixels {
+        let mut run = 1;
+        while i + run < pixels && run < MAX_RUN && pixel(i + run) == pixel(i) {
+            run += 1;
+        }
+        // A run of two costs the same as two literals; keep it literal
+        if run >= 3 {
+            flush_literals(out, &mut len, literal_start, i);
+            out[len] = 0x80 | (run - 1) as u8;
+            out[len + 1..len + 3].copy_from_slice(&pixel(i));
+            len += 3;
+            i += run;
+            literal_start = i;
+        } else {
+            i += run;
+        }
+    }
+    flush_literals(out, &mut len, literal_start, pixels);
+    len
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn decode_row(mut data: &[u8], pixels: usize) -> Vec<u8> {
+        let mut row = Vec::new();
+        while row.len() < pixels * 2 {
+            let tag = data[0] as usize;
+            if tag & 0x80 != 0 {
+                for _ in 0..(tag & 0x7F) + 1 {
+                    row.extend_from_slice(&data[1..3]);
+                }
+                data = &data[3..];
+            } else {
+                row.extend_from_slice(&data[1..1 + (tag + 1) * 2]);
+                data = &data[1 + (tag + 1) * 2..];
+            }
+        }
+        assert!(data.is_empty());
+        row
+    }
+
+    #[test]
+    fn test_row_encoding_round_trip() {
+        let mut out = [0u8; MAX_ROW_LEN];
+
+        // A flat background collapses to a few runs
+        let flat = [0x12u8, 0x34].repeat(FRAMEBUFFER_WIDTH as usize);
+        let len = encode_row(&flat, &mut out);
+        assert_eq!(len, 3 * 3);
+        assert_eq!(decode_row(&out[..len], FRAMEBUFFER_WIDTH as usize), flat);
+
+        // Noise stays within the worst-case bound
+        let noise: Vec<u8> = (0..FRAMEBUFFER_WIDTH as usize * 2).map(|i| (i * 37 % 251) as u8).collect();
+        let len = encode_row(&noise, &mut out);
+        assert!(len <= MAX_ROW_LEN);
+        assert_eq!(decode_row(&out[..len], FRAMEBUFFER_WIDTH as usize), noise);
+
+        // Mixed runs and literals, including runs of two
+        let mixed: Vec<u8> = [1u16, 2, 2, 3, 3, 3, 3, 4, 5, 5, 5]
+            .iter().flat_map(|p| p.to_be_bytes()).collect();
+        let len = encode_row(&mixed, &mut out);
+        assert_eq!(decode_row(&out[..len], 11), mixed);
+    }
+}
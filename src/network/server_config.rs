@@ -1,5 +1,37 @@
 use esp_idf_svc::http::server::Configuration;
 use esp_idf_sys as _;
+use core::sync::atomic::{AtomicPtr, AtomicU32, Ordering};
+
+/// Sockets lwIP hands out in total, as configured in sdkconfig
+const LWIP_MAX_SOCKETS: u16 = esp_idf_sys::CONFIG_LWIP_MAX_SOCKETS as u16;
+
+/// Held back for telnet, mDNS, SNTP and OTA downloads
+const RESERVED_SOCKETS: u16 = 4;
+
+/// Long-lived streams (SSE, binary metrics) draw on the same socket budget
+pub const MAX_STREAMING_SOCKETS: u16 = 3;
+
+/// Sockets kept for short requests, so /health and page loads get through
+/// while streams and idle keep-alive sessions hold the rest
+const MIN_REQUEST_SOCKETS: u16 = 2;
+
+/// Idle time before a kept-alive session is closed
+const KEEP_ALIVE_IDLE_SECS: u64 = 5;
+
+// Running server, null until register_server()
+static SERVER: AtomicPtr<core::ffi::c_void> = AtomicPtr::new(core::ptr::null_mut());
+
+// Streams holding a StreamSlot, whichever subsystem opened them
+static ACTIVE_STREAMS: AtomicU32 = AtomicU32::new(0);
+
+/// One of the MAX_STREAMING_SOCKETS stream slots; released on drop
+pub struct StreamSlot(());
+
+impl Drop for StreamSlot {
+    fn drop(&mut self) {
+        ACTIVE_STREAMS.fetch_sub(1, Ordering::Relaxed);
+    }
+}
 
 pub struct StableServerConfig;
 
@@ -16,8 +48,8 @@ impl StableServerConfig {
             max_open_sockets: Self::max_sockets() as usize,
             max_resp_headers: 12,
             lru_purge_enable: true,
-            // Shorten idle session timeout to free sockets faster
-            session_timeout: core::time::Duration::from_secs(5),
+            // Keep-alive sessions are cheap to reuse but hold a socket; close idle ones quickly
+            session_timeout: core::time::Duration::from_secs(KEEP_ALIVE_IDLE_SECS),
             ..Default::default()
         }
     }
@@ -26,7 +58,50 @@ impl StableServerConfig {
     pub const fn stack_size() -> usize { 24576 }
     
     /// Get max sockets configuration value  
-    pub const fn max_sockets() -> u16 { 12 }
+    pub const fn max_sockets() -> u16 { LWIP_MAX_SOCKETS - RESERVED_SOCKETS }
+
+    /// Remember the running server so responses can check the socket budget
+    pub fn register_server(handle: esp_idf_sys::httpd_handle_t) {
+        SERVER.store(handle, Ordering::Release);
+    }
+
+    /// Sessions currently open on the server, streams included
+    pub fn open_sessions() -> Option<u16> {
+        let server = SERVER.load(Ordering::Acquire);
+        if server.is_null() {
+            return None;
+        }
+        let mut fds = [0 as core::ffi::c_int; Self::max_sockets() as usize];
+        let mut count = fds.len();
+        let err = unsafe { esp_idf_sys::httpd_get_client_list(server, &mut count, fds.as_mut_ptr()) };
+        (err == esp_idf_sys::ESP_OK).then_some(count as u16)
+    }
+
+    /// `Connection` header for a response: keep-alive while enough sockets
+    /// stay free for other clients, close once the budget runs low
+    pub fn connection_header() -> (&'static str, &'static str) {
+        match Self::open_sessions() {
+            Some(open) if open + MIN_REQUEST_SOCKETS <= Self::max_sockets() => ("Connection", "keep-alive"),
+            _ => ("Connection", "close"),
+        }
+    }
+
+    /// Claim a stream slot for a long-lived response, if another stream fits
+    /// in the socket budget. SSE, binary metrics and the screen view all
+    /// draw on the same MAX_STREAMING_SOCKETS.
+    pub fn acquire_stream_slot() -> Option<StreamSlot> {
+        let open = Self::open_sessions().unwrap_or(0);
+        // `open` already counts the requesting session
+        if open + MIN_REQUEST_SOCKETS > Self::max_sockets() {
+            return None;
+        }
+        ACTIVE_STREAMS
+            .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |active| {
+                (active < MAX_STREAMING_SOCKETS as u32).then_some(active + 1)
+            })
+            .ok()?;
+        Some(StreamSlot(()))
+    }
 }
 
 /// HTTP request instrumentation for diagnostics
@@ -5,9 +5,17 @@ use std::sync::{Arc, Mutex};
 use std::time::{Duration, Instant};
 use esp_idf_hal::delay::FreeRtos;
 use log::{info, warn, error};
+use super::telemetry_hub::{self, Format, RecvError};
+use super::async_handler::{self, AsyncRequest, Dispatch};
+use super::server_config::{StableServerConfig, StreamSlot, MAX_STREAMING_SOCKETS};
+use crate::arena::SlotPool;
 
 // SSE configuration constants
-const MAX_SSE_CONNECTIONS: u32 = 1;  // Constrain to 1 to protect sockets/heap during logs viewing
+// Metrics streams share one encoded frame per tick and queue at most a few
+// per client, so each extra connection costs a socket and a small queue.
+// Every stream runs on its own thread, off the httpd task.
+const MAX_SSE_CONNECTIONS: u16 = MAX_STREAMING_SOCKETS;
+const STREAM_STACK_SIZE: usize = 8192; // serde_json event encoding
 const SSE_TIMEOUT_SECS: u64 = 300;   // 5 minutes
 const HEARTBEAT_INTERVAL_SECS: u64 = 30;
 const METRICS_UPDATE_INTERVAL_SECS: u64 = 1;
@@ -16,31 +24,26 @@ const METRICS_UPDATE_INTERVAL_SECS: u64 = 1;
 struct ConnectionInfo {
     id: u32,
     _start_time: Instant,
-    _endpoint: String,
+    _endpoint: &'static str,
+    // Socket budget held until the connection leaves the pool
+    _slot: StreamSlot,
 }
 
 pub struct SseManager {
-    connections: Arc<Mutex<Vec<ConnectionInfo>>>,
+    // Fixed slots: connection churn never touches the heap
+    connections: Arc<SlotPool<ConnectionInfo, { MAX_SSE_CONNECTIONS as usize }>>,
     next_id: Arc<Mutex<u32>>,
 }
 
 impl SseManager {
     pub fn new() -> Self {
         Self {
-            connections: Arc::new(Mutex::new(Vec::new())),
+            connections: Arc::new(SlotPool::new()),
             next_id: Arc::new(Mutex::new(1)),
         }
     }
 
-    fn add_connection(&self, endpoint: &str) -> Result<u32> {
-        let mut connections = self.connections.lock().map_err(|e| anyhow::anyhow!("connections lock poisoned: {}", e))?;
-        
-        // Check connection limit
-        if connections.len() >= MAX_SSE_CONNECTIONS as usize {
-            crate::diagnostics::log_sse_event("limit_reject", None);
-            return Err(anyhow::anyhow!("Connection limit reached"));
-        }
-        
+    fn add_connection(&self, endpoint: &'static str) -> Result<u32> {
         // Check heap before accepting connection
         let free_heap = unsafe { esp_idf_sys::esp_get_free_heap_size() };
         if free_heap < 80 * 1024 { // 80KB minimum
@@ -48,33 +51,33 @@ impl SseManager {
             return Err(anyhow::anyhow!("Insufficient heap memory"));
         }
         
-        let mut next_id = self.next_id.lock().map_err(|e| anyhow::anyhow!("next_id lock poisoned: {}", e))?;
-        let id = *next_id;
-        *next_id += 1;
+        let id = {
+            let mut next_id = self.next_id.lock().map_err(|e| anyhow::anyhow!("next_id lock poisoned: {}", e))?;
+            let id = *next_id;
+            *next_id += 1;
+            id
+        };
         
-        connections.push(ConnectionInfo {
-            id,
-            _start_time: Instant::now(),
-            _endpoint: endpoint.to_string(),
-        });
+        // Check connection limit, shared with the other streaming endpoints
+        let Some(slot) = StableServerConfig::acquire_stream_slot() else {
+            crate::diagnostics::log_sse_event("limit_reject", None);
+            return Err(anyhow::anyhow!("Connection limit reached"));
+        };
+        let info = ConnectionInfo { id, _start_time: Instant::now(), _endpoint: endpoint, _slot: slot };
+        if self.connections.insert(info).is_err() {
+            crate::diagnostics::log_sse_event("limit_reject", None);
+            return Err(anyhow::anyhow!("Connection limit reached"));
+        }
         
-        info!("SSE: Connection {} added to {} (total: {})", 
-              id, endpoint, connections.len());
+        info!("SSE: Connection {} added to /sse/{} (total: {})", 
+              id, endpoint, self.connections.len());
         crate::diagnostics::log_sse_event("connect", Some(id));
         Ok(id)
     }
 
     fn remove_connection(&self, id: u32) {
-        let remaining = match self.connections.lock() {
-            Ok(mut connections) => {
-                connections.retain(|c| c.id != id);
-                connections.len()
-            }
-            Err(e) => {
-                error!("SSE: connections lock poisoned during remove: {}", e);
-                0
-            }
-        };
+        self.connections.remove_where(|c| c.id == id);
+        let remaining = self.connections.len();
         info!("SSE: Connection {} removed (remaining: {})", id, remaining);
         crate::diagnostics::log_sse_event("disconnect", Some(id));
     }
@@ -96,6 +99,11 @@ impl SseManager {
         // Keep /api/events for backward compatibility
         self.register_events_endpoint(server)?;
         
+        // Binary packets on the same tick, for low-overhead clients
+        self.register_binary_stream_endpoint(server)?;
+        
+        telemetry_hub::start()?;
+        
         info!("SSE: All endpoints registered (max {} clients)", features.max_sse_clients);
         Ok(())
     }
@@ -103,11 +111,11 @@ impl SseManager {
     fn register_logs_endpoint(&self, server: &mut EspHttpServer<'static>) -> Result<()> {
         let manager = self.clone();
         
-        server.fn_handler("/sse/logs", Method::Get, move |req| {
+        async_handler::register(server, c"/sse/logs", Method::Get, Dispatch::Thread(STREAM_STACK_SIZE), move |req| {
             handle_sse_connection(req, &manager, "logs", |response, heartbeat_count| {
                 // Send only an initial recent batch once to avoid repeated bursts
                 if heartbeat_count == 0 {
-                    let streamer = crate::network::log_streamer::init(None);
+                    let streamer = crate::network::log_streamer::init();
                     let logs = streamer.get_recent_logs(20);
                     for entry in logs {
                         let event = format!(
@@ -134,7 +142,7 @@ impl SseManager {
     fn register_stats_endpoint(&self, server: &mut EspHttpServer<'static>) -> Result<()> {
         let manager = self.clone();
         
-        server.fn_handler("/sse/stats", Method::Get, move |req| {
+        async_handler::register(server, c"/sse/stats", Method::Get, Dispatch::Thread(STREAM_STACK_SIZE), move |req| {
             handle_sse_connection(req, &manager, "stats", |response, _heartbeat_count| {
                 // Send system stats
                 let heap_free = unsafe { esp_idf_sys::esp_get_free_heap_size() };
@@ -167,59 +175,25 @@ impl SseManager {
     fn register_events_endpoint(&self, server: &mut EspHttpServer<'static>) -> Result<()> {
         let manager = self.clone();
         
-        server.fn_handler("/api/events", Method::Get, move |req| {
-            handle_sse_connection(req, &manager, "events", |response, _heartbeat_count| {
-                // Send comprehensive metrics data for dashboard
-                if let Ok(metrics) = crate::metrics::metrics().try_lock() {
-                    // Get system info
-                    let uptime_ms = unsafe { esp_idf_sys::esp_timer_get_time() / 1000 };
-                    let heap_free = unsafe { esp_idf_sys::esp_get_free_heap_size() };
-                    let psram_free = unsafe { esp_idf_sys::heap_caps_get_free_size(esp_idf_sys::MALLOC_CAP_SPIRAM) };
-                    
-                    // Calculate heap fragmentation
-                    let largest_free = unsafe { esp_idf_sys::heap_caps_get_largest_free_block(esp_idf_sys::MALLOC_CAP_INTERNAL) };
-                    let fragmentation = if heap_free > 0 && largest_free > 0 {
-                        ((1.0 - (largest_free as f32 / heap_free as f32)) * 100.0) as u32
-                    } else {
-                        0
-                    };
-                    
-                    let event = format!(
-                        "data: {}\n\n",
-                        serde_json::json!({
-                            "type": "metrics",
-                            "uptime_ms": uptime_ms,
-                            "temperature": (metrics.temperature * 10.0).round() / 10.0,
-                            "fps_actual": (metrics.fps_actual * 10.0).round() / 10.0,
-                            "temperature_str": format!("{:.1}", (metrics.temperature * 10.0).round() / 10.0),
-                            "fps_actual_str": format!("{:.1}", (metrics.fps_actual * 10.0).round() / 10.0),
-                            "cpu_usage": metrics.cpu_usage,
-                            "cpu0_usage": metrics.cpu0_usage,
-                            "cpu1_usage": metrics.cpu1_usage,
-                            "cpu_freq_mhz": metrics.cpu_freq_mhz,
-                            "wifi_rssi": metrics.wifi_rssi,
-                            "wifi_connected": metrics.wifi_connected,
-                            "wifi_ssid": metrics.wifi_ssid.clone(),
-                            "battery_percentage": metrics.battery_percentage,
-                            "heap_free_kb": heap_free / 1024,
-                            "psram_free_kb": psram_free / 1024,
-                            "heap_fragmentation": fragmentation,
-                            "skip_rate": if metrics.frame_count > 0 {
-                                metrics.skip_count as f32 / metrics.frame_count as f32 * 100.0
-                            } else { 0.0 },
-                            "render_time_ms": metrics.render_time_ms,
-                            // Additional health/diagnostic fields
-                            "reset_reason": crate::system::reset::get_reset_reason(),
-                            "httpd_stack_low_water": crate::network::observability::http_snapshot().httpd_stack_low_water_bytes,
-                            // ip_address intentionally omitted here to avoid stale values
-                        })
-                    );
-                    
-                    if response.write_all(event.as_bytes()).is_err() {
-                        return Err(anyhow::anyhow!("Failed to write metrics event"));
-                    }
-                }
-                Ok(())
+        async_handler::register(server, c"/api/events", Method::Get, Dispatch::Thread(STREAM_STACK_SIZE), move |req| {
+            // Comprehensive metrics for the dashboard, encoded once per tick by the hub
+            handle_telemetry_connection(req, &manager, "events", Format::Json, |response, frame| {
+                safe_write(response, b"data: ")?;
+                safe_write(response, frame)?;
+                safe_write(response, b"\n\n")
+            })
+        })?;
+        
+        Ok(())
+    }
+
+    fn register_binary_stream_endpoint(&self, server: &mut EspHttpServer<'static>) -> Result<()> {
+        let manager = self.clone();
+        
+        async_handler::register(server, c"/api/metrics/binary/stream", Method::Get, Dispatch::Thread(STREAM_STACK_SIZE), move |req| {
+            // Back-to-back fixed-size MetricsBinaryPacket records
+            handle_telemetry_connection(req, &manager, "binary", Format::Binary, |response, frame| {
+                safe_write(response, frame)
             })
         })?;
         
@@ -238,21 +212,20 @@ impl Clone for SseManager {
 
 // Generic SSE connection handler
 fn handle_sse_connection<F>(
-    req: esp_idf_svc::http::server::Request<&mut esp_idf_svc::http::server::EspHttpConnection>,
+    req: &mut AsyncRequest,
     manager: &SseManager,
-    endpoint_name: &str,
+    endpoint_name: &'static str,
     mut data_sender: F,
-) -> Result<(), Box<dyn std::error::Error>>
+) -> Result<()>
 where
-    F: FnMut(&mut esp_idf_svc::http::server::Response<&mut esp_idf_svc::http::server::EspHttpConnection>, u32) -> Result<()>,
+    F: FnMut(&mut AsyncRequest, u32) -> Result<()>,
 {
     // Try to add connection
-    let conn_id = match manager.add_connection(&format!("/sse/{}", endpoint_name)) {
+    let conn_id = match manager.add_connection(endpoint_name) {
         Ok(id) => id,
         Err(e) => {
             warn!("SSE: Connection rejected: {}", e);
-            let mut response = req.into_status_response(503)?;
-            response.write_all(b"Service Unavailable: Connection limit reached")?;
+            req.send_status(503, "Service Unavailable: Connection limit reached")?;
             return Ok(());
         }
     };
@@ -269,7 +242,7 @@ where
         ("X-Accel-Buffering", "no"), // Disable proxy buffering
     ];
     
-    let mut response = req.into_response(200, Some("OK"), &headers)?;
+    req.start_response(200, &headers)?;
     
     // Send initial connection event with a soft timeout guard
     let init_event = format!(
@@ -277,8 +250,8 @@ where
         conn_id
     );
     // attempt initial write, if it fails, exit early
-    safe_write(&mut response, init_event.as_bytes())?;
-    response.flush()?;
+    safe_write(req, init_event.as_bytes())?;
+    req.flush()?;
     
     // Main event loop
     let start_time = Instant::now();
@@ -294,9 +267,9 @@ where
         
         // Send data updates every second
         if last_update.elapsed() >= Duration::from_secs(METRICS_UPDATE_INTERVAL_SECS) {
-            match data_sender(&mut response, heartbeat_count) {
+            match data_sender(req, heartbeat_count) {
                 Ok(_) => {
-                    if response.flush().is_err() {
+                    if req.flush().is_err() {
                         break;
                     }
                 }
@@ -312,10 +285,10 @@ where
         heartbeat_count += 1;
         if heartbeat_count >= HEARTBEAT_INTERVAL_SECS as u32 {
             heartbeat_count = 0;
-            if safe_write(&mut response, b":heartbeat\n\n").is_err() {
+            if safe_write(req, b":heartbeat\n\n").is_err() {
                 break;
             }
-            if response.flush().is_err() {
+            if req.flush().is_err() {
                 break;
             }
         }
@@ -327,9 +300,87 @@ where
     Ok(())
 }
 
+// Streaming handler fed by the telemetry hub instead of polling metrics
+fn handle_telemetry_connection<F>(
+    req: &mut AsyncRequest,
+    manager: &SseManager,
+    endpoint_name: &'static str,
+    format: Format,
+    mut write_frame: F,
+) -> Result<()>
+where
+    F: FnMut(&mut AsyncRequest, &[u8]) -> Result<()>,
+{
+    let conn_id = match manager.add_connection(endpoint_name) {
+        Ok(id) => id,
+        Err(e) => {
+            warn!("SSE: Connection rejected: {}", e);
+            req.send_status(503, "Service Unavailable: Connection limit reached")?;
+            return Ok(());
+        }
+    };
+    let _cleanup = ConnectionCleanup::new(manager.clone(), conn_id);
+    let subscription = telemetry_hub::subscribe(format);
+    
+    let content_type = match format {
+        Format::Json => "text/event-stream",
+        Format::Binary => "application/octet-stream",
+    };
+    let headers = [
+        ("Content-Type", content_type),
+        ("Cache-Control", "no-cache"),
+        ("Connection", "keep-alive"),
+        ("Access-Control-Allow-Origin", "*"),
+        ("X-Accel-Buffering", "no"), // Disable proxy buffering
+    ];
+    req.start_response(200, &headers)?;
+    
+    if format == Format::Json {
+        let init_event = format!(
+            "event: connected\ndata: {{\"connection_id\":{}}}\n\n",
+            conn_id
+        );
+        safe_write(req, init_event.as_bytes())?;
+        req.flush()?;
+    }
+    
+    let start_time = Instant::now();
+    while start_time.elapsed() <= Duration::from_secs(SSE_TIMEOUT_SECS) {
+        match subscription.recv_timeout(Duration::from_secs(HEARTBEAT_INTERVAL_SECS)) {
+            Ok(frame) => {
+                if let Err(e) = write_frame(req, &frame) {
+                    error!("SSE: Data send error: {}", e);
+                    break;
+                }
+                if req.flush().is_err() {
+                    break;
+                }
+            }
+            Err(RecvError::Timeout) => {
+                // Nothing published for a while; keep SSE proxies from timing out
+                if format == Format::Json
+                    && (safe_write(req, b":heartbeat\n\n").is_err() || req.flush().is_err())
+                {
+                    break;
+                }
+            }
+            Err(RecvError::Stalled) => {
+                warn!("SSE: Connection {} too slow, disconnecting", conn_id);
+                break;
+            }
+        }
+    }
+    
+    let dropped = subscription.dropped();
+    if dropped > 0 {
+        info!("SSE: Connection {} dropped {} frames", conn_id, dropped);
+    }
+    Ok(())
+}
+
 // Safe write wrapper with error handling
 fn safe_write(
-    response: &mut esp_idf_svc::http::server::Response<&mut esp_idf_svc::http::server::EspHttpConnection>,
+    response: &mut AsyncRequest,
     data: &[u8],
 ) -> Result<()> {
     match response.write_all(data) {
@@ -0,0 +1,98 @@
+// Pre-compressed static assets embedded at build time
+//
+// build.rs gzips every entry of its STATIC_ASSETS table and emits a table of
+// `include_bytes!` slices, so responses are written straight from flash: no
+// runtime compression and no heap buffers. Each representation carries a
+// strong content-hash ETag, letting browsers revalidate with a bodyless 304.
+
+use esp_idf_svc::http::server::{EspHttpConnection, Request};
+use esp_idf_svc::io::Write;
+use super::server_config::StableServerConfig;
+
+pub struct Asset {
+    pub path: &'static str,
+    pub content_type: &'static str,
+    pub cache_control: &'static str,
+    pub etag: &'static str,
+    pub gzip_etag: &'static str,
+    pub identity: &'static [u8],
+    /// None when gzip would not make the asset smaller
+    pub gzip: Option<&'static [u8]>,
+}
+
+include!(concat!(env!("OUT_DIR"), "/static_assets.rs"));
+
+pub fn lookup(path: &str) -> Option<&'static Asset> {
+    ASSETS.iter().find(|asset| asset.path == path)
+}
+
+/// Serve `asset`, honouring Accept-Encoding and If-None-Match
+pub fn serve(req: Request<&mut EspHttpConnection>, asset: &'static Asset) -> Result<(), Box<dyn std::error::Error>> {
+    let gzip = asset.gzip.filter(|_| req.header("Accept-Encoding").is_some_and(accepts_gzip));
+    let (etag, body) = match gzip {
+        Some(body) => (asset.gzip_etag, body),
+        None => (asset.etag, asset.identity),
+    };
+
+    if req.header("If-None-Match").is_some_and(|tags| etag_matches(tags, etag)) {
+        let mut response = req.into_response(304, Some("Not Modified"), &[
+            ("ETag", etag),
+            ("Cache-Control", asset.cache_control),
+            ("Vary", "Accept-Encoding"),
+            StableServerConfig::connection_header(),
+        ])?;
+        response.flush()?;
+        return Ok(());
+    }
+
+    let mut headers = heapless::Vec::<(&str, &str), 6>::new();
+    let _ = headers.push(("Content-Type", asset.content_type));
+    let _ = headers.push(("ETag", etag));
+    let _ = headers.push(("Cache-Control", asset.cache_control));
+    let _ = headers.push(("Vary", "Accept-Encoding"));
+    let _ = headers.push(StableServerConfig::connection_header());
+    if gzip.is_some() {
+        let _ = headers.push(("Content-Encoding", "gzip"));
+    }
+
+    let mut response = req.into_response(200, Some("OK"), &headers)?;
+    response.write_all(body)?;
+    Ok(())
+}
+
+/// Whether an Accept-Encoding header allows gzip (and doesn't set q=0)
+fn accepts_gzip(header: &str) -> bool {
+    header.split(',').any(|coding| {
+        let mut params = coding.split(';').map(str::trim);
+        let name = params.next().unwrap_or("");
+        let refused = params.any(|param| {
+            param.strip_prefix("q=").is_some_and(|q| q.parse::<f32>().map_or(false, |q| q == 0.0))
+        });
+        (name.eq_ignore_ascii_case("gzip") || name == "*") && !refused
+    })
+}
+
+/// Whether an If-None-Match list names `etag`, ignoring weak prefixes
+fn etag_matches(header: &str, etag: &str) -> bool {
+    header.split(',').map(str::trim).any(|tag| {
+        tag == "*" || tag.strip_prefix("W/").unwrap_or(tag) == etag
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_conditional_request_parsing() {
+        assert!(accepts_gzip("gzip, deflate, br"));
+        assert!(accepts_gzip("br;q=1.0, GZIP;q=0.5"));
+        assert!(!accepts_gzip("gzip;q=0, deflate"));
+        assert!(!accepts_gzip("identity"));
+
+        assert!(etag_matches("\"abc\"", "\"abc\""));
+        assert!(etag_matches("\"x\", W/\"abc-gz\"", "\"abc-gz\""));
+        assert!(etag_matches("*", "\"abc\""));
+        assert!(!etag_matches("\"abc\"", "\"abc-gz\""));
+    }
+}
@@ -13,7 +13,7 @@ pub fn handle_ota_streaming(req: Request<&mut EspHttpConnection>, has_ota_manage
         Some("OK"),
         &[
             ("Content-Type", "text/html; charset=utf-8"),
-            ("Connection", "close"),
+            crate::network::server_config::StableServerConfig::connection_header(),
             // Don't use compression for OTA page
         ]
     )?;
@@ -0,0 +1,296 @@
+// Shared telemetry fan-out for streaming endpoints
+//
+// One publisher thread encodes each metrics tick once per wire format and
+// hands the same refcounted buffer to every subscriber. Each subscriber owns a
+// small bounded queue: a client that falls behind loses its oldest frames, and
+// one that stops reading altogether is disconnected, so a slow consumer costs
+// a fixed amount of memory instead of a fresh copy per tick.
+
+use anyhow::Result;
+use std::collections::VecDeque;
+use std::sync::{Arc, Condvar, Mutex, MutexGuard, OnceLock};
+use std::thread::{self, Thread};
+use std::time::Duration;
+use log::{info, warn};
+use crate::metrics::MetricsData;
+use super::binary_protocol::MetricsBinaryPacket;
+
+/// One encoded tick, shared by every subscriber of its format
+pub type Frame = Arc<[u8]>;
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Format {
+    /// Dashboard metrics object, without SSE framing
+    Json,
+    /// MetricsBinaryPacket bytes
+    Binary,
+}
+
+const FORMAT_COUNT: usize = 2;
+
+/// Frames buffered per subscriber
+const QUEUE_DEPTH: usize = 4;
+
+/// Frames dropped in a row before a subscriber counts as stalled
+const MAX_CONSECUTIVE_DROPS: u32 = 8;
+
+/// Publish even without a tick notification, e.g. while the main loop is busy
+const TICK_TIMEOUT: Duration = Duration::from_secs(2);
+
+#[derive(Debug, PartialEq, Eq)]
+pub enum RecvError {
+    Timeout,
+    /// The subscriber fell too far behind and was dropped
+    Stalled,
+}
+
+struct Queue {
+    frames: VecDeque<Frame>,
+    consecutive_drops: u32,
+    dropped: u32,
+    stalled: bool,
+}
+
+struct Subscriber {
+    format: Format,
+    queue: Mutex<Queue>,
+    ready: Condvar,
+}
+
+impl Subscriber {
+    /// Queue a frame; returns true when this push marked the subscriber stalled
+    fn push(&self, frame: &Frame) -> bool {
+        let mut queue = lock(&self.queue);
+        if queue.stalled {
+            return false;
+        }
+        if queue.frames.len() >= QUEUE_DEPTH {
+            // Newer metrics supersede older ones, so drop from the front
+            queue.frames.pop_front();
+            queue.dropped += 1;
+            queue.consecutive_drops += 1;
+            if queue.consecutive_drops >= MAX_CONSECUTIVE_DROPS {
+                // Free the queued frames now; the reader sees Stalled next
+                queue.stalled = true;
+                queue.frames.clear();
+                self.ready.notify_one();
+                return true;
+            }
+        }
+        queue.frames.push_back(frame.clone());
+        self.ready.notify_one();
+        false
+    }
+}
+
+/// A client's view of the stream; unsubscribes on drop
+pub struct Subscription {
+    subscriber: Arc<Subscriber>,
+}
+
+impl Subscription {
+    /// Next frame in order, waiting up to `timeout` for one to be published
+    pub fn recv_timeout(&self, timeout: Duration) -> Result<Frame, RecvError> {
+        let queue = lock(&self.subscriber.queue);
+        let (mut queue, _) = self.subscriber.ready
+            .wait_timeout_while(queue, timeout, |queue| queue.frames.is_empty() && !queue.stalled)
+            .unwrap_or_else(|poisoned| poisoned.into_inner());
+
+        if queue.stalled {
+            return Err(RecvError::Stalled);
+        }
+        match queue.frames.pop_front() {
+            Some(frame) => {
+                queue.consecutive_drops = 0;
+                Ok(frame)
+            }
+            None => Err(RecvError::Timeout),
+        }
+    }
+
+    /// Frames this subscriber lost to the slow-consumer policy
+    pub fn dropped(&self) -> u32 {
+        lock(&self.subscriber.queue).dropped
+    }
+}
+
+impl Drop for Subscription {
+    fn drop(&mut self) {
+        if let Some(hub) = HUB.get() {
+            lock(&hub.subscribers).retain(|s| !Arc::ptr_eq(s, &self.subscriber));
+        }
+    }
+}
+
+struct TelemetryHub {
+    subscribers: Mutex<Vec<Arc<Subscriber>>>,
+    publisher: OnceLock<Thread>,
+}
+
+static HUB: OnceLock<TelemetryHub> = OnceLock::new();
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|poisoned| poisoned.into_inner())
+}
+
+fn hub() -> &'static TelemetryHub {
+    HUB.get_or_init(|| TelemetryHub {
+        subscribers: Mutex::new(Vec::new()),
+        publisher: OnceLock::new(),
+    })
+}
+
+/// Start the publisher thread; later calls are no-ops
+pub fn start() -> Result<()> {
+    let hub = hub();
+    if hub.publisher.get().is_some() {
+        return Ok(());
+    }
+
+    let handle = thread::Builder::new()
+        .name("telemetry".to_string())
+        .stack_size(8192) // serde_json encoding
+        .spawn(move || loop {
+            thread::park_timeout(TICK_TIMEOUT);
+            hub.publish(&crate::metrics::metrics().snapshot());
+        })?;
+    let _ = hub.publisher.set(handle.thread().clone());
+    info!("Telemetry: publisher started");
+    Ok(())
+}
+
+/// Signal that a new metrics snapshot was published
+pub fn notify_tick() {
+    if let Some(publisher) = HUB.get().and_then(|hub| hub.publisher.get()) {
+        publisher.unpark();
+    }
+}
+
+/// Subscribe to the stream in `format`
+pub fn subscribe(format: Format) -> Subscription {
+    let subscriber = Arc::new(Subscriber {
+        format,
+        queue: Mutex::new(Queue {
+            frames: VecDeque::with_capacity(QUEUE_DEPTH),
+            consecutive_drops: 0,
+            dropped: 0,
+            stalled: false,
+        }),
+        ready: Condvar::new(),
+    });
+    lock(&hub().subscribers).push(subscriber.clone());
+    Subscription { subscriber }
+}
+
+impl TelemetryHub {
+    fn publish(&self, metrics: &MetricsData) {
+        let subscribers = lock(&self.subscribers);
+        if subscribers.is_empty() {
+            return;
+        }
+
+        // Encode lazily: formats nobody subscribed to cost nothing
+        let mut frames: [Option<Frame>; FORMAT_COUNT] = [None, None];
+        for subscriber in subscribers.iter() {
+            let frame = frames[subscriber.format as usize]
+                .get_or_insert_with(|| encode(subscriber.format, metrics));
+            if subscriber.push(frame) {
+                warn!("Telemetry: {:?} subscriber stalled, dropping it", subscriber.format);
+            }
+        }
+    }
+}
+
+fn encode(format: Format, metrics: &MetricsData) -> Frame {
+    match format {
+        Format::Json => {
+            let json = dashboard_json(metrics);
+            serde_json::to_vec(&json).unwrap_or_default().into()
+        }
+        Format::Binary => MetricsBinaryPacket::from_metrics(metrics).to_bytes().into(),
+    }
+}
+
+/// Metrics object pushed to the dashboard each tick
+fn dashboard_json(metrics: &MetricsData) -> serde_json::Value {
+    // Get system info
+    let uptime_ms = unsafe { esp_idf_sys::esp_timer_get_time() / 1000 };
+    let heap_free = unsafe { esp_idf_sys::esp_get_free_heap_size() };
+    let psram_free = unsafe { esp_idf_sys::heap_caps_get_free_size(esp_idf_sys::MALLOC_CAP_SPIRAM) };
+
+    // Calculate heap fragmentation
+    let largest_free = unsafe { esp_idf_sys::heap_caps_get_largest_free_block(esp_idf_sys::MALLOC_CAP_INTERNAL) };
+    let fragmentation = if heap_free > 0 && largest_free > 0 {
+        ((1.0 - (largest_free as f32 / heap_free as f32)) * 100.0) as u32
+    } else {
+        0
+    };
+
+    serde_json::json!({
+        "type": "metrics",
+        "uptime_ms": uptime_ms,
+        "temperature": (metrics.temperature * 10.0).round() / 10.0,
+        "fps_actual": (metrics.fps_actual * 10.0).round() / 10.0,
+        "temperature_str": format!("{:.1}", (metrics.temperature * 10.0).round() / 10.0),
+        "fps_actual_str": format!("{:.1}", (metrics.fps_actual * 10.0).round() / 10.0),
+        "cpu_usage": metrics.cpu_usage,
+        "cpu0_usage": metrics.cpu0_usage,
+        "cpu1_usage": metrics.cpu1_usage,
+        "cpu_freq_mhz": metrics.cpu_freq_mhz,
+        "wifi_rssi": metrics.wifi_rssi,
+        "wifi_connected": metrics.wifi_connected,
+        "wifi_ssid": metrics.wifi_ssid(),
+        "battery_percentage": metrics.battery_percentage,
+        "heap_free_kb": heap_free / 1024,
+        "psram_free_kb": psram_free / 1024,
+        "heap_fragmentation": fragmentation,
+        "skip_rate": if metrics.frame_count > 0 {
+            metrics.skip_count as f32 / metrics.frame_count as f32 * 100.0
+        } else { 0.0 },
+        "render_time_ms": metrics.render_time_ms,
+        // Additional health/diagnostic fields
+        "reset_reason": crate::system::reset::get_reset_reason(),
+        "httpd_stack_low_water": crate::network::observability::httpd_stack_low_water_bytes(),
+        // ip_address intentionally omitted here to avoid stale values
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn subscriber() -> Subscription {
+        Subscription {
+            subscriber: Arc::new(Subscriber {
+                format: Format::Binary,
+                queue: Mutex::new(Queue {
+                    frames: VecDeque::new(),
+                    consecutive_drops: 0,
+                    dropped: 0,
+                    stalled: false,
+                }),
+                ready: Condvar::new(),
+            }),
+        }
+    }
+
+    #[test]
+    fn test_slow_consumer_policy() {
+        let subscription = subscriber();
+        let frames: Vec<Frame> = (0u8..6).map(|i| Frame::from(vec![i])).collect();
+        for frame in &frames {
+            subscription.subscriber.push(frame);
+        }
+
+        // The oldest frames were dropped, the rest arrive in order
+        assert_eq!(subscription.dropped(), 2);
+        assert_eq!(&*subscription.recv_timeout(Duration::ZERO).unwrap(), &[2]);
+        assert_eq!(subscription.recv_timeout(Duration::ZERO).map(|f| f[0]), Ok(3));
+
+        // A reader that never catches up is cut off
+        for _ in 0..MAX_CONSECUTIVE_DROPS + QUEUE_DEPTH as u32 {
+            subscription.subscriber.push(&frames[0]);
+        }
+        assert_eq!(subscription.recv_timeout(Duration::ZERO), Err(RecvError::Stalled));
+    }
+}
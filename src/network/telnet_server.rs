@@ -1,59 +1,35 @@
 use anyhow::Result;
+use std::fmt::Write as _;
 use std::io::Write;
 use std::net::{TcpListener, TcpStream};
 use std::sync::{Arc, Mutex};
 use std::thread;
 use std::time::Duration;
+use crate::log_ring::{self, LogLine};
+use crate::logging::{self, Uptime};
 
-/// Ring buffer for storing recent log messages
-pub(super) struct LogBuffer {
-    buffer: Vec<String>,
-    capacity: usize,
-    write_index: usize,
-}
+// Records formatted and sent per pass over the log ring
+const PUMP_BATCH: usize = 64;
+// Lines of history sent to a client when it connects
+const HISTORY_LINES: usize = 100;
 
-impl LogBuffer {
-    pub(super) fn new(capacity: usize) -> Self {
-        Self {
-            buffer: Vec::with_capacity(capacity),
-            capacity,
-            write_index: 0,
-        }
-    }
-    
-    pub(super) fn push(&mut self, message: String) {
-        if self.buffer.len() < self.capacity {
-            self.buffer.push(message);
-        } else {
-            self.buffer[self.write_index] = message;
-            self.write_index = (self.write_index + 1) % self.capacity;
-        }
-    }
-    
-    pub(super) fn get_all(&self) -> Vec<String> {
-        if self.buffer.len() < self.capacity {
-            self.buffer.clone()
-        } else {
-            // Return in correct order when buffer has wrapped
-            let mut result = Vec::with_capacity(self.capacity);
-            for i in 0..self.capacity {
-                let idx = (self.write_index + i) % self.capacity;
-                result.push(self.buffer[idx].clone());
-            }
-            result
-        }
-    }
-    
-    pub(super) fn get_recent(&self, count: usize) -> Vec<String> {
-        let all_logs = self.get_all();
-        let start = all_logs.len().saturating_sub(count);
-        all_logs[start..].to_vec()
-    }
+/// Render one ring record as a telnet line
+fn write_line(out: &mut String, line: &LogLine) {
+    let _ = write!(
+        out,
+        "{} [{:<5}] {:>12} | {}{}\r\n",
+        Uptime(line.timestamp_ms()),
+        line.level().as_str(),
+        logging::module_label(line.module()),
+        line.message(),
+        if line.truncated() { "…" } else { "" }
+    );
 }
 
 /// Telnet server for remote log streaming
 pub struct TelnetLogServer {
-    log_buffer: Arc<Mutex<LogBuffer>>,
+    // Ring sequence number of the next record to send to clients
+    cursor: Mutex<u32>,
     clients: Arc<Mutex<Vec<Arc<Mutex<TcpStream>>>>>,
     port: u16,
     shutdown_signal: Option<crate::system::ShutdownSignal>,
@@ -63,7 +39,7 @@ pub struct TelnetLogServer {
 impl TelnetLogServer {
     pub fn new(port: u16) -> Self {
         Self {
-            log_buffer: Arc::new(Mutex::new(LogBuffer::new(100))), // Keep last 100 messages
+            cursor: Mutex::new(log_ring::ring().head()),
             clients: Arc::new(Mutex::new(Vec::new())),
             port,
             shutdown_signal: None,
@@ -85,6 +61,7 @@ impl TelnetLogServer {
             .name("telnet-server".to_string())
             .stack_size(4096)
             .spawn(move || {
+                let _alloc_tag = crate::alloc_profiler::scope(crate::alloc_profiler::Tag::Logging);
                 if let Err(e) = server.run_server() {
                     log::error!("Telnet server error: {:?}", e);
                 }
@@ -129,13 +106,18 @@ impl TelnetLogServer {
                         let _ = writeln!(s, "\r\nConnected to device. Streaming live logs...\r\n");
                         let _ = writeln!(s, "TIP: Use monitor-telnet.py for filtering and commands\r\n");
                         
-                        // Send recent log history
-                        if let Ok(buffer) = self.log_buffer.lock() {
-                            let _ = writeln!(s, "--- Recent log history ---");
-                            for msg in buffer.get_all() {
-                                let _ = write!(s, "{msg}");
+                        // Send recent log history; everything newer is
+                        // left to the pump, so nothing is sent twice
+                        if let Ok(mut cursor) = self.cursor.lock() {
+                            self.pump_locked(&mut cursor);
+                            let history = log_ring::ring()
+                                .read(cursor.wrapping_sub(HISTORY_LINES as u32), HISTORY_LINES);
+                            let mut text = String::from("--- Recent log history ---\r\n");
+                            for line in history.lines.iter().take_while(|line| line.seq != *cursor) {
+                                write_line(&mut text, line);
                             }
-                            let _ = writeln!(s, "--- End of history ---\r\n");
+                            text.push_str("--- End of history ---\r\n\r\n");
+                            let _ = s.write_all(text.as_bytes());
                         }
                     }
                     
@@ -159,7 +141,8 @@ impl TelnetLogServer {
                     if e.kind() != std::io::ErrorKind::WouldBlock {
                         log::error!("Accept error: {:?}", e);
                     }
-                    thread::sleep(Duration::from_millis(100));
+                    self.pump();
+                    thread::sleep(Duration::from_millis(50));
                 }
             }
         }
@@ -201,34 +184,57 @@ impl TelnetLogServer {
         }
     }
     
-    /// Log a message to buffer and all connected clients
+    /// Log a message and push it to connected clients straight away, for
+    /// callers (like the panic hook) that cannot wait for the next pump
     pub fn log_message(&self, level: &str, message: &str) {
-        let timestamp = esp_idf_svc::systime::EspSystemTime.now().as_secs();
-        let formatted = format!("[{timestamp:10}] {level:5} {message}\r\n");
-        
-        // Add to buffer
-        if let Ok(mut buffer) = self.log_buffer.lock() {
-            buffer.push(formatted.clone());
+        let level = level.trim().parse().unwrap_or(log::Level::Info);
+        log_ring::ring().push(logging::uptime_ms(), level, Some(module_path!()), format_args!("{message}"));
+        // If the pump holds the cursor it will send this record itself
+        if let Ok(mut cursor) = self.cursor.try_lock() {
+            self.pump_locked(&mut cursor);
         }
-        
-        // Send to all connected clients
-        if let Ok(clients) = self.clients.lock() {
-            for client in clients.iter() {
-                if let Ok(mut stream) = client.lock() {
-                    let _ = stream.write_all(formatted.as_bytes());
-                    let _ = stream.flush();
-                }
-            }
+    }
+    
+    /// Send records logged since the last pass to every connected client
+    fn pump(&self) {
+        if let Ok(mut cursor) = self.cursor.lock() {
+            self.pump_locked(&mut cursor);
         }
     }
     
-    /// Get recent logs from the buffer
-    #[allow(dead_code)]
-    pub fn get_recent_logs(&self, count: usize) -> Vec<String> {
-        if let Ok(buffer) = self.log_buffer.lock() {
-            buffer.get_recent(count)
-        } else {
-            Vec::new()
+    fn pump_locked(&self, cursor: &mut u32) {
+        // Nobody to send to: skip ahead without formatting anything
+        if self.clients.lock().map_or(true, |clients| clients.is_empty()) {
+            *cursor = log_ring::ring().head();
+            return;
+        }
+        loop {
+            let read = log_ring::ring().read(*cursor, PUMP_BATCH);
+            *cursor = read.next;
+            if read.lines.is_empty() && read.missed == 0 {
+                return;
+            }
+            
+            let mut text = String::with_capacity(read.lines.len() * 96);
+            if read.missed > 0 {
+                let _ = write!(text, "--- {} log lines overwritten before they were sent ---\r\n", read.missed);
+            }
+            for line in &read.lines {
+                write_line(&mut text, line);
+            }
+            
+            if let Ok(clients) = self.clients.lock() {
+                for client in clients.iter() {
+                    if let Ok(mut stream) = client.lock() {
+                        let _ = stream.write_all(text.as_bytes());
+                        let _ = stream.flush();
+                    }
+                }
+            }
+            
+            if read.lines.len() < PUMP_BATCH {
+                return;
+            }
         }
     }
     
@@ -238,9 +244,7 @@ impl TelnetLogServer {
         let total_connections = self.total_connections.lock().map(|t| *t).unwrap_or(0);
         
         // Update metrics
-        if let Ok(mut metrics) = crate::metrics::metrics().lock() {
-            metrics.update_telnet_connections(active_clients, total_connections);
-        }
+        crate::metrics::metrics().update_telnet_connections(active_clients, total_connections);
     }
 }
 
@@ -1,54 +1,154 @@
-/// Simple template engine for ESP32 with minimal memory usage
-use std::collections::HashMap;
-
-/// Basic template engine that supports variable substitution
-pub struct TemplateEngine;
-
-impl TemplateEngine {
-    /// Render a template with variables
-    /// Variables are in the format {{variable_name}}
-    pub fn render(template: &str, vars: &HashMap<&str, String>) -> String {
-        let mut result = String::from(template);
-        
-        for (key, value) in vars {
-            let placeholder = format!("{{{{{}}}}}", key);
-            result = result.replace(&placeholder, value);
+/// Streaming template renderer for ESP32 with a fixed memory footprint
+///
+/// build.rs parses each template (see COMPILED_TEMPLATES there) into literal
+/// text and `{{variable}}` segments, with `{{>partial}}` includes already
+/// inlined. Rendering walks the segments and writes straight to the response:
+/// literals come from flash, variables are formatted by a callback, and small
+/// pieces are coalesced in one stack buffer so the page never exists in heap.
+use core::fmt;
+use esp_idf_svc::io::Write;
+
+/// Bytes coalesced before a chunk goes out; larger literals bypass the buffer
+pub const CHUNK_SIZE: usize = 512;
+
+pub enum Segment {
+    Text(&'static str),
+    Var(&'static str),
+}
+
+pub struct Template {
+    pub segments: &'static [Segment],
+}
+
+include!(concat!(env!("OUT_DIR"), "/templates.rs"));
+
+impl Template {
+    /// Render into `out`, calling `var` for each placeholder. Placeholders the
+    /// callback writes nothing for (e.g. inactive navbar flags) render empty.
+    pub fn render<W, F>(&self, out: &mut W, mut var: F) -> Result<(), W::Error>
+    where
+        W: Write,
+        F: FnMut(&mut ChunkWriter<'_, W>, &str) -> fmt::Result,
+    {
+        let mut writer = ChunkWriter::new(out);
+        for segment in self.segments {
+            match segment {
+                Segment::Text(text) => writer.write_bytes(text.as_bytes())?,
+                Segment::Var(name) => {
+                    if var(&mut writer, name).is_err() {
+                        writer.take_error()?;
+                    }
+                }
+            }
+        }
+        writer.flush()
+    }
+}
+
+/// Buffers small writes into CHUNK_SIZE chunks on the stack
+pub struct ChunkWriter<'a, W: Write> {
+    inner: &'a mut W,
+    buf: [u8; CHUNK_SIZE],
+    len: usize,
+    // I/O error hidden behind fmt::Error while a variable was being formatted
+    error: Option<W::Error>,
+}
+
+impl<'a, W: Write> ChunkWriter<'a, W> {
+    fn new(inner: &'a mut W) -> Self {
+        Self { inner, buf: [0; CHUNK_SIZE], len: 0, error: None }
+    }
+
+    fn write_bytes(&mut self, bytes: &[u8]) -> Result<(), W::Error> {
+        if self.len + bytes.len() > CHUNK_SIZE {
+            self.flush()?;
+        }
+        if bytes.len() >= CHUNK_SIZE {
+            return self.inner.write_all(bytes);
+        }
+        self.buf[self.len..self.len + bytes.len()].copy_from_slice(bytes);
+        self.len += bytes.len();
+        Ok(())
+    }
+
+    fn flush(&mut self) -> Result<(), W::Error> {
+        if self.len > 0 {
+            let len = core::mem::take(&mut self.len);
+            self.inner.write_all(&self.buf[..len])?;
+        }
+        Ok(())
+    }
+
+    fn take_error(&mut self) -> Result<(), W::Error> {
+        match self.error.take() {
+            Some(error) => Err(error),
+            None => Ok(()), // A formatting error from the callback itself; skip the value
         }
-        
-        result
-    }
-    
-    /// Render with partials support (include other templates)
-    /// Partials are in the format {{>partial_name}}
-    pub fn render_with_partials(
-        template: &str, 
-        vars: &HashMap<&str, String>,
-        partials: &HashMap<&str, &str>
-    ) -> String {
-        let mut result = String::from(template);
-        
-        // First process partials
-        for (name, content) in partials {
-            let placeholder = format!("{{{{>{}}}}}", name);
-            result = result.replace(&placeholder, content);
+    }
+}
+
+impl<W: Write> fmt::Write for ChunkWriter<'_, W> {
+    fn write_str(&mut self, s: &str) -> fmt::Result {
+        self.write_bytes(s.as_bytes()).map_err(|error| {
+            self.error = Some(error);
+            fmt::Error
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use esp_idf_svc::io::ErrorType;
+
+    /// Records each write the renderer makes as one chunk
+    #[derive(Default)]
+    struct ChunkSink {
+        chunks: Vec<Vec<u8>>,
+    }
+
+    impl ErrorType for ChunkSink {
+        type Error = core::convert::Infallible;
+    }
+
+    impl Write for ChunkSink {
+        fn write(&mut self, buf: &[u8]) -> Result<usize, Self::Error> {
+            self.chunks.push(buf.to_vec());
+            Ok(buf.len())
         }
-        
-        // Then process variables
-        Self::render(&result, vars)
-    }
-
-    /// Render with partials and additional string flags (e.g., active navbar classes)
-    pub fn render_with_partials_and_flags(
-        template: &str,
-        vars: &HashMap<&str, String>,
-        partials: &HashMap<&str, &str>,
-        flags: &HashMap<&str, &str>
-    ) -> String {
-        let mut result = Self::render_with_partials(template, vars, partials);
-        for (key, value) in flags {
-            let placeholder = format!("{{{{{}}}}}", key);
-            result = result.replace(&placeholder, value);
+
+        fn flush(&mut self) -> Result<(), Self::Error> {
+            Ok(())
         }
-        result
     }
-}
\ No newline at end of file
+
+    #[test]
+    fn test_writes_crossing_the_chunk_buffer_flush_in_order() {
+        let head: &'static str = "a".repeat(CHUNK_SIZE - 12).leak();
+        let body: &'static str = "b".repeat(CHUNK_SIZE + 88).leak();
+        let segments: &'static [Segment] = vec![
+            Segment::Text(head),
+            Segment::Var("fill"),
+            Segment::Var("value"),
+            Segment::Text(body),
+            Segment::Var("missing"),
+            Segment::Text("tail"),
+        ].leak();
+        let template = Template { segments };
+
+        let mut sink = ChunkSink::default();
+        template.render(&mut sink, |out, name| match name {
+            // Exactly fills the buffer behind the head
+            "fill" => fmt::Write::write_str(out, "ffffffffffff"),
+            // No longer fits, so the full buffer goes out first
+            "value" => fmt::Write::write_str(out, "vvvvvvvvvvvvvvvvvvvv"),
+            _ => Ok(()),
+        }).unwrap();
+
+        // The oversized literal bypasses the buffer after flushing what it holds
+        let lengths: Vec<usize> = sink.chunks.iter().map(Vec::len).collect();
+        assert_eq!(lengths, [CHUNK_SIZE, 20, CHUNK_SIZE + 88, 4]);
+        let page = sink.chunks.concat();
+        assert_eq!(page, format!("{head}ffffffffffff{}{body}tail", "v".repeat(20)).into_bytes());
+    }
+}
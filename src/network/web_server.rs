@@ -1,4 +1,5 @@
 use anyhow::Result;
+use esp_idf_svc::handle::RawHandle;
 use esp_idf_svc::http::server::EspHttpServer;
 use esp_idf_svc::io::Write;
 use std::sync::{Arc, Mutex};
@@ -6,18 +7,33 @@ use std::sync::atomic::{AtomicBool, Ordering};
 use esp_idf_hal::delay::FreeRtos;
 use crate::config::Config;
 use crate::ota::OtaManager;
+use crate::ota::decoder::Encoding as OtaEncoding;
 use crate::ota::manager::ensure_ota_boot_if_needed;
-use crate::metrics_formatter::MetricsFormatter;
+use crate::metrics_formatter::{Exposition, MetricsEncoder};
 // use crate::network::compression::write_compressed_response;
-use crate::network::binary_protocol::MetricsBinaryPacket;
+use crate::network::binary_protocol::{self, MetricsBinaryPacket};
 use crate::network::error_wrapper::error_response;
 use crate::network::error_handler::ErrorResponse;
+use crate::network::observability::ProfiledHandlers;
+use crate::network::async_handler::{self, Dispatch};
+use crate::network::server_config::StableServerConfig;
+use crate::dual_core::WorkItem;
 
 // Global flag to prevent heavy operations during OTA
 static OTA_IN_PROGRESS: AtomicBool = AtomicBool::new(false);
 
+/// Whether an OTA upload is being received
+pub fn ota_in_progress() -> bool {
+    OTA_IN_PROGRESS.load(Ordering::Acquire)
+}
+
 pub struct WebConfigServer {
-    _server: EspHttpServer<'static>,
+    server: EspHttpServer<'static>,
+    // Kept for the routes registered after boot, see register_deferred_routes
+    config: Arc<Mutex<Config>>,
+    metrics: Arc<crate::metrics::MetricsWrapper>,
+    sensor_history: Option<Arc<crate::sensors::history::SensorHistory>>,
+    deferred_registered: bool,
 }
 
 // Legacy struct removed; using WebConfigUpdate per-handler for clarity
@@ -39,7 +55,7 @@ impl WebConfigServer {
         config: Arc<Mutex<Config>>, 
         ota_manager: Option<Arc<Mutex<OtaManager>>>,
         metrics: Arc<crate::metrics::MetricsWrapper>,
-        sensor_history: Option<Arc<Mutex<crate::sensors::history::SensorHistory>>>
+        sensor_history: Option<Arc<crate::sensors::history::SensorHistory>>
     ) -> Result<Self> {
         // Check if we're recovering from OTA
         let reset_reason = unsafe { esp_idf_sys::esp_reset_reason() };
@@ -55,6 +71,7 @@ impl WebConfigServer {
         // Use optimized configuration to prevent socket exhaustion
         let server_config = crate::network::http_config::create_http_config();
         let mut server = EspHttpServer::new(&server_config)?;
+        StableServerConfig::register_server(server.handle());
 
         // Record initial HTTPD stack low-watermark (remaining bytes)
         unsafe {
@@ -64,16 +81,11 @@ impl WebConfigServer {
         // Reduce accept backlog issues by setting keep-alive where possible is handled per handler
         
         // Home page (templated, fast and memory-safe)
-        server.fn_handler("/", esp_idf_svc::http::Method::Get, |req| {
+        server.profiled_handler("/", esp_idf_svc::http::Method::Get, |req| {
             let instr = crate::network::server_config::RequestInstrumentation::capture(None);
             let result = crate::network::templated_home::handle_home_templated(req);
             let status = if result.is_ok() { 200 } else { 500 };
             instr.log_completion("/", status);
-            // Record stack watermark periodically per request
-            unsafe {
-                let watermark = esp_idf_sys::uxTaskGetStackHighWaterMark(std::ptr::null_mut());
-                crate::network::observability::record_httpd_stack_low_water(watermark);
-            }
             result
         })?;
         
@@ -82,7 +94,7 @@ impl WebConfigServer {
         // New streaming handler above prevents this issue
         
         /*  Old handler for reference:
-        server.fn_handler("/legacy", esp_idf_svc::http::Method::Get, move |req| {
+        server.profiled_handler("/legacy", esp_idf_svc::http::Method::Get, move |req| {
             // Log memory state before handling request
             crate::memory_diagnostics::log_memory_state("Home page - start");
             
@@ -134,12 +146,12 @@ impl WebConfigServer {
         // Self-heal: ensure device is running from an OTA slot (reboots if factory)
         if ensure_ota_boot_if_needed() {
             // If self-heal triggered, this process will restart; return okay here
-            return Ok(Self { _server: server });
+            return Ok(Self { server, config, metrics, sensor_history, deferred_registered: true });
         }
 
         // Get current configuration
         let config_clone2 = config.clone();
-        server.fn_handler("/api/config", esp_idf_svc::http::Method::Get, move |req| {
+        server.profiled_handler("/api/config", esp_idf_svc::http::Method::Get, move |req| {
             let config = match config_clone2.lock() {
                 Ok(cfg) => cfg,
                 Err(e) => {
@@ -147,7 +159,7 @@ impl WebConfigServer {
                     return ErrorResponse::bad_request("Configuration lock failed").send(req);
                 }
             };
-            let json = serde_json::to_string(&*config)?;
+            let json = crate::arena::to_json(&*config)?;
             
             let mut response = req.into_response(
                 200,
@@ -160,7 +172,7 @@ impl WebConfigServer {
 
     // Update configuration (accepts partial updates via WebConfigUpdate)
     let config_clone3 = config.clone();
-    server.fn_handler("/api/config", esp_idf_svc::http::Method::Post, move |mut req| {
+    server.profiled_handler("/api/config", esp_idf_svc::http::Method::Post, move |mut req| {
             // Cap config payload size to 1KB
             let mut buf = vec![0; 1024];
             let len = req.read(&mut buf)?;
@@ -232,7 +244,7 @@ impl WebConfigServer {
 
         // System info endpoint
         let config_clone_system = config.clone();
-        server.fn_handler("/api/system", esp_idf_svc::http::Method::Get, move |req| {
+        server.profiled_handler("/api/system", esp_idf_svc::http::Method::Get, move |req| {
             let instr = crate::network::server_config::RequestInstrumentation::capture(None);
             // Get SSID from config
             let ssid = match config_clone_system.lock() {
@@ -269,7 +281,7 @@ impl WebConfigServer {
                 } else { None }
             };
 
-            let json = serde_json::json!({
+            let json = crate::arena::to_json(&serde_json::json!({
                 "version": crate::version::DISPLAY_VERSION,
                 "ssid": ssid,
                 "free_heap": unsafe { esp_idf_sys::esp_get_free_heap_size() },
@@ -283,7 +295,7 @@ impl WebConfigServer {
                     "running_partition": running_label,
                     "available": ota_available
                 }
-            }).to_string();
+            }))?;
             let mut response = req.into_response(
                 200,
                 Some("OK"),
@@ -296,9 +308,7 @@ impl WebConfigServer {
 
         // Health check endpoint - simple and lightweight
         let metrics_health = metrics.clone();
-        server.fn_handler("/health", esp_idf_svc::http::Method::Get, move |req| {
-            // Observability begin
-            let _obs_start = crate::network::observability::begin_request();
+        server.profiled_handler("/health", esp_idf_svc::http::Method::Get, move |req| {
             // Keep /health minimal and fast: avoid extra logging/work
             
             let uptime = unsafe { esp_idf_sys::esp_timer_get_time() / 1_000_000 } as u64;
@@ -316,16 +326,11 @@ impl WebConfigServer {
                 issues.push("low_memory");
             }
             
-            // Keep health computation minimal; skip metrics lock to avoid contention
-            
             // Simple JSON response
-            // Best-effort WiFi RSSI from metrics (non-blocking)
-            let mut wifi_rssi: Option<i32> = None;
-            if let Ok(m) = metrics_health.try_lock() {
-                wifi_rssi = Some(m.wifi_rssi as i32);
-            }
+            // WiFi RSSI from the published metrics snapshot (non-blocking)
+            let wifi_rssi: Option<i32> = Some(metrics_health.snapshot().wifi_rssi as i32);
             let wifi_stats = crate::network::wifi_stats::snapshot();
-            let health_json = serde_json::json!({
+            let health_json = crate::arena::to_json(&serde_json::json!({
                 "status": status,
                 "uptime_seconds": uptime,
                 "free_heap": heap,
@@ -336,57 +341,46 @@ impl WebConfigServer {
                 "wifi_rssi": wifi_rssi,
                 "wifi": wifi_stats,
                 "boot_id": crate::network::observability::boot_id(),
-            }).to_string();
+                "boot": crate::boot_diagnostics::timeline(),
+            }))?;
             
             let mut response = req.into_response(
                 200,
                 Some("OK"),
-                &[("Content-Type", "application/json"), ("Connection", "close")]
+                &[("Content-Type", "application/json"), StableServerConfig::connection_header()]
             )?;
             response.write_all(health_json.as_bytes())?;
-            // Observability end
-            crate::network::observability::end_request(_obs_start, crate::network::observability::Endpoint::Health, 200);
-            unsafe {
-                let watermark = esp_idf_sys::uxTaskGetStackHighWaterMark(std::ptr::null_mut());
-                crate::network::observability::record_httpd_stack_low_water(watermark);
-            }
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
         // Ultra-light ping endpoint (keep-alive friendly)
-        server.fn_handler("/ping", esp_idf_svc::http::Method::Get, move |req| {
-            let _obs_start = crate::network::observability::begin_request();
+        server.profiled_handler("/ping", esp_idf_svc::http::Method::Get, move |req| {
             let mut response = req.into_response(
                 200,
                 Some("OK"),
-                &[("Content-Type", "text/plain"), ("Connection", "close")]
+                &[("Content-Type", "text/plain"), StableServerConfig::connection_header()]
             )?;
             response.write_all(b"OK")?;
-            crate::network::observability::end_request(_obs_start, crate::network::observability::Endpoint::Ping, 200);
-            unsafe {
-                let watermark = esp_idf_sys::uxTaskGetStackHighWaterMark(std::ptr::null_mut());
-                crate::network::observability::record_httpd_stack_low_water(watermark);
-            }
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
         // Debug observability snapshots (on-demand JSON)
-        server.fn_handler("/debug/stats", esp_idf_svc::http::Method::Get, move |req| {
-            let json = serde_json::to_string(&crate::network::observability::http_snapshot())?;
-            let mut response = req.into_response(200, Some("OK"), &[("Content-Type", "application/json"), ("Connection", "close")])?;
+        server.profiled_handler("/debug/stats", esp_idf_svc::http::Method::Get, move |req| {
+            let json = crate::arena::to_json(&crate::network::observability::http_snapshot())?;
+            let mut response = req.into_response(200, Some("OK"), &[("Content-Type", "application/json"), StableServerConfig::connection_header()])?;
             response.write_all(json.as_bytes())?;
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
-        server.fn_handler("/debug/events", esp_idf_svc::http::Method::Get, move |req| {
-            let json = serde_json::to_string(&crate::network::observability::events_snapshot())?;
-            let mut response = req.into_response(200, Some("OK"), &[("Content-Type", "application/json"), ("Connection", "close")])?;
+        server.profiled_handler("/debug/events", esp_idf_svc::http::Method::Get, move |req| {
+            let json = crate::arena::to_json(&crate::network::observability::events_snapshot())?;
+            let mut response = req.into_response(200, Some("OK"), &[("Content-Type", "application/json"), StableServerConfig::connection_header()])?;
             response.write_all(json.as_bytes())?;
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
         // Restart endpoint for remote device management - protected
-        server.fn_handler("/restart", esp_idf_svc::http::Method::Post, move |req| {
+        server.profiled_handler("/restart", esp_idf_svc::http::Method::Post, move |req| {
             // Check for authentication header
             const RESTART_TOKEN: &str = "esp32-restart";
             let auth_header = req.header("X-Restart-Token").unwrap_or("");
@@ -410,12 +404,15 @@ impl WebConfigServer {
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
-        // Prometheus metrics endpoint - optimized with formatter
-        server.fn_handler("/metrics", esp_idf_svc::http::Method::Get, move |req| {
+        // Prometheus metrics endpoint - encoded on the executor so a slow
+        // scrape doesn't hold up the httpd task, and streamed straight into
+        // the chunked response so it needs no heap however large it gets
+        async_handler::register(&mut server, c"/metrics", esp_idf_svc::http::Method::Get,
+                                Dispatch::Executor(WorkItem::ProcessNetwork), move |req| {
             let instr = crate::network::server_config::RequestInstrumentation::capture(None);
             // Check if OTA is in progress
             if OTA_IN_PROGRESS.load(Ordering::Acquire) {
-                let _ = error_response(req, 503, "Service temporarily unavailable - OTA in progress");
+                req.send_status(503, "Service temporarily unavailable - OTA in progress")?;
                 instr.log_completion("/metrics", 503);
                 return Ok(());
             }
@@ -430,63 +427,52 @@ impl WebConfigServer {
             let board_type = "ESP32-S3";
             let chip_model = "T-Display-S3";
             
-            // Try to get metrics data with timeout
-            let metrics_result = crate::metrics::metrics().try_lock();
-            
-            let formatted_metrics = match metrics_result {
-                Ok(metrics_guard) => {
-                    // Create formatter and format metrics
-                    let mut formatter = MetricsFormatter::new();
-                    formatter.format_metrics(
-                        &*metrics_guard,
-                        version,
-                        board_type,
-                        chip_model,
-                        uptime_seconds,
-                        heap_free,
-                        heap_total,
-                    )
-                },
-                Err(_) => {
-                    // If we can't get metrics, return partial data
-                    log::warn!("Metrics lock contended, returning partial data");
-                    Ok(format!(
-                        "# HELP esp32_device_info Device information\n\
-                        # TYPE esp32_device_info gauge\n\
-                        esp32_device_info{{version=\"{}\",board=\"{}\",model=\"{}\"}} 1\n\n\
-                        # HELP esp32_uptime_seconds Total uptime in seconds\n\
-                        # TYPE esp32_uptime_seconds counter\n\
-                        esp32_uptime_seconds {}\n\n\
-                        # HELP esp32_heap_free_bytes Current free heap memory in bytes\n\
-                        # TYPE esp32_heap_free_bytes gauge\n\
-                        esp32_heap_free_bytes {}\n\n\
-                        # HELP esp32_metrics_unavailable Metrics temporarily unavailable\n\
-                        # TYPE esp32_metrics_unavailable gauge\n\
-                        esp32_metrics_unavailable 1\n",
-                        version, board_type, chip_model, uptime_seconds, heap_free
-                    ))
-                }
+            // OpenMetrics when the scraper asks for it (or ?format=openmetrics)
+            let format = match req.query_param("format") {
+                Some("openmetrics") => Exposition::OpenMetrics,
+                _ => Exposition::negotiate(req.header("Accept").as_deref()),
             };
             
-            let result = match formatted_metrics {
-                Ok(metrics) => {
-                    let mut response = req.into_response(
-                        200,
-                        Some("OK"),
-                        &[("Content-Type", "text/plain; version=0.0.4")]
-                    )?;
-                    response.write_all(metrics.as_bytes())?;
-                    Ok(())
-                },
-                Err(e) => {
-                    log::error!("Failed to format metrics: {}", e);
-                    error_response(req, 500, "Internal Server Error")
-                }
-            };
+            // Encode the snapshot published on the last metrics tick
+            let metrics_snapshot = crate::metrics::metrics().snapshot();
+            let routes = crate::network::observability::route_snapshots();
+            let allocations = crate::alloc_profiler::snapshot();
+            req.start_response(200, &[("Content-Type", format.content_type()), StableServerConfig::connection_header()])?;
+            let encoded = MetricsEncoder::new(format, |chunk: &[u8]| req.write_all(chunk)).encode(
+                &metrics_snapshot,
+                version,
+                board_type,
+                chip_model,
+                uptime_seconds,
+                heap_free,
+                heap_total,
+                &routes,
+                allocations.as_ref(),
+            );
+            
+            // Headers are gone by now; a failed write means the scraper hung up
+            if let Err(e) = encoded {
+                log::warn!("Metrics scrape aborted: {:?}", e);
+            }
+            instr.log_completion("/metrics", 200);
+            Ok(())
+        })?;
 
-            let status = if result.is_ok() { 200 } else { 500 };
-            instr.log_completion("/metrics", status);
-            result
+        // Span rings as Chrome trace JSON (default) or OTLP/JSON; ?detail=1|0
+        // switches fill_rect/write_pixels spans on or off before the dump
+        async_handler::register(&mut server, c"/debug/trace", esp_idf_svc::http::Method::Get,
+                                Dispatch::Executor(WorkItem::ProcessNetwork), move |req| {
+            match req.query_param("detail") {
+                Some("1") => crate::trace::set_detail(true),
+                Some("0") => crate::trace::set_detail(false),
+                _ => {}
+            }
+            let format = crate::trace::TraceFormat::from_query(req.query_param("format"));
+            req.start_response(200, &[("Content-Type", "application/json"), StableServerConfig::connection_header()])?;
+            if let Err(e) = crate::trace::export(format, |chunk: &[u8]| req.write_all(chunk)) {
+                log::warn!("Trace dump aborted: {:?}", e);
+            }
+            Ok(())
         })?;
 
         // Always add OTA endpoints (they'll show error if OTA not available)
@@ -495,7 +481,7 @@ impl WebConfigServer {
             let ota_mgr_clone = ota_manager.clone();
             
             // OTA web interface with streaming
-            server.fn_handler("/ota", esp_idf_svc::http::Method::Get, move |req| {
+            server.profiled_handler("/ota", esp_idf_svc::http::Method::Get, move |req| {
                 log::info!("OTA page requested");
                 
                 // Use streaming handler to avoid large allocations
@@ -509,7 +495,7 @@ impl WebConfigServer {
             
             // OTA update endpoint
             let ota_manager_clone2 = ota_manager.clone();
-            server.fn_handler("/ota/update", esp_idf_svc::http::Method::Post, move |mut req| {
+            server.profiled_handler("/ota/update", esp_idf_svc::http::Method::Post, move |mut req| {
                 // Basic password protection for OTA
                 const OTA_PASSWORD: &str = "esp32"; // Change this to your preferred password
                 
@@ -533,7 +519,26 @@ impl WebConfigServer {
                 // Get optional SHA256 header
                 let sha256_header = req.header("X-SHA256").map(|s| s.to_string());
                 
-                log::info!("OTA Update started, size: {} bytes", content_length);
+                // Compressed and delta uploads (scripts/ota-pack.py) carry the decoded size
+                let Some(encoding) = OtaEncoding::parse(req.header("X-OTA-Encoding").unwrap_or("")) else {
+                    return error_response(req, 415, "Unsupported X-OTA-Encoding (identity, deflate or delta)");
+                };
+                let image_size = match encoding {
+                    OtaEncoding::Identity => content_length,
+                    _ => req
+                        .header("X-OTA-Image-Size")
+                        .and_then(|v| v.parse::<usize>().ok())
+                        .ok_or_else(|| anyhow::anyhow!("Missing X-OTA-Image-Size"))?,
+                };
+                if encoding == OtaEncoding::Delta {
+                    let base = req.header("X-OTA-Base-SHA256").unwrap_or("");
+                    if !crate::ota::manager::running_image_sha256().is_some_and(|running| running.eq_ignore_ascii_case(base)) {
+                        log::warn!("OTA delta rejected - built against {}", base);
+                        return error_response(req, 409, "Delta base does not match the running image");
+                    }
+                }
+                
+                log::info!("OTA Update started, size: {} bytes ({:?}, {} bytes decoded)", content_length, encoding, image_size);
                 if let Some(ref sha) = sha256_header {
                     log::info!("OTA Expected SHA256: {}", sha);
                 }
@@ -557,39 +562,24 @@ impl WebConfigServer {
                         ota.set_expected_sha256(sha);
                     }
                     
+                    ota.set_encoding(encoding);
+                    
                     // Begin OTA update
-                    if let Err(e) = ota.begin_update(content_length) {
+                    if let Err(e) = ota.begin_update(image_size) {
                         log::error!("OTA begin_update failed: {:?}", e);
                         Err(anyhow::anyhow!("Failed to begin OTA: {:?}", e))
                     } else {
-                        // Read and write firmware in chunks
-                        let mut buffer = [0u8; 4096];  // Stack allocated to reduce heap pressure
-                        let mut total_read = 0;
-                        let mut write_error = None;
-                        
-                        loop {
-                            match req.read(&mut buffer) {
-                                Ok(0) => break, // EOF
-                                Ok(bytes_read) => {
-                                    if let Err(e) = ota.write_chunk(&buffer[..bytes_read]) {
-                                        log::error!("OTA write_chunk failed after {} bytes: {:?}", total_read, e);
-                                        write_error = Some(anyhow::anyhow!("Failed to write OTA data: {:?}", e));
-                                        break;
-                                    }
-                                    total_read += bytes_read;
-                                    
-                                    // Log progress
-                                    let progress = ota.get_progress();
-                                    if progress % 10 == 0 && progress > 0 {
-                                        log::info!("OTA Progress: {}%", progress);
-                                    }
-                                }
-                                Err(e) => {
-                                    write_error = Some(anyhow::anyhow!("Failed to read request data: {:?}", e));
-                                    break;
-                                }
+                        // Read straight into the pipeline's chunks; Core 1 flashes them
+                        let write_error = match ota.receive(|buf| req.read(buf)) {
+                            Ok(total_read) => {
+                                log::info!("OTA: Received {} bytes", total_read);
+                                None
                             }
-                        }
+                            Err(e) => {
+                                log::error!("OTA receive failed: {:?}", e);
+                                Some(anyhow::anyhow!("Failed to write OTA data: {:?}", e))
+                            }
+                        };
                         
                         if let Some(e) = write_error {
                             Err(e)
@@ -633,24 +623,33 @@ impl WebConfigServer {
             
             // OTA status endpoint
             let ota_manager_clone3 = ota_manager.clone();
-            server.fn_handler("/api/ota/status", esp_idf_svc::http::Method::Get, move |req| {
+            server.profiled_handler("/api/ota/status", esp_idf_svc::http::Method::Get, move |req| {
                 let status_json = if let Some(ref ota_mgr) = ota_manager_clone3 {
-                    let status = match ota_mgr.lock() {
+                    let status = match ota_mgr.try_lock() {
                         Ok(mgr) => mgr.get_status(),
+                        // The upload handler holds the manager for the whole transfer
+                        Err(std::sync::TryLockError::WouldBlock) => {
+                            crate::ota::OtaStatus::Downloading { progress: crate::ota::pipeline::progress() }
+                        }
                         Err(e) => {
                             log::error!("Failed to lock OTA manager: {}", e);
                             crate::ota::OtaStatus::Failed
                         }
                     };
-                    match status {
-                        crate::ota::OtaStatus::Idle => r#"{"status":"idle"}"#.to_string(),
+                    let mut status = match status {
+                        crate::ota::OtaStatus::Idle => serde_json::json!({"status": "idle"}),
                         crate::ota::OtaStatus::Downloading { progress } => {
-                            format!(r#"{{"status":"downloading","progress":{progress}}}"#)
+                            serde_json::json!({"status": "downloading", "progress": progress})
                         },
-                        crate::ota::OtaStatus::Verifying => r#"{"status":"verifying"}"#.to_string(),
-                        crate::ota::OtaStatus::Ready => r#"{"status":"ready"}"#.to_string(),
-                        crate::ota::OtaStatus::Failed => r#"{"status":"failed"}"#.to_string(),
-                    }
+                        crate::ota::OtaStatus::Verifying => serde_json::json!({"status": "verifying"}),
+                        crate::ota::OtaStatus::Ready => serde_json::json!({"status": "ready"}),
+                        crate::ota::OtaStatus::Failed => serde_json::json!({"status": "failed"}),
+                    };
+                    // Stage timings of the current or last update
+                    status["pipeline"] = serde_json::to_value(crate::ota::pipeline::stats())?;
+                    // Base id for delta updates
+                    status["running_image"] = serde_json::json!(crate::ota::manager::running_image_sha256());
+                    status.to_string()
                 } else {
                     r#"{"status":"unavailable","message":"OTA not available on factory partition"}"#.to_string()
                 };
@@ -667,8 +666,29 @@ impl WebConfigServer {
             log::info!("OTA endpoints registered on main web server");
         }
 
+        // Dashboard, APIs, SSE and file routes come later through
+        // register_deferred_routes, once the UI is up
+        log::info!("Core routes registered (/health, /metrics, /ota)");
+        Ok(Self { server, config, metrics, sensor_history, deferred_registered: false })
+    }
+
+    /// Register the dashboard, API, SSE and file manager routes. Boot serves
+    /// /health, /metrics and OTA first and calls this after the first frame,
+    /// so the heavier registrations (and the history sampler they start)
+    /// stay off the boot path. Later calls do nothing.
+    pub fn register_deferred_routes(&mut self) -> Result<()> {
+        if self.deferred_registered {
+            return Ok(());
+        }
+        self.deferred_registered = true;
+        // An early return through `?` records the stage as failed
+        let stage = crate::boot_diagnostics::BootStage::new("deferred_routes");
+        let server = &mut self.server;
+        let config = self.config.clone();
+        let metrics = self.metrics.clone();
+
         // Dashboard route - enhanced dashboard with SSE-ready UI
-        server.fn_handler("/dashboard", esp_idf_svc::http::Method::Get, move |req| {
+        server.profiled_handler("/dashboard", esp_idf_svc::http::Method::Get, move |req| {
             let instr = crate::network::server_config::RequestInstrumentation::capture(None);
             let result = crate::network::streaming_dashboard::handle_dashboard_enhanced(req);
             let status = if result.is_ok() { 200 } else { 500 };
@@ -677,102 +697,61 @@ impl WebConfigServer {
         })?;
         
         // Dashboard CSS endpoint (for async loading)
-        server.fn_handler("/dashboard.css", esp_idf_svc::http::Method::Get, move |req| {
+        server.profiled_handler("/dashboard.css", esp_idf_svc::http::Method::Get, move |req| {
             crate::network::streaming_dashboard::handle_dashboard_css(req)
         })?;
 
         // Deprecated Control Center page -> redirect to dashboard
-        server.fn_handler("/control", esp_idf_svc::http::Method::Get, move |req| {
+        server.profiled_handler("/control", esp_idf_svc::http::Method::Get, move |req| {
             let mut response = req.into_response(
                 302,
                 Some("Found"),
-                &[("Location", "/dashboard"), ("Cache-Control", "no-store"), ("Connection", "close")],
+                &[("Location", "/dashboard"), ("Cache-Control", "no-store"), StableServerConfig::connection_header()],
             )?;
             response.write_all(b"")?;
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
-        // Dev Tools page - serve uncompressed to avoid gzip heap spikes
-        server.fn_handler("/dev", esp_idf_svc::http::Method::Get, move |req| {
-            let template = include_str!("../templates/dev.html");
-            let mut navbar = include_str!("../templates/partials/navbar.html").to_string();
-            navbar = navbar
-                .replace("{{HOME_ACTIVE}}", "")
-                .replace("{{DASH_ACTIVE}}", "")
-                .replace("{{LOGS_ACTIVE}}", "")
-                .replace("{{FILES_ACTIVE}}", "")
-                .replace("{{OTA_ACTIVE}}", "")
-                .replace("{{DEV_ACTIVE}}", "class=\\\"active\\\"");
-            let html = if template.contains("<nav class=\"navbar\">") {
-                template.to_string()
-            } else {
-                template.replacen("<header>", &format!("<header>\n{}", navbar), 1)
-            };
-            let mut response = req.into_response(
-                200,
-                Some("OK"),
-                &[("Content-Type", "text/html; charset=utf-8"), ("Connection", "close")],
-            )?;
-            response.write_all(html.as_bytes())?;
-            Ok(()) as Result<(), Box<dyn std::error::Error>>
-        })?;
-
-        // Common icon paths to suppress noisy 404s or serve tiny placeholder
-        server.fn_handler("/apple-touch-icon.png", esp_idf_svc::http::Method::Get, move |req| {
-            let png: &[u8] = include_bytes!("../../static/icons/apple-touch-icon.png");
-            let mut resp = req.into_response(200, Some("OK"), &[("Content-Type", "image/png"), ("Cache-Control", "max-age=86400")])?;
-            resp.write_all(png)?;
-            Ok(()) as Result<(), Box<dyn std::error::Error>>
-        })?;
-        server.fn_handler("/apple-touch-icon-precomposed.png", esp_idf_svc::http::Method::Get, move |req| {
-            let png: &[u8] = include_bytes!("../../static/icons/apple-touch-icon.png");
-            let mut resp = req.into_response(200, Some("OK"), &[("Content-Type", "image/png"), ("Cache-Control", "max-age=86400")])?;
-            resp.write_all(png)?;
-            Ok(()) as Result<(), Box<dyn std::error::Error>>
-        })?;
-        
-        // Sensor graphs route - serve uncompressed to reduce peak allocations
-        server.fn_handler("/graphs", esp_idf_svc::http::Method::Get, move |req| {
-            let html = crate::templates::GRAPHS_PAGE;
-            let mut response = req.into_response(
-                200,
-                Some("OK"),
-                &[("Content-Type", "text/html; charset=utf-8"), ("Connection", "close")],
-            )?;
-            response.write_all(html.as_bytes())?;
-            Ok(()) as Result<(), Box<dyn std::error::Error>>
-        })?;
+        // Build-time gzipped pages, scripts and icons, served straight from flash
+        // (/dev, /graphs, /logs, /sw.js, /apple-touch-icon.png)
+        for asset in crate::network::static_assets::ASSETS {
+            server.profiled_handler(asset.path, esp_idf_svc::http::Method::Get, move |req| {
+                crate::network::static_assets::serve(req, asset)
+            })?;
+        }
+        if let Some(icon) = crate::network::static_assets::lookup("/apple-touch-icon.png") {
+            server.profiled_handler("/apple-touch-icon-precomposed.png", esp_idf_svc::http::Method::Get, move |req| {
+                crate::network::static_assets::serve(req, icon)
+            })?;
+        }
         
         // Config backup endpoint - exports current config as JSON
         let config_backup = config.clone();
-        server.fn_handler("/api/config/backup", esp_idf_svc::http::Method::Get, move |req| {
-            let config = match config_backup.lock() {
-                Ok(cfg) => cfg,
+        async_handler::register(server, c"/api/config/backup", esp_idf_svc::http::Method::Get,
+                                Dispatch::Executor(WorkItem::ProcessNetwork), move |req| {
+            // Serialize under the lock, write after releasing it
+            let json = match config_backup.lock() {
+                Ok(cfg) => serde_json::to_string_pretty(&*cfg)?,
                 Err(e) => {
                     log::error!("Failed to lock config for backup: {}", e);
-                    return error_response(req, 503, "Configuration lock failed");
+                    req.send_status(503, "Configuration lock failed")?;
+                    return Ok(());
                 }
             };
             
-            // Export full config as JSON
-            let json = serde_json::to_string_pretty(&*config)?;
-            
             // Return as downloadable file
-            let mut response = req.into_response(
-                200,
-                Some("OK"),
-                &[
-                    ("Content-Type", "application/json"),
-                    ("Content-Disposition", "attachment; filename=\"esp32-config-backup.json\"")
-                ]
-            )?;
-            response.write_all(json.as_bytes())?;
-            Ok(()) as Result<(), Box<dyn std::error::Error>>
+            req.start_response(200, &[
+                ("Content-Type", "application/json"),
+                ("Content-Disposition", "attachment; filename=\"esp32-config-backup.json\""),
+                StableServerConfig::connection_header(),
+            ])?;
+            req.write_all(json.as_bytes())?;
+            Ok(())
         })?;
         
         // Config restore endpoint - imports config from JSON
         let config_restore = config.clone();
-        server.fn_handler("/api/config/restore", esp_idf_svc::http::Method::Post, move |mut req| {
+        server.profiled_handler("/api/config/restore", esp_idf_svc::http::Method::Post, move |mut req| {
             // Read uploaded JSON with 4KB cap
             let mut buf = vec![0; 4096];
             let len = req.read(&mut buf)?;
@@ -828,78 +807,46 @@ impl WebConfigServer {
             });
             
             let mut response = req.into_ok_response()?;
-            response.write_all(serde_json::to_string(&response_json)?.as_bytes())?;
+            response.write_all(crate::arena::to_json(&response_json)?.as_bytes())?;
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
         // Binary metrics endpoint for efficient updates
         let metrics_clone_bin = metrics.clone();
-        server.fn_handler("/api/metrics/binary", esp_idf_svc::http::Method::Get, move |req| {
-            if let Ok(metrics_guard) = metrics_clone_bin.try_lock() {
-                let packet = MetricsBinaryPacket::from_metrics(&*metrics_guard);
-                let bytes = packet.to_bytes();
-                
-                let mut response = req.into_response(
-                    200,
-                    Some("OK"),
-                    &[
-                        ("Content-Type", "application/octet-stream"),
-                        ("Cache-Control", "no-cache"),
-                    ]
-                )?;
-                response.write_all(&bytes)?;
+        server.profiled_handler("/api/metrics/binary", esp_idf_svc::http::Method::Get, move |req| {
+            // ?v=2&schema=<id>&ack=<seq> selects the delta-encoded v2 format
+            let query_param = |name: &str| -> Option<u32> {
+                req.uri()
+                    .split('?')
+                    .nth(1)
+                    .and_then(|query| query.split('&')
+                        .find_map(|p| p.strip_prefix(name).and_then(|rest| rest.strip_prefix('='))))
+                    .and_then(|v| v.parse::<u32>().ok())
+            };
+            let snapshot = metrics_clone_bin.snapshot();
+            let bytes = if query_param("v") == Some(binary_protocol::V2_VERSION as u32) {
+                let schema = query_param("schema").map(|id| id as u16);
+                binary_protocol::encode_v2(&snapshot, query_param("ack"), schema)
             } else {
-                return error_response(req, 503, "Metrics temporarily unavailable");
-            }
+                MetricsBinaryPacket::from_metrics(&snapshot).to_bytes()
+            };
+            
+            let mut response = req.into_response(
+                200,
+                Some("OK"),
+                &[
+                    ("Content-Type", "application/octet-stream"),
+                    ("Cache-Control", "no-cache"),
+                ]
+            )?;
+            response.write_all(&bytes)?;
             
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
-        // JSON metrics endpoint for dashboard
-        let metrics_clone = metrics.clone();
-        server.fn_handler("/api/metrics", esp_idf_svc::http::Method::Get, move |req| {
-            // Get basic system info
-            let uptime = unsafe { esp_idf_sys::esp_timer_get_time() / 1_000_000 } as u64;
-            let heap_free = unsafe { esp_idf_sys::esp_get_free_heap_size() };
-            
-            // Try to get metrics data
-            let metrics_json = if let Ok(metrics_guard) = metrics_clone.try_lock() {
-                // Get all metrics from the guard (deref to MetricsData)
-                serde_json::json!({
-                    "uptime": uptime,
-                    "heap_free": heap_free,
-                    "temperature": (metrics_guard.temperature * 10.0).round() / 10.0,
-                    "fps_actual": (metrics_guard.fps_actual * 10.0).round() / 10.0,
-                    "fps_target": metrics_guard.fps_target,
-                    "render_time_ms": metrics_guard.render_time_ms,
-                    "flush_time_ms": metrics_guard.flush_time_ms,
-                    "cpu_usage": metrics_guard.cpu_usage,
-                    "cpu0_usage": metrics_guard.cpu0_usage,
-                    "cpu1_usage": metrics_guard.cpu1_usage,
-                    "cpu_freq_mhz": metrics_guard.cpu_freq_mhz,
-                    "battery_voltage": metrics_guard.battery_voltage_mv,
-                    "battery_percentage": metrics_guard.battery_percentage,
-                    "battery_charging": metrics_guard.battery_charging,
-                    "wifi_rssi": metrics_guard.wifi_rssi,
-                    "wifi_connected": metrics_guard.wifi_connected,
-                    "wifi_ssid": metrics_guard.wifi_ssid.clone(),
-                    "display_brightness": metrics_guard.display_brightness,
-                    "frame_count": metrics_guard.frame_count,
-                    "skip_count": metrics_guard.skip_count,
-                    "skip_rate": if metrics_guard.frame_count > 0 {
-                        metrics_guard.skip_count as f32 / metrics_guard.frame_count as f32 * 100.0
-                    } else { 0.0 }
-                })
-            } else {
-                // Return partial data if metrics locked
-                serde_json::json!({
-                    "uptime": uptime,
-                    "heap_free": heap_free,
-                    "error": "metrics_locked"
-                })
-            };
-            
-            let json_string = serde_json::to_string(&metrics_json)?;
+        // Field table for v2 binary clients
+        server.profiled_handler("/api/metrics/schema", esp_idf_svc::http::Method::Get, move |req| {
+            let json_string = crate::arena::to_json(&binary_protocol::schema_json())?;
             let mut response = req.into_response(
                 200,
                 Some("OK"),
@@ -909,56 +856,71 @@ impl WebConfigServer {
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
-        // Logs page (SSE-enabled)
-        // NOTE (global-nav): This page participates in the shared navbar set.
-        server.fn_handler("/logs", esp_idf_svc::http::Method::Get, move |req| {
-            // Serve logs page with shared navbar by injecting partials
-            let template = include_str!("../templates/logs_enhanced.html");
-            let mut navbar = include_str!("../templates/partials/navbar.html").to_string();
-            navbar = navbar
-                .replace("{{HOME_ACTIVE}}", "")
-                .replace("{{DASH_ACTIVE}}", "")
-                .replace("{{LOGS_ACTIVE}}", "class=\\\"active\\\"")
-                .replace("{{FILES_ACTIVE}}", "")
-                .replace("{{OTA_ACTIVE}}", "")
-                .replace("{{DEV_ACTIVE}}", "");
-            // Insert navbar at top of body if not already present
-            let html = if template.contains("<nav class=\"navbar\">") {
-                template.to_string()
-            } else {
-                template.replacen("<body>", &format!("<body>\n{}", navbar), 1)
-            };
+        // JSON metrics endpoint for dashboard
+        let metrics_clone = metrics.clone();
+        server.profiled_handler("/api/metrics", esp_idf_svc::http::Method::Get, move |req| {
+            // Get basic system info
+            let uptime = unsafe { esp_idf_sys::esp_timer_get_time() / 1_000_000 } as u64;
+            let heap_free = unsafe { esp_idf_sys::esp_get_free_heap_size() };
+            
+            let metrics = metrics_clone.snapshot();
+            let metrics_json = serde_json::json!({
+                "uptime": uptime,
+                "heap_free": heap_free,
+                "temperature": (metrics.temperature * 10.0).round() / 10.0,
+                "fps_actual": (metrics.fps_actual * 10.0).round() / 10.0,
+                "fps_target": metrics.fps_target,
+                "render_time_ms": metrics.render_time_ms,
+                "flush_time_ms": metrics.flush_time_ms,
+                "flush_wait_time_ms": metrics.flush_wait_time_ms,
+                "main_loop_idle_percent": metrics.main_loop_idle_percent,
+                "cpu_usage": metrics.cpu_usage,
+                "cpu0_usage": metrics.cpu0_usage,
+                "cpu1_usage": metrics.cpu1_usage,
+                "cpu_freq_mhz": metrics.cpu_freq_mhz,
+                "battery_voltage": metrics.battery_voltage_mv,
+                "battery_percentage": metrics.battery_percentage,
+                "battery_charging": metrics.battery_charging,
+                "wifi_rssi": metrics.wifi_rssi,
+                "wifi_connected": metrics.wifi_connected,
+                "wifi_ssid": metrics.wifi_ssid(),
+                "display_brightness": metrics.display_brightness,
+                "frame_count": metrics.frame_count,
+                "skip_count": metrics.skip_count,
+                "skip_rate": if metrics.frame_count > 0 {
+                    metrics.skip_count as f32 / metrics.frame_count as f32 * 100.0
+                } else { 0.0 }
+            });
+            
+            let json_string = crate::arena::to_json(&metrics_json)?;
             let mut response = req.into_response(
                 200,
                 Some("OK"),
-                &[("Content-Type", "text/html; charset=utf-8"), ("Connection", "close")],
+                &[("Content-Type", "application/json")]
             )?;
-            response.write_all(html.as_bytes())?;
+            response.write_all(json_string.as_bytes())?;
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
         // Logs API endpoint - returns recent log entries from in-memory streamer
-        server.fn_handler("/api/logs", esp_idf_svc::http::Method::Get, move |req| {
+        async_handler::register(server, c"/api/logs", esp_idf_svc::http::Method::Get,
+                                Dispatch::Executor(WorkItem::ProcessNetwork), move |req| {
             // Optional count parameter
-            let count = req.uri()
-                .split('?')
-                .nth(1)
-                .and_then(|query| query.split('&').find(|p| p.starts_with("count=")))
-                .and_then(|p| p.strip_prefix("count="))
+            let count = req.query_param("count")
                 .and_then(|c| c.parse::<usize>().ok())
                 .unwrap_or(100);
 
-            let streamer = crate::network::log_streamer::init(None);
+            let streamer = crate::network::log_streamer::init();
             let recent_logs = streamer.get_recent_logs(count);
-            let json_string = serde_json::to_string(&serde_json::json!({ "logs": recent_logs }))?;
-            let mut response = req.into_ok_response()?;
-            response.write_all(json_string.as_bytes())?;
-            Ok(()) as Result<(), Box<dyn std::error::Error>>
+            let json_string = crate::arena::to_json(&serde_json::json!({ "logs": recent_logs }))?;
+            req.start_response(200, &[StableServerConfig::connection_header()])?;
+            req.write_all(json_string.as_bytes())?;
+            Ok(())
         })?;
 
         // Device control endpoint
         let config_clone_control = config.clone();
-        server.fn_handler("/api/control", esp_idf_svc::http::Method::Post, move |mut req| {
+        server.profiled_handler("/api/control", esp_idf_svc::http::Method::Post, move |mut req| {
             let mut buf = vec![0; 512];
             let len = req.read(&mut buf)?;
             if len > buf.len() {
@@ -1023,7 +985,7 @@ impl WebConfigServer {
         })?;
 
         // Restart endpoint - protected
-        server.fn_handler("/api/restart", esp_idf_svc::http::Method::Post, move |req| {
+        server.profiled_handler("/api/restart", esp_idf_svc::http::Method::Post, move |req| {
             // Check for authentication header
             const RESTART_TOKEN: &str = "esp32-restart";
             let auth_header = req.header("X-Restart-Token").unwrap_or("");
@@ -1051,21 +1013,21 @@ impl WebConfigServer {
         // SSE (Server-Sent Events) endpoints - register v2 manager with feature-gated client caps
         // NOTE (sse): Replaces the legacy broadcaster to support named events (logs, stats) and client caps
         let sse_manager = crate::network::sse_v2::init();
-        sse_manager.register_endpoints(&mut server)?;
+        sse_manager.register_endpoints(server)?;
 
         // Register API v1 routes
-        let sensor_history = sensor_history.unwrap_or_else(|| {
+        let sensor_history = self.sensor_history.take().unwrap_or_else(|| {
             crate::sensors::history::init()
         });
-        crate::network::api_routes::register_api_v1_routes(&mut server, config.clone(), sensor_history)?;
+        crate::network::api_routes::register_api_v1_routes(server, config.clone(), sensor_history)?;
 
         // Register file manager routes
-        crate::network::file_manager::register_file_routes(&mut server)?;
+        crate::network::file_manager::register_file_routes(server)?;
         
         // NOTE: SSE endpoint /api/events is already registered by sse_broadcaster.register_endpoints() above
 
         // Recent logs endpoint for initial load
-        server.fn_handler("/api/logs/recent", esp_idf_svc::http::Method::Get, move |req| {
+        server.profiled_handler("/api/logs/recent", esp_idf_svc::http::Method::Get, move |req| {
             let count = req.uri()
                 .split('?')
                 .nth(1)
@@ -1075,32 +1037,17 @@ impl WebConfigServer {
                 .unwrap_or(100);
             
             // Get log streamer instance
-            let log_streamer = crate::network::log_streamer::init(None);
+            let log_streamer = crate::network::log_streamer::init();
             let recent_logs = log_streamer.get_recent_logs(count);
             
-            let json = serde_json::to_string(&recent_logs)?;
+            let json = crate::arena::to_json(&recent_logs)?;
             let mut response = req.into_ok_response()?;
             response.write_all(json.as_bytes())?;
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
-        // Service Worker
-        server.fn_handler("/sw.js", esp_idf_svc::http::Method::Get, move |req| {
-            const SW_JS: &str = include_str!("../templates/sw.js");
-            let mut response = req.into_response(
-                200,
-                Some("OK"),
-                &[
-                    ("Content-Type", "application/javascript"),
-                    ("Cache-Control", "no-cache"),
-                ]
-            )?;
-            response.write_all(SW_JS.as_bytes())?;
-            Ok(()) as Result<(), Box<dyn std::error::Error>>
-        })?;
-
         // Web App Manifest
-        server.fn_handler("/manifest.json", esp_idf_svc::http::Method::Get, move |req| {
+        server.profiled_handler("/manifest.json", esp_idf_svc::http::Method::Get, move |req| {
             // Use escaped quotes to avoid parsing issues
             const MANIFEST_JSON: &str = "{\"name\":\"ESP32-S3 Dashboard\",\"short_name\":\"ESP32 Dash\",\"description\":\"Control and monitor your ESP32-S3 device\",\"start_url\":\"/dashboard\",\"display\":\"standalone\",\"theme_color\":\"#3b82f6\",\"background_color\":\"#0a0a0a\",\"icons\":[{\"src\":\"/icon-192.png\",\"sizes\":\"192x192\",\"type\":\"image/png\"},{\"src\":\"/icon-512.png\",\"sizes\":\"512x512\",\"type\":\"image/png\"}]}";
             let mut response = req.into_response(
@@ -1112,7 +1059,8 @@ impl WebConfigServer {
             Ok(()) as Result<(), Box<dyn std::error::Error>>
         })?;
 
-        Ok(Self { _server: server })
+        stage.complete();
+        Ok(())
     }
 }
 
@@ -6,8 +6,8 @@ use esp_idf_svc::{
         ClientConfiguration, Configuration, EspWifi,
         AuthMethod, BlockingWifi,
     },
-    nvs::EspDefaultNvsPartition,
 };
+use super::wifi_reconnect::{self, ApCache};
 
 pub struct WifiManager {
     wifi: BlockingWifi<EspWifi<'static>>,
@@ -30,7 +30,7 @@ impl WifiManager {
             bail!("WiFi SSID cannot be empty");
         }
         
-        let nvs = EspDefaultNvsPartition::take()?;
+        let nvs = crate::config::nvs_partition()?;
         let mut esp_wifi = EspWifi::new(modem, sys_loop.clone(), Some(nvs))?;
 
         // Configure WiFi
@@ -74,10 +74,22 @@ impl WifiManager {
         
         log::info!("Starting WiFi connection process for SSID: '{}'", self.ssid);
         
+        // Go straight to the last AP if we know it; the scan costs seconds
+        if let Some(ap) = ApCache::load(&self.ssid) {
+            log::info!("Trying cached AP {:02X?} on channel {}", ap.bssid, ap.channel);
+            match self.try_connect(Some(&ap)) {
+                Ok(signal) => return Ok(signal),
+                Err(e) => {
+                    log::warn!("Cached AP connect failed, falling back to scan: {:?}", e);
+                    let _ = self.wifi.stop();
+                }
+            }
+        }
+        
         for attempt in 1..=MAX_RETRIES {
             log::info!("WiFi connection attempt {} of {}", attempt, MAX_RETRIES);
             
-            match self.try_connect() {
+            match self.try_connect(None) {
                 Ok(signal) => {
                     log::info!("WiFi connected successfully on attempt {}", attempt);
                     log::info!("Signal strength: {} dBm", signal);
@@ -103,7 +115,20 @@ impl WifiManager {
         bail!("Failed to connect to WiFi after {} attempts", MAX_RETRIES)
     }
     
-    fn try_connect(&mut self) -> Result<i8> {
+    /// Aim the connection at a known AP, or clear the pin so the driver
+    /// looks for the SSID on every channel
+    fn set_target(&mut self, target: Option<&ApCache>) -> Result<()> {
+        if let Configuration::Client(mut client) = self.wifi.get_configuration()? {
+            client.bssid = target.map(|ap| ap.bssid);
+            client.channel = target.map(|ap| ap.channel);
+            self.wifi.set_configuration(&Configuration::Client(client))?;
+        }
+        Ok(())
+    }
+    
+    fn try_connect(&mut self, cached: Option<&ApCache>) -> Result<i8> {
+        self.set_target(cached)?;
+        
         log::info!("Starting WiFi...");
         self.wifi.start()?;
         
@@ -117,6 +142,66 @@ impl WifiManager {
             }
         }
 
+        let signal_strength = match cached {
+            Some(_) => {
+                self.associate()?;
+                current_rssi().unwrap_or(-100)
+            }
+            None => {
+                let signal_strength = self.scan_for_ssid()?;
+                self.associate()?;
+                signal_strength
+            }
+        };
+        
+        log::info!("WiFi connected!");
+        
+        // Store signal strength
+        self.last_signal_strength = signal_strength;
+        crate::network::wifi_stats::set_connected(true);
+        crate::network::wifi_stats::set_rssi_dbm(signal_strength as i32);
+        
+        // Start every connection with power save off (MIN_MODEM dropped the
+        // link under web traffic, error 0x6374c0). From then on the main loop's
+        // link policy owns the setting: it only drops to MAX_MODEM while the
+        // display is dark and no session or OTA upload is open. The driver
+        // needs a moment to settle before it accepts the change.
+        esp_idf_hal::delay::FreeRtos::delay_ms(500);
+        
+        unsafe {
+            use esp_idf_sys::*;
+            let result = esp_wifi_set_ps(wifi_ps_type_t_WIFI_PS_NONE);
+            if result == ESP_OK {
+                log::info!("WiFi power save disabled for stable connection");
+                // Let the link policy re-check from the main loop, starting from NONE
+                wifi_reconnect::invalidate_link_policy();
+            } else {
+                log::warn!("Failed to set WiFi power save mode: {:?}", result);
+            }
+            // Maximize transmit power for stability
+            // 78 corresponds to approx 19.5 dBm (0.25 dBm step), capped by regulatory limits
+            let _ = esp_wifi_set_max_tx_power(78);
+            // Prefer 20MHz bandwidth for stability in crowded environments
+            let _ = esp_wifi_set_bandwidth(wifi_interface_t_WIFI_IF_STA, wifi_bandwidth_t_WIFI_BW_HT20);
+            // Optional: set PMF to optional (not required) to avoid strict MFP handshakes on some APs
+            #[cfg(any())]
+            {
+                let mut sta_cfg: wifi_sta_config_t = core::mem::zeroed();
+                // This block is illustrative; esp-idf-svc config usually drives PMF
+                sta_cfg.pmf_cfg.required = 0;
+                let _ = esp_wifi_set_config(wifi_interface_t_WIFI_IF_STA, &mut wifi_config_t { sta: sta_cfg } as *mut _);
+            }
+        }
+        
+        // Give WiFi more time to stabilize with power save disabled
+        esp_idf_hal::delay::FreeRtos::delay_ms(1000);
+        log::info!("WiFi connection stabilized");
+        
+        Ok(signal_strength)
+    }
+
+    /// Scan for our SSID and pin the channel it was found on; returns its RSSI
+    fn scan_for_ssid(&mut self) -> Result<i8> {
         log::info!("Scanning for networks...");
         
         // Temporarily remove current task from watchdog monitoring during WiFi scan
@@ -186,6 +271,11 @@ impl WifiManager {
             bail!("Network {} not found", self.ssid);
         }
 
+        Ok(signal_strength)
+    }
+    
+    /// Connect to the configured AP and wait for DHCP
+    fn associate(&mut self) -> Result<()> {
         log::info!("Connecting to {}...", self.ssid);
         
         // Set a timeout for connection
@@ -217,49 +307,7 @@ impl WifiManager {
         
         // Reset watchdog after DHCP complete
         unsafe { esp_idf_sys::esp_task_wdt_reset(); }
-
-        log::info!("WiFi connected!");
-        
-        // Store signal strength
-        self.last_signal_strength = signal_strength;
-        crate::network::wifi_stats::set_connected(true);
-        crate::network::wifi_stats::set_rssi_dbm(signal_strength as i32);
-        
-        // Disable WiFi power save mode to prevent disconnections
-        // MIN_MODEM mode can cause disconnections during web server activity
-        // The ESP32 may disconnect with error code 0x6374c0 when power save is active
-        // and there's significant network traffic (web requests, telnet, etc.)
-        // IMPORTANT: We must wait a bit for WiFi to stabilize before disabling power save
-        esp_idf_hal::delay::FreeRtos::delay_ms(500);
-        
-        unsafe {
-            use esp_idf_sys::*;
-            let result = esp_wifi_set_ps(wifi_ps_type_t_WIFI_PS_NONE);
-            if result == ESP_OK {
-                log::info!("WiFi power save disabled for stable connection");
-            } else {
-                log::warn!("Failed to set WiFi power save mode: {:?}", result);
-            }
-            // Maximize transmit power for stability
-            // 78 corresponds to approx 19.5 dBm (0.25 dBm step), capped by regulatory limits
-            let _ = esp_wifi_set_max_tx_power(78);
-            // Prefer 20MHz bandwidth for stability in crowded environments
-            let _ = esp_wifi_set_bandwidth(wifi_interface_t_WIFI_IF_STA, wifi_bandwidth_t_WIFI_BW_HT20);
-            // Optional: set PMF to optional (not required) to avoid strict MFP handshakes on some APs
-            #[cfg(any())]
-            {
-                let mut sta_cfg: wifi_sta_config_t = core::mem::zeroed();
-                // This block is illustrative; esp-idf-svc config usually drives PMF
-                sta_cfg.pmf_cfg.required = 0;
-                let _ = esp_wifi_set_config(wifi_interface_t_WIFI_IF_STA, &mut wifi_config_t { sta: sta_cfg } as *mut _);
-            }
-        }
-        
-        // Give WiFi more time to stabilize with power save disabled
-        esp_idf_hal::delay::FreeRtos::delay_ms(1000);
-        log::info!("WiFi connection stabilized");
-        
-        Ok(signal_strength)
+        Ok(())
     }
 
     // disconnect and is_connected removed - not used
@@ -294,4 +342,12 @@ impl WifiManager {
                               mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]))
             .unwrap_or_else(|| "Unknown".to_string())
     }
-}
\ No newline at end of file
+}
+
+/// RSSI of the AP we're associated with
+fn current_rssi() -> Option<i8> {
+    unsafe {
+        let mut ap_info: esp_idf_sys::wifi_ap_record_t = core::mem::zeroed();
+        (esp_idf_sys::esp_wifi_sta_get_ap_info(&mut ap_info) == esp_idf_sys::ESP_OK).then_some(ap_info.rssi)
+    }
+}
@@ -1,15 +1,192 @@
 use anyhow::{Result, bail};
 use esp_idf_svc::eventloop::{EspEventLoop, System};
-use std::sync::{Arc, Mutex};
-use std::time::Instant;
-use std::sync::atomic::{AtomicBool, Ordering};
+use esp_idf_svc::nvs::EspNvs;
+use std::sync::{Arc, Mutex, OnceLock};
+use std::sync::atomic::{AtomicBool, AtomicU32, Ordering};
+use std::thread::Thread;
+use std::time::{Duration, Instant};
 use esp_idf_hal::delay::FreeRtos;
+use crate::power::PowerMode;
+
+// Reconnect engine
+//
+// WiFi events drive the link state: a disconnect wakes the reconnect thread
+// at once instead of waiting for the next poll. The first attempts go straight
+// to the BSSID and channel of the last AP (cached in NVS), which skips the
+// all-channel scan; after that the driver scans normally. Attempts are spaced
+// by exponential backoff with jitter so a fleet doesn't retry in lockstep
+// after an AP reboot. Each recovery's latency goes into the observability
+// histograms, split by cached and scanned path.
+
+// The "wifi" boot stage owns the first connection; step in once it is done
+const BOOT_GRACE: Duration = Duration::from_secs(60);
+// Backstop poll in case an event is missed
+const LINK_CHECK_INTERVAL: Duration = Duration::from_secs(10);
+// How long one attempt may take to reach an IP
+const CONNECT_TIMEOUT: Duration = Duration::from_secs(8);
+const BACKOFF_BASE_MS: u32 = 500;
+const BACKOFF_MAX_MS: u32 = 60_000;
+// Attempts aimed at the cached AP before falling back to a scan
+const CACHED_ATTEMPTS: u32 = 2;
+// Restart the driver every this many failed attempts
+const RESTART_EVERY: u32 = 6;
+
+const CACHE_NAMESPACE: &str = "wifi_cache";
+const CACHE_KEY: &str = "ap";
+
+static LINK_UP: AtomicBool = AtomicBool::new(false);
+// Milliseconds since boot when the link last went down, 0 while never lost
+static DOWN_SINCE_MS: AtomicU32 = AtomicU32::new(0);
+// Whether the attempt in flight targets the cached AP
+static CACHED_ATTEMPT: AtomicBool = AtomicBool::new(false);
+static ENGINE: OnceLock<Thread> = OnceLock::new();
+
+fn now_ms() -> u32 {
+    (unsafe { esp_idf_sys::esp_timer_get_time() } / 1000) as u32
+}
+
+fn wake_engine() {
+    if let Some(engine) = ENGINE.get() {
+        engine.unpark();
+    }
+}
+
+/// Delay before retry `attempt` (0-based): exponential from BACKOFF_BASE_MS,
+/// capped at BACKOFF_MAX_MS, with the upper half randomised by `random`
+pub fn backoff_delay_ms(attempt: u32, random: u32) -> u32 {
+    let ceiling = BACKOFF_BASE_MS
+        .saturating_mul(1u32 << attempt.min(16))
+        .min(BACKOFF_MAX_MS);
+    let half = ceiling / 2;
+    half + random % (half + 1)
+}
+
+/// The AP we last associated with
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ApCache {
+    pub bssid: [u8; 6],
+    pub channel: u8,
+}
+
+impl ApCache {
+    /// Blob layout: channel, BSSID, then the SSID it belongs to
+    fn encode(&self, ssid: &str) -> Vec<u8> {
+        let mut blob = Vec::with_capacity(7 + ssid.len());
+        blob.push(self.channel);
+        blob.extend_from_slice(&self.bssid);
+        blob.extend_from_slice(ssid.as_bytes());
+        blob
+    }
+
+    /// None if the blob is malformed or was cached for another network
+    fn decode(blob: &[u8], ssid: &str) -> Option<Self> {
+        if blob.len() < 7 || &blob[7..] != ssid.as_bytes() || blob[0] == 0 || blob[0] > 14 {
+            return None;
+        }
+        let mut bssid = [0u8; 6];
+        bssid.copy_from_slice(&blob[1..7]);
+        Some(Self { bssid, channel: blob[0] })
+    }
+
+    pub fn load(ssid: &str) -> Option<Self> {
+        let nvs = EspNvs::new(crate::config::nvs_partition().ok()?, CACHE_NAMESPACE, true).ok()?;
+        let mut buf = [0u8; 7 + 32];
+        let blob = nvs.get_blob(CACHE_KEY, &mut buf).ok()??;
+        Self::decode(blob, ssid)
+    }
+
+    pub fn save(&self, ssid: &str) -> Result<()> {
+        let mut nvs = EspNvs::new(crate::config::nvs_partition()?, CACHE_NAMESPACE, true)?;
+        nvs.set_blob(CACHE_KEY, &self.encode(ssid))?;
+        Ok(())
+    }
+
+    /// The AP the station is associated with right now
+    pub fn current() -> Option<Self> {
+        unsafe {
+            let mut ap_info: esp_idf_sys::wifi_ap_record_t = core::mem::zeroed();
+            if esp_idf_sys::esp_wifi_sta_get_ap_info(&mut ap_info) != esp_idf_sys::ESP_OK {
+                return None;
+            }
+            Some(Self { bssid: ap_info.bssid, channel: ap_info.primary })
+        }
+    }
+}
+
+/// Modem power-save level
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum LinkPower {
+    /// Radio always on: no latency, and no MIN_MODEM disconnects under
+    /// load (WIFI_DISCONNECTION_FIX.md)
+    None,
+    /// Wake every listen interval: lowest idle current
+    MaxModem,
+}
+
+impl LinkPower {
+    /// Pick the power-save level for the display's power mode. Any open
+    /// HTTP session (streams included) or an OTA upload is traffic, and
+    /// keeps the radio on whatever the display is doing.
+    pub fn for_state(mode: PowerMode, open_sessions: u32, ota_in_progress: bool) -> Self {
+        if open_sessions > 0 || ota_in_progress {
+            return LinkPower::None;
+        }
+        match mode {
+            PowerMode::Active => LinkPower::None,
+            PowerMode::PowerSave | PowerMode::Sleep => LinkPower::MaxModem,
+        }
+    }
+
+    fn ps_type(self) -> esp_idf_sys::wifi_ps_type_t {
+        match self {
+            LinkPower::None => esp_idf_sys::wifi_ps_type_t_WIFI_PS_NONE,
+            LinkPower::MaxModem => esp_idf_sys::wifi_ps_type_t_WIFI_PS_MAX_MODEM,
+        }
+    }
+
+    pub fn name(self) -> &'static str {
+        match self {
+            LinkPower::None => "none",
+            LinkPower::MaxModem => "max_modem",
+        }
+    }
+}
+
+// Last power-save level handed to the driver, u32::MAX when it must be reapplied
+static APPLIED_PS: AtomicU32 = AtomicU32::new(u32::MAX);
+
+/// Apply the link power policy; cheap to call every loop, the driver is only
+/// touched when the level changes
+pub fn apply_link_policy(mode: PowerMode) {
+    if !LINK_UP.load(Ordering::Relaxed) {
+        return;
+    }
+    let sessions = crate::network::server_config::StableServerConfig::open_sessions().unwrap_or(0) as u32;
+    let level = LinkPower::for_state(mode, sessions, crate::network::web_server::ota_in_progress());
+    let ps = level.ps_type();
+    if APPLIED_PS.swap(ps, Ordering::Relaxed) == ps {
+        return;
+    }
+    let result = unsafe { esp_idf_sys::esp_wifi_set_ps(ps) };
+    if result == esp_idf_sys::ESP_OK {
+        log::info!("WiFi power save: {} ({} open sessions)", level.name(), sessions);
+        crate::network::wifi_stats::set_power_save(level.name());
+    } else {
+        log::warn!("Failed to set WiFi power save {}: {}", level.name(), result);
+        APPLIED_PS.store(u32::MAX, Ordering::Relaxed);
+    }
+}
+
+/// Make the next apply_link_policy call reapply its level (after the
+/// connect path has changed the driver's setting)
+pub fn invalidate_link_policy() {
+    APPLIED_PS.store(u32::MAX, Ordering::Relaxed);
+}
 
 /// WiFi reconnection manager that handles disconnection events
 pub struct WifiReconnectManager {
     ssid: String,
-    password: String,
-    last_disconnect: Arc<Mutex<Option<Instant>>>,
+    _password: String,
     reconnect_attempts: Arc<Mutex<u32>>,
     is_connected: Arc<AtomicBool>,
     monitoring_active: Arc<AtomicBool>,
@@ -19,133 +196,91 @@ impl WifiReconnectManager {
     pub fn new(ssid: String, password: String) -> Self {
         Self {
             ssid,
-            password,
-            last_disconnect: Arc::new(Mutex::new(None)),
+            _password: password,
             reconnect_attempts: Arc::new(Mutex::new(0)),
             is_connected: Arc::new(AtomicBool::new(true)), // Assume connected initially
             monitoring_active: Arc::new(AtomicBool::new(false)),
         }
     }
-    
-    /// Start monitoring WiFi connection and handle reconnections
+
+    /// Start the reconnect engine thread
     pub fn start_monitoring(&self) -> Result<()> {
         // Only start if not already monitoring
         if self.monitoring_active.swap(true, Ordering::SeqCst) {
             log::warn!("WiFi monitoring already active");
             return Ok(());
         }
-        
-        // Clone these in case we need them for future reconnection improvements
-        let _ssid = self.ssid.clone();
-        let _password = self.password.clone();
+
+        let ssid = self.ssid.clone();
         let is_connected = self.is_connected.clone();
         let reconnect_attempts = self.reconnect_attempts.clone();
-        let last_disconnect = self.last_disconnect.clone();
         let monitoring_active = self.monitoring_active.clone();
-        
-        // Spawn monitoring task
-        std::thread::spawn(move || {
-            log::info!("WiFi monitoring task started");
-            
-            // Initial delay to avoid race condition during boot
-            log::info!("Waiting 15 seconds before starting WiFi monitoring...");
-            FreeRtos::delay_ms(15_000);
-            
-            while monitoring_active.load(Ordering::Relaxed) {
-                // Check if WiFi is connected
-                let connected = unsafe {
-                    let mut ap_info: esp_idf_sys::wifi_ap_record_t = std::mem::zeroed();
-                    esp_idf_sys::esp_wifi_sta_get_ap_info(&mut ap_info) == esp_idf_sys::ESP_OK
-                };
-                
-                let was_connected = is_connected.load(Ordering::Relaxed);
-                is_connected.store(connected, Ordering::Relaxed);
-                
-                if was_connected && !connected {
-                    // Just disconnected
-                    log::warn!("WiFi disconnected! Starting reconnection process...");
-                    crate::network::wifi_stats::set_connected(false);
-                    crate::network::wifi_stats::record_disconnect();
-                    if let Ok(mut ld) = last_disconnect.lock() { *ld = Some(Instant::now()); }
-                    if let Ok(mut ra) = reconnect_attempts.lock() { *ra = 0; }
-                }
-                
-                if !connected {
-                    // Try to reconnect
-                    let attempts = {
-                        if let Ok(mut guard) = reconnect_attempts.lock() {
-                            *guard += 1;
-                            *guard
-                        } else {
-                            1
+
+        let handle = std::thread::Builder::new()
+            .name("wifi_reconnect".to_string())
+            .stack_size(4096)
+            .spawn(move || {
+                log::info!("WiFi reconnect engine started");
+                crate::boot_diagnostics::wait_for(&["wifi"], BOOT_GRACE);
+
+                let mut cache = ApCache::load(&ssid);
+                let mut attempt = 0u32;
+                while monitoring_active.load(Ordering::Relaxed) {
+                    let connected = LINK_UP.load(Ordering::Relaxed);
+                    is_connected.store(connected, Ordering::Relaxed);
+
+                    if connected {
+                        if attempt > 0 {
+                            log::info!("WiFi reconnected after {} attempts", attempt);
+                            attempt = 0;
+                            if let Ok(mut ra) = reconnect_attempts.lock() { *ra = 0; }
                         }
-                    };
-                    
-                    log::warn!("WiFi disconnected: attempt #{} (will not mask persistent issues)", attempts);
-                    
-                    // Calculate backoff delay (exponential, max 60 seconds)
-                    let delay = std::cmp::min(60, 5 * (1 << std::cmp::min(attempts - 1, 4)));
-                    log::info!("Backoff {}s before reconnection attempt", delay);
-                    FreeRtos::delay_ms(delay as u32 * 1000);
-                    
-                    // Attempt reconnection
-                    // After 3 failed attempts, perform stop/start cycle
-                    if attempts % 3 == 0 {
+                        remember_ap(&ssid, &mut cache);
+                        std::thread::park_timeout(LINK_CHECK_INTERVAL);
+                        continue;
+                    }
+
+                    if attempt > 0 {
+                        let delay = backoff_delay_ms(attempt - 1, unsafe { esp_idf_sys::esp_random() });
+                        log::info!("WiFi retry #{} in {} ms", attempt + 1, delay);
+                        FreeRtos::delay_ms(delay);
+                        if LINK_UP.load(Ordering::Relaxed) {
+                            continue;
+                        }
+                    }
+                    attempt += 1;
+                    if let Ok(mut ra) = reconnect_attempts.lock() { *ra = attempt; }
+
+                    if attempt % RESTART_EVERY == 0 {
+                        log::warn!("WiFi still down after {} attempts, restarting driver", attempt);
                         unsafe {
                             let _ = esp_idf_sys::esp_wifi_stop();
                             FreeRtos::delay_ms(500);
                             let _ = esp_idf_sys::esp_wifi_start();
-                            FreeRtos::delay_ms(500);
                         }
                     }
 
-                    match Self::force_reconnect() {
-                        Ok(_) => {
-                            log::info!("WiFi reconnection initiated");
-                            // Wait a bit for connection to establish
-                            FreeRtos::delay_ms(10_000);
-                        }
-                        Err(e) => {
-                            log::error!("WiFi reconnection failed: {:?}", e);
-                        }
+                    let target = if attempt <= CACHED_ATTEMPTS { cache.as_ref() } else { None };
+                    CACHED_ATTEMPT.store(target.is_some(), Ordering::Relaxed);
+                    if let Err(e) = set_target(target) {
+                        log::warn!("Failed to set WiFi target: {:?}", e);
                     }
-                } else {
-                    // Connected - reset attempts counter and refresh RSSI/channel
-                    let attempts = reconnect_attempts.lock().map(|g| *g).unwrap_or(0);
-                    if attempts > 0 {
-                        log::warn!("WiFi reconnected after {} attempts (intermittent network)", attempts);
-                        if let Ok(mut ra) = reconnect_attempts.lock() { *ra = 0; }
-                        crate::network::wifi_stats::record_reconnect();
-                        crate::network::wifi_stats::set_connected(true);
-                        unsafe {
-                            let mut ap_info: esp_idf_sys::wifi_ap_record_t = core::mem::zeroed();
-                            if esp_idf_sys::esp_wifi_sta_get_ap_info(&mut ap_info) == esp_idf_sys::ESP_OK {
-                                crate::network::wifi_stats::set_rssi_dbm(ap_info.rssi as i32);
-                                crate::network::wifi_stats::set_channel(ap_info.primary as u32);
-                            }
-                        }
-                        // Disable power-save again to ensure stability after reconnection
-                        unsafe {
-                            use esp_idf_sys::*;
-                            let _ = esp_wifi_set_ps(wifi_ps_type_t_WIFI_PS_NONE);
-                        }
+                    match Self::force_reconnect() {
+                        Ok(_) => { wait_for_link(CONNECT_TIMEOUT); }
+                        Err(e) => log::error!("WiFi reconnection failed: {:?}", e),
                     }
                 }
-                
-                // Check every 10 seconds
-                FreeRtos::delay_ms(10_000);
-            }
-            
-            log::info!("WiFi monitoring task stopped");
-        });
-        
+
+                log::info!("WiFi reconnect engine stopped");
+            })?;
+        let _ = ENGINE.set(handle.thread().clone());
+
         log::info!("WiFi auto-reconnection monitoring started");
         Ok(())
     }
-    
+
     /// Register WiFi event handlers so stats reflect real events (reason codes, timestamps)
     pub fn register_event_handlers(&self, _sysloop: &EspEventLoop<System>) -> Result<()> {
-        // Keep existing monitoring (polling/backoff) and also wire low-level events
         self.start_monitoring()?;
 
         unsafe extern "C" fn wifi_any_event_handler(
@@ -171,8 +306,13 @@ impl WifiReconnectManager {
                                 0,
                             );
                         }
-                        crate::network::wifi_stats::set_connected(false);
-                        crate::network::wifi_stats::record_disconnect();
+                        // Failed attempts disconnect too; only a lost link starts the clock
+                        if LINK_UP.swap(false, Ordering::Relaxed) {
+                            DOWN_SINCE_MS.store(now_ms().max(1), Ordering::Relaxed);
+                            crate::network::wifi_stats::set_connected(false);
+                            crate::network::wifi_stats::record_disconnect();
+                        }
+                        wake_engine();
                     }
                     wifi_event_t_WIFI_EVENT_STA_CONNECTED => {
                         crate::network::wifi_stats::set_connected(true);
@@ -192,6 +332,23 @@ impl WifiReconnectManager {
                     }
                     _ => {}
                 }
+            } else if event_base == IP_EVENT && event_id as u32 == ip_event_t_IP_EVENT_STA_GOT_IP {
+                LINK_UP.store(true, Ordering::Relaxed);
+                let down_since = DOWN_SINCE_MS.swap(0, Ordering::Relaxed);
+                if down_since != 0 {
+                    let latency_ms = now_ms().wrapping_sub(down_since);
+                    let mut ap: wifi_ap_record_t = core::mem::zeroed();
+                    let (rssi, channel) = if esp_wifi_sta_get_ap_info(&mut ap) == ESP_OK {
+                        (ap.rssi as i32, ap.primary as u32)
+                    } else {
+                        (0, 0)
+                    };
+                    crate::network::observability::record_wifi_reconnect(
+                        CACHED_ATTEMPT.load(Ordering::Relaxed), latency_ms, rssi, channel);
+                }
+                // The driver may have reset power save while associating
+                invalidate_link_policy();
+                wake_engine();
             }
         }
 
@@ -207,53 +364,61 @@ impl WifiReconnectManager {
             if err != ESP_OK {
                 log::warn!("Failed to register WiFi event handler: {}", err);
             }
+            // GOT_IP marks the link usable and times the reconnect
+            let err = esp_event_handler_register(
+                IP_EVENT,
+                ip_event_t_IP_EVENT_STA_GOT_IP as i32,
+                Some(wifi_any_event_handler),
+                core::ptr::null_mut(),
+            );
+            if err != ESP_OK {
+                log::warn!("Failed to register IP event handler: {}", err);
+            }
         }
 
         Ok(())
     }
-    
+
     /// Stop monitoring
     #[allow(dead_code)] // Will be used for graceful shutdown
     pub fn stop_monitoring(&self) {
         self.monitoring_active.store(false, Ordering::SeqCst);
+        wake_engine();
         log::info!("WiFi monitoring stopped");
     }
-    
+
     /// Check if currently connected
     #[allow(dead_code)] // Useful for status checks
     pub fn is_connected(&self) -> bool {
         self.is_connected.load(Ordering::Relaxed)
     }
-    
+
     /// Force a WiFi reconnection (useful after OTA)
     pub fn force_reconnect() -> Result<()> {
         log::info!("Forcing WiFi reconnection...");
-        
+
         unsafe {
             // Check WiFi state to avoid race condition
             let mut mode: esp_idf_sys::wifi_mode_t = 0;
             esp_idf_sys::esp_wifi_get_mode(&mut mode);
-            
+
             // If WiFi is not in STA mode, skip reconnection
-            if mode != esp_idf_sys::wifi_mode_t_WIFI_MODE_STA && 
+            if mode != esp_idf_sys::wifi_mode_t_WIFI_MODE_STA &&
                mode != esp_idf_sys::wifi_mode_t_WIFI_MODE_APSTA {
                 log::warn!("WiFi not in STA mode, skipping reconnection");
                 return Ok(());
             }
-            
+
             // Check if already connected
             let mut ap_info: esp_idf_sys::wifi_ap_record_t = std::mem::zeroed();
             if esp_idf_sys::esp_wifi_sta_get_ap_info(&mut ap_info) == esp_idf_sys::ESP_OK {
                 log::info!("WiFi already connected, skipping reconnection");
                 return Ok(());
             }
-            
+
             // Disconnect first (ignore error if not connected)
             let _ = esp_idf_sys::esp_wifi_disconnect();
-            
-            // Wait a bit
-            FreeRtos::delay_ms(500);
-            
+
             // Reconnect
             let result = esp_idf_sys::esp_wifi_connect();
             if result == esp_idf_sys::ESP_OK {
@@ -270,63 +435,89 @@ impl WifiReconnectManager {
     }
 }
 
-/// Check if we just completed an OTA update and force reconnection
-pub fn handle_post_ota_wifi() -> Result<()> {
-    let reset_reason = unsafe { esp_idf_sys::esp_reset_reason() };
-    
-    if reset_reason == esp_idf_sys::esp_reset_reason_t_ESP_RST_SW {
-        log::info!("Detected software reset (likely OTA), handling WiFi reconnection");
-        
-        // Give WiFi subsystem more time to fully initialize after OTA
-        log::info!("Waiting for WiFi subsystem to stabilize...");
-        FreeRtos::delay_ms(3_000);
-        
-        // Stop WiFi first to ensure clean state
-        unsafe {
-            let stop_result = esp_idf_sys::esp_wifi_stop();
-            if stop_result == esp_idf_sys::ESP_OK {
-                log::info!("WiFi stopped successfully");
-            } else {
-                log::warn!("WiFi stop returned: {:?}", stop_result);
-            }
+/// Block until the link has an IP or `timeout` passes
+fn wait_for_link(timeout: Duration) {
+    let deadline = Instant::now() + timeout;
+    while !LINK_UP.load(Ordering::Relaxed) {
+        let now = Instant::now();
+        if now >= deadline {
+            break;
         }
-        
-        // Small delay between stop and start
-        FreeRtos::delay_ms(500);
-        
-        // Start WiFi
-        unsafe {
-            let start_result = esp_idf_sys::esp_wifi_start();
-            if start_result == esp_idf_sys::ESP_OK {
-                log::info!("WiFi started successfully");
-            } else {
-                log::error!("WiFi start failed: {:?}", start_result);
-                return Err(anyhow::anyhow!("Failed to start WiFi"));
+        std::thread::park_timeout(deadline - now);
+    }
+}
+
+/// Keep the NVS cache pointed at the AP we're on; writes only on change
+fn remember_ap(ssid: &str, cache: &mut Option<ApCache>) {
+    let Some(current) = ApCache::current() else { return };
+    if cache.as_ref() == Some(&current) {
+        return;
+    }
+    match current.save(ssid) {
+        Ok(()) => log::info!("WiFi AP cached: {:02X?} channel {}", current.bssid, current.channel),
+        Err(e) => log::warn!("Failed to cache WiFi AP: {:?}", e),
+    }
+    *cache = Some(current);
+}
+
+/// Aim the next connect at `target`, or let the driver scan for the SSID
+fn set_target(target: Option<&ApCache>) -> Result<()> {
+    unsafe {
+        use esp_idf_sys::*;
+        let mut cfg: wifi_config_t = core::mem::zeroed();
+        esp_idf_sys::esp!(esp_wifi_get_config(wifi_interface_t_WIFI_IF_STA, &mut cfg))?;
+        match target {
+            Some(ap) => {
+                cfg.sta.bssid_set = true;
+                cfg.sta.bssid = ap.bssid;
+                cfg.sta.channel = ap.channel;
             }
-        }
-        
-        // Wait a bit more before attempting connection
-        FreeRtos::delay_ms(1_000);
-        
-        // Force reconnection with retries
-        for attempt in 1..=3 {
-            log::info!("WiFi reconnection attempt {} of 3", attempt);
-            match WifiReconnectManager::force_reconnect() {
-                Ok(_) => {
-                    log::info!("WiFi reconnection initiated successfully");
-                    return Ok(());
-                }
-                Err(e) => {
-                    log::warn!("Reconnection attempt {} failed: {:?}", attempt, e);
-                    if attempt < 3 {
-                        FreeRtos::delay_ms(2_000);
-                    }
-                }
+            None => {
+                cfg.sta.bssid_set = false;
+                cfg.sta.channel = 0;
             }
         }
-        
-        log::error!("Failed to reconnect WiFi after 3 attempts");
+        esp_idf_sys::esp!(esp_wifi_set_config(wifi_interface_t_WIFI_IF_STA, &mut cfg))?;
     }
-    
     Ok(())
-}
\ No newline at end of file
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_backoff_grows_to_the_cap_with_bounded_jitter() {
+        assert_eq!(backoff_delay_ms(0, 0), BACKOFF_BASE_MS / 2);
+        assert_eq!(backoff_delay_ms(0, u32::MAX), BACKOFF_BASE_MS / 2 + (u32::MAX % (BACKOFF_BASE_MS / 2 + 1)));
+        for attempt in 0..40 {
+            let ceiling = (BACKOFF_BASE_MS as u64 * (1u64 << attempt.min(16))).min(BACKOFF_MAX_MS as u64) as u32;
+            for random in [0, 1, 12_345, u32::MAX] {
+                let delay = backoff_delay_ms(attempt, random);
+                assert!(delay >= ceiling / 2 && delay <= ceiling, "attempt {} delay {}", attempt, delay);
+            }
+        }
+    }
+
+    #[test]
+    fn test_ap_cache_round_trips_for_its_own_ssid_only() {
+        let ap = ApCache { bssid: [0x24, 0x0A, 0xC4, 0x01, 0x02, 0x03], channel: 11 };
+        let blob = ap.encode("home");
+        assert_eq!(ApCache::decode(&blob, "home"), Some(ap));
+        assert_eq!(ApCache::decode(&blob, "office"), None);
+        assert_eq!(ApCache::decode(&blob[..6], "home"), None);
+    }
+
+    #[test]
+    fn test_traffic_keeps_the_radio_awake() {
+        assert_eq!(LinkPower::for_state(PowerMode::Sleep, 1, false), LinkPower::None);
+        assert_eq!(LinkPower::for_state(PowerMode::PowerSave, 0, true), LinkPower::None);
+        assert_eq!(LinkPower::for_state(PowerMode::Active, 0, false), LinkPower::None);
+        assert_eq!(LinkPower::for_state(PowerMode::PowerSave, 0, false), LinkPower::MaxModem);
+    }
+
+    #[test]
+    fn test_dimmed_display_without_sessions_sleeps_the_radio() {
+        assert_eq!(LinkPower::for_state(PowerMode::Sleep, 0, false), LinkPower::MaxModem);
+    }
+}
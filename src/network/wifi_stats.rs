@@ -11,6 +11,7 @@ static WIFI_CHANNEL: AtomicU32 = AtomicU32::new(0);
 static WIFI_LAST_DISC_MS: AtomicU64Compat = AtomicU64Compat::new(0);
 static WIFI_LAST_REASON: AtomicU32 = AtomicU32::new(0);
 static WIFI_LAST_REASON_MS: AtomicU64Compat = AtomicU64Compat::new(0);
+static WIFI_POWER_SAVE: std::sync::Mutex<&'static str> = std::sync::Mutex::new("none");
 
 pub fn set_connected(connected: bool) {
     WIFI_CONNECTED.store(connected, Ordering::Relaxed);
@@ -36,6 +37,10 @@ pub fn set_channel(ch: u32) {
     WIFI_CHANNEL.store(ch, Ordering::Relaxed);
 }
 
+pub fn set_power_save(level: &'static str) {
+    *WIFI_POWER_SAVE.lock().unwrap_or_else(|poisoned| poisoned.into_inner()) = level;
+}
+
 pub fn set_last_reason(reason: u32) {
     WIFI_LAST_REASON.store(reason, Ordering::Relaxed);
     unsafe {
@@ -54,6 +59,8 @@ pub struct WifiStatsSnapshot {
     pub last_disconnect_ms: u64,
     pub last_reason: u32,
     pub last_reason_ms: u64,
+    pub power_save: &'static str,
+    pub reconnect: crate::network::observability::WifiReconnectSnapshot,
 }
 
 pub fn snapshot() -> WifiStatsSnapshot {
@@ -66,6 +73,8 @@ pub fn snapshot() -> WifiStatsSnapshot {
         last_disconnect_ms: WIFI_LAST_DISC_MS.load(Ordering::Relaxed) as u64,
         last_reason: WIFI_LAST_REASON.load(Ordering::Relaxed),
         last_reason_ms: WIFI_LAST_REASON_MS.load(Ordering::Relaxed) as u64,
+        power_save: *WIFI_POWER_SAVE.lock().unwrap_or_else(|poisoned| poisoned.into_inner()),
+        reconnect: crate::network::observability::wifi_reconnect_snapshot(),
     }
 }
 
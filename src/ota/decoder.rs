@@ -0,0 +1,391 @@
+// Streaming decoders for compressed and delta OTA images
+//
+// An upload may be the plain image, a zlib stream of it ("deflate"), or a
+// zlib-compressed patch against the running image ("delta"), as produced by
+// scripts/ota-pack.py. Every form decodes straight into the pipeline's
+// receive chunks. RAM use is fixed whatever the image size: the inflater's
+// 32 KB window and state (above the SPIRAM malloc threshold, so in PSRAM)
+// plus a 4 KB input buffer and a small patch buffer.
+//
+// Patch format, once inflated (integers little-endian):
+//   "ESPD", version u8, 3 reserved bytes, image size u32
+//   then ops until END:
+//     0x00 COPY    source offset u32, length u32  (from the running partition)
+//     0x01 INSERT  length u32, then that many literal bytes
+//     0x02 END
+
+use core::ffi::c_void;
+use esp_idf_sys::*;
+use flate2::{Decompress, FlushDecompress, Status};
+use super::manager::OtaError;
+
+/// Compressed bytes read from the upload per refill
+const INPUT_SIZE: usize = 4096;
+
+/// Inflated patch bytes buffered while op headers are parsed
+const PATCH_BUFFER_SIZE: usize = 512;
+
+const PATCH_MAGIC: &[u8; 4] = b"ESPD";
+const PATCH_VERSION: u8 = 1;
+const PATCH_HEADER_LEN: usize = 12;
+const OP_COPY: u8 = 0x00;
+const OP_INSERT: u8 = 0x01;
+const OP_END: u8 = 0x02;
+
+/// Upload format, from the X-OTA-Encoding header
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Encoding {
+    Identity,
+    Deflate,
+    Delta,
+}
+
+impl Encoding {
+    pub fn parse(value: &str) -> Option<Self> {
+        match value.trim() {
+            "" | "identity" => Some(Encoding::Identity),
+            "deflate" => Some(Encoding::Deflate),
+            "delta" => Some(Encoding::Delta),
+            _ => None,
+        }
+    }
+}
+
+fn corrupt(what: &str) -> OtaError {
+    log::error!("OTA: Corrupt upload: {}", what);
+    OtaError::DecodeFailed
+}
+
+struct Inflater {
+    stream: Decompress,
+    input: Vec<u8>,
+    pos: usize,
+    len: usize,
+    input_done: bool,
+    finished: bool,
+}
+
+impl Inflater {
+    fn new() -> Self {
+        Self {
+            stream: Decompress::new(true),
+            input: vec![0; INPUT_SIZE],
+            pos: 0,
+            len: 0,
+            input_done: false,
+            finished: false,
+        }
+    }
+
+    /// Inflate into `out` (non-empty); Ok(0) once the zlib stream has ended
+    fn inflate<R>(&mut self, source: &mut R, out: &mut [u8]) -> Result<usize, OtaError>
+    where
+        R: FnMut(&mut [u8]) -> Result<usize, OtaError>,
+    {
+        while !self.finished {
+            if self.pos == self.len && !self.input_done {
+                self.len = source(&mut self.input)?;
+                self.pos = 0;
+                self.input_done = self.len == 0;
+            }
+
+            let (total_in, total_out) = (self.stream.total_in(), self.stream.total_out());
+            let flush = if self.input_done { FlushDecompress::Finish } else { FlushDecompress::None };
+            let status = self.stream.decompress(&self.input[self.pos..self.len], out, flush)
+                .map_err(|_| corrupt("invalid zlib data"))?;
+            self.pos += (self.stream.total_in() - total_in) as usize;
+            let produced = (self.stream.total_out() - total_out) as usize;
+
+            self.finished = status == Status::StreamEnd;
+            if produced > 0 {
+                return Ok(produced);
+            }
+            if self.input_done && !self.finished {
+                return Err(corrupt("zlib stream is truncated"));
+            }
+        }
+        Ok(0)
+    }
+}
+
+#[derive(Clone, Copy)]
+enum Op {
+    Header,
+    Next,
+    Copy { offset: u32, remaining: u32 },
+    Insert { remaining: u32 },
+    End,
+}
+
+/// The flash image a patch copies from
+pub struct Base {
+    partition: *const esp_partition_t,
+    size: u32,
+}
+
+impl Base {
+    /// The partition the device booted from
+    pub fn running() -> Option<Self> {
+        let partition = unsafe { esp_ota_get_running_partition() };
+        if partition.is_null() {
+            return None;
+        }
+        Some(Self { partition, size: unsafe { (*partition).size } })
+    }
+
+    fn read(&self, offset: u32, out: &mut [u8]) -> Result<(), OtaError> {
+        let result = unsafe {
+            esp_partition_read(self.partition, offset as usize, out.as_mut_ptr() as *mut c_void, out.len())
+        };
+        if result != ESP_OK {
+            log::error!("OTA: Reading delta base at 0x{:x} failed: 0x{:x}", offset, result);
+            return Err(OtaError::DecodeFailed);
+        }
+        Ok(())
+    }
+}
+
+struct Patch {
+    inflater: Inflater,
+    base: Base,
+    buf: [u8; PATCH_BUFFER_SIZE],
+    pos: usize,
+    len: usize,
+    op: Op,
+    image_size: u32,
+    produced: u32,
+}
+
+impl Patch {
+    /// Make at least `need` inflated bytes available in `buf`
+    fn fill<R>(&mut self, source: &mut R, need: usize) -> Result<(), OtaError>
+    where
+        R: FnMut(&mut [u8]) -> Result<usize, OtaError>,
+    {
+        if self.len - self.pos >= need {
+            return Ok(());
+        }
+        self.buf.copy_within(self.pos..self.len, 0);
+        self.len -= self.pos;
+        self.pos = 0;
+        while self.len < need {
+            let n = self.inflater.inflate(source, &mut self.buf[self.len..])?;
+            if n == 0 {
+                return Err(corrupt("patch ends mid-op"));
+            }
+            self.len += n;
+        }
+        Ok(())
+    }
+
+    fn take<const N: usize>(&mut self) -> [u8; N] {
+        let mut bytes = [0; N];
+        bytes.copy_from_slice(&self.buf[self.pos..self.pos + N]);
+        self.pos += N;
+        bytes
+    }
+
+    fn take_u32(&mut self) -> u32 {
+        u32::from_le_bytes(self.take())
+    }
+
+    fn read<R>(&mut self, source: &mut R, out: &mut [u8]) -> Result<usize, OtaError>
+    where
+        R: FnMut(&mut [u8]) -> Result<usize, OtaError>,
+    {
+        loop {
+            match self.op {
+                Op::Header => {
+                    self.fill(source, PATCH_HEADER_LEN)?;
+                    let header: [u8; PATCH_HEADER_LEN] = self.take();
+                    if &header[..4] != PATCH_MAGIC || header[4] != PATCH_VERSION {
+                        return Err(corrupt("not a version 1 delta patch"));
+                    }
+                    self.image_size = u32::from_le_bytes([header[8], header[9], header[10], header[11]]);
+                    self.op = Op::Next;
+                }
+                Op::Next => {
+                    self.fill(source, 1)?;
+                    let [tag] = self.take();
+                    self.op = match tag {
+                        OP_COPY => {
+                            self.fill(source, 8)?;
+                            let (offset, length) = (self.take_u32(), self.take_u32());
+                            if offset.checked_add(length).map_or(true, |end| end > self.base.size) {
+                                return Err(corrupt("copy outside the running partition"));
+                            }
+                            Op::Copy { offset, remaining: length }
+                        }
+                        OP_INSERT => {
+                            self.fill(source, 4)?;
+                            Op::Insert { remaining: self.take_u32() }
+                        }
+                        OP_END => Op::End,
+                        _ => return Err(corrupt("unknown patch op")),
+                    };
+                }
+                Op::Copy { remaining: 0, .. } | Op::Insert { remaining: 0 } => self.op = Op::Next,
+                Op::Copy { offset, remaining } => {
+                    let n = (remaining as usize).min(out.len());
+                    self.base.read(offset, &mut out[..n])?;
+                    self.op = Op::Copy { offset: offset + n as u32, remaining: remaining - n as u32 };
+                    return self.produce(n);
+                }
+                Op::Insert { remaining } => {
+                    let limit = (remaining as usize).min(out.len());
+                    let n = if self.pos < self.len {
+                        let n = limit.min(self.len - self.pos);
+                        out[..n].copy_from_slice(&self.buf[self.pos..self.pos + n]);
+                        self.pos += n;
+                        n
+                    } else {
+                        // Long literals inflate straight into the output
+                        match self.inflater.inflate(source, &mut out[..limit])? {
+                            0 => return Err(corrupt("patch ends mid-insert")),
+                            n => n,
+                        }
+                    };
+                    self.op = Op::Insert { remaining: remaining - n as u32 };
+                    return self.produce(n);
+                }
+                Op::End => {
+                    if self.produced != self.image_size {
+                        return Err(corrupt("patch output size differs from its header"));
+                    }
+                    return Ok(0);
+                }
+            }
+        }
+    }
+
+    fn produce(&mut self, n: usize) -> Result<usize, OtaError> {
+        self.produced += n as u32;
+        if self.produced > self.image_size {
+            return Err(corrupt("patch output exceeds its header size"));
+        }
+        Ok(n)
+    }
+}
+
+enum Kind {
+    Identity,
+    Deflate(Inflater),
+    Delta(Box<Patch>),
+}
+
+/// Turns the upload body into image bytes
+pub struct ImageDecoder<R> {
+    source: R,
+    kind: Kind,
+}
+
+impl<R> ImageDecoder<R>
+where
+    R: FnMut(&mut [u8]) -> Result<usize, OtaError>,
+{
+    /// `source` returns upload bytes, Ok(0) at the end of the body
+    pub fn new(encoding: Encoding, source: R) -> Result<Self, OtaError> {
+        let kind = match encoding {
+            Encoding::Identity => Kind::Identity,
+            Encoding::Deflate => Kind::Deflate(Inflater::new()),
+            Encoding::Delta => {
+                let base = Base::running().ok_or(OtaError::NoUpdatePartition)?;
+                Kind::Delta(Box::new(Patch {
+                    inflater: Inflater::new(),
+                    base,
+                    buf: [0; PATCH_BUFFER_SIZE],
+                    pos: 0,
+                    len: 0,
+                    op: Op::Header,
+                    image_size: 0,
+                    produced: 0,
+                }))
+            }
+        };
+        Ok(Self { source, kind })
+    }
+
+    /// Decode image bytes into `out` (non-empty); Ok(0) at the end of the image
+    pub fn read(&mut self, out: &mut [u8]) -> Result<usize, OtaError> {
+        match self.kind {
+            Kind::Identity => (self.source)(out),
+            Kind::Deflate(ref mut inflater) => inflater.inflate(&mut self.source, out),
+            Kind::Delta(ref mut patch) => patch.read(&mut self.source, out),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use flate2::{write::ZlibEncoder, Compression};
+    use std::io::Write;
+
+    fn zlib(data: &[u8]) -> Vec<u8> {
+        let mut encoder = ZlibEncoder::new(Vec::new(), Compression::best());
+        encoder.write_all(data).unwrap();
+        encoder.finish().unwrap()
+    }
+
+    /// Decode `upload` fed in `step`-byte pieces, reading in 1000-byte slices
+    fn decode(encoding: Encoding, upload: &[u8], step: usize) -> Result<Vec<u8>, OtaError> {
+        let mut offset = 0;
+        let source = |buf: &mut [u8]| {
+            let n = step.min(buf.len()).min(upload.len() - offset);
+            buf[..n].copy_from_slice(&upload[offset..offset + n]);
+            offset += n;
+            Ok(n)
+        };
+        let mut decoder = match encoding {
+            // The COPY-free patch below never touches the base partition
+            Encoding::Delta => ImageDecoder {
+                source,
+                kind: Kind::Delta(Box::new(Patch {
+                    inflater: Inflater::new(),
+                    base: Base { partition: core::ptr::null(), size: 0 },
+                    buf: [0; PATCH_BUFFER_SIZE],
+                    pos: 0,
+                    len: 0,
+                    op: Op::Header,
+                    image_size: 0,
+                    produced: 0,
+                })),
+            },
+            _ => ImageDecoder::new(encoding, source)?,
+        };
+        let mut image = Vec::new();
+        let mut out = [0u8; 1000];
+        loop {
+            match decoder.read(&mut out)? {
+                0 => return Ok(image),
+                n => image.extend_from_slice(&out[..n]),
+            }
+        }
+    }
+
+    #[test]
+    fn test_streaming_decode() {
+        let image: Vec<u8> = (0..20_000u32).map(|i| (i * 7 / 13) as u8).collect();
+
+        let compressed = zlib(&image);
+        assert_eq!(decode(Encoding::Deflate, &compressed, 7).unwrap(), image);
+        assert!(decode(Encoding::Deflate, &compressed[..compressed.len() / 2], 4096).is_err());
+
+        let mut patch = Vec::from(*PATCH_MAGIC);
+        patch.extend_from_slice(&[PATCH_VERSION, 0, 0, 0]);
+        patch.extend_from_slice(&(image.len() as u32).to_le_bytes());
+        for piece in image.chunks(6000) {
+            patch.push(OP_INSERT);
+            patch.extend_from_slice(&(piece.len() as u32).to_le_bytes());
+            patch.extend_from_slice(piece);
+        }
+        patch.push(OP_END);
+        assert_eq!(decode(Encoding::Delta, &zlib(&patch), 3).unwrap(), image);
+
+        // A copy beyond the base is rejected before any flash read
+        let mut bad = patch[..PATCH_HEADER_LEN].to_vec();
+        bad.push(OP_COPY);
+        bad.extend_from_slice(&[0, 0, 0, 0, 16, 0, 0, 0]);
+        assert!(decode(Encoding::Delta, &zlib(&bad), 4096).is_err());
+    }
+}
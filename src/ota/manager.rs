@@ -1,17 +1,17 @@
 // OTA Manager - handles firmware updates using ESP-IDF OTA API
 
-use core::ffi::c_void;
 use esp_idf_sys::{
-    esp_ota_begin, esp_ota_end, esp_ota_get_next_update_partition,
-    esp_ota_handle_t, esp_ota_set_boot_partition, esp_ota_write,
+    esp_ota_end, esp_ota_get_next_update_partition, esp_ota_set_boot_partition,
     esp_partition_t,
     esp_partition_find_first, esp_partition_type_t_ESP_PARTITION_TYPE_APP as ESP_PARTITION_TYPE_APP,
     esp_partition_subtype_t_ESP_PARTITION_SUBTYPE_APP_OTA_0 as ESP_PARTITION_SUBTYPE_APP_OTA_0,
 };
 use std::fmt;
 use std::ffi::CStr;
-use sha2::{Sha256, Digest};
 use esp_idf_hal::delay::FreeRtos;
+use std::sync::OnceLock;
+use super::decoder::{Encoding, ImageDecoder};
+use super::pipeline::{self, OtaPipeline};
 
 #[derive(Debug, Clone, Copy, PartialEq)]
 pub enum OtaStatus {
@@ -22,11 +22,13 @@ pub enum OtaStatus {
     Failed,
 }
 
-#[derive(Debug)]
+#[derive(Debug, Clone, Copy)]
 pub enum OtaError {
     NoUpdatePartition,
     BeginFailed,
+    ReceiveFailed,
     WriteFailed,
+    DecodeFailed,
     ValidationFailed,
     BootPartitionFailed,
     InvalidSize,
@@ -37,7 +39,9 @@ impl fmt::Display for OtaError {
         match self {
             OtaError::NoUpdatePartition => write!(f, "No update partition available"),
             OtaError::BeginFailed => write!(f, "Failed to begin OTA update"),
+            OtaError::ReceiveFailed => write!(f, "Failed to receive OTA data"),
             OtaError::WriteFailed => write!(f, "Failed to write OTA data"),
+            OtaError::DecodeFailed => write!(f, "Failed to decode OTA image"),
             OtaError::ValidationFailed => write!(f, "OTA validation failed"),
             OtaError::BootPartitionFailed => write!(f, "Failed to set boot partition"),
             OtaError::InvalidSize => write!(f, "Invalid firmware size"),
@@ -49,12 +53,10 @@ impl std::error::Error for OtaError {}
 
 pub struct OtaManager {
     update_partition: *const esp_partition_t,
-    ota_handle: Option<esp_ota_handle_t>,
-    expected_size: usize,
-    bytes_written: usize,
+    pipeline: Option<OtaPipeline>,
     status: OtaStatus,
-    sha256_hasher: Option<Sha256>,
     expected_sha256: Option<String>,
+    encoding: Encoding,
 }
 
 // SAFETY: OtaManager only contains a pointer to the partition structure which is
@@ -116,12 +118,10 @@ impl OtaManager {
         
         Ok(Self {
             update_partition,
-            ota_handle: None,
-            expected_size: 0,
-            bytes_written: 0,
+            pipeline: None,
             status: OtaStatus::Idle,
-            sha256_hasher: None,
             expected_sha256: None,
+            encoding: Encoding::Identity,
         })
     }
     
@@ -129,6 +129,11 @@ impl OtaManager {
         self.expected_sha256 = Some(sha256);
     }
     
+    /// How the next upload is encoded; the SHA-256 is always of the decoded image
+    pub fn set_encoding(&mut self, encoding: Encoding) {
+        self.encoding = encoding;
+    }
+    
     pub fn begin_update(&mut self, size: usize) -> Result<(), OtaError> {
         if size == 0 || size > 4 * 1024 * 1024 {
             // Sanity check: firmware should be between 0 and 4MB
@@ -146,96 +151,50 @@ impl OtaManager {
                 label, partition.address, partition.size);
         }
         
-        let mut handle: esp_ota_handle_t = 0;
-        
-        let result = unsafe {
-            esp_ota_begin(
-                self.update_partition,
-                size as _,
-                &mut handle as *mut _,
-            )
-        };
-        
-        if result != 0 {
-            log::error!("OTA: esp_ota_begin failed with error code: {} (0x{:x})", result, result);
-            
-            // Log specific error details
-            match result {
-                -1 => log::error!("OTA: ESP_FAIL - Generic failure"),
-                0x101 => log::error!("OTA: ESP_ERR_NO_MEM - Out of memory"),
-                0x102 => log::error!("OTA: ESP_ERR_INVALID_ARG - Invalid argument"), 
-                0x103 => log::error!("OTA: ESP_ERR_INVALID_STATE - Invalid state"),
-                0x104 => log::error!("OTA: ESP_ERR_INVALID_SIZE - Invalid size"),
-                0x105 => log::error!("OTA: ESP_ERR_NOT_FOUND - Requested resource not found"),
-                0x106 => log::error!("OTA: ESP_ERR_NOT_SUPPORTED - Operation not supported"),
-                0x107 => log::error!("OTA: ESP_ERR_TIMEOUT - Operation timed out"),
-                0x108 => log::error!("OTA: ESP_ERR_INVALID_RESPONSE - Received invalid response"),
-                0x109 => log::error!("OTA: ESP_ERR_INVALID_CRC - CRC or checksum was invalid"),
-                0x10A => log::error!("OTA: ESP_ERR_INVALID_VERSION - Version was invalid"),
-                0x10B => log::error!("OTA: ESP_ERR_INVALID_MAC - MAC address was invalid"),
-                0x10C => log::error!("OTA: ESP_ERR_NOT_FINISHED - Operation has not fully completed"),
-                0x1500 => log::error!("OTA: ESP_ERR_OTA_BASE - OTA error base"),
-                0x1501 => log::error!("OTA: ESP_ERR_OTA_PARTITION_CONFLICT - Partition conflict"),
-                0x1502 => log::error!("OTA: ESP_ERR_OTA_SELECT_INFO_INVALID - OTA data partition invalid"),
-                0x1503 => log::error!("OTA: ESP_ERR_OTA_VALIDATE_FAILED - OTA image validate failed"),
-                0x1504 => log::error!("OTA: ESP_ERR_OTA_SMALL_SEC_VER - New firmware security version is less than current"),
-                0x1505 => log::error!("OTA: ESP_ERR_OTA_ROLLBACK_FAILED - Rollback failed"),
-                0x1506 => log::error!("OTA: ESP_ERR_OTA_ROLLBACK_INVALID_STATE - Invalid rollback state"),
-                _ => log::error!("OTA: Unknown error code: {} (0x{:x})", result, result),
-            }
-            
-            return Err(OtaError::BeginFailed);
-        }
-        
-        self.ota_handle = Some(handle);
-        self.expected_size = size;
-        self.bytes_written = 0;
+        // The erase runs on Core 1 while the first chunks are received
+        self.pipeline = Some(OtaPipeline::start(self.update_partition, size)?);
         self.status = OtaStatus::Downloading { progress: 0 };
-        self.sha256_hasher = Some(Sha256::new());
         
         Ok(())
     }
     
-    pub fn write_chunk(&mut self, data: &[u8]) -> Result<(), OtaError> {
-        let handle = self.ota_handle.ok_or(OtaError::WriteFailed)?;
-        
-        // Update SHA256 hash
-        if let Some(ref mut hasher) = self.sha256_hasher {
-            hasher.update(data);
-        }
-        
-        let result = unsafe {
-            esp_ota_write(
-                handle,
-                data.as_ptr() as *const c_void,
-                data.len() as _,
-            )
+    /// Receive and decode the upload from `read` (Ok(0) at the end of the
+    /// body) while Core 1 hashes and flashes it
+    pub fn receive<E: fmt::Debug>(&mut self, mut read: impl FnMut(&mut [u8]) -> Result<usize, E>) -> Result<usize, OtaError> {
+        let pipeline = self.pipeline.as_mut().ok_or(OtaError::WriteFailed)?;
+        let source = |buf: &mut [u8]| match read(buf) {
+            Ok(n) => {
+                pipeline::count_upload(n);
+                Ok(n)
+            }
+            Err(e) => {
+                log::error!("OTA: Reading request body failed: {:?}", e);
+                Err(OtaError::ReceiveFailed)
+            }
         };
-        
-        if result != 0 {
+        let result = ImageDecoder::new(self.encoding, source)
+            .and_then(|mut decoder| pipeline.receive(|out| decoder.read(out)));
+        if result.is_err() {
+            self.pipeline = None;
             self.status = OtaStatus::Failed;
-            return Err(OtaError::WriteFailed);
         }
-        
-        self.bytes_written += data.len();
-        
-        // Update progress
-        if self.expected_size > 0 {
-            let progress = ((self.bytes_written * 100) / self.expected_size) as u8;
-            self.status = OtaStatus::Downloading { progress };
-        }
-        
-        Ok(())
+        result
     }
     
     pub fn finish_update(&mut self) -> Result<(), OtaError> {
-        let handle = self.ota_handle.take().ok_or(OtaError::ValidationFailed)?;
+        let pipeline = self.pipeline.take().ok_or(OtaError::ValidationFailed)?;
         
         self.status = OtaStatus::Verifying;
+        let (handle, computed) = match pipeline.finish() {
+            Ok(finished) => finished,
+            Err(e) => {
+                self.status = OtaStatus::Failed;
+                return Err(e);
+            }
+        };
         
         // Verify SHA256 if provided
-        if let (Some(hasher), Some(expected)) = (self.sha256_hasher.take(), &self.expected_sha256) {
-            let computed = format!("{:x}", hasher.finalize());
+        if let Some(ref expected) = self.expected_sha256 {
             log::info!("OTA: Computed SHA256: {}", computed);
             log::info!("OTA: Expected SHA256: {}", expected);
             
@@ -271,18 +230,39 @@ impl OtaManager {
     }
     
     pub fn get_status(&self) -> OtaStatus {
-        self.status
+        match self.status {
+            // Progress is counted by the writer jobs
+            OtaStatus::Downloading { .. } => OtaStatus::Downloading { progress: pipeline::progress() },
+            status => status,
+        }
     }
     
     pub fn get_progress(&self) -> u8 {
         match self.status {
-            OtaStatus::Downloading { progress } => progress,
+            OtaStatus::Downloading { .. } => pipeline::progress(),
             OtaStatus::Ready => 100,
             _ => 0,
         }
     }
 }
 
+/// SHA-256 appended to the running app image (hex), which identifies the
+/// base a delta update must have been built against. Hashed once, on first use.
+pub fn running_image_sha256() -> Option<&'static str> {
+    static DIGEST: OnceLock<Option<String>> = OnceLock::new();
+    DIGEST.get_or_init(|| {
+        let running = unsafe { esp_idf_sys::esp_ota_get_running_partition() };
+        if running.is_null() {
+            return None;
+        }
+        let mut digest = [0u8; 32];
+        if unsafe { esp_idf_sys::esp_partition_get_sha256(running, digest.as_mut_ptr()) } != 0 {
+            return None;
+        }
+        Some(digest.iter().map(|b| format!("{:02x}", b)).collect())
+    }).as_deref()
+}
+
 /// Ensure the device is booted into an OTA slot (ota_0/ota_1). If currently
 /// running from the factory partition but an OTA partition exists, switch the
 /// boot partition to the first OTA slot and reboot. Returns true if a switch
@@ -328,12 +308,3 @@ pub fn ensure_ota_boot_if_needed() -> bool {
         true
     }
 }
-
-impl Drop for OtaManager {
-    fn drop(&mut self) {
-        // Clean up any ongoing OTA operation
-        if let Some(handle) = self.ota_handle.take() {
-            unsafe { esp_ota_end(handle); }
-        }
-    }
-}
\ No newline at end of file
@@ -1,6 +1,8 @@
 // OTA (Over-The-Air) update module
 
+pub mod decoder;
 pub mod manager;
+pub mod pipeline;
 
 pub use manager::{OtaManager, OtaStatus};
 
@@ -0,0 +1,423 @@
+// Double-buffered OTA writer
+//
+// The upload handler only receives: it reads the socket, through the image
+// decoder, straight into PSRAM chunks and queues each full chunk. A job
+// pinned to Core 1 hashes the chunk, writes it to flash and hands the buffer
+// back, so flash stalls no longer stop the TCP window from draining until
+// every chunk is queued. The first Core 1 job erases the image's flash range
+// while the first chunks are still arriving, instead of delaying the first
+// read. Without the dual-core processor the stages run inline, as before.
+
+use core::ffi::c_void;
+use esp_idf_sys::*;
+use serde::Serialize;
+use sha2::{Digest, Sha256};
+use std::sync::atomic::{AtomicBool, AtomicU32, Ordering};
+use std::sync::mpsc::{sync_channel, Receiver, SyncSender};
+use std::sync::{Arc, Mutex, MutexGuard};
+use crate::dual_core::{self, WorkItem, CORE_1};
+use super::manager::OtaError;
+
+/// Bytes received before a chunk is handed to the writer
+pub const CHUNK_SIZE: usize = 16 * 1024;
+
+/// Chunks in flight; the receiver blocks only when all of them are queued
+pub const CHUNK_COUNT: usize = 4;
+
+/// Chunks to fall back to in internal RAM when PSRAM is unavailable
+const INTERNAL_CHUNK_COUNT: usize = 2;
+
+struct Chunk {
+    data: *mut u8,
+    len: usize,
+}
+
+// Owned by exactly one stage at a time, passed along by value
+unsafe impl Send for Chunk {}
+
+impl Chunk {
+    fn alloc(caps: u32) -> Option<Self> {
+        let data = unsafe { heap_caps_malloc(CHUNK_SIZE, caps) } as *mut u8;
+        (!data.is_null()).then_some(Self { data, len: 0 })
+    }
+
+    fn filled(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.data, self.len) }
+    }
+
+    fn spare(&mut self) -> &mut [u8] {
+        unsafe { std::slice::from_raw_parts_mut(self.data.add(self.len), CHUNK_SIZE - self.len) }
+    }
+}
+
+impl Drop for Chunk {
+    fn drop(&mut self) {
+        unsafe { heap_caps_free(self.data as *mut c_void) };
+    }
+}
+
+/// Stage timings of the current or most recent update
+struct Stats {
+    active: AtomicBool,
+    expected_size: AtomicU32,
+    bytes_uploaded: AtomicU32,
+    bytes_received: AtomicU32,
+    bytes_written: AtomicU32,
+    chunks: AtomicU32,
+    started_us: AtomicU32,
+    finished_us: AtomicU32,
+    receive_us: AtomicU32,
+    receive_stall_us: AtomicU32,
+    erase_us: AtomicU32,
+    hash_us: AtomicU32,
+    flash_us: AtomicU32,
+}
+
+static STATS: Stats = Stats {
+    active: AtomicBool::new(false),
+    expected_size: AtomicU32::new(0),
+    bytes_uploaded: AtomicU32::new(0),
+    bytes_received: AtomicU32::new(0),
+    bytes_written: AtomicU32::new(0),
+    chunks: AtomicU32::new(0),
+    started_us: AtomicU32::new(0),
+    finished_us: AtomicU32::new(0),
+    receive_us: AtomicU32::new(0),
+    receive_stall_us: AtomicU32::new(0),
+    erase_us: AtomicU32::new(0),
+    hash_us: AtomicU32::new(0),
+    flash_us: AtomicU32::new(0),
+};
+
+/// Snapshot for /api/ota/status
+#[derive(Debug, Clone, Serialize)]
+pub struct PipelineStats {
+    pub active: bool,
+    pub expected_size: u32,
+    /// Body bytes off the wire; fewer than bytes_received for compressed images
+    pub bytes_uploaded: u32,
+    /// Image bytes after decoding
+    pub bytes_received: u32,
+    pub bytes_written: u32,
+    pub chunks: u32,
+    pub elapsed_ms: u32,
+    pub throughput_kbps: u32,
+    /// Time spent in socket reads
+    pub receive_ms: u32,
+    /// Time the receiver waited for the writer to free a chunk
+    pub receive_stall_ms: u32,
+    pub erase_ms: u32,
+    pub hash_ms: u32,
+    pub flash_ms: u32,
+    /// Time the writer waited for the receiver to fill a chunk
+    pub write_stall_ms: u32,
+}
+
+fn now_us() -> u32 {
+    unsafe { esp_timer_get_time() as u32 }
+}
+
+/// Add the time since `start` to `counter`
+fn charge(counter: &AtomicU32, start: u32) {
+    counter.fetch_add(now_us().wrapping_sub(start), Ordering::Relaxed);
+}
+
+pub fn stats() -> PipelineStats {
+    let ms = |counter: &AtomicU32| counter.load(Ordering::Relaxed) / 1000;
+    let active = STATS.active.load(Ordering::Relaxed);
+    let end = if active { now_us() } else { STATS.finished_us.load(Ordering::Relaxed) };
+    let elapsed_us = end.wrapping_sub(STATS.started_us.load(Ordering::Relaxed));
+    let bytes_written = STATS.bytes_written.load(Ordering::Relaxed);
+    let (erase_ms, hash_ms, flash_ms) = (ms(&STATS.erase_us), ms(&STATS.hash_us), ms(&STATS.flash_us));
+    PipelineStats {
+        active,
+        expected_size: STATS.expected_size.load(Ordering::Relaxed),
+        bytes_uploaded: STATS.bytes_uploaded.load(Ordering::Relaxed),
+        bytes_received: STATS.bytes_received.load(Ordering::Relaxed),
+        bytes_written,
+        chunks: STATS.chunks.load(Ordering::Relaxed),
+        elapsed_ms: elapsed_us / 1000,
+        throughput_kbps: if elapsed_us > 0 { (bytes_written as u64 * 1000 / elapsed_us as u64) as u32 } else { 0 },
+        receive_ms: ms(&STATS.receive_us),
+        receive_stall_ms: ms(&STATS.receive_stall_us),
+        erase_ms,
+        hash_ms,
+        flash_ms,
+        write_stall_ms: (elapsed_us / 1000).saturating_sub(erase_ms + hash_ms + flash_ms),
+    }
+}
+
+/// Count body bytes read from the socket
+pub(crate) fn count_upload(bytes: usize) {
+    STATS.bytes_uploaded.fetch_add(bytes as u32, Ordering::Relaxed);
+}
+
+/// Share of the image written to flash, 0-100
+pub fn progress() -> u8 {
+    let expected = STATS.expected_size.load(Ordering::Relaxed) as u64;
+    if expected == 0 {
+        return 0;
+    }
+    (STATS.bytes_written.load(Ordering::Relaxed) as u64 * 100 / expected).min(100) as u8
+}
+
+/// Writer-side state, only touched by jobs on Core 1 (and by finish())
+struct Writer {
+    handle: Option<esp_ota_handle_t>,
+    hasher: Sha256,
+    error: Option<OtaError>,
+}
+
+struct Shared {
+    writer: Mutex<Writer>,
+    // Set by the writer so the receiver stops early
+    failed: AtomicBool,
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|poisoned| poisoned.into_inner())
+}
+
+/// Queue `job` behind the earlier writer jobs
+fn run_on_writer<F: FnOnce() + Send + 'static>(job: F) {
+    match dual_core::processor() {
+        Some(processor) => processor.submit_pinned(WorkItem::HandleOta, CORE_1, job),
+        None => job(),
+    }
+}
+
+/// Run `job` after every queued writer job and wait for its result
+fn call_on_writer<R: Send + 'static, F: FnOnce() -> R + Send + 'static>(job: F) -> Option<R> {
+    match dual_core::processor() {
+        Some(processor) => processor.spawn_pinned(WorkItem::HandleOta, CORE_1, job).wait(),
+        None => Some(job()),
+    }
+}
+
+impl Shared {
+    fn fail(&self, writer: &mut Writer, error: OtaError) {
+        writer.error.get_or_insert(error);
+        self.failed.store(true, Ordering::Release);
+    }
+
+    fn begin(&self, partition: *const esp_partition_t, size: usize) {
+        let start = now_us();
+        let mut handle: esp_ota_handle_t = 0;
+        // A known size makes esp_ota_begin erase exactly the image's sectors
+        let result = unsafe { esp_ota_begin(partition, size as _, &mut handle) };
+        charge(&STATS.erase_us, start);
+
+        let mut writer = lock(&self.writer);
+        if result != ESP_OK {
+            log_begin_error(result);
+            self.fail(&mut writer, OtaError::BeginFailed);
+            return;
+        }
+        writer.handle = Some(handle);
+    }
+
+    fn write(&self, data: &[u8]) {
+        let mut writer = lock(&self.writer);
+        let Some(handle) = writer.handle.filter(|_| writer.error.is_none()) else {
+            return;
+        };
+
+        let start = now_us();
+        writer.hasher.update(data);
+        charge(&STATS.hash_us, start);
+
+        let start = now_us();
+        let result = unsafe { esp_ota_write(handle, data.as_ptr() as *const c_void, data.len() as _) };
+        charge(&STATS.flash_us, start);
+        if result != ESP_OK {
+            log::error!("OTA: esp_ota_write failed after {} bytes: 0x{:x}",
+                STATS.bytes_written.load(Ordering::Relaxed), result);
+            self.fail(&mut writer, OtaError::WriteFailed);
+            return;
+        }
+
+        let before = progress();
+        STATS.bytes_written.fetch_add(data.len() as u32, Ordering::Relaxed);
+        STATS.chunks.fetch_add(1, Ordering::Relaxed);
+        if progress() != before {
+            crate::power::frame_scheduler::wake(crate::power::frame_scheduler::WAKE_OTA);
+        }
+    }
+}
+
+/// An update in progress: the receive side of the pipeline plus the handle
+/// to its writer jobs
+pub struct OtaPipeline {
+    shared: Arc<Shared>,
+    free: Receiver<Chunk>,
+    recycle: SyncSender<Chunk>,
+    // Chunk being filled by the receiver
+    current: Option<Chunk>,
+    // Decoded image size declared by the upload
+    size: usize,
+}
+
+impl OtaPipeline {
+    /// Allocate the chunk pool and queue the partition erase for `size` bytes
+    pub fn start(partition: *const esp_partition_t, size: usize) -> Result<Self, OtaError> {
+        let (recycle, free) = sync_channel(CHUNK_COUNT);
+        let mut allocated = 0;
+        while allocated < CHUNK_COUNT {
+            let Some(chunk) = Chunk::alloc(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) else { break };
+            let _ = recycle.send(chunk);
+            allocated += 1;
+        }
+        while allocated < INTERNAL_CHUNK_COUNT {
+            let Some(chunk) = Chunk::alloc(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) else {
+                log::error!("OTA: No memory for {} KB receive chunks", CHUNK_SIZE / 1024);
+                return Err(OtaError::BeginFailed);
+            };
+            let _ = recycle.send(chunk);
+            allocated += 1;
+        }
+
+        for counter in [&STATS.bytes_uploaded, &STATS.bytes_received, &STATS.bytes_written, &STATS.chunks, &STATS.receive_us,
+                        &STATS.receive_stall_us, &STATS.erase_us, &STATS.hash_us, &STATS.flash_us] {
+            counter.store(0, Ordering::Relaxed);
+        }
+        STATS.expected_size.store(size as u32, Ordering::Relaxed);
+        STATS.started_us.store(now_us(), Ordering::Relaxed);
+        STATS.active.store(true, Ordering::Relaxed);
+        log::info!("OTA: Pipeline started with {} x {} KB chunks", allocated, CHUNK_SIZE / 1024);
+
+        let shared = Arc::new(Shared {
+            writer: Mutex::new(Writer { handle: None, hasher: Sha256::new(), error: None }),
+            failed: AtomicBool::new(false),
+        });
+        let begin = shared.clone();
+        let partition = partition as usize; // raw pointers aren't Send
+        run_on_writer(move || begin.begin(partition as *const esp_partition_t, size));
+
+        Ok(Self { shared, free, recycle, current: None, size })
+    }
+
+    /// Receive the image from `read`, which returns Ok(0) at the end of the
+    /// image, queuing each full chunk for the writer. Returns bytes received.
+    pub fn receive(&mut self, mut read: impl FnMut(&mut [u8]) -> Result<usize, OtaError>) -> Result<usize, OtaError> {
+        let mut total = 0;
+        loop {
+            if self.shared.failed.load(Ordering::Acquire) {
+                return Err(self.error());
+            }
+            if self.current.is_none() {
+                let start = now_us();
+                let chunk = self.free.recv().map_err(|_| OtaError::WriteFailed)?;
+                charge(&STATS.receive_stall_us, start);
+                self.current = Some(chunk);
+            }
+            let Some(chunk) = self.current.as_mut() else { continue };
+
+            let start = now_us();
+            let result = read(chunk.spare());
+            charge(&STATS.receive_us, start);
+            match result {
+                Ok(0) => break,
+                Ok(n) => {
+                    chunk.len += n;
+                    total += n;
+                    STATS.bytes_received.fetch_add(n as u32, Ordering::Relaxed);
+                    if chunk.len == CHUNK_SIZE {
+                        self.submit_current();
+                    }
+                }
+                Err(e) => {
+                    log::error!("OTA: Receive failed after {} bytes: {}", total, e);
+                    return Err(e);
+                }
+            }
+        }
+        self.submit_current();
+        Ok(total)
+    }
+
+    fn submit_current(&mut self) {
+        let Some(mut chunk) = self.current.take() else { return };
+        if chunk.len == 0 {
+            self.current = Some(chunk);
+            return;
+        }
+        let shared = self.shared.clone();
+        let recycle = self.recycle.clone();
+        run_on_writer(move || {
+            shared.write(chunk.filled());
+            chunk.len = 0;
+            let _ = recycle.send(chunk);
+        });
+    }
+
+    fn error(&self) -> OtaError {
+        lock(&self.shared.writer).error.unwrap_or(OtaError::WriteFailed)
+    }
+
+    /// Wait for the writer to drain; returns the OTA handle, ready for
+    /// esp_ota_end, and the hex SHA-256 of everything written. An image
+    /// shorter or longer than the declared size is aborted instead.
+    pub fn finish(mut self) -> Result<(esp_ota_handle_t, String), OtaError> {
+        self.submit_current();
+        let shared = self.shared.clone();
+        let size = self.size;
+        call_on_writer(move || {
+            let mut writer = lock(&shared.writer);
+            if let Some(error) = writer.error {
+                return Err(error);
+            }
+            let handle = writer.handle.take().ok_or(OtaError::BeginFailed)?;
+            let received = STATS.bytes_received.load(Ordering::Relaxed) as usize;
+            let written = STATS.bytes_written.load(Ordering::Relaxed) as usize;
+            if received != size || written != size {
+                log::error!("OTA: Image should be {} bytes, decoded {} and wrote {}", size, received, written);
+                unsafe { esp_ota_abort(handle) };
+                return Err(OtaError::InvalidSize);
+            }
+            Ok((handle, format!("{:x}", writer.hasher.clone().finalize())))
+        }).unwrap_or(Err(OtaError::WriteFailed))
+    }
+}
+
+impl Drop for OtaPipeline {
+    fn drop(&mut self) {
+        // Unfinished update: release the handle once the queued jobs are done
+        let shared = self.shared.clone();
+        run_on_writer(move || {
+            if let Some(handle) = lock(&shared.writer).handle.take() {
+                unsafe { esp_ota_abort(handle) };
+            }
+        });
+        STATS.finished_us.store(now_us(), Ordering::Relaxed);
+        STATS.active.store(false, Ordering::Relaxed);
+    }
+}
+
+fn log_begin_error(result: esp_err_t) {
+    log::error!("OTA: esp_ota_begin failed with error code: {} (0x{:x})", result, result);
+
+    // Log specific error details
+    match result {
+        -1 => log::error!("OTA: ESP_FAIL - Generic failure"),
+        0x101 => log::error!("OTA: ESP_ERR_NO_MEM - Out of memory"),
+        0x102 => log::error!("OTA: ESP_ERR_INVALID_ARG - Invalid argument"),
+        0x103 => log::error!("OTA: ESP_ERR_INVALID_STATE - Invalid state"),
+        0x104 => log::error!("OTA: ESP_ERR_INVALID_SIZE - Invalid size"),
+        0x105 => log::error!("OTA: ESP_ERR_NOT_FOUND - Requested resource not found"),
+        0x106 => log::error!("OTA: ESP_ERR_NOT_SUPPORTED - Operation not supported"),
+        0x107 => log::error!("OTA: ESP_ERR_TIMEOUT - Operation timed out"),
+        0x108 => log::error!("OTA: ESP_ERR_INVALID_RESPONSE - Received invalid response"),
+        0x109 => log::error!("OTA: ESP_ERR_INVALID_CRC - CRC or checksum was invalid"),
+        0x10A => log::error!("OTA: ESP_ERR_INVALID_VERSION - Version was invalid"),
+        0x10B => log::error!("OTA: ESP_ERR_INVALID_MAC - MAC address was invalid"),
+        0x10C => log::error!("OTA: ESP_ERR_NOT_FINISHED - Operation has not fully completed"),
+        0x1500 => log::error!("OTA: ESP_ERR_OTA_BASE - OTA error base"),
+        0x1501 => log::error!("OTA: ESP_ERR_OTA_PARTITION_CONFLICT - Partition conflict"),
+        0x1502 => log::error!("OTA: ESP_ERR_OTA_SELECT_INFO_INVALID - OTA data partition invalid"),
+        0x1503 => log::error!("OTA: ESP_ERR_OTA_VALIDATE_FAILED - OTA image validate failed"),
+        0x1504 => log::error!("OTA: ESP_ERR_OTA_SMALL_SEC_VER - New firmware security version is less than current"),
+        0x1505 => log::error!("OTA: ESP_ERR_OTA_ROLLBACK_FAILED - Rollback failed"),
+        0x1506 => log::error!("OTA: ESP_ERR_OTA_ROLLBACK_INVALID_STATE - Invalid rollback state"),
+        _ => log::error!("OTA: Unknown error code: {} (0x{:x})", result, result),
+    }
+}
@@ -182,6 +182,7 @@ pub struct PerformanceMetrics {
     // Timing breakdown
     pub last_render_time: Duration,
     pub last_flush_time: Duration,
+    pub last_flush_wait: Duration,
     
     // Memory stats
     pub heap_free: usize,
@@ -198,6 +199,7 @@ impl PerformanceMetrics {
             fps_tracker: FpsTracker::new(),
             last_render_time: Duration::ZERO,
             last_flush_time: Duration::ZERO,
+            last_flush_wait: Duration::ZERO,
             heap_free: 0,
             heap_largest_block: 0,
             psram_free: 0,
@@ -235,4 +237,9 @@ impl PerformanceMetrics {
         self.last_flush_time = duration;
     }
     
+    /// Record how long the render loop was blocked by the flush
+    pub fn record_flush_wait(&mut self, duration: Duration) {
+        self.last_flush_wait = duration;
+    }
+    
 }
\ No newline at end of file
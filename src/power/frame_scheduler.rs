@@ -0,0 +1,147 @@
+// Event-driven frame scheduling for the main loop
+//
+// Instead of sleeping a fixed frame period, the main task blocks on its
+// FreeRTOS task notification until the earliest deadline it registered or
+// until another task (or an ISR) signals new work. Wake reasons are
+// notification bits, so a burst of events costs a single wake-up.
+
+use esp_idf_sys::*;
+use std::sync::atomic::{AtomicPtr, Ordering};
+use std::time::{Duration, Instant};
+use super::PowerMode;
+
+/// Button edge seen by the GPIO ISR
+pub const WAKE_BUTTON: u32 = 1 << 0;
+/// Core 1 has sent processed sensor data
+pub const WAKE_SENSOR_DATA: u32 = 1 << 1;
+/// OTA status or progress changed
+pub const WAKE_OTA: u32 = 1 << 2;
+
+/// Longest single sleep; keeps the loop's periodic housekeeping alive
+const MAX_SLEEP: Duration = Duration::from_secs(1);
+
+// Task blocked in FrameScheduler::wait, null until a scheduler exists
+static SCHEDULER_TASK: AtomicPtr<tskTaskControlBlock> = AtomicPtr::new(core::ptr::null_mut());
+
+/// Wake the main loop from task context
+pub fn wake(reason: u32) {
+    let task = SCHEDULER_TASK.load(Ordering::Acquire);
+    if task.is_null() {
+        return;
+    }
+    unsafe {
+        xTaskGenericNotify(task, 0, reason, eNotifyAction_eSetBits, core::ptr::null_mut());
+    }
+}
+
+/// Wake the main loop from an interrupt handler
+pub fn wake_from_isr(reason: u32) {
+    let task = SCHEDULER_TASK.load(Ordering::Acquire);
+    if task.is_null() {
+        return;
+    }
+    let mut higher_priority_woken: BaseType_t = 0;
+    unsafe {
+        xTaskGenericNotifyFromISR(task, 0, reason, eNotifyAction_eSetBits,
+                                  core::ptr::null_mut(), &mut higher_priority_woken);
+    }
+    if higher_priority_woken != 0 {
+        esp_idf_hal::task::do_yield();
+    }
+}
+
+pub struct FrameScheduler {
+    // Frame period floor imposed by the display hardware
+    min_frame_period: Duration,
+    frame_period: Duration,
+    last_frame: Instant,
+    // Earliest deadline registered for the current iteration
+    next_deadline: Option<Instant>,
+    // Idle accounting since the last take_idle_percent()
+    idle: Duration,
+    window_start: Instant,
+}
+
+impl FrameScheduler {
+    /// Create the scheduler for the calling task, which becomes the target
+    /// of wake() and wake_from_isr()
+    pub fn new(max_fps: f32) -> Self {
+        let task = unsafe { xTaskGetCurrentTaskHandle() };
+        SCHEDULER_TASK.store(task, Ordering::Release);
+
+        let min_frame_period = Duration::from_secs_f32(1.0 / max_fps);
+        let now = Instant::now();
+        Self {
+            min_frame_period,
+            frame_period: PowerMode::Active.frame_period().max(min_frame_period),
+            last_frame: now,
+            next_deadline: None,
+            idle: Duration::ZERO,
+            window_start: now,
+        }
+    }
+
+    /// Scale the frame rate with the power mode
+    pub fn set_power_mode(&mut self, mode: PowerMode) {
+        self.frame_period = mode.frame_period().max(self.min_frame_period);
+    }
+
+    /// Whether a frame may be rendered now without exceeding the target FPS
+    pub fn frame_due(&self) -> bool {
+        self.last_frame.elapsed() >= self.frame_period
+    }
+
+    pub fn frame_rendered(&mut self) {
+        self.last_frame = Instant::now();
+    }
+
+    /// Earliest time the next frame may be rendered
+    pub fn next_frame_at(&self) -> Instant {
+        self.last_frame + self.frame_period
+    }
+
+    /// Register a deadline the next wait() must not sleep past
+    pub fn schedule(&mut self, at: Instant) {
+        self.next_deadline = Some(match self.next_deadline {
+            Some(current) => current.min(at),
+            None => at,
+        });
+    }
+
+    /// Sleep until the earliest scheduled deadline or a wake() call.
+    /// Returns the wake reason bits, 0 when a deadline expired.
+    pub fn wait(&mut self) -> u32 {
+        let now = Instant::now();
+        let timeout = self.next_deadline.take()
+            .map_or(MAX_SLEEP, |deadline| deadline.saturating_duration_since(now))
+            .min(MAX_SLEEP);
+
+        // Round up so a deadline is never missed by a partial tick
+        let ticks = ((timeout.as_micros() as u64 * configTICK_RATE_HZ as u64 + 999_999) / 1_000_000) as TickType_t;
+        let mut reasons: u32 = 0;
+        unsafe {
+            xTaskGenericNotifyWait(0, 0, u32::MAX, &mut reasons, ticks);
+        }
+        self.idle += now.elapsed();
+        reasons
+    }
+
+    /// Share of wall time spent sleeping since the previous call, 0-100
+    pub fn take_idle_percent(&mut self) -> u8 {
+        let window = self.window_start.elapsed();
+        let percent = if window.is_zero() {
+            0
+        } else {
+            (self.idle.as_secs_f32() / window.as_secs_f32() * 100.0).min(100.0) as u8
+        };
+        self.idle = Duration::ZERO;
+        self.window_start = Instant::now();
+        percent
+    }
+}
+
+impl Drop for FrameScheduler {
+    fn drop(&mut self) {
+        SCHEDULER_TASK.store(core::ptr::null_mut(), Ordering::Release);
+    }
+}
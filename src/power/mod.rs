@@ -1,6 +1,7 @@
 // Power management system for ESP32-S3 dashboard
 
 // pub mod voltage_monitor; // removed (unused)
+pub mod frame_scheduler;
 
 use std::time::{Duration, Instant};
 use esp_idf_hal::gpio::{AnyIOPin, Output, PinDriver};
@@ -12,6 +13,17 @@ pub enum PowerMode {
     Sleep,       // Display off, wake on button press
 }
 
+impl PowerMode {
+    /// Target display update period
+    pub fn frame_period(self) -> Duration {
+        match self {
+            PowerMode::Active => Duration::from_millis(33),      // 30 FPS
+            PowerMode::PowerSave => Duration::from_millis(100),  // 10 FPS
+            PowerMode::Sleep => Duration::from_secs(1),          // 1 FPS (minimal)
+        }
+    }
+}
+
 #[derive(Debug, Clone, Copy)]
 pub struct PowerConfig {
     pub active_brightness: u8,         // 0-100
@@ -100,11 +112,7 @@ impl PowerManager {
     }
     
     pub fn get_update_rate(&self) -> Duration {
-        match self.current_mode {
-            PowerMode::Active => Duration::from_millis(33),      // 30 FPS
-            PowerMode::PowerSave => Duration::from_millis(100),  // 10 FPS
-            PowerMode::Sleep => Duration::from_secs(1),          // 1 FPS (minimal)
-        }
+        self.current_mode.frame_period()
     }
     
     
@@ -1,4 +1,8 @@
 // Efficient ring buffer implementation for performance tracking
+use std::cell::UnsafeCell;
+use std::mem::MaybeUninit;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicU32, AtomicUsize, Ordering};
 use std::time::Duration;
 
 /// Fixed-size ring buffer for storing frame times without allocations
@@ -37,7 +41,7 @@ impl<T: Default + Copy, const N: usize> RingBuffer<T, N> {
     }
     
     /// Get an iterator over the elements (oldest to newest)
-    pub fn iter(&self) -> RingBufferIter<T, N> {
+    pub fn iter(&self) -> RingBufferIter<'_, T, N> {
         RingBufferIter {
             buffer: &self.buffer,
             head: self.head,
@@ -209,6 +213,189 @@ impl<const N: usize> DurationRingBuffer<N> {
     }
 }
 
+/// Keeps a hot atomic on its own cache line so producer and consumer
+/// indices don't share one (ESP32-S3 data cache lines are 32 bytes)
+#[repr(align(32))]
+struct CachePadded<T>(T);
+
+impl<T> std::ops::Deref for CachePadded<T> {
+    type Target = T;
+
+    fn deref(&self) -> &T {
+        &self.0
+    }
+}
+
+/// Occupancy and loss counters for an SPSC ring
+#[derive(Debug, Clone, Copy, Default)]
+pub struct RingStats {
+    pub len: usize,
+    pub capacity: usize,
+    pub high_water: usize,
+    pub dropped: u32,
+}
+
+/// Fixed-capacity lock-free ring between exactly one producer and one
+/// consumer, typically on different cores. Storage is allocated once when
+/// the ring is created; pushing and popping never allocate or block.
+///
+/// Indices increase monotonically and wrap through `N`, which must be a
+/// power of two. A full ring can either reject the new value or overwrite
+/// the oldest; either way the loss is counted.
+pub struct SpscRing<T: Copy, const N: usize> {
+    buffer: [UnsafeCell<MaybeUninit<T>>; N],
+    // Next slot to write, only stored by the producer
+    head: CachePadded<AtomicUsize>,
+    // Next slot to read; advanced by the consumer, or by the producer when
+    // it overwrites, so both sides move it with compare-exchange
+    tail: CachePadded<AtomicUsize>,
+    dropped: AtomicU32,
+    high_water: AtomicUsize,
+}
+
+// Producer and consumer handles guarantee one writer and one reader
+unsafe impl<T: Copy + Send, const N: usize> Sync for SpscRing<T, N> {}
+
+impl<T: Copy, const N: usize> SpscRing<T, N> {
+    const MASK: usize = {
+        assert!(N.is_power_of_two(), "SpscRing capacity must be a power of two");
+        N - 1
+    };
+
+    fn new() -> Self {
+        Self {
+            buffer: std::array::from_fn(|_| UnsafeCell::new(MaybeUninit::uninit())),
+            head: CachePadded(AtomicUsize::new(0)),
+            tail: CachePadded(AtomicUsize::new(0)),
+            dropped: AtomicU32::new(0),
+            high_water: AtomicUsize::new(0),
+        }
+    }
+
+    /// Write `value` at `head` and publish it (producer only, slot must be free)
+    fn publish(&self, head: usize, value: T) {
+        unsafe { (*self.buffer[head & Self::MASK].get()).write(value) };
+        self.head.store(head.wrapping_add(1), Ordering::Release);
+
+        let len = head.wrapping_add(1).wrapping_sub(self.tail.load(Ordering::Relaxed));
+        self.high_water.fetch_max(len.min(N), Ordering::Relaxed);
+    }
+
+    fn push(&self, value: T) -> Result<(), T> {
+        let head = self.head.load(Ordering::Relaxed);
+        let tail = self.tail.load(Ordering::Acquire);
+        if head.wrapping_sub(tail) >= N {
+            self.dropped.fetch_add(1, Ordering::Relaxed);
+            return Err(value);
+        }
+        self.publish(head, value);
+        Ok(())
+    }
+
+    fn push_overwrite(&self, value: T) -> bool {
+        let head = self.head.load(Ordering::Relaxed);
+        let mut tail = self.tail.load(Ordering::Acquire);
+        let mut overwrote = false;
+        while head.wrapping_sub(tail) >= N {
+            // Retire the oldest slot before reusing it; a consumer reading it
+            // concurrently loses the race on `tail` and discards its copy
+            match self.tail.compare_exchange_weak(tail, tail.wrapping_add(1),
+                                                  Ordering::AcqRel, Ordering::Acquire) {
+                Ok(_) => {
+                    self.dropped.fetch_add(1, Ordering::Relaxed);
+                    overwrote = true;
+                    break;
+                }
+                Err(current) => tail = current,
+            }
+        }
+        self.publish(head, value);
+        overwrote
+    }
+
+    fn pop(&self) -> Option<T> {
+        let mut tail = self.tail.load(Ordering::Acquire);
+        loop {
+            let head = self.head.load(Ordering::Acquire);
+            if tail == head {
+                return None;
+            }
+            // Copy first, then claim the slot; if the producer overwrote it
+            // meanwhile the claim fails and the copy is discarded
+            let value = unsafe { std::ptr::read_volatile(self.buffer[tail & Self::MASK].get()) };
+            match self.tail.compare_exchange_weak(tail, tail.wrapping_add(1),
+                                                  Ordering::AcqRel, Ordering::Acquire) {
+                Ok(_) => return Some(unsafe { value.assume_init() }),
+                Err(current) => tail = current,
+            }
+        }
+    }
+
+    fn stats(&self) -> RingStats {
+        let head = self.head.load(Ordering::Acquire);
+        let tail = self.tail.load(Ordering::Acquire);
+        RingStats {
+            len: head.wrapping_sub(tail).min(N),
+            capacity: N,
+            high_water: self.high_water.load(Ordering::Relaxed),
+            dropped: self.dropped.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// Create an SPSC ring and split it into its two ends
+pub fn spsc_ring<T: Copy, const N: usize>() -> (RingProducer<T, N>, RingConsumer<T, N>) {
+    let ring = Arc::new(SpscRing::new());
+    (RingProducer { ring: ring.clone() }, RingConsumer { ring })
+}
+
+/// Sending end of an SPSC ring; deliberately not Clone
+pub struct RingProducer<T: Copy, const N: usize> {
+    ring: Arc<SpscRing<T, N>>,
+}
+
+impl<T: Copy, const N: usize> RingProducer<T, N> {
+    /// Append `value`, handing it back if the ring is full
+    pub fn push(&self, value: T) -> Result<(), T> {
+        self.ring.push(value)
+    }
+
+    /// Append `value`, dropping the oldest entry if the ring is full.
+    /// Returns true if an entry was dropped.
+    pub fn push_overwrite(&self, value: T) -> bool {
+        self.ring.push_overwrite(value)
+    }
+
+    pub fn stats(&self) -> RingStats {
+        self.ring.stats()
+    }
+}
+
+/// Receiving end of an SPSC ring; deliberately not Clone
+pub struct RingConsumer<T: Copy, const N: usize> {
+    ring: Arc<SpscRing<T, N>>,
+}
+
+impl<T: Copy, const N: usize> RingConsumer<T, N> {
+    /// Take the oldest entry, if any
+    pub fn pop(&self) -> Option<T> {
+        self.ring.pop()
+    }
+
+    /// Drain the ring, returning only the newest entry
+    pub fn pop_latest(&self) -> Option<T> {
+        let mut latest = None;
+        while let Some(value) = self.ring.pop() {
+            latest = Some(value);
+        }
+        latest
+    }
+
+    pub fn stats(&self) -> RingStats {
+        self.ring.stats()
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -250,7 +437,68 @@ mod tests {
         // Overwrite oldest
         buffer.push(Duration::from_millis(5));
         
-        assert_eq!(buffer.average(), Some(Duration::from_millis(18))); // (20+30+5)/3
+        assert_eq!(buffer.average(), Some(Duration::from_millis(20 + 30 + 5) / 3));
         assert_eq!(buffer.min(), Some(Duration::from_millis(5)));
     }
-}
\ No newline at end of file
+    
+    #[test]
+    fn test_spsc_ring_fifo() {
+        let (tx, rx) = spsc_ring::<u32, 4>();
+        
+        assert!(rx.pop().is_none());
+        for i in 0..4 {
+            assert!(tx.push(i).is_ok());
+        }
+        // Full: rejected and counted
+        assert_eq!(tx.push(99), Err(99));
+        
+        let values: Vec<u32> = std::iter::from_fn(|| rx.pop()).collect();
+        assert_eq!(values, vec![0, 1, 2, 3]);
+        
+        let stats = rx.stats();
+        assert_eq!(stats.len, 0);
+        assert_eq!(stats.high_water, 4);
+        assert_eq!(stats.dropped, 1);
+    }
+    
+    #[test]
+    fn test_spsc_ring_overwrite_oldest() {
+        let (tx, rx) = spsc_ring::<u32, 4>();
+        
+        for i in 0..6 {
+            tx.push_overwrite(i);
+        }
+        
+        let values: Vec<u32> = std::iter::from_fn(|| rx.pop()).collect();
+        assert_eq!(values, vec![2, 3, 4, 5]);
+        assert_eq!(tx.stats().dropped, 2);
+        
+        tx.push_overwrite(7);
+        tx.push_overwrite(8);
+        assert_eq!(rx.pop_latest(), Some(8));
+        assert!(rx.pop().is_none());
+    }
+    
+    #[test]
+    fn test_spsc_ring_across_threads() {
+        let (tx, rx) = spsc_ring::<u64, 8>();
+        const COUNT: u64 = 10_000;
+        
+        let producer = std::thread::spawn(move || {
+            for i in 0..COUNT {
+                while tx.push(i).is_err() {
+                    std::thread::yield_now();
+                }
+            }
+        });
+        
+        let mut expected = 0;
+        while expected < COUNT {
+            if let Some(value) = rx.pop() {
+                assert_eq!(value, expected);
+                expected += 1;
+            }
+        }
+        producer.join().unwrap();
+    }
+}
@@ -0,0 +1,361 @@
+// Battery monitoring on ADC1 channel 3 (GPIO4) in continuous DMA mode
+//
+// The ADC digital controller converts at `sample_rate_hz` and DMA fills the
+// driver's ring of conversion frames without the CPU. Core 1 drains whatever
+// frames are ready on each DataProcessor pass, never waiting. Each frame is
+// oversampled to one mean and calibrated to millivolts once. It then goes
+// through a short median (rejecting display and backlight switching spikes)
+// and an IIR low-pass. Power-source detection runs on the filtered voltage
+// with hysteresis and reports only changes, so a USB plug or unplug reaches
+// the UI on the next pass rather than the next sensor tick.
+//
+// If the continuous driver cannot start, the same pipeline is fed from a
+// burst of one-shot reads per pass, still on Core 1.
+
+use esp_idf_sys::*;
+
+/// Conversion rate; the S3 digital controller accepts 611 Hz to 83.3 kHz
+pub const DEFAULT_SAMPLE_RATE_HZ: u32 = 1000;
+
+// Conversions averaged into one frame; each result is 4 bytes (TYPE2) on the S3
+const FRAME_CONVERSIONS: u32 = 64;
+const RESULT_BYTES: usize = 4;
+const FRAME_BYTES: usize = FRAME_CONVERSIONS as usize * RESULT_BYTES;
+// Driver ring: 8 frames, ~0.5 s at the default rate, well above the 100 ms drain interval
+const STORE_BYTES: usize = FRAME_BYTES * 8;
+// One-shot reads per pass when running without DMA
+const ONESHOT_BURST: u32 = 16;
+
+const BATTERY_CHANNEL: adc_channel_t = adc_channel_t_ADC_CHANNEL_3;
+const BATTERY_ATTEN: adc_atten_t = adc_atten_t_ADC_ATTEN_DB_12;
+
+const MEDIAN_FRAMES: usize = 5;
+// Each frame moves the IIR output by 1/8 of the difference
+const IIR_SHIFT: u32 = 3;
+// Thresholds shift by this much in favour of the current power state
+const HYSTERESIS_MV: u16 = 75;
+// Frames between [BATTERY_SAMPLE] debug lines (~10 s at the default rate)
+const LOG_EVERY_FRAMES: u32 = 150;
+
+/// Median over the last few frames, then a fixed-point (x256) IIR
+pub struct VoltageFilter {
+    window: [u16; MEDIAN_FRAMES],
+    len: usize,
+    next: usize,
+    iir: Option<u32>,
+}
+
+impl VoltageFilter {
+    pub const fn new() -> Self {
+        Self { window: [0; MEDIAN_FRAMES], len: 0, next: 0, iir: None }
+    }
+
+    /// Feed one frame's voltage, returning the filtered voltage
+    pub fn push(&mut self, mv: u16) -> u16 {
+        self.window[self.next] = mv;
+        self.next = (self.next + 1) % MEDIAN_FRAMES;
+        self.len = (self.len + 1).min(MEDIAN_FRAMES);
+        let mut sorted = self.window;
+        let recent = &mut sorted[..self.len];
+        recent.sort_unstable();
+        let median = (recent[self.len / 2] as u32) << 8;
+
+        let iir = match self.iir {
+            Some(prev) => prev - (prev >> IIR_SHIFT) + (median >> IIR_SHIFT),
+            None => median,
+        };
+        self.iir = Some(iir);
+        ((iir + 128) >> 8) as u16
+    }
+}
+
+/// Power source as seen on the battery pin
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct PowerState {
+    pub battery_connected: bool,
+    pub on_usb: bool,
+    pub charging: bool,
+}
+
+impl PowerState {
+    /// Classify `mv`, keeping each flag until the voltage clears its
+    /// threshold by HYSTERESIS_MV
+    pub fn next(self, mv: u16) -> Self {
+        let biased = |active: bool| if active { mv.saturating_add(HYSTERESIS_MV) } else { mv };
+        let battery_connected = super::is_battery_connected(0, biased(self.battery_connected));
+        Self {
+            battery_connected,
+            on_usb: super::is_on_usb_power(biased(self.on_usb), battery_connected),
+            charging: super::is_charging(biased(self.charging), battery_connected),
+        }
+    }
+}
+
+#[derive(Debug, Clone, Copy)]
+pub struct BatteryReading {
+    pub voltage_mv: u16,
+    pub percentage: u8,
+    pub power: PowerState,
+}
+
+enum Source {
+    Continuous(adc_continuous_handle_t),
+    Oneshot(adc_oneshot_unit_handle_t),
+    None,
+}
+
+/// Battery ADC pipeline, owned and polled by the Core 1 DataProcessor
+pub struct BatteryMonitor {
+    source: Source,
+    cali: Option<adc_cali_handle_t>,
+    buf: Vec<u8>,
+    // Oversampling accumulator for the frame in progress
+    sum: u32,
+    count: u32,
+    frames: u32,
+    filter: VoltageFilter,
+    reading: Option<BatteryReading>,
+}
+
+// The driver handles are only used by the task that owns the monitor
+unsafe impl Send for BatteryMonitor {}
+
+impl BatteryMonitor {
+    pub fn new(sample_rate_hz: u32) -> Self {
+        let source = match unsafe { start_continuous(sample_rate_hz) } {
+            Ok(handle) => {
+                log::info!("Battery ADC: continuous DMA at {} Hz, {} conversions per frame",
+                           sample_rate_hz, FRAME_CONVERSIONS);
+                Source::Continuous(handle)
+            }
+            Err(e) => {
+                log::warn!("Battery ADC: continuous mode unavailable ({}), using one-shot reads", e);
+                match unsafe { start_oneshot() } {
+                    Ok(handle) => Source::Oneshot(handle),
+                    Err(e) => {
+                        log::error!("Battery ADC: one-shot init failed: {}", e);
+                        Source::None
+                    }
+                }
+            }
+        };
+        let cali = unsafe { create_calibration() };
+        if cali.is_none() {
+            log::warn!("Battery ADC: no eFuse calibration, using the linear 0-3100 mV fit");
+        }
+        Self {
+            source,
+            cali,
+            buf: vec![0; STORE_BYTES / 2],
+            sum: 0,
+            count: 0,
+            frames: 0,
+            filter: VoltageFilter::new(),
+            reading: None,
+        }
+    }
+
+    /// Latest filtered reading, once the first frame has been converted
+    pub fn reading(&self) -> Option<BatteryReading> {
+        self.reading
+    }
+
+    /// Process every frame converted since the last call. Returns true if
+    /// the power source (battery, USB, charging) changed.
+    pub fn poll(&mut self) -> bool {
+        let before = self.reading.map(|r| r.power);
+        match self.source {
+            Source::Continuous(handle) => self.drain_continuous(handle),
+            Source::Oneshot(handle) => self.read_oneshot(handle),
+            Source::None => {}
+        }
+        let after = self.reading.map(|r| r.power);
+        if let (Some(before), Some(after)) = (before, after) {
+            if before != after {
+                log::info!("Power source changed: battery {} -> {}, USB {} -> {}, charging {} -> {}",
+                           before.battery_connected, after.battery_connected,
+                           before.on_usb, after.on_usb, before.charging, after.charging);
+                return true;
+            }
+        }
+        before.is_none() && after.is_some()
+    }
+
+    fn drain_continuous(&mut self, handle: adc_continuous_handle_t) {
+        loop {
+            let mut len = 0u32;
+            let ret = unsafe { adc_continuous_read(handle, self.buf.as_mut_ptr(), self.buf.len() as u32, &mut len, 0) };
+            if ret != ESP_OK || len == 0 {
+                // ESP_ERR_TIMEOUT: the ring is empty
+                return;
+            }
+            for i in (0..len as usize / RESULT_BYTES).map(|i| i * RESULT_BYTES) {
+                let result: adc_digi_output_data_t =
+                    unsafe { core::ptr::read_unaligned(self.buf[i..].as_ptr() as *const adc_digi_output_data_t) };
+                let (channel, data) = unsafe {
+                    (result.__bindgen_anon_1.type2.channel(), result.__bindgen_anon_1.type2.data())
+                };
+                if channel == BATTERY_CHANNEL as u32 {
+                    self.accumulate(data);
+                }
+            }
+        }
+    }
+
+    fn read_oneshot(&mut self, handle: adc_oneshot_unit_handle_t) {
+        for _ in 0..ONESHOT_BURST {
+            let mut raw = 0i32;
+            if unsafe { adc_oneshot_read(handle, BATTERY_CHANNEL, &mut raw) } == ESP_OK {
+                self.accumulate(raw.max(0) as u32);
+            }
+        }
+        // A burst is one frame
+        if self.count > 0 {
+            self.finish_frame();
+        }
+    }
+
+    fn accumulate(&mut self, raw: u32) {
+        self.sum += raw;
+        self.count += 1;
+        if self.count >= FRAME_CONVERSIONS {
+            self.finish_frame();
+        }
+    }
+
+    fn finish_frame(&mut self) {
+        let raw = ((self.sum + self.count / 2) / self.count) as u16;
+        self.sum = 0;
+        self.count = 0;
+        self.frames = self.frames.wrapping_add(1);
+
+        let voltage_mv = self.filter.push(self.adc_to_millivolts(raw));
+        let power = self.reading.map(|r| r.power).unwrap_or_default().next(voltage_mv);
+        let percentage = super::voltage_to_percentage(voltage_mv);
+        self.reading = Some(BatteryReading { voltage_mv, percentage, power });
+
+        if self.frames % LOG_EVERY_FRAMES == 0 {
+            log::debug!("[BATTERY_SAMPLE] Voltage: {}mV, Percentage: {}%, ADC raw (frame mean): {}, USB: {}, Charging: {}",
+                        voltage_mv, percentage, raw, power.on_usb, power.charging);
+        }
+    }
+
+    /// Battery millivolts for a frame's mean raw value. T-Display-S3 divides
+    /// the battery by two (100k + 100k) before GPIO4.
+    fn adc_to_millivolts(&self, raw: u16) -> u16 {
+        let mut pin_mv = None;
+        if let Some(cali) = self.cali {
+            let mut mv = 0i32;
+            if unsafe { adc_cali_raw_to_voltage(cali, raw as i32, &mut mv) } == ESP_OK {
+                pin_mv = Some(mv.clamp(0, u16::MAX as i32 / 2) as u16);
+            }
+        }
+        // Uncalibrated: 12-bit full scale is about 3100 mV at 12 dB
+        let pin_mv = pin_mv.unwrap_or(((raw as u32 * 3100) / 4095) as u16);
+        pin_mv * 2
+    }
+}
+
+impl Drop for BatteryMonitor {
+    fn drop(&mut self) {
+        unsafe {
+            match self.source {
+                Source::Continuous(handle) => {
+                    adc_continuous_stop(handle);
+                    adc_continuous_deinit(handle);
+                }
+                Source::Oneshot(handle) => {
+                    adc_oneshot_del_unit(handle);
+                }
+                Source::None => {}
+            }
+            if let Some(cali) = self.cali {
+                adc_cali_delete_scheme_curve_fitting(cali);
+            }
+        }
+    }
+}
+
+unsafe fn start_continuous(sample_rate_hz: u32) -> Result<adc_continuous_handle_t, EspError> {
+    let mut handle: adc_continuous_handle_t = core::ptr::null_mut();
+    let mut handle_config: adc_continuous_handle_cfg_t = core::mem::zeroed();
+    handle_config.max_store_buf_size = STORE_BYTES as u32;
+    handle_config.conv_frame_size = FRAME_BYTES as u32;
+    esp!(adc_continuous_new_handle(&handle_config, &mut handle))?;
+
+    let mut pattern = adc_digi_pattern_config_t {
+        atten: BATTERY_ATTEN as u8,
+        channel: BATTERY_CHANNEL as u8,
+        unit: adc_unit_t_ADC_UNIT_1 as u8,
+        bit_width: adc_bitwidth_t_ADC_BITWIDTH_12 as u8,
+    };
+    let mut config: adc_continuous_config_t = core::mem::zeroed();
+    config.pattern_num = 1;
+    config.adc_pattern = &mut pattern;
+    config.sample_freq_hz = sample_rate_hz;
+    config.conv_mode = adc_digi_convert_mode_t_ADC_CONV_SINGLE_UNIT_1;
+    config.format = adc_digi_output_format_t_ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+
+    // The driver copies the pattern, so it may live on this stack
+    if let Err(e) = esp!(adc_continuous_config(handle, &config)).and_then(|_| esp!(adc_continuous_start(handle))) {
+        adc_continuous_deinit(handle);
+        return Err(e);
+    }
+    Ok(handle)
+}
+
+unsafe fn start_oneshot() -> Result<adc_oneshot_unit_handle_t, EspError> {
+    let mut handle: adc_oneshot_unit_handle_t = core::ptr::null_mut();
+    let mut unit_config: adc_oneshot_unit_init_cfg_t = core::mem::zeroed();
+    unit_config.unit_id = adc_unit_t_ADC_UNIT_1;
+    esp!(adc_oneshot_new_unit(&unit_config, &mut handle))?;
+    let channel_config = adc_oneshot_chan_cfg_t {
+        atten: BATTERY_ATTEN,
+        bitwidth: adc_bitwidth_t_ADC_BITWIDTH_12,
+    };
+    if let Err(e) = esp!(adc_oneshot_config_channel(handle, BATTERY_CHANNEL, &channel_config)) {
+        adc_oneshot_del_unit(handle);
+        return Err(e);
+    }
+    Ok(handle)
+}
+
+unsafe fn create_calibration() -> Option<adc_cali_handle_t> {
+    let mut cali: adc_cali_handle_t = core::ptr::null_mut();
+    let cali_config = adc_cali_curve_fitting_config_t {
+        unit_id: adc_unit_t_ADC_UNIT_1,
+        chan: BATTERY_CHANNEL,
+        atten: BATTERY_ATTEN,
+        bitwidth: adc_bitwidth_t_ADC_BITWIDTH_12,
+    };
+    (adc_cali_create_scheme_curve_fitting(&cali_config, &mut cali) == ESP_OK).then_some(cali)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_filter_rejects_spikes_and_settles() {
+        let mut filter = VoltageFilter::new();
+        assert_eq!(filter.push(3900), 3900);
+        // A single spike never reaches the output
+        for mv in [3900, 3900, 5000, 3900, 3900] {
+            assert_eq!(filter.push(mv), 3900);
+        }
+        // A real step converges within a couple of dozen frames
+        let settled = (0..24).map(|_| filter.push(4900)).last().unwrap();
+        assert!(settled > 4850 && settled <= 4900, "settled at {settled}");
+    }
+
+    #[test]
+    fn test_power_state_hysteresis() {
+        let on_usb = PowerState::default().next(4800);
+        assert!(on_usb.battery_connected && on_usb.on_usb && on_usb.charging);
+        // Just under the USB threshold stays on USB, well under leaves it
+        assert!(on_usb.next(4450).on_usb);
+        assert!(!on_usb.next(4300).on_usb);
+        assert!(!PowerState::default().next(3000).on_usb);
+        assert!(PowerState::default().next(1000).on_usb);
+    }
+}
@@ -1,95 +1,184 @@
-use std::collections::VecDeque;
-use std::sync::{Arc, Mutex, OnceLock};
-
-const MAX_HISTORY_POINTS: usize = 360; // 6 hours at 1 sample/minute for memory efficiency
+// Sensor and metrics history
+//
+// A sampler thread copies selected fields of the published MetricsData into a
+// TimeSeriesStore once a second: 1 s, 1 min and 1 h tiers in PSRAM, with
+// sealed blocks archived to the `spiffs` partition so history survives
+// reboots. Series ids are written into the archive, so SERIES is append-only.
+
+use std::ffi::CStr;
+use std::path::Path;
+use std::sync::{Arc, OnceLock};
+use std::time::{SystemTime, UNIX_EPOCH};
+use esp_idf_hal::delay::FreeRtos;
+use crate::metrics::MetricsData;
+use super::timeseries::{Point, StoreStats, TimeSeriesStore, TIERS};
+
+const SAMPLE_INTERVAL_MS: u32 = 1000;
+const STORAGE_PATH: &CStr = c"/spiffs";
+const STORAGE_LABEL: &CStr = c"spiffs";
+const ARCHIVE_DIR: &str = "/spiffs";
+
+/// Default cap on points returned per query; "auto" also picks the tier by it
+pub const DEFAULT_MAX_POINTS: u32 = 1500;
 
 // Global sensor history instance
-static SENSOR_HISTORY: OnceLock<Arc<Mutex<SensorHistory>>> = OnceLock::new();
+static SENSOR_HISTORY: OnceLock<Arc<SensorHistory>> = OnceLock::new();
+
+/// A recorded series: where it comes from and the step it is stored at
+pub struct SeriesDef {
+    pub name: &'static str,
+    pub unit: &'static str,
+    quantum: f32,
+    read: fn(&MetricsData) -> f32,
+}
 
-pub fn init() -> Arc<Mutex<SensorHistory>> {
+/// Recorded series; the index is the id stored on flash, so only append
+pub const SERIES: &[SeriesDef] = &[
+    SeriesDef { name: "temperature", unit: "celsius", quantum: 0.05, read: |m| m.temperature },
+    SeriesDef { name: "battery", unit: "percentage", quantum: 1.0, read: |m| m.battery_percentage as f32 },
+    SeriesDef { name: "battery_voltage", unit: "millivolts", quantum: 5.0, read: |m| m.battery_voltage_mv as f32 },
+    SeriesDef { name: "cpu", unit: "percentage", quantum: 1.0, read: |m| m.cpu_usage as f32 },
+    SeriesDef { name: "cpu0", unit: "percentage", quantum: 1.0, read: |m| m.cpu0_usage as f32 },
+    SeriesDef { name: "cpu1", unit: "percentage", quantum: 1.0, read: |m| m.cpu1_usage as f32 },
+    SeriesDef { name: "fps", unit: "fps", quantum: 0.1, read: |m| m.fps_actual },
+    SeriesDef { name: "render_time", unit: "milliseconds", quantum: 1.0, read: |m| m.render_time_ms as f32 },
+    SeriesDef { name: "flush_time", unit: "milliseconds", quantum: 1.0, read: |m| m.flush_time_ms as f32 },
+    SeriesDef { name: "idle", unit: "percentage", quantum: 1.0, read: |m| m.main_loop_idle_percent as f32 },
+    SeriesDef { name: "heap_free", unit: "bytes", quantum: 64.0, read: |m| m.heap_free as f32 },
+    SeriesDef { name: "psram_free", unit: "bytes", quantum: 1024.0, read: |m| m.psram_free as f32 },
+    SeriesDef { name: "wifi_rssi", unit: "dBm", quantum: 1.0, read: |m| m.wifi_rssi as f32 },
+    SeriesDef { name: "http_connections", unit: "connections", quantum: 1.0, read: |m| m.http_connections_active as f32 },
+    SeriesDef { name: "button_response", unit: "milliseconds", quantum: 0.1, read: |m| m.button_avg_response_ms },
+];
+
+impl SeriesDef {
+    /// Decimal places worth printing at this series' step
+    pub fn decimals(&self) -> usize {
+        if self.quantum >= 1.0 { 0 } else if self.quantum >= 0.1 { 1 } else { 2 }
+    }
+}
+
+/// Create the history and start sampling (once)
+pub fn init() -> Arc<SensorHistory> {
     SENSOR_HISTORY.get_or_init(|| {
-        Arc::new(Mutex::new(SensorHistory::new()))
+        let history = Arc::new(SensorHistory::new());
+        let sampler = history.clone();
+        if let Err(e) = std::thread::Builder::new()
+            .name("history".to_string())
+            .stack_size(6144)
+            .spawn(move || sampler.run())
+        {
+            log::error!("Failed to start history sampler: {:?}", e);
+        }
+        history
     }).clone()
 }
 
-pub fn get() -> Option<Arc<Mutex<SensorHistory>>> {
+pub fn get() -> Option<Arc<SensorHistory>> {
     SENSOR_HISTORY.get().cloned()
 }
 
-#[derive(Debug, Clone, serde::Serialize)]
-pub struct DataPoint {
-    pub timestamp: u64,
-    pub value: f32,
+fn unix_now() -> u32 {
+    SystemTime::now()
+        .duration_since(UNIX_EPOCH)
+        .unwrap_or_default()
+        .as_secs() as u32
+}
+
+/// Most stored points one query may scan before merging; bounds how many
+/// archive blocks a request reads
+pub const MAX_SCAN_POINTS: u32 = 7200;
+
+/// Whether `tier` holds `span` seconds in at most MAX_SCAN_POINTS points
+pub fn tier_covers_span(tier: usize, span: u32) -> bool {
+    span / TIERS[tier].step <= MAX_SCAN_POINTS
+}
+
+/// Finest tier that covers `span` seconds in at most `max_points` points
+pub fn tier_for_span(span: u32, max_points: u32) -> usize {
+    TIERS.iter()
+        .position(|tier| span / tier.step <= max_points.clamp(1, MAX_SCAN_POINTS))
+        .unwrap_or(TIERS.len() - 1)
 }
 
 pub struct SensorHistory {
-    temperature: Mutex<VecDeque<DataPoint>>,
-    battery: Mutex<VecDeque<DataPoint>>,
+    store: TimeSeriesStore,
 }
 
 impl SensorHistory {
-    pub fn new() -> Self {
-        Self {
-            temperature: Mutex::new(VecDeque::with_capacity(MAX_HISTORY_POINTS)),
-            battery: Mutex::new(VecDeque::with_capacity(MAX_HISTORY_POINTS)),
-        }
+    fn new() -> Self {
+        let quanta: Vec<f32> = SERIES.iter().map(|series| series.quantum).collect();
+        Self { store: TimeSeriesStore::new(&quanta) }
     }
 
-    pub fn add_temperature(&self, value: f32) {
-        self.add_data_point(&self.temperature, value);
+    /// Series id for a name
+    pub fn series(name: &str) -> Option<usize> {
+        SERIES.iter().position(|series| series.name == name)
     }
 
-    pub fn add_battery(&self, value: f32) {
-        self.add_data_point(&self.battery, value);
+    /// Points of `series` in `tier` between Unix times `from` and `to`, oldest
+    /// first, merged down to at most `max_points`
+    pub fn query(&self, series: usize, tier: usize, from: u32, to: u32, max_points: u32, f: impl FnMut(Point)) {
+        self.store.query_at_most(series, tier, from, to, max_points, f);
     }
 
-    fn add_data_point(&self, queue: &Mutex<VecDeque<DataPoint>>, value: f32) {
-        let timestamp = std::time::SystemTime::now()
-            .duration_since(std::time::UNIX_EPOCH)
-            .unwrap_or_default()
-            .as_secs();
-
-        let mut data = match queue.lock() {
-            Ok(g) => g,
-            Err(e) => {
-                log::error!("SensorHistory lock failed in add_data_point: {}", e);
-                return;
-            }
-        };
-        data.push_back(DataPoint { timestamp, value });
-
-        // Remove old data points
-        while data.len() > MAX_HISTORY_POINTS {
-            data.pop_front();
-        }
+    pub fn stats(&self) -> StoreStats {
+        self.store.stats()
     }
 
-    pub fn get_temperature_history(&self, hours: u32) -> Vec<DataPoint> {
-        self.get_history(&self.temperature, hours)
-    }
+    fn run(&self) {
+        match mount_storage() {
+            Ok(()) => match self.store.attach_archive(Path::new(ARCHIVE_DIR)) {
+                Ok(()) => log::info!("History archive on /spiffs: {:?}", self.store.stats()),
+                Err(e) => log::warn!("History archive unavailable, keeping RAM only: {}", e),
+            },
+            Err(e) => log::warn!("History archive unavailable, keeping RAM only: {}", e),
+        }
 
-    pub fn get_battery_history(&self, hours: u32) -> Vec<DataPoint> {
-        self.get_history(&self.battery, hours)
+        let metrics = crate::metrics::metrics();
+        let mut values = vec![0.0; SERIES.len()];
+        let mut flush_failed = false;
+        loop {
+            FreeRtos::delay_ms(SAMPLE_INTERVAL_MS);
+            let data = metrics.snapshot();
+            // Nothing has been published yet
+            if data.timestamp == 0 {
+                continue;
+            }
+            for (value, series) in values.iter_mut().zip(SERIES) {
+                *value = (series.read)(&data);
+            }
+            self.store.record_all(unix_now(), &values);
+
+            match self.store.flush() {
+                Ok(()) => flush_failed = false,
+                Err(e) if !flush_failed => {
+                    log::warn!("History archive write failed: {}", e);
+                    flush_failed = true;
+                }
+                Err(_) => {}
+            }
+        }
     }
+}
 
-    fn get_history(&self, queue: &Mutex<VecDeque<DataPoint>>, hours: u32) -> Vec<DataPoint> {
-        let cutoff = std::time::SystemTime::now()
-            .duration_since(std::time::UNIX_EPOCH)
-            .unwrap_or_default()
-            .as_secs()
-            .saturating_sub(hours as u64 * 3600);
-
-        let data = match queue.lock() {
-            Ok(g) => g,
-            Err(e) => {
-                log::error!("SensorHistory lock failed in get_history: {}", e);
-                return Vec::new();
-            }
+/// Mount the `spiffs` partition at /spiffs unless it already is
+fn mount_storage() -> anyhow::Result<()> {
+    unsafe {
+        if esp_idf_sys::esp_spiffs_mounted(STORAGE_LABEL.as_ptr()) {
+            return Ok(());
+        }
+        let conf = esp_idf_sys::esp_vfs_spiffs_conf_t {
+            base_path: STORAGE_PATH.as_ptr(),
+            partition_label: STORAGE_LABEL.as_ptr(),
+            max_files: 5,
+            format_if_mount_failed: true,
         };
-        data.iter()
-            .filter(|dp| dp.timestamp >= cutoff)
-            .cloned()
-            .collect()
+        match esp_idf_sys::esp!(esp_idf_sys::esp_vfs_spiffs_register(&conf)) {
+            Ok(()) => Ok(()),
+            // Something else already registered /spiffs
+            Err(e) if e.code() == esp_idf_sys::ESP_ERR_INVALID_STATE as i32 => Ok(()),
+            Err(e) => Err(anyhow::anyhow!("esp_vfs_spiffs_register failed: {}", e)),
+        }
     }
-
-}
\ No newline at end of file
+}
@@ -0,0 +1,860 @@
+// Columnar time-series store with min/max/avg rollup tiers
+//
+// Every sample is folded into one bucket per tier (1 s, 1 min, 1 h). When a
+// bucket closes it is appended to that tier's open block. A block is
+// columnar: timestamps as zigzag varints of their delta-of-delta (a steady
+// cadence costs one byte), then each value column as zigzag varint deltas of
+// the value quantized to the series' step. The 1 s tier only keeps the
+// average; the rollup tiers add min and max columns.
+//
+// Full blocks are sealed end to end into one byte ring per tier, allocated
+// once from PSRAM (a fraction of the size in internal RAM without it), where
+// the oldest blocks are overwritten as it fills. Once the clock is valid they
+// are also appended to an archive file per tier. The archive is two
+// generations, `ts_<tier>.dat` and `ts_<tier>.old`. When the current file
+// reaches its cap, the old file is dropped and the current one rotates into
+// its place. Queries copy only the RAM blocks overlapping the requested
+// range and decode them outside the lock; archived blocks are decoded one at
+// a time as they are read back.
+
+use std::fs::{self, File, OpenOptions};
+use std::io::{self, BufReader, Read, Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+use std::sync::{Mutex, MutexGuard};
+use crate::psram::PsramAllocator;
+
+/// Rollup tiers, finest first
+pub const TIERS: [Tier; 3] = [
+    Tier { name: "1s", step: 1, block_points: 120, ram_bytes: 192 * 1024, file_bytes: 2 * 1024 * 1024 },
+    Tier { name: "1m", step: 60, block_points: 60, ram_bytes: 64 * 1024, file_bytes: 1024 * 1024 },
+    Tier { name: "1h", step: 3600, block_points: 6, ram_bytes: 16 * 1024, file_bytes: 256 * 1024 },
+];
+
+/// Timestamps before this (Nov 2023) mean SNTP has not set the clock yet;
+/// blocks that start earlier stay in RAM and are never archived
+pub const VALID_EPOCH: u32 = 1_700_000_000;
+
+const MAGIC: u8 = 0xD5;
+// Block carries min and max columns after the average
+const FLAG_RANGE: u8 = 0x01;
+const HEADER_LEN: usize = 20;
+/// Without PSRAM each RAM ring gets this fraction of its tier's ram_bytes
+const INTERNAL_RAM_DIVISOR: usize = 8;
+
+pub struct Tier {
+    pub name: &'static str,
+    /// Bucket width in seconds
+    pub step: u32,
+    block_points: u16,
+    ram_bytes: usize,
+    file_bytes: u64,
+}
+
+/// Tier index for a resolution name ("1s", "1m", "1h")
+pub fn tier_by_name(name: &str) -> Option<usize> {
+    TIERS.iter().position(|tier| tier.name == name)
+}
+
+/// One bucket of a series
+#[derive(Debug, Clone, Copy, PartialEq, serde::Serialize)]
+pub struct Point {
+    /// Bucket start, Unix seconds
+    pub timestamp: u32,
+    /// Average over the bucket
+    pub value: f32,
+    pub min: f32,
+    pub max: f32,
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|poisoned| poisoned.into_inner())
+}
+
+fn put_varint(out: &mut Vec<u8>, mut value: u64) {
+    while value >= 0x80 {
+        out.push(value as u8 | 0x80);
+        value >>= 7;
+    }
+    out.push(value as u8);
+}
+
+fn get_varint(buf: &[u8], pos: &mut usize) -> Option<u64> {
+    let mut value = 0u64;
+    let mut shift = 0;
+    loop {
+        let byte = *buf.get(*pos)?;
+        *pos += 1;
+        if shift > 63 {
+            return None;
+        }
+        value |= ((byte & 0x7F) as u64) << shift;
+        if byte & 0x80 == 0 {
+            return Some(value);
+        }
+        shift += 7;
+    }
+}
+
+fn zigzag(value: i64) -> u64 {
+    ((value << 1) ^ (value >> 63)) as u64
+}
+
+fn unzigzag(value: u64) -> i64 {
+    ((value >> 1) as i64) ^ -((value & 1) as i64)
+}
+
+// FNV-1a; catches torn or stale archive blocks
+fn checksum(bytes: &[u8]) -> u32 {
+    bytes.iter().fold(0x811C_9DC5u32, |hash, &byte| (hash ^ byte as u32).wrapping_mul(0x0100_0193))
+}
+
+fn quantize(value: f32, quantum: f32) -> i64 {
+    // NaN becomes 0; out-of-range values saturate
+    (value / quantum).round() as i32 as i64
+}
+
+/// Header fields of an encoded block
+#[derive(Clone, Copy)]
+struct BlockInfo {
+    series: u8,
+    start: u32,
+    end: u32,
+    // Header plus payload
+    len: u16,
+}
+
+impl BlockInfo {
+    fn parse(header: &[u8]) -> Option<Self> {
+        if header.len() < HEADER_LEN || header[0] != MAGIC {
+            return None;
+        }
+        let payload = u16::from_le_bytes([header[14], header[15]]) as usize;
+        Some(Self {
+            series: header[2],
+            start: u32::from_le_bytes(header[6..10].try_into().ok()?),
+            end: u32::from_le_bytes(header[10..14].try_into().ok()?),
+            len: u16::try_from(HEADER_LEN + payload).ok()?,
+        })
+    }
+
+    fn overlaps(&self, from: u32, to: u32) -> bool {
+        self.end >= from && self.start <= to
+    }
+}
+
+/// The open block of one series in one tier, encoded as points arrive
+#[derive(Default)]
+struct BlockBuilder {
+    count: u16,
+    start: u32,
+    last: u32,
+    last_delta: i64,
+    last_values: [i64; 3],
+    timestamps: Vec<u8>,
+    // Average, min, max
+    columns: [Vec<u8>; 3],
+}
+
+impl BlockBuilder {
+    fn push(&mut self, timestamp: u32, values: [i64; 3], columns: usize) {
+        if self.count == 0 {
+            // The first timestamp lives in the header, the first values are absolute
+            self.start = timestamp;
+            for (column, value) in self.columns.iter_mut().zip(values).take(columns) {
+                put_varint(column, zigzag(value));
+            }
+        } else {
+            let delta = timestamp as i64 - self.last as i64;
+            put_varint(&mut self.timestamps, zigzag(delta - self.last_delta));
+            self.last_delta = delta;
+            for ((column, value), last) in self.columns.iter_mut().zip(values).zip(self.last_values).take(columns) {
+                put_varint(column, zigzag(value - last));
+            }
+        }
+        self.last = timestamp;
+        self.last_values = values;
+        self.count += 1;
+    }
+
+    fn encode(&self, series: u8, tier: u8, columns: usize) -> Vec<u8> {
+        let payload = self.timestamps.len() + self.columns[..columns].iter().map(Vec::len).sum::<usize>();
+        let mut block = Vec::with_capacity(HEADER_LEN + payload);
+        block.extend_from_slice(&[MAGIC, if columns > 1 { FLAG_RANGE } else { 0 }, series, tier]);
+        block.extend_from_slice(&self.count.to_le_bytes());
+        block.extend_from_slice(&self.start.to_le_bytes());
+        block.extend_from_slice(&self.last.to_le_bytes());
+        block.extend_from_slice(&(payload as u16).to_le_bytes());
+        block.extend_from_slice(&[0; 4]);
+        block.extend_from_slice(&self.timestamps);
+        for column in &self.columns[..columns] {
+            block.extend_from_slice(column);
+        }
+        let sum = checksum(&block[HEADER_LEN..]);
+        block[16..20].copy_from_slice(&sum.to_le_bytes());
+        block
+    }
+
+    fn clear(&mut self) {
+        self.count = 0;
+        self.last_delta = 0;
+        self.timestamps.clear();
+        for column in &mut self.columns {
+            column.clear();
+        }
+    }
+}
+
+/// Decode every point of an encoded block; false if it is malformed
+fn decode_block(block: &[u8], quantum: f32, f: &mut dyn FnMut(Point)) -> bool {
+    let Some(info) = BlockInfo::parse(block) else { return false };
+    if block.len() < info.len as usize
+        || checksum(&block[HEADER_LEN..info.len as usize]) != u32::from_le_bytes(block[16..20].try_into().unwrap())
+    {
+        return false;
+    }
+    let payload = &block[HEADER_LEN..info.len as usize];
+    let count = u16::from_le_bytes([block[4], block[5]]) as usize;
+    let columns = if block[1] & FLAG_RANGE != 0 { 3 } else { 1 };
+
+    // Find where each column starts by skipping the ones before it
+    let mut starts = [0usize; 4];
+    let mut pos = 0;
+    for (index, start) in starts.iter_mut().enumerate().take(columns + 1) {
+        *start = pos;
+        let entries = if index == 0 { count.saturating_sub(1) } else { count };
+        for _ in 0..entries {
+            if get_varint(payload, &mut pos).is_none() {
+                return false;
+            }
+        }
+    }
+
+    let mut cursors = starts;
+    let mut timestamp = info.start as i64;
+    let mut delta = 0i64;
+    let mut values = [0i64; 3];
+    for index in 0..count {
+        if index > 0 {
+            delta += unzigzag(get_varint(payload, &mut cursors[0]).unwrap_or(0));
+            timestamp += delta;
+        }
+        for column in 0..columns {
+            let step = unzigzag(get_varint(payload, &mut cursors[column + 1]).unwrap_or(0));
+            values[column] = if index == 0 { step } else { values[column] + step };
+        }
+        let value = values[0] as f32 * quantum;
+        let (min, max) = if columns > 1 {
+            (values[1] as f32 * quantum, values[2] as f32 * quantum)
+        } else {
+            (value, value)
+        };
+        f(Point { timestamp: timestamp as u32, value, min, max });
+    }
+    true
+}
+
+#[derive(Clone, Copy)]
+struct Bucket {
+    start: u32,
+    min: f32,
+    max: f32,
+    sum: f32,
+    count: u32,
+}
+
+impl Bucket {
+    fn point(&self) -> Point {
+        Point { timestamp: self.start, value: self.sum / self.count as f32, min: self.min, max: self.max }
+    }
+}
+
+struct SeriesState {
+    quantum: f32,
+    buckets: [Option<Bucket>; TIERS.len()],
+    open: [BlockBuilder; TIERS.len()],
+}
+
+/// One tier's sealed blocks, oldest first, laid end to end in a fixed ring.
+/// Each block starts with its header, so walking the ring needs no index.
+struct RamTier {
+    base: *mut u8,
+    capacity: usize,
+    in_psram: bool,
+    // Offset of the oldest block
+    tail: usize,
+    bytes: usize,
+    blocks: usize,
+}
+
+// The ring is only touched under the Memory lock
+unsafe impl Send for RamTier {}
+
+impl RamTier {
+    fn allocate(tier: usize) -> Self {
+        let size = TIERS[tier].ram_bytes;
+        if PsramAllocator::is_available() {
+            let base = unsafe { esp_idf_sys::heap_caps_malloc(size, esp_idf_sys::MALLOC_CAP_SPIRAM) } as *mut u8;
+            if !base.is_null() {
+                return Self { base, capacity: size, in_psram: true, tail: 0, bytes: 0, blocks: 0 };
+            }
+        }
+        let size = size / INTERNAL_RAM_DIVISOR;
+        log::warn!("Time series {} tier: PSRAM unavailable, {} KB internal", TIERS[tier].name, size / 1024);
+        let base = Box::into_raw(vec![0u8; size].into_boxed_slice()) as *mut u8;
+        Self { base, capacity: size, in_psram: false, tail: 0, bytes: 0, blocks: 0 }
+    }
+
+    fn ring(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.base, self.capacity) }
+    }
+
+    // Copy `out.len()` bytes starting at `offset`, wrapping at the end
+    fn read(&self, offset: usize, out: &mut [u8]) {
+        let ring = self.ring();
+        let first = out.len().min(self.capacity - offset);
+        out[..first].copy_from_slice(&ring[offset..offset + first]);
+        let rest = out.len() - first;
+        out[first..].copy_from_slice(&ring[..rest]);
+    }
+
+    fn info_at(&self, offset: usize) -> Option<BlockInfo> {
+        let mut header = [0u8; HEADER_LEN];
+        self.read(offset, &mut header);
+        BlockInfo::parse(&header)
+    }
+
+    /// Offset and header of each block, oldest first
+    fn iter(&self) -> impl Iterator<Item = (usize, BlockInfo)> + '_ {
+        let mut offset = self.tail;
+        (0..self.blocks).map_while(move |_| {
+            let info = self.info_at(offset)?;
+            let at = offset;
+            offset = (offset + info.len as usize) % self.capacity;
+            Some((at, info))
+        })
+    }
+
+    fn copy(&self, offset: usize, info: &BlockInfo) -> Vec<u8> {
+        let mut bytes = vec![0; info.len as usize];
+        self.read(offset, &mut bytes);
+        bytes
+    }
+
+    /// Append a block, evicting the oldest until it fits
+    fn push(&mut self, block: &[u8]) {
+        if block.len() > self.capacity {
+            return;
+        }
+        while self.bytes + block.len() > self.capacity {
+            let Some(oldest) = self.info_at(self.tail) else { break };
+            self.tail = (self.tail + oldest.len as usize) % self.capacity;
+            self.bytes -= oldest.len as usize;
+            self.blocks -= 1;
+        }
+        let head = (self.tail + self.bytes) % self.capacity;
+        let ring = unsafe { std::slice::from_raw_parts_mut(self.base, self.capacity) };
+        let first = block.len().min(self.capacity - head);
+        ring[head..head + first].copy_from_slice(&block[..first]);
+        ring[..block.len() - first].copy_from_slice(&block[first..]);
+        self.bytes += block.len();
+        self.blocks += 1;
+    }
+}
+
+impl Drop for RamTier {
+    fn drop(&mut self) {
+        unsafe {
+            if self.in_psram {
+                esp_idf_sys::heap_caps_free(self.base as *mut _);
+            } else {
+                drop(Box::from_raw(std::ptr::slice_from_raw_parts_mut(self.base, self.capacity)));
+            }
+        }
+    }
+}
+
+struct Memory {
+    series: Vec<SeriesState>,
+    tiers: [RamTier; TIERS.len()],
+    // Sealed blocks waiting to be appended to the archive
+    unsaved: Vec<(usize, Vec<u8>)>,
+}
+
+impl Memory {
+    fn record(&mut self, series: usize, timestamp: u32, value: f32) {
+        for tier in 0..TIERS.len() {
+            let start = timestamp - timestamp % TIERS[tier].step;
+            let state = &mut self.series[series];
+            match state.buckets[tier] {
+                Some(ref mut bucket) if bucket.start == start => {
+                    bucket.min = bucket.min.min(value);
+                    bucket.max = bucket.max.max(value);
+                    bucket.sum += value;
+                    bucket.count += 1;
+                    continue;
+                }
+                _ => {}
+            }
+            let closed = state.buckets[tier].replace(Bucket { start, min: value, max: value, sum: value, count: 1 });
+            if let Some(bucket) = closed {
+                self.append(series, tier, bucket.point());
+            }
+        }
+    }
+
+    fn append(&mut self, series: usize, tier: usize, point: Point) {
+        let columns = if tier == 0 { 1 } else { 3 };
+        let state = &mut self.series[series];
+        let quantum = state.quantum;
+        let open = &mut state.open[tier];
+        // Keep each block on one side of the clock being set, and monotonic
+        if open.count > 0
+            && ((open.start < VALID_EPOCH) != (point.timestamp < VALID_EPOCH) || point.timestamp < open.last)
+        {
+            self.seal(series, tier);
+        }
+        let open = &mut self.series[series].open[tier];
+        open.push(point.timestamp, [
+            quantize(point.value, quantum),
+            quantize(point.min, quantum),
+            quantize(point.max, quantum),
+        ], columns);
+        if open.count >= TIERS[tier].block_points {
+            self.seal(series, tier);
+        }
+    }
+
+    fn seal(&mut self, series: usize, tier: usize) {
+        let columns = if tier == 0 { 1 } else { 3 };
+        let open = &mut self.series[series].open[tier];
+        let bytes = open.encode(series as u8, tier as u8, columns);
+        open.clear();
+        let Some(info) = BlockInfo::parse(&bytes) else { return };
+        self.tiers[tier].push(&bytes);
+        if info.start >= VALID_EPOCH {
+            self.unsaved.push((tier, bytes));
+        }
+    }
+}
+
+struct FileBlock {
+    info: BlockInfo,
+    offset: u32,
+    // In the `.old` generation rather than the current file
+    old: bool,
+}
+
+#[derive(Default)]
+struct ArchiveTier {
+    index: Vec<FileBlock>,
+    current_len: u64,
+}
+
+/// Sealed blocks on flash, two generations per tier
+pub struct Archive {
+    dir: PathBuf,
+    tiers: [ArchiveTier; TIERS.len()],
+}
+
+impl Archive {
+    fn path(dir: &Path, tier: usize, old: bool) -> PathBuf {
+        dir.join(format!("ts_{}.{}", TIERS[tier].name, if old { "old" } else { "dat" }))
+    }
+
+    /// Index the block headers already in `dir`
+    pub fn open(dir: &Path) -> io::Result<Self> {
+        let mut archive = Self { dir: dir.to_path_buf(), tiers: Default::default() };
+        for tier in 0..TIERS.len() {
+            for old in [true, false] {
+                let (len, intact) = archive.scan(tier, old)?;
+                if !old {
+                    archive.tiers[tier].current_len = len;
+                    if !intact {
+                        // Appending after a torn block would hide everything after it
+                        archive.rotate(tier)?;
+                    }
+                }
+            }
+        }
+        Ok(archive)
+    }
+
+    // Returns the indexed length and whether the file ended on a block boundary
+    fn scan(&mut self, tier: usize, old: bool) -> io::Result<(u64, bool)> {
+        let file = match File::open(Self::path(&self.dir, tier, old)) {
+            Ok(file) => file,
+            Err(e) if e.kind() == io::ErrorKind::NotFound => return Ok((0, true)),
+            Err(e) => return Err(e),
+        };
+        let file_len = file.metadata()?.len();
+        let mut reader = BufReader::with_capacity(4096, file);
+        let mut offset = 0u64;
+        let mut header = [0u8; HEADER_LEN];
+        while offset < file_len {
+            if reader.read_exact(&mut header).is_err() {
+                return Ok((offset, false));
+            }
+            let Some(info) = BlockInfo::parse(&header) else { return Ok((offset, false)) };
+            if offset + info.len as u64 > file_len {
+                return Ok((offset, false));
+            }
+            self.tiers[tier].index.push(FileBlock { info, offset: offset as u32, old });
+            reader.seek_relative(info.len as i64 - HEADER_LEN as i64)?;
+            offset += info.len as u64;
+        }
+        Ok((offset, true))
+    }
+
+    fn rotate(&mut self, tier: usize) -> io::Result<()> {
+        let old = Self::path(&self.dir, tier, true);
+        match fs::remove_file(&old) {
+            Ok(()) => {}
+            Err(e) if e.kind() == io::ErrorKind::NotFound => {}
+            Err(e) => return Err(e),
+        }
+        match fs::rename(Self::path(&self.dir, tier, false), &old) {
+            Ok(()) => {}
+            Err(e) if e.kind() == io::ErrorKind::NotFound => {}
+            Err(e) => return Err(e),
+        }
+        let archive = &mut self.tiers[tier];
+        archive.index.retain(|block| !block.old);
+        for block in &mut archive.index {
+            block.old = true;
+        }
+        archive.current_len = 0;
+        Ok(())
+    }
+
+    fn append(&mut self, tier: usize, blocks: &[&[u8]]) -> io::Result<()> {
+        let total: u64 = blocks.iter().map(|block| block.len() as u64).sum();
+        if self.tiers[tier].current_len + total > TIERS[tier].file_bytes {
+            self.rotate(tier)?;
+        }
+        let mut file = OpenOptions::new().create(true).append(true).open(Self::path(&self.dir, tier, false))?;
+        let mut buffer = Vec::with_capacity(total as usize);
+        for block in blocks {
+            buffer.extend_from_slice(block);
+        }
+        file.write_all(&buffer)?;
+        file.flush()?;
+
+        let archive = &mut self.tiers[tier];
+        for block in blocks {
+            if let Some(info) = BlockInfo::parse(block) {
+                archive.index.push(FileBlock { info, offset: archive.current_len as u32, old: false });
+            }
+            archive.current_len += block.len() as u64;
+        }
+        Ok(())
+    }
+
+    /// Pass each block of `series` overlapping `from..=to` that starts before
+    /// `before` to `f`, reading them one at a time into a single buffer
+    fn read(&self, series: u8, tier: usize, from: u32, to: u32, before: u32, mut f: impl FnMut(&[u8])) {
+        let mut bytes = Vec::new();
+        let mut files: [Option<File>; 2] = [None, None];
+        for block in &self.tiers[tier].index {
+            if block.info.series != series || !block.info.overlaps(from, to) || block.info.start >= before {
+                continue;
+            }
+            let slot = &mut files[block.old as usize];
+            if slot.is_none() {
+                *slot = File::open(Self::path(&self.dir, tier, block.old)).ok();
+            }
+            let Some(file) = slot.as_mut() else { continue };
+            bytes.resize(block.info.len as usize, 0);
+            if file.seek(SeekFrom::Start(block.offset as u64)).is_ok() && file.read_exact(&mut bytes).is_ok() {
+                f(&bytes);
+            }
+        }
+    }
+
+    /// Bytes on flash across all tiers
+    fn bytes(&self) -> u64 {
+        self.tiers.iter()
+            .map(|tier| tier.current_len + tier.index.iter().filter(|b| b.old).map(|b| b.info.len as u64).sum::<u64>())
+            .sum()
+    }
+}
+
+/// Occupancy figures for diagnostics
+#[derive(Debug, Clone, Copy, serde::Serialize)]
+pub struct StoreStats {
+    pub ram_bytes: usize,
+    pub ram_blocks: usize,
+    pub archive_bytes: u64,
+    pub archive_blocks: usize,
+    pub unsaved_blocks: usize,
+}
+
+struct QueryPlan {
+    blocks: Vec<Vec<u8>>,
+    // Bucket still accumulating, if it falls in range
+    tail: Option<Point>,
+    // Archive blocks starting from here are also in RAM
+    archive_before: u32,
+}
+
+pub struct TimeSeriesStore {
+    memory: Mutex<Memory>,
+    archive: Mutex<Option<Archive>>,
+}
+
+impl TimeSeriesStore {
+    /// One series per quantum: the value step it is stored at
+    pub fn new(quanta: &[f32]) -> Self {
+        Self {
+            memory: Mutex::new(Memory {
+                series: quanta.iter()
+                    .map(|&quantum| SeriesState { quantum, buckets: [None; TIERS.len()], open: Default::default() })
+                    .collect(),
+                tiers: std::array::from_fn(RamTier::allocate),
+                unsaved: Vec::new(),
+            }),
+            archive: Mutex::new(None),
+        }
+    }
+
+    /// Start archiving sealed blocks under `dir`, indexing what is already there
+    pub fn attach_archive(&self, dir: &Path) -> io::Result<()> {
+        let archive = Archive::open(dir)?;
+        *lock(&self.archive) = Some(archive);
+        Ok(())
+    }
+
+    /// Record one sample of every series, in series order
+    pub fn record_all(&self, timestamp: u32, values: &[f32]) {
+        let mut memory = lock(&self.memory);
+        for (series, &value) in values.iter().enumerate().take(memory.series.len()) {
+            memory.record(series, timestamp, value);
+        }
+    }
+
+    /// Append blocks sealed since the last call to the archive, if attached
+    pub fn flush(&self) -> io::Result<()> {
+        let mut archive = lock(&self.archive);
+        let Some(archive) = archive.as_mut() else { return Ok(()) };
+        let unsaved = std::mem::take(&mut lock(&self.memory).unsaved);
+        for tier in 0..TIERS.len() {
+            let blocks: Vec<&[u8]> = unsaved.iter()
+                .filter(|(t, _)| *t == tier)
+                .map(|(_, bytes)| bytes.as_slice())
+                .collect();
+            if !blocks.is_empty() {
+                archive.append(tier, &blocks)?;
+            }
+        }
+        Ok(())
+    }
+
+    /// Call `f` for every point of `series` in `tier` with a timestamp in
+    /// `from..=to`, oldest first
+    pub fn query(&self, series: usize, tier: usize, from: u32, to: u32, mut f: impl FnMut(Point)) {
+        let Some((plan, quantum)) = self.plan(series, tier, from, to) else { return };
+
+        let mut emit = |point: Point| {
+            if point.timestamp >= from && point.timestamp <= to {
+                f(point);
+            }
+        };
+        // Archived blocks are decoded as they are read. Flush and stats wait
+        // on this lock meanwhile, holding no other while they do.
+        let before = plan.archive_before;
+        if let Some(archive) = lock(&self.archive).as_ref() {
+            archive.read(series as u8, tier, from, to, before, |block| {
+                decode_block(block, quantum, &mut |point| if point.timestamp < before { emit(point) });
+            });
+        }
+        for block in &plan.blocks {
+            decode_block(block, quantum, &mut emit);
+        }
+        if let Some(point) = plan.tail {
+            emit(point);
+        }
+    }
+
+    /// Like `query`, but merges neighbouring points so that at most
+    /// `max_points` come out. `from..=to` is cut into equal buckets; each
+    /// reports its first timestamp, the mean of its averages, and its min and max.
+    pub fn query_at_most(&self, series: usize, tier: usize, from: u32, to: u32, max_points: u32,
+                         mut f: impl FnMut(Point)) {
+        let width = (to.saturating_sub(from) as u64 + 1).div_ceil(max_points.max(1) as u64);
+        // Bucket index, merged point and the number of points in it
+        let mut open: Option<(u64, Point, u32)> = None;
+        self.query(series, tier, from, to, |point| {
+            let bucket = (point.timestamp - from) as u64 / width;
+            match open {
+                Some((index, ref mut merged, ref mut count)) if index == bucket => {
+                    merged.value += point.value;
+                    merged.min = merged.min.min(point.min);
+                    merged.max = merged.max.max(point.max);
+                    *count += 1;
+                }
+                _ => {
+                    if let Some((_, merged, count)) = open.replace((bucket, point, 1)) {
+                        f(Point { value: merged.value / count as f32, ..merged });
+                    }
+                }
+            }
+        });
+        if let Some((_, merged, count)) = open {
+            f(Point { value: merged.value / count as f32, ..merged });
+        }
+    }
+
+    // Copy the in-memory blocks a query needs, holding the lock only for that
+    fn plan(&self, series: usize, tier: usize, from: u32, to: u32) -> Option<(QueryPlan, f32)> {
+        let memory = lock(&self.memory);
+        let state = memory.series.get(series)?;
+        let columns = if tier == 0 { 1 } else { 3 };
+        let mut plan = QueryPlan { blocks: Vec::new(), tail: None, archive_before: u32::MAX };
+
+        let ram = &memory.tiers[tier];
+        for (offset, info) in ram.iter().filter(|(_, info)| info.series as usize == series) {
+            if info.start >= VALID_EPOCH {
+                plan.archive_before = plan.archive_before.min(info.start);
+            }
+            if info.overlaps(from, to) {
+                plan.blocks.push(ram.copy(offset, &info));
+            }
+        }
+        let open = &state.open[tier];
+        if open.count > 0 {
+            if open.start >= VALID_EPOCH {
+                plan.archive_before = plan.archive_before.min(open.start);
+            }
+            if open.last >= from && open.start <= to {
+                plan.blocks.push(open.encode(series as u8, tier as u8, columns));
+            }
+        }
+        if let Some(bucket) = state.buckets[tier] {
+            if bucket.start >= VALID_EPOCH {
+                plan.archive_before = plan.archive_before.min(bucket.start);
+            }
+            plan.tail = Some(bucket.point());
+        }
+        Some((plan, state.quantum))
+    }
+
+    pub fn stats(&self) -> StoreStats {
+        let (ram_bytes, ram_blocks, unsaved_blocks) = {
+            let memory = lock(&self.memory);
+            (
+                memory.tiers.iter().map(|tier| tier.bytes).sum(),
+                memory.tiers.iter().map(|tier| tier.blocks).sum(),
+                memory.unsaved.len(),
+            )
+        };
+        let archive = lock(&self.archive);
+        StoreStats {
+            ram_bytes,
+            ram_blocks,
+            archive_bytes: archive.as_ref().map(Archive::bytes).unwrap_or(0),
+            archive_blocks: archive.as_ref().map(|a| a.tiers.iter().map(|t| t.index.len()).sum()).unwrap_or(0),
+            unsaved_blocks,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn collect(store: &TimeSeriesStore, series: usize, tier: usize, from: u32, to: u32) -> Vec<Point> {
+        let mut points = Vec::new();
+        store.query(series, tier, from, to, |point| points.push(point));
+        points
+    }
+
+    #[test]
+    fn test_block_round_trip_and_compactness() {
+        let mut builder = BlockBuilder::default();
+        let timestamps = [VALID_EPOCH, VALID_EPOCH + 1, VALID_EPOCH + 2, VALID_EPOCH + 5, VALID_EPOCH + 6];
+        for (i, &t) in timestamps.iter().enumerate() {
+            builder.push(t, [i as i64 * 3, -(i as i64), 1000], 3);
+        }
+        let block = builder.encode(7, 1, 3);
+        // 4 timestamp deltas and 15 small value deltas, one byte each
+        assert!(block.len() <= HEADER_LEN + 4 + 15 + 2, "block is {} bytes", block.len());
+
+        let mut points = Vec::new();
+        assert!(decode_block(&block, 0.5, &mut |p| points.push(p)));
+        assert_eq!(points.len(), 5);
+        assert_eq!(points[3], Point { timestamp: VALID_EPOCH + 5, value: 4.5, min: -1.5, max: 500.0 });
+
+        let mut corrupt = block.clone();
+        *corrupt.last_mut().unwrap() ^= 0x01;
+        assert!(!decode_block(&corrupt, 0.5, &mut |_| {}));
+    }
+
+    #[test]
+    fn test_ram_ring_wraps_and_evicts_oldest() {
+        let mut ram = RamTier::allocate(2);
+        let mut pushed = 0u32;
+        while (pushed as usize) < 3 * ram.capacity / HEADER_LEN {
+            let mut builder = BlockBuilder::default();
+            for i in 0..1 + pushed % 7 {
+                builder.push(pushed * 100 + i, [i as i64; 3], 3);
+            }
+            ram.push(&builder.encode(0, 2, 3));
+            pushed += 1;
+        }
+        assert!(ram.bytes <= ram.capacity && ram.blocks > 0);
+
+        // The survivors are the newest blocks, in order, and still decode
+        let blocks: Vec<_> = ram.iter().collect();
+        assert_eq!(blocks.len(), ram.blocks);
+        assert_eq!(blocks.last().unwrap().1.start, (pushed - 1) * 100);
+        assert!(blocks.windows(2).all(|w| w[1].1.start == w[0].1.start + 100));
+        for (offset, info) in &blocks {
+            assert!(decode_block(&ram.copy(*offset, info), 1.0, &mut |_| {}));
+        }
+    }
+
+    #[test]
+    fn test_rollups_and_archive_rotation() {
+        let dir = std::env::temp_dir().join(format!("tsdb-test-{}", std::process::id()));
+        let _ = fs::remove_dir_all(&dir);
+        fs::create_dir_all(&dir).unwrap();
+
+        let store = TimeSeriesStore::new(&[0.1]);
+        store.attach_archive(&dir).unwrap();
+        let start = VALID_EPOCH + 3600 - VALID_EPOCH % 3600;
+        for t in 0..7200u32 {
+            store.record_all(start + t, &[(t % 60) as f32]);
+            if t % 100 == 0 {
+                store.flush().unwrap();
+            }
+        }
+        store.flush().unwrap();
+
+        let minutes = collect(&store, 0, 1, start, start + 7200);
+        assert_eq!(minutes.len(), 120);
+        assert_eq!((minutes[5].min, minutes[5].max), (0.0, 59.0));
+        assert!((minutes[5].value - 29.5).abs() < 0.05);
+
+        let seconds = collect(&store, 0, 0, start + 600, start + 659);
+        assert_eq!(seconds.len(), 60);
+        assert!(seconds.windows(2).all(|w| w[1].timestamp == w[0].timestamp + 1));
+
+        // A wide span on the 1 s tier is merged down to max_points
+        let mut decimated = Vec::new();
+        store.query_at_most(0, 0, start, start + 3599, 100, |point| decimated.push(point));
+        assert!(!decimated.is_empty() && decimated.len() <= 100, "{} points", decimated.len());
+        assert_eq!((decimated[0].timestamp, decimated[0].min, decimated[0].max), (start, 0.0, 35.0));
+        let mut all = 0;
+        store.query_at_most(0, 0, start + 600, start + 659, 1500, |_| all += 1);
+        assert_eq!(all, 60);
+
+        // A fresh store only sees the archive and returns the same sealed minutes
+        let reopened = TimeSeriesStore::new(&[0.1]);
+        reopened.attach_archive(&dir).unwrap();
+        let archived = collect(&reopened, 0, 1, start, start + 7200);
+        assert_eq!(archived, minutes[..archived.len()].to_vec());
+        assert_eq!(archived.len(), 60);
+        assert!(reopened.stats().archive_blocks > 0);
+
+        fs::remove_dir_all(&dir).unwrap();
+    }
+}
@@ -1,9 +1,38 @@
+// Interrupt-driven button input
+//
+// Each button's GPIO ISR timestamps the edge with esp_timer, reads the level
+// and pushes the pair onto a lock-free ring before waking the main loop. Both
+// handlers run from the one GPIO ISR service and never nest, so they share
+// the ring as its single producer. The driver disarms a pin's interrupt when
+// it fires. poll() re-arms it once DEBOUNCE_TIME has passed since the edge,
+// and that lockout is the debounce: the first edge is taken at its hardware
+// timestamp, the bounces after it never interrupt, and the level is read
+// again once the contacts have settled. Until then the pin counts as
+// disarmed and its settle time stays a deadline, however late the loop is,
+// so a pin is never left without an interrupt. ButtonState holds that state
+// machine apart from the pins. Events carry the ISR timestamp, so
+// the display can measure input-to-photon latency from the moment the edge
+// arrived, however long the loop took to drain it.
+
 use anyhow::Result;
-use esp_idf_hal::gpio::{PinDriver, Input, Pull, AnyIOPin};
+use esp_idf_hal::gpio::{PinDriver, Input, Pull, AnyIOPin, InterruptType};
+use crate::power::frame_scheduler::{self, WAKE_BUTTON};
+use crate::ring_buffer::{spsc_ring, RingConsumer};
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicU32, Ordering};
+use std::sync::Arc;
 use std::time::{Duration, Instant};
 
 const DEBOUNCE_TIME: Duration = Duration::from_millis(50);
 const LONG_PRESS_TIME: Duration = Duration::from_millis(1000);
+const DEBOUNCE_US: i64 = DEBOUNCE_TIME.as_micros() as i64;
+const LONG_PRESS_US: i64 = LONG_PRESS_TIME.as_micros() as i64;
+/// Edges the ISRs can queue between two polls; with the lockout a press
+/// costs at most one per button
+const EDGE_RING_CAPACITY: usize = 16;
+
+// Bit n set by the ISR when button n fired with the ring full
+static LOST_EDGES: AtomicU32 = AtomicU32::new(0);
 
 #[derive(Debug, Clone, Copy, PartialEq)]
 pub enum ButtonEvent {
@@ -18,29 +47,154 @@ pub enum ButtonEvent {
     BothButtonsLongPress, // Shutdown trigger
 }
 
+impl ButtonEvent {
+    /// Whether UiManager::handle_button_event changes what is on screen
+    pub fn affects_display(self) -> bool {
+        matches!(self, ButtonEvent::Button1Click | ButtonEvent::Button2Click)
+    }
+}
+
+/// A decoded event and the esp_timer time (us) of the edge behind it
+#[derive(Debug, Clone, Copy)]
+pub struct InputEvent {
+    pub event: ButtonEvent,
+    pub timestamp_us: i64,
+}
+
+impl InputEvent {
+    /// Time since the edge
+    pub fn age(&self) -> Duration {
+        Duration::from_micros(now_us().saturating_sub(self.timestamp_us).max(0) as u64)
+    }
+}
+
+#[derive(Debug, Clone, Copy)]
+struct Edge {
+    button: u8,
+    pressed: bool,
+    at_us: i64,
+}
+
 pub struct ButtonManager {
     button1: PinDriver<'static, AnyIOPin, Input>,
     button2: PinDriver<'static, AnyIOPin, Input>,
+    edges: RingConsumer<Edge, EDGE_RING_CAPACITY>,
     button1_state: ButtonState,
     button2_state: ButtonState,
+    // Decoded but not yet returned by poll()
+    pending: VecDeque<InputEvent>,
 }
 
+/// Debounce and press decoding for one button, driven by edge and level
+/// readings with their timestamps
 struct ButtonState {
+    number: u8,
     pressed: bool,
-    press_time: Option<Instant>,
-    last_change: Instant,
+    press_at_us: Option<i64>,
+    // Last accepted state change, and the last edge of any kind
+    last_change_us: i64,
+    last_edge_us: i64,
+    // False from an edge until poll() re-enables the pin's interrupt
+    armed: bool,
     long_press_fired: bool,
 }
 
-impl Default for ButtonState {
-    fn default() -> Self {
+impl ButtonState {
+    fn new(number: u8) -> Self {
         Self {
+            number,
             pressed: false,
-            press_time: None,
-            last_change: Instant::now(),
+            press_at_us: None,
+            last_change_us: i64::MIN / 2,
+            last_edge_us: i64::MIN / 2,
+            armed: true,
             long_press_fired: false,
         }
     }
+
+    /// An edge from the ISR; the driver has disarmed the pin
+    fn edge(&mut self, pressed: bool, at_us: i64) -> Option<InputEvent> {
+        self.disarm(at_us);
+        if at_us - self.last_change_us < DEBOUNCE_US {
+            return None;
+        }
+        self.change_state(pressed, at_us)
+    }
+
+    /// The pin fired at or before `at_us` without its edge being seen
+    fn disarm(&mut self, at_us: i64) {
+        self.last_edge_us = self.last_edge_us.max(at_us);
+        self.armed = false;
+    }
+
+    /// Whether the lockout is over and the pin waits to be re-armed
+    fn rearm_due(&self, now_us: i64) -> bool {
+        !self.armed && now_us - self.last_edge_us >= DEBOUNCE_US
+    }
+
+    /// The pin is armed again and settled at `pressed`; a change here is an
+    /// edge that came in during the lockout
+    fn rearm(&mut self, pressed: bool, now_us: i64) -> Option<InputEvent> {
+        self.armed = true;
+        self.change_state(pressed, now_us)
+    }
+
+    /// When this button next needs a poll without a new edge: its re-arm,
+    /// even if overdue, or a long press coming due
+    fn deadline(&self) -> Option<i64> {
+        let settle = (!self.armed).then_some(self.last_edge_us + DEBOUNCE_US);
+        let long_press = self.press_at_us
+            .filter(|_| self.pressed && !self.long_press_fired)
+            .map(|press| press + LONG_PRESS_US);
+        settle.into_iter().chain(long_press).min()
+    }
+
+    /// Apply a debounced level at `at_us`
+    fn change_state(&mut self, pressed: bool, at_us: i64) -> Option<InputEvent> {
+        if pressed == self.pressed {
+            return None;
+        }
+        self.last_change_us = at_us;
+        self.pressed = pressed;
+
+        let event = if pressed {
+            self.press_at_us = Some(at_us);
+            self.long_press_fired = false;
+            match self.number {
+                1 => ButtonEvent::Button1Press,
+                _ => ButtonEvent::Button2Press,
+            }
+        } else {
+            let press_duration = self.press_at_us.take().map_or(0, |press| at_us - press);
+            // Generate click event if not a long press
+            match (self.number, press_duration < LONG_PRESS_US && !self.long_press_fired) {
+                (1, true) => ButtonEvent::Button1Click,
+                (_, true) => ButtonEvent::Button2Click,
+                (1, false) => ButtonEvent::Button1Release,
+                (_, false) => ButtonEvent::Button2Release,
+            }
+        };
+        Some(InputEvent { event, timestamp_us: at_us })
+    }
+
+    fn check_long_press(&mut self, now_us: i64) -> Option<InputEvent> {
+        let press = self.press_at_us?;
+        if !self.pressed || self.long_press_fired || now_us - press < LONG_PRESS_US {
+            return None;
+        }
+        self.long_press_fired = true;
+        Some(InputEvent {
+            event: match self.number {
+                1 => ButtonEvent::Button1LongPress,
+                _ => ButtonEvent::Button2LongPress,
+            },
+            timestamp_us: press + LONG_PRESS_US,
+        })
+    }
+}
+
+fn now_us() -> i64 {
+    unsafe { esp_idf_sys::esp_timer_get_time() }
 }
 
 impl ButtonManager {
@@ -50,120 +204,159 @@ impl ButtonManager {
     ) -> Result<Self> {
         let mut button1 = PinDriver::input(button1_pin.into())?;
         let mut button2 = PinDriver::input(button2_pin.into())?;
-        
+
         // Set pull-up resistors
         button1.set_pull(Pull::Up)?;
         button2.set_pull(Pull::Up)?;
 
+        let (edge_tx, edges) = spsc_ring();
+        let edge_tx = Arc::new(edge_tx);
+        for (index, button) in [&mut button1, &mut button2].into_iter().enumerate() {
+            button.set_interrupt_type(InterruptType::AnyEdge)?;
+            let pin = button.pin();
+            let edge_tx = edge_tx.clone();
+            unsafe {
+                button.subscribe(move || {
+                    let at_us = esp_idf_sys::esp_timer_get_time();
+                    // Active low
+                    let pressed = esp_idf_sys::gpio_get_level(pin) == 0;
+                    // A full ring only loses the edge; poll() still re-arms the pin and reads the level
+                    if edge_tx.push(Edge { button: index as u8, pressed, at_us }).is_err() {
+                        LOST_EDGES.fetch_or(1 << index, Ordering::Relaxed);
+                    }
+                    frame_scheduler::wake_from_isr(WAKE_BUTTON);
+                })?;
+            }
+            button.enable_interrupt()?;
+        }
+
         Ok(Self {
             button1,
             button2,
-            button1_state: ButtonState::default(),
-            button2_state: ButtonState::default(),
+            edges,
+            button1_state: ButtonState::new(1),
+            button2_state: ButtonState::new(2),
+            pending: VecDeque::with_capacity(8),
         })
     }
 
-    pub fn poll(&mut self) -> Option<ButtonEvent> {
-        // Check button states
-        let button1_pressed = self.button1.is_low(); // Active low
-        let button2_pressed = self.button2.is_low(); // Active low
-        
-        // Check for both buttons long press (shutdown trigger)
-        if button1_pressed && button2_pressed {
-            if let (Some(press1), Some(press2)) = (self.button1_state.press_time, self.button2_state.press_time) {
-                let now = Instant::now();
-                let duration1 = now.duration_since(press1);
-                let duration2 = now.duration_since(press2);
-                
-                // Both held for long press time and we haven't fired this event yet
-                if duration1 >= LONG_PRESS_TIME && duration2 >= LONG_PRESS_TIME 
-                    && !self.button1_state.long_press_fired && !self.button2_state.long_press_fired {
-                    self.button1_state.long_press_fired = true;
-                    self.button2_state.long_press_fired = true;
-                    return Some(ButtonEvent::BothButtonsLongPress);
-                }
-            }
-        }
-        
-        // Check button 1
-        if let Some(event) = Self::check_button_state(button1_pressed, &mut self.button1_state, 1) {
-            return Some(event);
+    /// When poll() next has work without a new edge: a pin to re-arm or a
+    /// long press coming due. None means only an interrupt can change anything.
+    pub fn next_deadline(&self) -> Option<Instant> {
+        if !self.pending.is_empty() {
+            return Some(Instant::now());
         }
+        let now = now_us();
+        let earliest = self.button1_state.deadline().into_iter().chain(self.button2_state.deadline()).min()?;
+        Some(Instant::now() + Duration::from_micros(earliest.saturating_sub(now).max(0) as u64))
+    }
 
-        // Check button 2
-        if let Some(event) = Self::check_button_state(button2_pressed, &mut self.button2_state, 2) {
+    /// Next decoded event, oldest first; call until it returns None
+    pub fn poll(&mut self) -> Option<InputEvent> {
+        if let Some(event) = self.pending.pop_front() {
             return Some(event);
         }
+        let now = now_us();
 
-        None
-    }
-
-    fn check_button_state(
-        pressed: bool,
-        state: &mut ButtonState,
-        button_num: u8,
-    ) -> Option<ButtonEvent> {
-        let now = Instant::now();
+        // Edges in the order the ISRs saw them
+        while let Some(edge) = self.edges.pop() {
+            let state = match edge.button {
+                0 => &mut self.button1_state,
+                _ => &mut self.button2_state,
+            };
+            if let Some(event) = state.edge(edge.pressed, edge.at_us) {
+                self.pending.push_back(event);
+            }
+        }
+        let lost = LOST_EDGES.swap(0, Ordering::Relaxed);
+        for (index, state) in [&mut self.button1_state, &mut self.button2_state].into_iter().enumerate() {
+            if lost & (1 << index) != 0 {
+                state.disarm(now);
+            }
+        }
 
-        // Debounce
-        if now.duration_since(state.last_change) < DEBOUNCE_TIME {
-            return None;
+        // Once a lockout is over, re-arm the pin and take the level it settled at
+        for (button, state) in [(&mut self.button1, &mut self.button1_state),
+                                (&mut self.button2, &mut self.button2_state)] {
+            if !state.rearm_due(now) {
+                continue;
+            }
+            button.enable_interrupt().ok();
+            let pressed = button.is_low(); // Active low
+            if let Some(event) = state.rearm(pressed, now) {
+                self.pending.push_back(event);
+            }
         }
 
-        // State change detection
-        if pressed != state.pressed {
-            state.last_change = now;
-            state.pressed = pressed;
-
-            if pressed {
-                // Button pressed
-                state.press_time = Some(now);
-                state.long_press_fired = false;
-                
-                return Some(match button_num {
-                    1 => ButtonEvent::Button1Press,
-                    2 => ButtonEvent::Button2Press,
-                    _ => unreachable!(),
-                });
-            } else {
-                // Button released
-                let press_duration = state.press_time
-                    .map(|t| now.duration_since(t))
-                    .unwrap_or(Duration::ZERO);
-
-                state.press_time = None;
-
-                // Generate click event if not a long press
-                if press_duration < LONG_PRESS_TIME && !state.long_press_fired {
-                    return Some(match button_num {
-                        1 => ButtonEvent::Button1Click,
-                        2 => ButtonEvent::Button2Click,
-                        _ => unreachable!(),
+        // Check for both buttons long press (shutdown trigger)
+        let (first, second) = (&mut self.button1_state, &mut self.button2_state);
+        if first.pressed && second.pressed && !first.long_press_fired && !second.long_press_fired {
+            if let (Some(press1), Some(press2)) = (first.press_at_us, second.press_at_us) {
+                let both_since = press1.max(press2);
+                if now - both_since >= LONG_PRESS_US {
+                    first.long_press_fired = true;
+                    second.long_press_fired = true;
+                    self.pending.push_back(InputEvent {
+                        event: ButtonEvent::BothButtonsLongPress,
+                        timestamp_us: both_since + LONG_PRESS_US,
                     });
                 }
-
-                return Some(match button_num {
-                    1 => ButtonEvent::Button1Release,
-                    2 => ButtonEvent::Button2Release,
-                    _ => unreachable!(),
-                });
             }
         }
 
-        // Check for long press
-        if pressed && !state.long_press_fired {
-            if let Some(press_time) = state.press_time {
-                if now.duration_since(press_time) >= LONG_PRESS_TIME {
-                    state.long_press_fired = true;
-                    return Some(match button_num {
-                        1 => ButtonEvent::Button1LongPress,
-                        2 => ButtonEvent::Button2LongPress,
-                        _ => unreachable!(),
-                    });
-                }
+        for state in [&mut self.button1_state, &mut self.button2_state] {
+            if let Some(event) = state.check_long_press(now) {
+                self.pending.push_back(event);
             }
         }
 
-        None
+        self.pending.pop_front()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn event(input: Option<InputEvent>) -> Option<(ButtonEvent, i64)> {
+        input.map(|input| (input.event, input.timestamp_us))
     }
-}
\ No newline at end of file
+
+    #[test]
+    fn test_late_poll_still_rearms_and_reads_the_settled_level() {
+        let mut state = ButtonState::new(1);
+        assert_eq!(state.deadline(), None);
+
+        // The press is taken at its edge; the bounce after it is locked out
+        assert_eq!(event(state.edge(true, 1_000)), Some((ButtonEvent::Button1Press, 1_000)));
+        assert_eq!(event(state.edge(false, 1_500)), None);
+        assert_eq!(state.deadline(), Some(1_500 + DEBOUNCE_US));
+
+        // The loop slept through the lockout: the re-arm stays due, not dropped
+        let late = 1_500 + 10 * DEBOUNCE_US;
+        assert!(state.rearm_due(late));
+        assert_eq!(state.deadline(), Some(1_500 + DEBOUNCE_US));
+
+        // Released during the lockout, so the re-arm reports the click
+        assert_eq!(event(state.rearm(false, late)), Some((ButtonEvent::Button1Click, late)));
+        assert!(!state.rearm_due(late + DEBOUNCE_US));
+        assert_eq!(state.deadline(), None);
+
+        // A lost edge disarms the pin just the same
+        state.disarm(late + 100);
+        assert!(!state.rearm_due(late + 100 + DEBOUNCE_US - 1));
+        assert_eq!(event(state.rearm(true, late + 100 + DEBOUNCE_US)),
+                   Some((ButtonEvent::Button1Press, late + 100 + DEBOUNCE_US)));
+    }
+
+    #[test]
+    fn test_held_press_becomes_a_long_press_and_release() {
+        let mut state = ButtonState::new(2);
+        state.edge(true, 0);
+        assert_eq!(event(state.rearm(true, DEBOUNCE_US)), None);
+        assert_eq!(state.deadline(), Some(LONG_PRESS_US));
+        assert_eq!(event(state.check_long_press(LONG_PRESS_US - 1)), None);
+        assert_eq!(event(state.check_long_press(LONG_PRESS_US)), Some((ButtonEvent::Button2LongPress, LONG_PRESS_US)));
+        assert_eq!(event(state.edge(false, 2 * LONG_PRESS_US)), Some((ButtonEvent::Button2Release, 2 * LONG_PRESS_US)));
+    }
+}
@@ -28,12 +28,8 @@ impl UptimeTracker {
             }
         }
 
-        // Try to take default NVS partition first; on INVALID_STATE fall back silently
-        let nvs_result = esp_idf_svc::nvs::EspNvsPartition::<NvsDefault>::take()
-            .or_else(|_e| {
-                // Avoid noisy warnings; just try the default NVS partition
-                esp_idf_svc::nvs::EspDefaultNvsPartition::take().map(|p| p.into())
-            });
+        // Shared handle; the partition is already taken once WiFi is up
+        let nvs_result = crate::config::nvs_partition();
         
         let (nvs, total_uptime, boot_count) = match nvs_result {
             Ok(nvs_partition) => {
@@ -1,8 +1,7 @@
 // HTML templates for web server
 // Separated from web_server.rs for better maintainability
 
-/// Sensor graphs page template
-pub const GRAPHS_PAGE: &str = include_str!("graphs.html");
+// Sensor graphs page is served by network::static_assets (gzipped in build.rs)
 
 /// OTA update page template
 pub const OTA_PAGE: &str = include_str!("ota.html");
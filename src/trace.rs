@@ -0,0 +1,450 @@
+// Frame-level tracing spans (served at /debug/trace)
+//
+// perf_metrics says a frame took 16 ms, and debug_probe can log one timing
+// at a time. Neither says where those 16 ms went. A span is a guard around
+// a block. It has a static id, so a hot path never formats or allocates.
+// On drop it writes one fixed-size record into the ring of the core it ran
+// on. Each per-core ring is a seqlock'd array of atomics. A writer claims its
+// slot with one fetch_add, so tasks that preempt each other on a core never
+// wait on one another. The oldest records are overwritten. A reader that
+// catches a slot mid-write skips it.
+//
+// Timestamps come from esp_timer, not the CPU cycle counter. Each core has
+// its own CCOUNT, and the counters are not synchronised. It also stops in
+// light sleep. esp_timer is the shared systimer, so spans from both cores
+// line up on one timeline at the microsecond resolution both export formats
+// use.
+//
+// Fine-grained spans (fill_rect, write_pixels) run hundreds of times per
+// frame and would flush a frame's history out of the ring. They are only
+// recorded while detail is switched on (/debug/trace?detail=1).
+//
+// The rings are exported as Chrome trace JSON (chrome://tracing, Perfetto)
+// or as OTLP/JSON. In OTLP, parents come from nesting on the same task, and
+// each root span starts its own trace.
+
+use std::collections::HashMap;
+use std::fmt::{self, Write as _};
+use std::sync::atomic::{fence, AtomicBool, AtomicU32, Ordering};
+use std::sync::{Mutex, OnceLock};
+
+/// Records kept per core; a power of two. Both rings together are over the
+/// 16 KB malloc threshold, so with PSRAM they are allocated there.
+pub const RING_CAPACITY: usize = 512;
+const CORES: usize = 2;
+const SCRATCH_BYTES: usize = 512;
+const SERVICE_NAME: &str = "esp32-dashboard";
+
+// Spans with this bit set are only recorded in detail mode
+const DETAIL_BIT: u16 = 0x8000;
+
+/// Static span id. Names are resolved only when the ring is exported.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SpanId(u16);
+
+impl SpanId {
+    fn index(self) -> usize {
+        (self.0 & !DETAIL_BIT) as usize
+    }
+
+    fn is_detail(self) -> bool {
+        self.0 & DETAIL_BIT != 0
+    }
+}
+
+pub const FRAME: SpanId = SpanId(0);
+pub const UI_RENDER: SpanId = SpanId(1);
+pub const RENDER_SYSTEM: SpanId = SpanId(2);
+pub const RENDER_NETWORK: SpanId = SpanId(3);
+pub const RENDER_SENSOR: SpanId = SpanId(4);
+pub const RENDER_SETTINGS: SpanId = SpanId(5);
+pub const RENDER_OTA: SpanId = SpanId(6);
+pub const DISPLAY_FLUSH: SpanId = SpanId(7);
+pub const FILL_RECT: SpanId = SpanId(8 | DETAIL_BIT);
+pub const WRITE_PIXELS: SpanId = SpanId(9 | DETAIL_BIT);
+pub const SENSOR_SAMPLE: SpanId = SpanId(10);
+pub const CORE1_PROCESS: SpanId = SpanId(11);
+pub const CORE1_NETWORK: SpanId = SpanId(12);
+
+// (name, category), indexed by SpanId
+const BUILTIN: [(&str, &str); 13] = [
+    ("frame", "frame"),
+    ("ui.render", "ui"),
+    ("ui.render_system_screen", "ui"),
+    ("ui.render_network_screen", "ui"),
+    ("ui.render_sensor_screen", "ui"),
+    ("ui.render_settings_screen", "ui"),
+    ("ui.render_ota_screen", "ui"),
+    ("display.flush", "display"),
+    ("display.fill_rect", "display"),
+    ("lcd.write_pixels", "display"),
+    ("sensors.sample", "sensors"),
+    ("core1.process", "core1"),
+    ("core1.network_monitor", "core1"),
+];
+
+// Ids handed out at runtime (one per HTTP route), after the builtins
+static REGISTERED: Mutex<Vec<(&'static str, &'static str)>> = Mutex::new(Vec::new());
+
+/// Allocate an id for a span named at runtime, e.g. an HTTP route. Call once
+/// per name at setup, not per span. Names must not need JSON escaping.
+pub fn register(name: &'static str, category: &'static str) -> SpanId {
+    let mut registered = REGISTERED.lock().unwrap_or_else(|poisoned| poisoned.into_inner());
+    registered.push((name, category));
+    SpanId((BUILTIN.len() + registered.len() - 1).min((DETAIL_BIT - 1) as usize) as u16)
+}
+
+struct Slot {
+    // 0 while being written, otherwise the ring index + 1 it holds
+    seq: AtomicU32,
+    id: AtomicU32,
+    task: AtomicU32,
+    start_lo: AtomicU32,
+    start_hi: AtomicU32,
+    dur_us: AtomicU32,
+}
+
+struct Ring {
+    head: AtomicU32,
+    slots: &'static [Slot],
+}
+
+struct Tracer {
+    rings: [Ring; CORES],
+    // Mixed into OTLP ids so traces from different boots never collide
+    salt: u32,
+}
+
+static TRACER: OnceLock<Tracer> = OnceLock::new();
+static DETAIL: AtomicBool = AtomicBool::new(false);
+
+/// Allocate the rings; spans before this are dropped
+pub fn init() {
+    TRACER.get_or_init(|| {
+        let slots: &'static [Slot] = (0..CORES * RING_CAPACITY)
+            .map(|_| Slot {
+                seq: AtomicU32::new(0),
+                id: AtomicU32::new(0),
+                task: AtomicU32::new(0),
+                start_lo: AtomicU32::new(0),
+                start_hi: AtomicU32::new(0),
+                dur_us: AtomicU32::new(0),
+            })
+            .collect::<Vec<_>>()
+            .leak();
+        let (core0, core1) = slots.split_at(RING_CAPACITY);
+        log::info!("Trace: {} spans per core", RING_CAPACITY);
+        Tracer {
+            rings: [Ring { head: AtomicU32::new(0), slots: core0 }, Ring { head: AtomicU32::new(0), slots: core1 }],
+            salt: unsafe { esp_idf_sys::esp_random() },
+        }
+    });
+}
+
+/// Record fill_rect/write_pixels spans too
+pub fn set_detail(enabled: bool) {
+    DETAIL.store(enabled, Ordering::Relaxed);
+}
+
+pub fn detail() -> bool {
+    DETAIL.load(Ordering::Relaxed)
+}
+
+#[inline]
+fn now_us() -> u64 {
+    unsafe { esp_idf_sys::esp_timer_get_time() as u64 }
+}
+
+/// Open a span; it is recorded when the guard drops
+#[inline]
+pub fn span(id: SpanId) -> Span {
+    let active = TRACER.get().is_some() && (!id.is_detail() || detail());
+    Span { id, start_us: if active { now_us() } else { 0 }, active }
+}
+
+#[must_use = "a span covers the scope of its guard"]
+pub struct Span {
+    id: SpanId,
+    start_us: u64,
+    active: bool,
+}
+
+impl Drop for Span {
+    #[inline]
+    fn drop(&mut self) {
+        if self.active {
+            record(self.id, self.start_us, now_us());
+        }
+    }
+}
+
+fn record(id: SpanId, start_us: u64, end_us: u64) {
+    let Some(tracer) = TRACER.get() else { return };
+    // The core this runs on; xTaskGetCoreID gives the task's affinity, which
+    // is tskNO_AFFINITY for unpinned tasks such as httpd
+    let core = esp_idf_hal::cpu::core() as usize % CORES;
+    let task = unsafe { esp_idf_sys::xTaskGetCurrentTaskHandle() } as usize as u32;
+    let ring = &tracer.rings[core];
+    let index = ring.head.fetch_add(1, Ordering::Relaxed);
+    let slot = &ring.slots[index as usize & (RING_CAPACITY - 1)];
+
+    slot.seq.store(0, Ordering::Relaxed);
+    fence(Ordering::Release);
+    slot.id.store(id.index() as u32, Ordering::Relaxed);
+    slot.task.store(task, Ordering::Relaxed);
+    slot.start_lo.store(start_us as u32, Ordering::Relaxed);
+    slot.start_hi.store((start_us >> 32) as u32, Ordering::Relaxed);
+    slot.dur_us.store(end_us.saturating_sub(start_us).min(u32::MAX as u64) as u32, Ordering::Relaxed);
+    slot.seq.store(index.wrapping_add(1).max(1), Ordering::Release);
+}
+
+/// One completed span, as read back from a ring
+#[derive(Debug, Clone)]
+pub struct TraceEvent {
+    pub name: &'static str,
+    pub category: &'static str,
+    pub core: u8,
+    pub task: u32,
+    pub start_us: u64,
+    pub dur_us: u32,
+    seq: u32,
+}
+
+impl TraceEvent {
+    fn end_us(&self) -> u64 {
+        self.start_us + self.dur_us as u64
+    }
+}
+
+/// Copy out every intact record, oldest first
+pub fn snapshot() -> Vec<TraceEvent> {
+    let Some(tracer) = TRACER.get() else { return Vec::new() };
+    let registered = REGISTERED.lock().unwrap_or_else(|poisoned| poisoned.into_inner()).clone();
+    let describe = |id: usize| BUILTIN.get(id).or_else(|| registered.get(id - BUILTIN.len())).copied();
+
+    let mut events = Vec::with_capacity(CORES * RING_CAPACITY);
+    for (core, ring) in tracer.rings.iter().enumerate() {
+        let head = ring.head.load(Ordering::Acquire);
+        // Walking back from head stays right across u32 wrap; slots not yet
+        // written on the first lap fail the seq check
+        for back in (1..=RING_CAPACITY as u32).rev() {
+            let index = head.wrapping_sub(back);
+            let slot = &ring.slots[index as usize & (RING_CAPACITY - 1)];
+            let seq = slot.seq.load(Ordering::Acquire);
+            let id = slot.id.load(Ordering::Relaxed) as usize;
+            let task = slot.task.load(Ordering::Relaxed);
+            let start_us = slot.start_lo.load(Ordering::Relaxed) as u64
+                | (slot.start_hi.load(Ordering::Relaxed) as u64) << 32;
+            let dur_us = slot.dur_us.load(Ordering::Relaxed);
+            fence(Ordering::Acquire);
+            // Torn, or already overwritten by a newer lap of the ring
+            if seq != index.wrapping_add(1).max(1) || slot.seq.load(Ordering::Relaxed) != seq {
+                continue;
+            }
+            let Some((name, category)) = describe(id) else { continue };
+            events.push(TraceEvent { name, category, core: core as u8, task, start_us, dur_us, seq });
+        }
+    }
+    // Outer spans first when they start in the same microsecond: they are
+    // longer, or were recorded later
+    events.sort_by_key(|event| (event.start_us, std::cmp::Reverse((event.dur_us, event.seq))));
+    events
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TraceFormat {
+    Chrome,
+    Otlp,
+}
+
+impl TraceFormat {
+    pub fn from_query(format: Option<&str>) -> Self {
+        match format {
+            Some("otlp") => TraceFormat::Otlp,
+            _ => TraceFormat::Chrome,
+        }
+    }
+}
+
+/// Stream the current rings in `format` to `sink`
+pub fn export<F, E>(format: TraceFormat, sink: F) -> Result<(), E>
+where
+    F: FnMut(&[u8]) -> Result<(), E>,
+{
+    let events = snapshot();
+    let salt = TRACER.get().map_or(0, |tracer| tracer.salt);
+    // esp_timer counts from boot; OTLP wants wall-clock nanoseconds
+    let boot_unix_us = std::time::SystemTime::now()
+        .duration_since(std::time::UNIX_EPOCH)
+        .map_or(0, |since| since.as_micros() as u64)
+        .saturating_sub(now_us());
+    TraceEncoder::new(sink).encode(format, &events, salt, boot_unix_us)
+}
+
+/// Formats spans through a small scratch buffer, like MetricsEncoder, so a
+/// dump of both rings needs no response-sized allocation
+pub struct TraceEncoder<F, E> {
+    sink: F,
+    scratch: [u8; SCRATCH_BYTES],
+    len: usize,
+    error: Option<E>,
+}
+
+impl<F, E> TraceEncoder<F, E>
+where
+    F: FnMut(&[u8]) -> Result<(), E>,
+{
+    pub fn new(sink: F) -> Self {
+        Self { sink, scratch: [0; SCRATCH_BYTES], len: 0, error: None }
+    }
+
+    pub fn encode(mut self, format: TraceFormat, events: &[TraceEvent], salt: u32, boot_unix_us: u64) -> Result<(), E> {
+        // A formatting error here only ever means the sink failed
+        let _ = match format {
+            TraceFormat::Chrome => self.write_chrome(events),
+            TraceFormat::Otlp => self.write_otlp(events, salt, boot_unix_us),
+        };
+        self.flush();
+        match self.error {
+            Some(e) => Err(e),
+            None => Ok(()),
+        }
+    }
+
+    fn write_chrome(&mut self, events: &[TraceEvent]) -> fmt::Result {
+        self.write_str("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[")?;
+        for core in 0..CORES {
+            if core > 0 {
+                self.write_char(',')?;
+            }
+            write!(self, "{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{core},\"args\":{{\"name\":\"Core {core}\"}}}}")?;
+        }
+        for event in events {
+            write!(self, ",{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{},\"dur\":{},\"pid\":{},\"tid\":{}}}",
+                   event.name, event.category, event.start_us, event.dur_us, event.core, event.task)?;
+        }
+        self.write_str("]}")
+    }
+
+    fn write_otlp(&mut self, events: &[TraceEvent], salt: u32, boot_unix_us: u64) -> fmt::Result {
+        let span_id = |event: &TraceEvent| ((salt ^ event.core as u32) as u64) << 32 | event.seq as u64;
+
+        write!(self, "{{\"resourceSpans\":[{{\"resource\":{{\"attributes\":[{{\"key\":\"service.name\",\"value\":{{\"stringValue\":\"{SERVICE_NAME}\"}}}},")?;
+        write!(self, "{{\"key\":\"service.version\",\"value\":{{\"stringValue\":\"{}\"}}}}]}},", crate::version::DISPLAY_VERSION)?;
+        write!(self, "\"scopeSpans\":[{{\"scope\":{{\"name\":\"{SERVICE_NAME}.trace\"}},\"spans\":[")?;
+
+        // Events are in start order, so a per-task stack of open spans gives
+        // each one its parent and its root
+        let mut open: HashMap<u32, Vec<usize>> = HashMap::new();
+        let mut root_of = vec![0usize; events.len()];
+        for (i, event) in events.iter().enumerate() {
+            let stack = open.entry(event.task).or_default();
+            // A child is recorded before its parent, which settles spans that
+            // share their microseconds
+            let encloses = |outer: &TraceEvent| outer.end_us() >= event.end_us()
+                && (outer.core != event.core || outer.seq > event.seq);
+            while stack.last().is_some_and(|&top| !encloses(&events[top])) {
+                stack.pop();
+            }
+            let parent = stack.last().copied();
+            root_of[i] = parent.map_or(i, |parent| root_of[parent]);
+            stack.push(i);
+
+            if i > 0 {
+                self.write_char(',')?;
+            }
+            let start_ns = (boot_unix_us + event.start_us) * 1000;
+            write!(self, "{{\"traceId\":\"{:08x}{:08x}{:016x}\",\"spanId\":\"{:016x}\",",
+                   salt, event.core, span_id(&events[root_of[i]]), span_id(event))?;
+            if let Some(parent) = parent {
+                write!(self, "\"parentSpanId\":\"{:016x}\",", span_id(&events[parent]))?;
+            }
+            // SPAN_KIND_SERVER for HTTP handlers, INTERNAL otherwise
+            let kind = if event.category == "http" { 2 } else { 1 };
+            write!(self, "\"name\":\"{}\",\"kind\":{},\"startTimeUnixNano\":\"{}\",\"endTimeUnixNano\":\"{}\",",
+                   event.name, kind, start_ns, start_ns + event.dur_us as u64 * 1000)?;
+            write!(self, "\"attributes\":[{{\"key\":\"cpu.core\",\"value\":{{\"intValue\":\"{}\"}}}},{{\"key\":\"thread.id\",\"value\":{{\"intValue\":\"{}\"}}}}]}}",
+                   event.core, event.task)?;
+        }
+        self.write_str("]}]}]}")
+    }
+
+    fn flush(&mut self) {
+        if self.len > 0 && self.error.is_none() {
+            if let Err(e) = (self.sink)(&self.scratch[..self.len]) {
+                self.error = Some(e);
+            }
+        }
+        self.len = 0;
+    }
+}
+
+impl<F, E> fmt::Write for TraceEncoder<F, E>
+where
+    F: FnMut(&[u8]) -> Result<(), E>,
+{
+    fn write_str(&mut self, s: &str) -> fmt::Result {
+        let mut bytes = s.as_bytes();
+        while !bytes.is_empty() {
+            if self.error.is_some() {
+                return Err(fmt::Error);
+            }
+            if self.len == SCRATCH_BYTES {
+                self.flush();
+                continue;
+            }
+            let take = bytes.len().min(SCRATCH_BYTES - self.len);
+            self.scratch[self.len..self.len + take].copy_from_slice(&bytes[..take]);
+            self.len += take;
+            bytes = &bytes[take..];
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn encode(format: TraceFormat, events: &[TraceEvent]) -> serde_json::Value {
+        let mut out = Vec::new();
+        TraceEncoder::new(|chunk: &[u8]| { out.extend_from_slice(chunk); Ok::<(), ()>(()) })
+            .encode(format, events, 0xabcd, 0)
+            .unwrap();
+        serde_json::from_slice(&out).unwrap()
+    }
+
+    #[test]
+    fn test_spans_export_as_chrome_and_otlp() {
+        init();
+        let route = register("GET /debug/trace", "http");
+        {
+            let _frame = span(FRAME);
+            let _render = span(UI_RENDER);
+            // Detail spans stay out of the ring until asked for
+            let _fill = span(FILL_RECT);
+        }
+        drop(span(route));
+
+        let events: Vec<_> = snapshot().into_iter().filter(|e| e.task == snapshot_task()).collect();
+        let names: Vec<_> = events.iter().map(|e| e.name).collect();
+        assert_eq!(names, ["frame", "ui.render", "GET /debug/trace"]);
+
+        let chrome = encode(TraceFormat::Chrome, &events);
+        let spans: Vec<_> = chrome["traceEvents"].as_array().unwrap().iter().filter(|e| e["ph"] == "X").collect();
+        assert_eq!(spans.len(), 3);
+        assert!(encode(TraceFormat::Chrome, &[])["traceEvents"].is_array());
+
+        let otlp = encode(TraceFormat::Otlp, &events);
+        let spans = otlp["resourceSpans"][0]["scopeSpans"][0]["spans"].as_array().unwrap();
+        // ui.render nests under frame; the route span is its own trace
+        assert_eq!(spans[1]["parentSpanId"], spans[0]["spanId"]);
+        assert_eq!(spans[1]["traceId"], spans[0]["traceId"]);
+        assert!(spans[2].get("parentSpanId").is_none());
+        assert_eq!(spans[2]["kind"], 2);
+    }
+
+    fn snapshot_task() -> u32 {
+        unsafe { esp_idf_sys::xTaskGetCurrentTaskHandle() as usize as u32 }
+    }
+}
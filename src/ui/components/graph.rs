@@ -1,14 +1,45 @@
 // Graph and chart components for data visualization
 
-use crate::display::{Display, Color, FontRenderer};
+use anyhow::Result;
+use crate::display::{DisplayManager, DirtyRect, colors};
+use crate::display::font5x7::FONT_WIDTH;
+use crate::ui::widgets::Widget;
 use heapless::Vec;
 
+/// Dark gray grid
+const GRID_COLOR: u16 = 0x2104;
+
 #[derive(Debug, Clone, Copy)]
 pub struct DataPoint {
     pub value: f32,
     pub timestamp: u32, // Seconds since start
 }
 
+/// Draw `text` horizontally centered in a `width` pixel span
+fn draw_text_centered_in(display: &mut DisplayManager, x: u16, y: u16, width: u16, text: &str, color: u16) -> Result<()> {
+    let text_width = text.len() as u16 * (FONT_WIDTH as u16 + 1);
+    let text_x = x + width.saturating_sub(text_width) / 2;
+    display.draw_text(text_x, y, text, color, None, 1)
+}
+
+/// How a LineGraph reacts to new samples
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum GraphMode {
+    /// Stretch the whole series across the plot and redraw it on every sample
+    Redraw,
+    /// Fixed pixels per sample; appending a point draws only the new segment.
+    /// With a frame buffer the plot scrolls left (column shift, newest sample
+    /// at the right edge); without one it sweeps left to right like a scope,
+    /// erasing a short gap ahead of the cursor.
+    Incremental,
+}
+
+/// Columns erased ahead of the sweep cursor so the newest sample stands out
+const SWEEP_GAP: u16 = 3;
+
+/// Characters reserved for the latest-value label in incremental mode
+const VALUE_LABEL_CHARS: u16 = 5;
+
 pub struct LineGraph {
     x: u16,
     y: u16,
@@ -18,10 +49,22 @@ pub struct LineGraph {
     min_value: f32,
     max_value: f32,
     auto_scale: bool,
-    grid_color: Color,
-    line_color: Color,
-    background_color: Color,
+    grid_color: u16,
+    line_color: u16,
+    background_color: u16,
     title: heapless::String<32>,
+    damaged: bool,
+    mode: GraphMode,
+    // Pixels per sample in incremental mode
+    column_step: u16,
+    // Samples appended since the last draw
+    pending: u16,
+    // Columns scrolled so far; keeps the vertical grid moving with the data
+    grid_origin: u32,
+    // Plot column of the newest drawn sample (sweep)
+    cursor: u16,
+    // Whether the last full draw used the scrolling layout
+    drawn_scrolling: bool,
 }
 
 impl LineGraph {
@@ -35,45 +78,90 @@ impl LineGraph {
             min_value: 0.0,
             max_value: 100.0,
             auto_scale: true,
-            grid_color: Color(0x2104), // Dark gray
-            line_color: Color::GREEN,
-            background_color: Color::BLACK,
+            grid_color: GRID_COLOR,
+            line_color: colors::PRIMARY_GREEN,
+            background_color: colors::BLACK,
             title: heapless::String::new(),
+            damaged: true,
+            mode: GraphMode::Redraw,
+            column_step: 2,
+            pending: 0,
+            grid_origin: 0,
+            cursor: 0,
+            drawn_scrolling: false,
         }
     }
-    
+
+    /// Switch to incremental drawing with `column_step` pixels per sample
+    pub fn with_incremental(mut self, column_step: u16) -> Self {
+        self.mode = GraphMode::Incremental;
+        self.column_step = column_step.max(1);
+        self
+    }
+
+    pub fn with_line_color(mut self, color: u16) -> Self {
+        self.line_color = color;
+        self
+    }
+
     pub fn set_title(&mut self, title: &str) {
-        self.title.clear();
-        self.title.push_str(title).ok();
+        if self.title != title {
+            self.title.clear();
+            self.title.push_str(title).ok();
+            self.damaged = true;
+        }
     }
-    
+
     pub fn set_range(&mut self, min: f32, max: f32) {
-        self.min_value = min;
-        self.max_value = max;
-        self.auto_scale = false;
+        if self.auto_scale || self.min_value != min || self.max_value != max {
+            self.min_value = min;
+            self.max_value = max;
+            self.auto_scale = false;
+            self.damaged = true;
+        }
     }
-    
+
     pub fn add_point(&mut self, value: f32, timestamp: u32) {
+        let first = self.data.is_empty();
         if self.data.push(DataPoint { value, timestamp }).is_err() {
             // Remove oldest point if buffer is full
             self.data.remove(0);
             self.data.push(DataPoint { value, timestamp }).ok();
         }
-        
-        if self.auto_scale {
-            self.update_scale();
+
+        match self.mode {
+            GraphMode::Redraw => {
+                if self.auto_scale {
+                    self.update_scale(0.1);
+                }
+                self.damaged = true;
+            }
+            GraphMode::Incremental => {
+                // Rescaling moves every plotted sample, so only a value outside
+                // the current range costs a full redraw
+                if self.auto_scale && (first || value < self.min_value || value > self.max_value) {
+                    self.update_scale(0.5);
+                    self.damaged = true;
+                }
+                self.pending = self.pending.saturating_add(1);
+            }
         }
     }
-    
+
     pub fn clear(&mut self) {
-        self.data.clear();
+        if !self.data.is_empty() {
+            self.data.clear();
+            self.pending = 0;
+            self.damaged = true;
+        }
     }
-    
-    fn update_scale(&mut self) {
+
+    /// Fit the range to the data, padded by `padding` of the span on each side
+    fn update_scale(&mut self, padding: f32) {
         if let Some(first) = self.data.first() {
             self.min_value = first.value;
             self.max_value = first.value;
-            
+
             for point in &self.data {
                 if point.value < self.min_value {
                     self.min_value = point.value;
@@ -82,191 +170,273 @@ impl LineGraph {
                     self.max_value = point.value;
                 }
             }
-            
-            // Add some padding
-            let range = self.max_value - self.min_value;
-            self.min_value -= range * 0.1;
-            self.max_value += range * 0.1;
+
+            // Add some padding (a flat series still needs a non-zero range)
+            let range = (self.max_value - self.min_value).max(1.0);
+            self.min_value -= range * padding;
+            self.max_value += range * padding;
         }
     }
-    
-    pub fn draw(&self, display: &mut Display) {
-        // Background
-        display.fill_rect(self.x, self.y, self.width, self.height, self.background_color);
-        
-        // Title
-        if !self.title.is_empty() {
-            display.draw_text_centered_5x7(self.x, self.y + 2, self.width, &self.title, Color::WHITE);
-        }
-        
+
+    fn plot_area(&self) -> (u16, u16) {
         let graph_y = if self.title.is_empty() { self.y } else { self.y + 12 };
         let graph_height = if self.title.is_empty() { self.height } else { self.height - 12 };
-        
-        // Grid
-        self.draw_grid(display, graph_y, graph_height);
-        
-        // Data line
-        if self.data.len() >= 2 {
-            let points_per_pixel = self.data.len() as f32 / self.width as f32;
-            
-            for i in 1..self.width {
-                let data_index1 = ((i - 1) as f32 * points_per_pixel) as usize;
-                let data_index2 = (i as f32 * points_per_pixel) as usize;
-                
-                if data_index1 < self.data.len() && data_index2 < self.data.len() {
-                    let point1 = &self.data[data_index1];
-                    let point2 = &self.data[data_index2];
-                    
-                    let y1 = self.value_to_y(point1.value, graph_y, graph_height);
-                    let y2 = self.value_to_y(point2.value, graph_y, graph_height);
-                    
-                    display.draw_line(self.x + i - 1, y1, self.x + i, y2, self.line_color);
+        (graph_y, graph_height)
+    }
+
+    /// Plot interior inside the border: (x, y, width, height)
+    fn inner(&self) -> (u16, u16, u16, u16) {
+        let (graph_y, graph_height) = self.plot_area();
+        (self.x + 1, graph_y + 1, self.width.saturating_sub(2), graph_height.saturating_sub(2))
+    }
+
+    /// Samples that fit across the plot at `column_step` pixels each
+    fn visible_capacity(&self) -> usize {
+        let (_, _, inner_width, _) = self.inner();
+        (inner_width.saturating_sub(1) / self.column_step) as usize + 1
+    }
+
+    /// Draw the grid for `count` plot columns starting at `first_col`
+    fn draw_grid_columns(&self, display: &mut DisplayManager, first_col: u16, count: u16) -> Result<()> {
+        let (graph_y, graph_height) = self.plot_area();
+        let (inner_x, inner_y, _, inner_height) = self.inner();
+        let v_spacing = (self.width / 8).max(4) as u32;
+
+        for col in first_col..first_col + count {
+            let x = inner_x + col;
+            let g = self.grid_origin + col as u32 + 1;
+
+            // Vertical grid lines
+            if g % v_spacing == 0 {
+                for y in (inner_y..inner_y + inner_height).step_by(4) {
+                    display.draw_pixel(x, y, self.grid_color)?;
+                }
+            }
+
+            // Horizontal grid lines
+            if g % 4 == 0 {
+                for i in 1..5 {
+                    display.draw_pixel(x, graph_y + (graph_height * i / 5), self.grid_color)?;
                 }
             }
         }
-        
-        // Border
-        display.draw_rect(self.x, graph_y, self.width, graph_height, Color::WHITE);
+        Ok(())
     }
-    
-    fn draw_grid(&self, display: &mut Display, graph_y: u16, graph_height: u16) {
-        // Horizontal grid lines
-        for i in 1..5 {
-            let y = graph_y + (graph_height * i / 5);
-            for x in (self.x..self.x + self.width).step_by(4) {
-                display.set_pixel(x, y, self.grid_color);
-            }
+
+    fn value_to_y(&self, value: f32) -> u16 {
+        let (_, inner_y, _, inner_height) = self.inner();
+        let range = self.max_value - self.min_value;
+        let normalized = if range > 0.0 { (value - self.min_value) / range } else { 0.5 };
+        let y = inner_height.saturating_sub(1) as f32 * (1.0 - normalized.clamp(0.0, 1.0));
+        inner_y + y as u16
+    }
+
+    /// Segment from the previous sample (if any) to `index` ending at plot column `col`
+    fn draw_segment(&self, display: &mut DisplayManager, index: usize, col: u16, connect: bool) -> Result<()> {
+        let (inner_x, _, _, _) = self.inner();
+        let y = self.value_to_y(self.data[index].value);
+        if connect && index > 0 && col >= self.column_step {
+            let prev_y = self.value_to_y(self.data[index - 1].value);
+            display.draw_line(inner_x + col - self.column_step, prev_y, inner_x + col, y, self.line_color)
+        } else {
+            display.draw_pixel(inner_x + col, y, self.line_color)
         }
-        
-        // Vertical grid lines
-        for i in 1..8 {
-            let x = self.x + (self.width * i / 8);
-            for y in (graph_y..graph_y + graph_height).step_by(4) {
-                display.set_pixel(x, y, self.grid_color);
-            }
+    }
+
+    /// Title-row field holding the newest value (incremental mode)
+    fn value_label_rect(&self) -> DirtyRect {
+        let field_width = VALUE_LABEL_CHARS * (FONT_WIDTH as u16 + 1);
+        DirtyRect::new(self.x + self.width.saturating_sub(field_width), self.y + 2, field_width, 7)
+    }
+
+    fn draw_value_label(&self, display: &mut DisplayManager) -> Result<()> {
+        if self.title.is_empty() {
+            return Ok(());
+        }
+        let Some(latest) = self.data.last() else {
+            return Ok(());
+        };
+        use core::fmt::Write;
+        let mut text: heapless::String<8> = heapless::String::new();
+        let _ = write!(text, "{:>5}", format_float(latest.value));
+        let rect = self.value_label_rect();
+        display.draw_text_field(rect.x, rect.y, rect.width, &text, colors::WHITE, self.background_color, 1)
+    }
+
+    fn draw_incremental_series(&mut self, display: &mut DisplayManager) -> Result<()> {
+        let (_, _, inner_width, _) = self.inner();
+        let count = self.data.len().min(self.visible_capacity());
+        if count == 0 {
+            self.cursor = 0;
+            return Ok(());
         }
+        let first = self.data.len() - count;
+        let span = (count as u16 - 1) * self.column_step;
+        let start_col = if self.drawn_scrolling { inner_width - 1 - span } else { 0 };
+
+        for i in 0..count {
+            self.draw_segment(display, first + i, start_col + i as u16 * self.column_step, i > 0)?;
+        }
+        self.cursor = start_col + span;
+        Ok(())
     }
-    
-    fn value_to_y(&self, value: f32, graph_y: u16, graph_height: u16) -> u16 {
-        let normalized = (value - self.min_value) / (self.max_value - self.min_value);
-        let y = graph_height as f32 * (1.0 - normalized);
-        (graph_y as f32 + y) as u16
+
+    /// Shift the plot left and draw the pending samples at the right edge
+    fn draw_pending_scrolled(&mut self, display: &mut DisplayManager, pending: u16) -> Result<()> {
+        let (inner_x, inner_y, inner_width, inner_height) = self.inner();
+        let shift = pending * self.column_step;
+
+        display.draw_widget(DirtyRect::new(inner_x, inner_y, inner_width, inner_height), |display| {
+            display.scroll_left(inner_x, inner_y, inner_width, inner_height, shift, self.background_color)?;
+            self.grid_origin = self.grid_origin.wrapping_add(shift as u32);
+            self.draw_grid_columns(display, inner_width - shift, shift)?;
+
+            let len = self.data.len();
+            for k in 0..pending {
+                let col = inner_width - 1 - (pending - 1 - k) * self.column_step;
+                self.draw_segment(display, len - (pending - k) as usize, col, true)?;
+            }
+            Ok(())
+        })?;
+        self.cursor = inner_width - 1;
+        Ok(())
     }
-}
 
-pub struct BarChart {
-    x: u16,
-    y: u16,
-    width: u16,
-    height: u16,
-    values: Vec<(heapless::String<8>, f32), 8>,
-    max_value: f32,
-    bar_color: Color,
-    background_color: Color,
-    show_values: bool,
-}
+    /// Advance the sweep cursor over the pending samples
+    fn draw_pending_swept(&mut self, display: &mut DisplayManager, pending: u16) -> Result<()> {
+        let (inner_x, inner_y, inner_width, inner_height) = self.inner();
+        let len = self.data.len();
 
-impl BarChart {
-    pub fn new(x: u16, y: u16, width: u16, height: u16) -> Self {
-        Self {
-            x,
-            y,
-            width,
-            height,
-            values: Vec::new(),
-            max_value: 100.0,
-            bar_color: Color::PRIMARY_BLUE,
-            background_color: Color::BLACK,
-            show_values: true,
+        for k in 0..pending {
+            let index = len - (pending - k) as usize;
+            let mut next = self.cursor + self.column_step;
+            let wrapped = next >= inner_width;
+            if wrapped {
+                next = 0;
+            }
+
+            // Erase the new segment's columns plus the gap ahead of it
+            let clear_from = if wrapped { 0 } else { self.cursor + 1 };
+            let clear_to = (next + SWEEP_GAP + 1).min(inner_width);
+            let clear_width = clear_to - clear_from;
+
+            display.draw_widget(DirtyRect::new(inner_x + clear_from, inner_y, clear_width, inner_height), |display| {
+                display.fill_rect(inner_x + clear_from, inner_y, clear_width, inner_height, self.background_color)?;
+                self.draw_grid_columns(display, clear_from, clear_width)?;
+                self.draw_segment(display, index, next, !wrapped)
+            })?;
+            self.cursor = next;
         }
+        Ok(())
     }
-    
-    pub fn add_bar(&mut self, label: &str, value: f32) -> Result<(), ()> {
-        let mut label_string = heapless::String::new();
-        label_string.push_str(label).ok();
-        self.values.push((label_string, value))
+}
+
+impl Widget for LineGraph {
+    fn bounds(&self) -> DirtyRect {
+        DirtyRect::new(self.x, self.y, self.width, self.height)
     }
-    
-    pub fn clear(&mut self) {
-        self.values.clear();
+
+    fn is_damaged(&self) -> bool {
+        self.damaged || self.pending > 0
     }
-    
-    pub fn set_max_value(&mut self, max: f32) {
-        self.max_value = max;
+
+    fn invalidate(&mut self) {
+        self.damaged = true;
     }
-    
-    pub fn draw(&self, display: &mut Display) {
-        // Background
-        display.fill_rect(self.x, self.y, self.width, self.height, self.background_color);
-        
-        if self.values.is_empty() {
-            return;
+
+    fn render(&mut self, display: &mut DisplayManager) -> Result<bool> {
+        // Column shifting needs pixels to read back, so it only works on the frame buffer
+        let scrolling = display.is_framebuffer_enabled();
+        let pending = self.pending;
+
+        if self.mode == GraphMode::Incremental && !self.damaged && pending > 0
+            && scrolling == self.drawn_scrolling && (pending as usize) < self.visible_capacity()
+        {
+            self.pending = 0;
+            if scrolling {
+                self.draw_pending_scrolled(display, pending)?;
+            } else {
+                self.draw_pending_swept(display, pending)?;
+            }
+            // Cheap label refresh: the newest value is the only text that changes
+            let label = self.value_label_rect();
+            display.draw_widget(label, |display| self.draw_value_label(display))?;
+            return Ok(true);
+        }
+
+        if !self.is_damaged() {
+            return Ok(false);
         }
-        
-        let bar_width = (self.width - 4) / self.values.len() as u16;
-        let spacing = 2;
-        
-        for (i, (label, value)) in self.values.iter().enumerate() {
-            let bar_x = self.x + 2 + (i as u16 * bar_width);
-            let bar_height = ((value / self.max_value) * (self.height - 20) as f32) as u16;
-            let bar_y = self.y + self.height - bar_height - 15;
-            
-            // Draw bar
-            display.fill_rect(
-                bar_x + spacing,
-                bar_y,
-                bar_width - spacing * 2,
-                bar_height,
-                self.bar_color
-            );
-            
-            // Draw value on top
-            if self.show_values {
-                let value_text = format_float(*value);
-                display.draw_text_centered_5x7(
-                    bar_x,
-                    bar_y - 10,
-                    bar_width,
-                    &value_text,
-                    Color::WHITE
-                );
+        self.drawn_scrolling = scrolling;
+        let bounds = self.bounds();
+        display.draw_widget(bounds, |display| self.draw(display))?;
+        Ok(true)
+    }
+
+    fn draw(&mut self, display: &mut DisplayManager) -> Result<()> {
+        self.damaged = false;
+        self.pending = 0;
+
+        // Background
+        display.fill_rect(self.x, self.y, self.width, self.height, self.background_color)?;
+
+        let (graph_y, graph_height) = self.plot_area();
+        let (inner_x, _, inner_width, _) = self.inner();
+
+        // Grid
+        self.draw_grid_columns(display, 0, inner_width)?;
+
+        match self.mode {
+            GraphMode::Redraw => {
+                // Title
+                if !self.title.is_empty() {
+                    draw_text_centered_in(display, self.x, self.y + 2, self.width, &self.title, colors::WHITE)?;
+                }
+
+                // Data line
+                if self.data.len() >= 2 {
+                    let points_per_pixel = self.data.len() as f32 / inner_width as f32;
+
+                    for i in 1..inner_width {
+                        let data_index1 = ((i - 1) as f32 * points_per_pixel) as usize;
+                        let data_index2 = (i as f32 * points_per_pixel) as usize;
+
+                        if data_index1 < self.data.len() && data_index2 < self.data.len() {
+                            let y1 = self.value_to_y(self.data[data_index1].value);
+                            let y2 = self.value_to_y(self.data[data_index2].value);
+
+                            display.draw_line(inner_x + i - 1, y1, inner_x + i, y2, self.line_color)?;
+                        }
+                    }
+                }
+            }
+            GraphMode::Incremental => {
+                // Title on the left, latest value on the right
+                if !self.title.is_empty() {
+                    display.draw_text(self.x + 2, self.y + 2, &self.title, colors::WHITE, None, 1)?;
+                }
+                self.draw_incremental_series(display)?;
+                self.draw_value_label(display)?;
             }
-            
-            // Draw label at bottom
-            display.draw_text_centered_5x7(
-                bar_x,
-                self.y + self.height - 12,
-                bar_width,
-                label,
-                Color::WHITE
-            );
         }
-        
+
         // Border
-        display.draw_rect(self.x, self.y, self.width, self.height - 15, Color::WHITE);
+        display.draw_rect(self.x, graph_y, self.width, graph_height, colors::WHITE)
     }
 }
 
 // Helper function to format float values
 fn format_float(value: f32) -> heapless::String<8> {
+    use core::fmt::Write;
     let mut s = heapless::String::new();
-    
+
     if value >= 100.0 {
-        s.push_str(&(value as u32).to_string()).ok();
+        let _ = write!(s, "{}", value as u32);
     } else if value >= 10.0 {
-        let whole = value as u32;
-        let decimal = ((value - whole as f32) * 10.0) as u32;
-        s.push_str(&whole.to_string()).ok();
-        s.push('.').ok();
-        s.push((b'0' + decimal as u8) as char).ok();
+        let _ = write!(s, "{:.1}", value);
     } else {
-        let whole = value as u32;
-        let decimal = ((value - whole as f32) * 100.0) as u32;
-        s.push_str(&whole.to_string()).ok();
-        s.push('.').ok();
-        s.push((b'0' + (decimal / 10) as u8) as char).ok();
-        s.push((b'0' + (decimal % 10) as u8) as char).ok();
+        let _ = write!(s, "{:.2}", value);
     }
-    
+
     s
-}
\ No newline at end of file
+}
@@ -1,9 +1,3 @@
 // Advanced UI components
 
-pub mod progress;
 pub mod graph;
-pub mod spinner;
-
-pub use progress::{ProgressBar, CircularProgress};
-pub use graph::{LineGraph, BarChart, DataPoint};
-pub use spinner::{LoadingSpinner, SpinnerStyle};
\ No newline at end of file
@@ -1,18 +1,210 @@
+pub mod components;
+pub mod widgets;
+
 use anyhow::Result;
 use crate::display::{DisplayManager, colors::*};
+use self::widgets::{Widget, Label, ProgressBar, CircleGauge, BatteryIndicator, render_widgets, invalidate_widgets};
+use self::components::graph::LineGraph;
 use crate::sensors::SensorData;
 use crate::system::{ButtonEvent, SystemInfo};
 use crate::ota::OtaStatus;
-use std::time::Instant;
+use std::time::{Duration, Instant};
+
+/// Interval between temperature samples on the sensor screen graph
+const SENSOR_GRAPH_PERIOD: Duration = Duration::from_secs(1);
+
+/// Resolution of the on-screen clocks (uptime, header time)
+const CLOCK_TICK: Duration = Duration::from_secs(1);
+
+/// Step between animation updates
+const ANIMATION_STEP: Duration = Duration::from_millis(100);
+
+/// Static row labels on the system screen, drawn once per screen change
+const SYSTEM_LABELS: [&str; 6] = ["Uptime:", "Free Heap:", "CPU Freq:", "Flash:", "Temp:", "PSRAM/DMA:"];
+
+/// Retained widgets for the system screen values
+struct SystemWidgets {
+    battery: BatteryIndicator,
+    uptime: Label,
+    heap: Label,
+    cpu: Label,
+    flash: Label,
+    temperature: Label,
+    psram: Label,
+    progress: ProgressBar,
+}
+
+impl SystemWidgets {
+    fn new() -> Self {
+        let y_start = 45;
+        let line_height = 20;
+        Self {
+            battery: BatteryIndicator::new(220, 5, PRIMARY_BLUE),
+            uptime: Label::new(120, y_start, 120, PRIMARY_GREEN),
+            heap: Label::new(120, y_start + line_height, 120, PRIMARY_GREEN),
+            cpu: Label::new(120, y_start + line_height * 2, 180, PRIMARY_GREEN),
+            flash: Label::new(120, y_start + line_height * 3, 120, PRIMARY_GREEN),
+            temperature: Label::new(120, y_start + line_height * 4, 120, PRIMARY_GREEN),
+            psram: Label::new(120, y_start + line_height * 5, 180, PRIMARY_GREEN),
+            progress: ProgressBar::new(10, 138, 280, 8),
+        }
+    }
+
+    fn widgets(&mut self) -> [&mut dyn Widget; 8] {
+        [&mut self.battery, &mut self.uptime, &mut self.heap, &mut self.cpu, &mut self.flash,
+         &mut self.temperature, &mut self.psram, &mut self.progress]
+    }
+}
+
+/// Retained widgets for the sensor screen values
+struct SensorWidgets {
+    battery_bar: ProgressBar,
+    battery_percent: Label,
+    voltage: Label,
+    power_source: Label,
+    temperature: Label,
+    light: Label,
+    indicator: CircleGauge,
+    // Temperature history, appended once per SENSOR_GRAPH_PERIOD
+    temperature_graph: LineGraph,
+}
+
+impl SensorWidgets {
+    fn new() -> Self {
+        let y_start = 50;
+        let line_height = 30;
+        Self {
+            battery_bar: ProgressBar::new(100, y_start, 120, 15),
+            battery_percent: Label::new(225, y_start, 70, PRIMARY_GREEN),
+            voltage: Label::new(100, y_start + 18, 110, TEXT_SECONDARY),
+            power_source: Label::new(210, y_start + 18, 85, PRIMARY_BLUE),
+            temperature: Label::new(100, y_start + line_height + 5, 100, TEXT_PRIMARY),
+            light: Label::new(100, y_start + line_height * 2 + 5, 100, TEXT_PRIMARY),
+            indicator: CircleGauge::new(160, 130, 20, PRIMARY_GREEN),
+            temperature_graph: {
+                let mut graph = LineGraph::new(200, 82, 95, 44).with_incremental(2).with_line_color(ACCENT_ORANGE);
+                graph.set_title("Temp");
+                graph
+            },
+        }
+    }
+
+    fn widgets(&mut self) -> [&mut dyn Widget; 8] {
+        [&mut self.battery_bar, &mut self.battery_percent, &mut self.voltage, &mut self.power_source,
+         &mut self.temperature, &mut self.light, &mut self.indicator, &mut self.temperature_graph]
+    }
+}
+
+/// Link state a screen's static network section was last drawn for
+struct LinkSnapshot {
+    connected: bool,
+    ip: Option<String>,
+    ssid: String,
+}
+
+impl LinkSnapshot {
+    fn matches(&self, connected: bool, ip: &Option<String>, ssid: &str) -> bool {
+        self.connected == connected && self.ip == *ip && self.ssid == ssid
+    }
+}
+
+/// Retained widgets for the network screen values
+struct NetworkWidgets {
+    clock: Label,
+    status: Label,
+    ssid: Label,
+    ip: Label,
+    signal: Label,
+    // Shown below the signal row while connected
+    mac: Label,
+    gateway: Label,
+    section: Option<LinkSnapshot>,
+}
+
+impl NetworkWidgets {
+    fn new() -> Self {
+        let y_start = 38;
+        let line_height = 20;
+        let value_x = 65;
+        let info_y = y_start + line_height * 4 + 5;
+        Self {
+            clock: Label::new(245, 8, 55, WHITE).with_background(PRIMARY_PURPLE),
+            status: Label::new(value_x, y_start, 230, PRIMARY_RED),
+            ssid: Label::new(value_x, y_start + line_height, 230, TEXT_SECONDARY),
+            ip: Label::new(value_x, y_start + line_height * 2, 200, TEXT_PRIMARY),
+            signal: Label::new(value_x, y_start + line_height * 3, 200, TEXT_SECONDARY),
+            mac: Label::new(value_x, info_y, 230, TEXT_SECONDARY),
+            gateway: Label::new(value_x, info_y + line_height, 230, TEXT_SECONDARY),
+            section: None,
+        }
+    }
+
+    fn widgets(&mut self) -> [&mut dyn Widget; 5] {
+        [&mut self.clock, &mut self.status, &mut self.ssid, &mut self.ip, &mut self.signal]
+    }
+
+    fn details(&mut self) -> [&mut dyn Widget; 2] {
+        [&mut self.mac, &mut self.gateway]
+    }
+}
+
+/// Retained widgets for the settings screen values
+struct SettingsWidgets {
+    brightness: ProgressBar,
+    brightness_value: Label,
+    auto_dim: Label,
+    update_rate: Label,
+    version: Label,
+}
+
+impl SettingsWidgets {
+    fn new() -> Self {
+        let y_start = 50;
+        let line_height = 30;
+        let mut brightness = ProgressBar::new(120, y_start, 100, 15);
+        brightness.set_fill_color(PRIMARY_BLUE);
+        Self {
+            brightness,
+            brightness_value: Label::new(230, y_start, 50, TEXT_PRIMARY),
+            auto_dim: Label::new(120, y_start + line_height, 60, PRIMARY_GREEN),
+            update_rate: Label::new(120, y_start + line_height * 2, 80, TEXT_PRIMARY),
+            version: Label::new(120, y_start + line_height * 3, 100, TEXT_SECONDARY),
+        }
+    }
+
+    fn widgets(&mut self) -> [&mut dyn Widget; 5] {
+        [&mut self.brightness, &mut self.brightness_value, &mut self.auto_dim,
+         &mut self.update_rate, &mut self.version]
+    }
+}
+
+/// Retained widgets for the OTA screen values
+struct OtaWidgets {
+    clock: Label,
+    status: Label,
+    // Visible only while downloading
+    progress: ProgressBar,
+    section: Option<LinkSnapshot>,
+}
 
-// Text cache entry
-#[derive(Clone)]
-struct TextCache {
-    text: String,
-    x: u16,
-    y: u16,
-    color: u16,
-    rendered: bool,
+impl OtaWidgets {
+    fn new() -> Self {
+        let y_start = 36;
+        let line_height = 16;
+        let mut progress = ProgressBar::new(10, y_start + line_height * 2 + 4, 280, 10);
+        progress.set_fill_color(PRIMARY_BLUE);
+        progress.set_visible(false);
+        Self {
+            clock: Label::new(245, 8, 55, WHITE).with_background(ACCENT_ORANGE),
+            status: Label::new(80, y_start + line_height, 200, TEXT_SECONDARY),
+            progress,
+            section: None,
+        }
+    }
+
+    fn widgets(&mut self) -> [&mut dyn Widget; 3] {
+        [&mut self.clock, &mut self.status, &mut self.progress]
+    }
 }
 
 pub struct UiManager {
@@ -32,16 +224,10 @@ pub struct UiManager {
     // FPS tracking
     fps: f32,
     // Cached values to avoid redundant updates
-    cached_uptime: String,
-    cached_heap: String,
-    cached_cpu: String,
-    cached_flash: String,
     // Dual-core stats
     cpu0_usage: u8,
     cpu1_usage: u8,
     core_tasks: (u32, u32),
-    cached_temp: String,
-    cached_battery: u8,
     // Pre-allocated string buffer for formatting
     string_buffer: String,
     // Skip render counter
@@ -49,18 +235,8 @@ pub struct UiManager {
     // FPS rendering
     force_fps_render: bool,
     total_renders: u32,
-    // Text cache for static labels
-    text_cache: Vec<TextCache>,
-    // OTA screen caching
-    cached_ota_time: u64,
-    cached_network_ip: Option<String>,
-    cached_ota_status_enum: Option<OtaStatus>,
-    ota_screen_initialized: bool,
     // Screen initialization flags for optimized rendering
-    system_screen_initialized: bool,
-    network_screen_initialized: bool,
     sensor_screen_initialized: bool,
-    settings_screen_initialized: bool,
     // Global time caching for all screens
     global_cached_time: u64,
     // Alert states
@@ -71,10 +247,14 @@ pub struct UiManager {
     render_dirty: bool,
     // Stability: avoid global mutable statics by caching per-instance
     render_needed: bool,
-    last_progress_value: u8,
-    sensor_last_battery: u8,
-    sensor_last_temp: f32,
-    sensor_last_light: u16,
+    system_widgets: SystemWidgets,
+    sensor_widgets: SensorWidgets,
+    network_widgets: NetworkWidgets,
+    settings_widgets: SettingsWidgets,
+    ota_widgets: OtaWidgets,
+    last_graph_sample: Option<Instant>,
+    // Next clock update, rendered even when no data changed
+    next_clock_tick: Instant,
     last_fps_rendered: f32,
 }
 
@@ -95,25 +275,11 @@ impl UiManager {
             network_mac: String::from("Unknown"),
             ota_status: OtaStatus::Idle,
             fps: 0.0,
-            cached_uptime: String::new(),
-            cached_heap: String::new(),
-            cached_cpu: String::new(),
-            cached_flash: String::new(),
-            cached_temp: String::new(),
-            cached_battery: 0,
             string_buffer: String::with_capacity(32),
             skip_renders: 0,
             force_fps_render: false,
             total_renders: 0,
-            text_cache: Vec::with_capacity(20),
-            cached_ota_time: 0,
-            cached_network_ip: None,
-            cached_ota_status_enum: None,
-            ota_screen_initialized: false,
-            system_screen_initialized: false,
-            network_screen_initialized: false,
             sensor_screen_initialized: false,
-            settings_screen_initialized: false,
             global_cached_time: 0,
             cpu0_usage: 0,
             cpu1_usage: 0,
@@ -123,10 +289,13 @@ impl UiManager {
             battery_alert: false,
             render_dirty: true,
             render_needed: true,
-            last_progress_value: 255,
-            sensor_last_battery: 255,
-            sensor_last_temp: -999.0,
-            sensor_last_light: 65535,
+            system_widgets: SystemWidgets::new(),
+            sensor_widgets: SensorWidgets::new(),
+            network_widgets: NetworkWidgets::new(),
+            settings_widgets: SettingsWidgets::new(),
+            ota_widgets: OtaWidgets::new(),
+            last_graph_sample: None,
+            next_clock_tick: Instant::now(),
             last_fps_rendered: -1.0,
         })
     }
@@ -166,15 +335,28 @@ impl UiManager {
         // Check for battery alert (<10% is critical)
         self.battery_alert = data._battery_percentage < 10 && !data._is_on_usb;
         
-        self.sensor_data = data;
+        // Sample the temperature history at a fixed rate; sensor updates arrive far faster
+        if self.last_graph_sample.map_or(true, |t| t.elapsed() >= SENSOR_GRAPH_PERIOD) {
+            self.last_graph_sample = Some(Instant::now());
+            let timestamp = self.system_info.get_uptime().as_secs() as u32;
+            self.sensor_widgets.temperature_graph.add_point(data._temperature, timestamp);
+        }
         
-        // Force render when sensor data updates
-        self.force_next_render();
-        self.render_dirty = true;
-        self.render_needed = true;
+        // Samples arrive far faster than the reading changes; widgets bound to
+        // these values redraw themselves only when what they show differs
+        let changed = self.sensor_data != data;
+        self.sensor_data = data;
+        if changed {
+            self.render_needed = true;
+        }
     }
     
     pub fn update_network_status(&mut self, connected: bool, ip: Option<String>, ssid: String, signal: i8, gateway: Option<String>, mac: String) {
+        // Polled twice a second; only a real change is worth a frame
+        if self.network_connected == connected && self.network_ip == ip && self.network_ssid == ssid
+            && self.network_signal == signal && self.network_gateway == gateway && self.network_mac == mac {
+            return;
+        }
         self.network_connected = connected;
         self.network_ip = ip;
         self.network_ssid = ssid;
@@ -190,7 +372,10 @@ impl UiManager {
     }
     
     pub fn update_ota_status(&mut self, status: OtaStatus) {
-        self.ota_status = status;
+        if self.ota_status != status {
+            self.ota_status = status;
+            self.render_dirty = true;
+        }
     }
     
     pub fn update_core_stats(&mut self, cpu0: u8, cpu1: u8, tasks0: u32, tasks1: u32) {
@@ -208,22 +393,12 @@ impl UiManager {
         self.cpu1_usage = cpu1;
     }
     
-    fn force_next_render(&mut self) {
-        // Force render by clearing cached values
-        self.cached_uptime.clear();
-        self.cached_heap.clear();
-        self.cached_cpu.clear();
-        self.cached_flash.clear();
-        self.cached_temp.clear();
-        self.cached_battery = 255; // Invalid value to force update
-    }
-
     pub fn update(&mut self) -> Result<()> {
         // Update animation progress with frame skipping
         let elapsed = self.last_update.elapsed().as_secs_f32();
         
         // Only update animation every 100ms to reduce overhead
-        if elapsed > 0.1 {
+        if elapsed > ANIMATION_STEP.as_secs_f32() {
             self.animation_progress = (self.animation_progress + elapsed * 2.0).min(1.0);
             self.last_update = Instant::now();
         }
@@ -231,7 +406,20 @@ impl UiManager {
         Ok(())
     }
 
+    /// When the UI next needs a frame: now if state changed, the next
+    /// animation step while animating, otherwise the next clock tick
+    pub fn next_frame_deadline(&self) -> Instant {
+        if self.render_dirty || self.render_needed {
+            Instant::now()
+        } else if self.animation_progress < 1.0 {
+            self.last_update + ANIMATION_STEP
+        } else {
+            self.next_clock_tick
+        }
+    }
+
     pub fn render(&mut self, display: &mut DisplayManager) -> Result<bool> {
+        let _span = crate::trace::span(crate::trace::UI_RENDER);
         // Track if anything needs updating (per-instance, no globals)
         self.total_renders += 1;
         // If state changed, request a render
@@ -239,6 +427,16 @@ impl UiManager {
             self.render_needed = true;
         }
         
+        // Clocks and animations advance without any external event
+        let now = Instant::now();
+        if now >= self.next_clock_tick {
+            self.next_clock_tick = now + CLOCK_TICK;
+            self.render_needed = true;
+        }
+        if self.animation_progress < 1.0 {
+            self.render_needed = true;
+        }
+        
         // Check if screen changed
         let screen_changed = self.last_rendered_screen != Some(self.current_screen);
         if screen_changed {
@@ -247,11 +445,8 @@ impl UiManager {
             self.render_needed = true;
             
             // Reset all screen initialization flags when switching
-            self.system_screen_initialized = false;
-            self.network_screen_initialized = false;
+            // (the new screen starts from a cleared display)
             self.sensor_screen_initialized = false;
-            self.settings_screen_initialized = false;
-            self.ota_screen_initialized = false;
         }
         
         // Skip render if nothing changed (except on screen change)
@@ -301,31 +496,7 @@ impl UiManager {
     }
 
     fn render_system_screen(&mut self, display: &mut DisplayManager, screen_changed: bool) -> Result<()> {
-        // Early exit if nothing needs updating
-        if !screen_changed && self.system_screen_initialized {
-            // Check if any values actually changed
-            let heap_kb = self.system_info.get_free_heap_kb();
-            let heap_str = format!("{heap_kb} KB");
-            let cpu_freq = self.system_info.get_cpu_freq_mhz();
-            let cpu_str = format!("{cpu_freq} MHz");
-            let temp_str = format!("{:.1}°C", self.sensor_data._temperature);
-            
-            if heap_str == self.cached_heap && 
-               cpu_str == self.cached_cpu && 
-               temp_str == self.cached_temp &&
-               self.sensor_data._battery_percentage == self.cached_battery {
-                // Only update time every 5 seconds
-                let current_seconds = self.system_info.get_uptime().as_secs();
-                if current_seconds >= self.global_cached_time + 5 {
-                    self.global_cached_time = current_seconds;
-                    display.fill_rect(235, 5, 65, 20, PRIMARY_BLUE)?;
-                    let time_str = self.system_info.format_uptime();
-                    display.draw_text(240, 8, &time_str, WHITE, None, 1)?;
-                }
-                return Ok(());
-            }
-        }
-        
+        let _span = crate::trace::span(crate::trace::RENDER_SYSTEM);
         // Only clear screen when switching to this screen
         if screen_changed {
             log::info!("render_system_screen: Clearing screen for new screen");
@@ -337,28 +508,13 @@ impl UiManager {
             display.fill_rect(0, 0, 300, 30, PRIMARY_BLUE)?;
             display.draw_text_centered(8, "System Status", WHITE, None, 2)?;
             
-            // Reset initialization flag
-            self.system_screen_initialized = false;
+            invalidate_widgets(&mut self.system_widgets.widgets());
             
-            // Static labels - cache them instead of redrawing
+            // Static labels
             let y_start = 45;
             let line_height = 20;
-            
-            // Add static labels to cache
-            self.text_cache.clear();
-            self.text_cache.push(TextCache { text: "Uptime:".to_string(), x: 10, y: y_start, color: TEXT_PRIMARY, rendered: false });
-            self.text_cache.push(TextCache { text: "Free Heap:".to_string(), x: 10, y: y_start + line_height, color: TEXT_PRIMARY, rendered: false });
-            self.text_cache.push(TextCache { text: "CPU Freq:".to_string(), x: 10, y: y_start + line_height * 2, color: TEXT_PRIMARY, rendered: false });
-            self.text_cache.push(TextCache { text: "Flash:".to_string(), x: 10, y: y_start + line_height * 3, color: TEXT_PRIMARY, rendered: false });
-            self.text_cache.push(TextCache { text: "Temp:".to_string(), x: 10, y: y_start + line_height * 4, color: TEXT_PRIMARY, rendered: false });
-            self.text_cache.push(TextCache { text: "PSRAM/DMA:".to_string(), x: 10, y: y_start + line_height * 5, color: TEXT_PRIMARY, rendered: false });
-            
-            // Render cached text
-            for cache_entry in &mut self.text_cache {
-                if !cache_entry.rendered {
-                    display.draw_text(cache_entry.x, cache_entry.y, &cache_entry.text, cache_entry.color, None, 1)?;
-                    cache_entry.rendered = true;
-                }
+            for (row, label) in SYSTEM_LABELS.iter().enumerate() {
+                display.draw_text(10, y_start + line_height * row as u16, label, TEXT_PRIMARY, None, 1)?;
             }
             
             // Button hints (moved up to avoid overlap)
@@ -366,65 +522,23 @@ impl UiManager {
             display.draw_text(200, 150, "[USER] Next", TEXT_SECONDARY, None, 1)?;
         }
         
-        // Set screen as initialized after first render
-        self.system_screen_initialized = true;
-        
-        // Update time in header (only update every 5 seconds or on first render)
+        // Uptime clock in header, left of the title (only update every 5 seconds or on first render)
         let current_seconds = self.system_info.get_uptime().as_secs();
-        if current_seconds >= self.global_cached_time + 5 || !self.system_screen_initialized {
-            self.global_cached_time = current_seconds;
-            display.fill_rect(235, 5, 65, 20, PRIMARY_BLUE)?;
-            let time_str = self.system_info.format_uptime();
-            display.draw_text(240, 8, &time_str, WHITE, None, 1)?;
-        }
-        
-        // Battery indicator in header (moved to right side with icon)
-        if self.sensor_data._battery_percentage != self.cached_battery || self.sensor_data._is_charging {
-            // Clear battery area on right side
-            display.fill_rect(220, 5, 95, 20, PRIMARY_BLUE)?;
-            
-            // Draw battery icon
-            display.draw_battery_icon(225, 7, self.sensor_data._battery_percentage, 
-                                     self.sensor_data._is_charging, 1)?;
-            
-            // Draw percentage text next to icon
-            let battery_color = if self.sensor_data._is_charging { WHITE }
-                               else if self.sensor_data._battery_percentage > 50 { PRIMARY_GREEN } 
-                               else if self.sensor_data._battery_percentage > 20 { YELLOW } 
-                               else { PRIMARY_RED };
-            
-            let battery_str = if self.sensor_data._is_charging {
-                format!("{}%", self.sensor_data._battery_percentage)
-            } else if self.sensor_data._is_on_usb && self.sensor_data._battery_percentage == 0 {
-                "USB".to_string()
-            } else {
-                format!("{}%", self.sensor_data._battery_percentage)
-            };
-            display.draw_text(255, 8, &battery_str, battery_color, None, 1)?;
-            
-            // Show voltage if charging
-            if self.sensor_data._is_charging {
-                let voltage_str = format!("{:.1}V", self.sensor_data._battery_voltage as f32 / 1000.0);
-                display.draw_text(285, 8, &voltage_str, TEXT_SECONDARY, None, 1)?;
-            }
-            
-            self.cached_battery = self.sensor_data._battery_percentage;
-        }
-        
-        // Move time to left side
-        let current_seconds = self.system_info.get_uptime().as_secs();
-        if current_seconds >= self.global_cached_time + 5 || !self.system_screen_initialized {
+        if current_seconds >= self.global_cached_time + 5 || screen_changed {
             self.global_cached_time = current_seconds;
             display.fill_rect(5, 5, 65, 20, PRIMARY_BLUE)?;
             let time_str = self.system_info.format_uptime();
             display.draw_text(10, 8, &time_str, WHITE, None, 1)?;
         }
         
-        // Dynamic content - update values by clearing their areas first
-        let y_start = 45;
-        let line_height = 20;
+        // Dynamic content - bind values to widgets; only changed ones redraw
+        let widgets = &mut self.system_widgets;
+        
+        // Battery indicator in header
+        widgets.battery.set_state(self.sensor_data._battery_percentage, self.sensor_data._is_charging,
+                                  self.sensor_data._is_on_usb, self.sensor_data._battery_voltage);
         
-        // Uptime value (only update if changed)
+        // Uptime value
         let uptime = self.system_info.get_uptime();
         let uptime_seconds = uptime.as_secs();
         
@@ -437,73 +551,48 @@ impl UiManager {
             use std::fmt::Write;
             let _ = write!(&mut self.string_buffer, "{}h {}m", uptime_seconds / 3600, (uptime_seconds % 3600) / 60);
         }
-        let uptime_str = self.string_buffer.clone();
-        if uptime_str != self.cached_uptime {
-            display.fill_rect(120, y_start, 120, 16, BLACK)?;
-            display.draw_text(120, y_start, &uptime_str, PRIMARY_GREEN, None, 1)?;
-            self.cached_uptime = uptime_str;
-        }
+        widgets.uptime.set_text(&self.string_buffer);
         
-        // Memory value (only update if changed)
+        // Memory value
         let heap_kb = self.system_info.get_free_heap_kb();
-        let heap_str = format!("{} KB", heap_kb);
-        if heap_str != self.cached_heap {
-            display.fill_rect(120, y_start + line_height, 120, 16, BLACK)?;
-            display.draw_text(120, y_start + line_height, &heap_str, PRIMARY_GREEN, None, 1)?;
-            self.cached_heap = heap_str;
-        }
+        widgets.heap.set_text(&format!("{} KB", heap_kb));
         
-        // CPU value with dual-core usage (only update if changed)
+        // CPU value with dual-core usage
         let cpu_freq = self.system_info.get_cpu_freq_mhz();
-        let cpu_str = format!("{} MHz C0:{}% C1:{}%", cpu_freq, self.cpu0_usage, self.cpu1_usage);
-        if cpu_str != self.cached_cpu {
-            display.fill_rect(120, y_start + line_height * 2, 180, 16, BLACK)?;
-            display.draw_text(120, y_start + line_height * 2, &cpu_str, PRIMARY_GREEN, None, 1)?;
-            self.cached_cpu = cpu_str;
-        }
+        widgets.cpu.set_text(&format!("{} MHz C0:{}% C1:{}%", cpu_freq, self.cpu0_usage, self.cpu1_usage));
         
-        // Flash storage value (only update if changed)
+        // Flash storage value
         let (flash_total, app_size) = self.system_info.get_flash_info();
-        let flash_str = format!("{}/{}MB", app_size, flash_total);
-        if flash_str != self.cached_flash {
-            display.fill_rect(120, y_start + line_height * 3, 120, 16, BLACK)?;
-            display.draw_text(120, y_start + line_height * 3, &flash_str, PRIMARY_GREEN, None, 1)?;
-            self.cached_flash = flash_str;
-        }
+        widgets.flash.set_text(&format!("{}/{}MB", app_size, flash_total));
         
-        // Temperature value (only update if changed)
-        let temp_str = format!("{:.1}°C", self.sensor_data._temperature);
-        if temp_str != self.cached_temp {
-            display.fill_rect(120, y_start + line_height * 4, 120, 16, BLACK)?;
-            let temp_color = if self.sensor_data._temperature > 50.0 { PRIMARY_RED } 
-                            else if self.sensor_data._temperature > 40.0 { YELLOW } 
-                            else { PRIMARY_GREEN };
-            display.draw_text(120, y_start + line_height * 4, &temp_str, temp_color, None, 1)?;
-            self.cached_temp = temp_str;
-        }
+        // Temperature value
+        let temp_color = if self.sensor_data._temperature > 50.0 { PRIMARY_RED } 
+                        else if self.sensor_data._temperature > 40.0 { YELLOW } 
+                        else { PRIMARY_GREEN };
+        widgets.temperature.set_text(&format!("{:.1}°C", self.sensor_data._temperature));
+        widgets.temperature.set_color(temp_color);
         
         // PSRAM status (without DMA check since it's not available in this version)
         let psram_info = crate::psram::PsramAllocator::get_info();
-        let psram_str = if psram_info.available {
-            format!("{}MB free", psram_info.free_size / 1024 / 1024)
+        if psram_info.available {
+            widgets.psram.set_text(&format!("{}MB free", psram_info.free_size / 1024 / 1024));
+            widgets.psram.set_color(PRIMARY_GREEN);
         } else {
-            "Not available".to_string()
-        };
-        display.fill_rect(120, y_start + line_height * 5, 180, 16, BLACK)?;
-        let psram_color = if psram_info.available { PRIMARY_GREEN } else { YELLOW };
-        display.draw_text(120, y_start + line_height * 5, &psram_str, psram_color, None, 1)?;
-        
-        // Progress indicator (only update when progress changes)
-        let progress = (self.animation_progress * 100.0) as u8;
-        if progress != self.last_progress_value {
-            self.last_progress_value = progress;
-            display.draw_progress_bar(10, 138, 280, 8, progress, PRIMARY_GREEN, SURFACE_LIGHT, BORDER_COLOR)?;
+            widgets.psram.set_text("Not available");
+            widgets.psram.set_color(YELLOW);
         }
         
+        // Progress indicator
+        widgets.progress.set_value((self.animation_progress * 100.0) as u8);
+        
+        render_widgets(display, &mut widgets.widgets())?;
         Ok(())
     }
 
     fn render_network_screen(&mut self, display: &mut DisplayManager, screen_changed: bool) -> Result<()> {
+        let _span = crate::trace::span(crate::trace::RENDER_NETWORK);
+        let y_start = 38;
+        let line_height = 20;
         if screen_changed {
             // Clear screen
             display.clear(BLACK)?;
@@ -513,65 +602,58 @@ impl UiManager {
             display.fill_rect(0, 0, 300, 30, PRIMARY_PURPLE)?;
             display.draw_text_centered(8, "Network Status", WHITE, None, 2)?;
             
-            // Reset initialization
-            self.network_screen_initialized = false;
+            invalidate_widgets(&mut self.network_widgets.widgets());
+            self.network_widgets.section = None;
             
             // Static labels - consistent layout
-            let y_start = 38;
-            let line_height = 20;
             display.draw_text(10, y_start, "Status:", TEXT_PRIMARY, None, 1)?;
             display.draw_text(10, y_start + line_height, "SSID:", TEXT_PRIMARY, None, 1)?;
             display.draw_text(10, y_start + line_height * 2, "IP:", TEXT_PRIMARY, None, 1)?;
             display.draw_text(10, y_start + line_height * 3, "Signal:", TEXT_PRIMARY, None, 1)?;
-            
-            // Button hints
-            display.draw_text(10, 155, "[BOOT] Prev", TEXT_SECONDARY, None, 1)?;
-            display.draw_text(200, 155, "[USER] Next", TEXT_SECONDARY, None, 1)?;
         }
         
+        let widgets = &mut self.network_widgets;
+        
         // Update time in header (every 5 seconds)
         let current_seconds = self.system_info.get_uptime().as_secs();
         if current_seconds >= self.global_cached_time + 5 || screen_changed {
             self.global_cached_time = current_seconds;
-            display.fill_rect(240, 5, 75, 20, PRIMARY_PURPLE)?;
-            let time_str = self.system_info.format_uptime();
-            display.draw_text(245, 8, &time_str, WHITE, None, 1)?;
+            widgets.clock.set_text(&self.system_info.format_uptime());
         }
         
-        // Dynamic content - consistent spacing
-        let y_start = 38;
-        let line_height = 20;
-        let value_x = 65; // Better aligned position for values
-        
         // WiFi Status
-        display.fill_rect(value_x, y_start, 240, 16, BLACK)?;
-        let status_text = if self.network_connected { "Connected" } else { "Disconnected" };
-        let status_color = if self.network_connected { PRIMARY_GREEN } else { PRIMARY_RED };
-        display.draw_text(value_x, y_start, status_text, status_color, None, 1)?;
+        if self.network_connected {
+            widgets.status.set_text("Connected");
+            widgets.status.set_color(PRIMARY_GREEN);
+        } else {
+            widgets.status.set_text("Disconnected");
+            widgets.status.set_color(PRIMARY_RED);
+        }
         
         // SSID
-        display.fill_rect(value_x, y_start + line_height, 240, 16, BLACK)?;
-        let ssid_color = if self.network_connected { TEXT_PRIMARY } else { TEXT_SECONDARY };
-        display.draw_text(value_x, y_start + line_height, &self.network_ssid, ssid_color, None, 1)?;
+        widgets.ssid.set_text(&self.network_ssid);
+        widgets.ssid.set_color(if self.network_connected { TEXT_PRIMARY } else { TEXT_SECONDARY });
         
         // IP Address
-        let ip_y = y_start + line_height * 2;
-        display.fill_rect(value_x, ip_y, 200, 16, BLACK)?;
-        
-        if let Some(ref ip) = self.network_ip {
-            display.draw_text(value_x, ip_y, ip, TEXT_PRIMARY, None, 1)?;
-        } else if self.network_ssid.is_empty() || self.network_ssid == "Not connected" {
+        let configured = !(self.network_ssid.is_empty() || self.network_ssid == "Not connected");
+        match self.network_ip {
+            Some(ref ip) => {
+                widgets.ip.set_text(ip);
+                widgets.ip.set_color(TEXT_PRIMARY);
+            }
             // No WiFi credentials configured
-            display.draw_text(value_x, ip_y, "No WiFi Config", YELLOW, None, 1)?;
-        } else {
+            None if !configured => {
+                widgets.ip.set_text("No WiFi Config");
+                widgets.ip.set_color(YELLOW);
+            }
             // WiFi configured but no IP yet
-            display.draw_text(value_x, ip_y, "Obtaining IP...", YELLOW, None, 1)?;
+            None => {
+                widgets.ip.set_text("Obtaining IP...");
+                widgets.ip.set_color(YELLOW);
+            }
         }
         
         // Signal strength - just text, no graph
-        let signal_y = y_start + line_height * 3;
-        display.fill_rect(value_x, signal_y, 200, 16, BLACK)?;
-        
         if self.network_connected {
             let signal_quality = match self.network_signal {
                 -50..=0 => "Excellent",
@@ -589,43 +671,66 @@ impl UiManager {
                 _ => PRIMARY_RED
             };
             
-            display.draw_text(value_x, signal_y, &format!("{} dBm ({})", self.network_signal, signal_quality), signal_color, None, 1)?;
+            widgets.signal.set_text(&format!("{} dBm ({})", self.network_signal, signal_quality));
+            widgets.signal.set_color(signal_color);
         } else {
-            display.draw_text(value_x, signal_y, "No signal", TEXT_SECONDARY, None, 1)?;
+            widgets.signal.set_text("No signal");
+            widgets.signal.set_color(TEXT_SECONDARY);
+        }
+        
+        render_widgets(display, &mut widgets.widgets())?;
+        
+        // The section below the values only changes with the link itself
+        let section_current = widgets.section.as_ref()
+            .is_some_and(|drawn| drawn.matches(self.network_connected, &self.network_ip, &self.network_ssid));
+        if !section_current {
+            Self::draw_network_section(display, self.network_connected, configured,
+                                       &self.network_ip, &self.network_ssid)?;
+            invalidate_widgets(&mut widgets.details());
+            widgets.section = Some(LinkSnapshot {
+                connected: self.network_connected,
+                ip: self.network_ip.clone(),
+                ssid: self.network_ssid.clone(),
+            });
         }
         
         // Additional network information
         if self.network_connected {
-            let info_y = y_start + line_height * 4 + 5;
-            
-            // MAC Address
+            widgets.mac.set_text(&self.network_mac);
+            widgets.gateway.set_text(self.network_gateway.as_deref().unwrap_or("Not available"));
+            render_widgets(display, &mut widgets.details())?;
+        }
+        
+        Ok(())
+    }
+    
+    /// Static part of the network screen below the signal row
+    fn draw_network_section(display: &mut DisplayManager, connected: bool, configured: bool,
+                            ip: &Option<String>, ssid: &str) -> Result<()> {
+        let y_start = 38;
+        let line_height = 20;
+        let section_y = y_start + line_height * 4;
+        display.fill_rect(0, section_y, 300, 168 - section_y, BLACK)?;
+        
+        if connected {
+            let info_y = section_y + 5;
             display.draw_text(10, info_y, "MAC:", TEXT_PRIMARY, None, 1)?;
-            display.fill_rect(value_x, info_y, 240, 16, BLACK)?;
-            display.draw_text(value_x, info_y, &self.network_mac, TEXT_SECONDARY, None, 1)?;
-            
-            // Gateway
             display.draw_text(10, info_y + line_height, "Gateway:", TEXT_PRIMARY, None, 1)?;
-            display.fill_rect(value_x, info_y + line_height, 240, 16, BLACK)?;
-            if let Some(ref gateway) = self.network_gateway {
-                display.draw_text(value_x, info_y + line_height, gateway, TEXT_SECONDARY, None, 1)?;
-            } else {
-                display.draw_text(value_x, info_y + line_height, "Not available", TEXT_SECONDARY, None, 1)?;
-            }
             
             // Web interface section - ensure no overlap
             let web_section_y = info_y + line_height * 2 + 10; // Dynamic positioning
             display.draw_line(10, web_section_y - 5, 290, web_section_y - 5, BORDER_COLOR)?;
             
             display.draw_text_centered(web_section_y + 5, "Web Configuration", TEXT_SECONDARY, None, 1)?;
-            if let Some(ref ip) = self.network_ip {
+            if let Some(ref ip) = ip {
                 display.draw_text_centered(web_section_y + 20, &format!("http://{}", ip), PRIMARY_BLUE, None, 1)?;
             }
         } else {
             // Not connected - show help
-            let help_y = y_start + line_height * 4 + 10;
+            let help_y = section_y + 10;
             display.draw_line(10, help_y - 5, 290, help_y - 5, BORDER_COLOR)?;
             
-            if self.network_ssid.is_empty() || self.network_ssid == "Not connected" {
+            if !configured {
                 // No WiFi credentials
                 display.draw_text_centered(help_y + 10, "WiFi Not Configured", ACCENT_ORANGE, None, 1)?;
                 display.draw_text_centered(help_y + 28, "Edit wifi_config.h:", TEXT_PRIMARY, None, 1)?;
@@ -635,31 +740,20 @@ impl UiManager {
             } else {
                 // WiFi configured but not connected
                 display.draw_text_centered(help_y + 10, "WiFi Connection Failed", PRIMARY_RED, None, 1)?;
-                display.draw_text_centered(help_y + 28, &format!("SSID: {}", self.network_ssid), TEXT_SECONDARY, None, 1)?;
+                display.draw_text_centered(help_y + 28, &format!("SSID: {}", ssid), TEXT_SECONDARY, None, 1)?;
                 display.draw_text_centered(help_y + 42, "Check password & signal", TEXT_SECONDARY, None, 1)?;
                 display.draw_text_centered(help_y + 65, "Retrying connection...", TEXT_SECONDARY, None, 1)?;
             }
         }
         
-        // Mark screen as initialized
-        self.network_screen_initialized = true;
-        
+        // Button hints
+        display.draw_text(10, 155, "[BOOT] Prev", TEXT_SECONDARY, None, 1)?;
+        display.draw_text(200, 155, "[USER] Next", TEXT_SECONDARY, None, 1)?;
         Ok(())
     }
 
     fn render_sensor_screen(&mut self, display: &mut DisplayManager, screen_changed: bool) -> Result<()> {
-        // Early exit if nothing needs updating
-        if !screen_changed && self.sensor_screen_initialized &&
-           self.sensor_last_battery == self.sensor_data._battery_percentage &&
-           (self.sensor_last_temp - self.sensor_data._temperature).abs() < 0.5 &&
-           self.sensor_last_light == self.sensor_data._light_level {
-            return Ok(());
-        }
-        // Update cached values
-        self.sensor_last_battery = self.sensor_data._battery_percentage;
-        self.sensor_last_temp = self.sensor_data._temperature;
-        self.sensor_last_light = self.sensor_data._light_level;
-        
+        let _span = crate::trace::span(crate::trace::RENDER_SENSOR);
         // Only clear screen when switching to this screen
         if screen_changed {
             display.clear(BLACK)?;
@@ -671,6 +765,7 @@ impl UiManager {
             
             // Reset initialization
             self.sensor_screen_initialized = false;
+            invalidate_widgets(&mut self.sensor_widgets.widgets());
             
             // Static labels
             let y_start = 50;
@@ -687,9 +782,8 @@ impl UiManager {
         // Mark screen as initialized
         self.sensor_screen_initialized = true;
         
-        // Dynamic sensor values (only update if changed)
-        let y_start = 50;
-        let line_height = 30;
+        // Dynamic sensor values - widgets redraw only when their value changes
+        let widgets = &mut self.sensor_widgets;
         
         // Battery value and bar with voltage and charging status
         let battery_percent = self.sensor_data._battery_percentage;
@@ -703,64 +797,52 @@ impl UiManager {
                            else if battery_percent > 20 { YELLOW }
                            else { PRIMARY_RED };
         
-        // Draw progress bar
-        display.draw_progress_bar(100, y_start, 120, 15, battery_percent, battery_color, SURFACE_LIGHT, BORDER_COLOR)?;
+        widgets.battery_bar.set_value(battery_percent);
+        widgets.battery_bar.set_fill_color(battery_color);
+        widgets.battery_percent.set_text(&format!("{}%", battery_percent));
+        widgets.battery_percent.set_color(battery_color);
         
-        // Draw percentage and voltage
-        display.fill_rect(225, y_start, 70, 16, BLACK)?;
-        display.draw_text(225, y_start, &format!("{}%", battery_percent), battery_color, None, 1)?;
-        
-        // Draw voltage below percentage with debug info
-        display.fill_rect(100, y_start + 18, 195, 14, BLACK)?;
+        // Voltage below percentage with debug info
         if battery_voltage > 0 {
             // Show precise voltage for debugging
-            let voltage_str = format!("{:.3}V ({}mV)", battery_voltage as f32 / 1000.0, battery_voltage);
-            display.draw_text(100, y_start + 18, &voltage_str, TEXT_SECONDARY, None, 1)?;
+            widgets.voltage.set_text(&format!("{:.3}V ({}mV)", battery_voltage as f32 / 1000.0, battery_voltage));
             
             // Show charging/USB status
             if is_charging {
-                display.draw_text(210, y_start + 18, "CHG", PRIMARY_BLUE, None, 1)?;
+                widgets.power_source.set_text("CHG");
+                widgets.power_source.set_color(PRIMARY_BLUE);
             } else if is_on_usb {
-                display.draw_text(210, y_start + 18, "USB", ACCENT_ORANGE, None, 1)?;
+                widgets.power_source.set_text("USB");
+                widgets.power_source.set_color(ACCENT_ORANGE);
+            } else {
+                widgets.power_source.set_text("");
             }
         } else {
-            display.draw_text(100, y_start + 18, "No Battery", TEXT_SECONDARY, None, 1)?;
+            widgets.voltage.set_text("No Battery");
+            widgets.power_source.set_text("");
         }
         
+        // Temperature value
+        widgets.temperature.set_text(&format!("{:.1}°C", self.sensor_data._temperature));
         
-        // Temperature value (adjusted position due to battery info)
-        let temp_y = y_start + line_height + 5;
-        display.fill_rect(100, temp_y, 100, 20, BLACK)?;
-        display.draw_text(100, temp_y, &format!("{:.1}°C", self.sensor_data._temperature), TEXT_PRIMARY, None, 1)?;
-        
-        // Light level value (adjusted position)
-        let light_y = y_start + line_height * 2 + 5;
-        display.fill_rect(100, light_y, 100, 20, BLACK)?;
+        // Light level value
         if self.sensor_data._light_level > 0 {
-            display.draw_text(100, light_y, &format!("{} lux", self.sensor_data._light_level), TEXT_PRIMARY, None, 1)?;
+            widgets.light.set_text(&format!("{} lux", self.sensor_data._light_level));
+            widgets.light.set_color(TEXT_PRIMARY);
         } else {
-            display.draw_text(100, light_y, "N/A", TEXT_SECONDARY, None, 1)?;
+            widgets.light.set_text("N/A");
+            widgets.light.set_color(TEXT_SECONDARY);
         }
         
         // Visual indicator
-        let radius = 20;
-        let cx = 160;
-        let cy = 130;
-        display.draw_circle(cx, cy, radius, BORDER_COLOR)?;
-        let fill_radius = (radius as f32 * self.animation_progress) as u16;
-        if fill_radius > 0 {
-            display.fill_circle(cx, cy, fill_radius, PRIMARY_GREEN)?;
-        }
+        widgets.indicator.set_level(self.animation_progress);
         
+        render_widgets(display, &mut widgets.widgets())?;
         Ok(())
     }
 
     fn render_settings_screen(&mut self, display: &mut DisplayManager, screen_changed: bool) -> Result<()> {
-        // Early exit - settings screen is mostly static
-        if !screen_changed && self.settings_screen_initialized {
-            return Ok(());
-        }
-        
+        let _span = crate::trace::span(crate::trace::RENDER_SETTINGS);
         if screen_changed {
             // Clear screen only on screen change
             display.clear(BLACK)?;
@@ -770,8 +852,7 @@ impl UiManager {
             display.fill_rect(0, 0, 300, 30, ACCENT_ORANGE)?;
             display.draw_text_centered(8, "Settings", WHITE, None, 2)?;
             
-            // Reset initialization
-            self.settings_screen_initialized = false;
+            invalidate_widgets(&mut self.settings_widgets.widgets());
             
             // Settings options
             let y_start = 50;
@@ -788,48 +869,23 @@ impl UiManager {
             display.draw_text(200, 150, "[USER] Select", TEXT_SECONDARY, None, 1)?;
         }
         
-        // Dynamic values (always update)
-        let y_start = 50;
-        let line_height = 30;
-        
-        // Brightness bar and value
-        display.draw_progress_bar(120, y_start, 100, 15, 80, PRIMARY_BLUE, SURFACE_LIGHT, BORDER_COLOR)?;
-        display.draw_text(230, y_start, "80%", TEXT_PRIMARY, None, 1)?;
-        
-        // Auto-dim status
-        display.fill_rect(120, y_start + line_height, 60, 20, BLACK)?;
-        display.draw_text(120, y_start + line_height, "ON", PRIMARY_GREEN, None, 1)?;
-        
-        // Update speed
-        display.fill_rect(120, y_start + line_height * 2, 80, 20, BLACK)?;
-        display.draw_text(120, y_start + line_height * 2, "Normal", TEXT_PRIMARY, None, 1)?;
-        
-        // Version
-        display.fill_rect(120, y_start + line_height * 3, 100, 20, BLACK)?;
-        display.draw_text(120, y_start + line_height * 3, crate::version::DISPLAY_VERSION, TEXT_SECONDARY, None, 1)?;
-        
-        // Mark screen as initialized
-        self.settings_screen_initialized = true;
+        // Settings screen is mostly static; unchanged widgets draw nothing
+        let widgets = &mut self.settings_widgets;
+        widgets.brightness.set_value(80);
+        widgets.brightness_value.set_text("80%");
+        widgets.auto_dim.set_text("ON");
+        widgets.update_rate.set_text("Normal");
+        widgets.version.set_text(crate::version::DISPLAY_VERSION);
         
+        render_widgets(display, &mut widgets.widgets())?;
         Ok(())
     }
     
     fn render_ota_screen(&mut self, display: &mut DisplayManager, screen_changed: bool) -> Result<()> {
-        // Early exit if nothing needs updating
-        if !screen_changed && 
-           self.cached_ota_status_enum == Some(self.ota_status) &&
-           self.cached_network_ip == self.network_ip &&
-           self.ota_screen_initialized {
-            // Only update time every 5 seconds to reduce operations
-            let current_seconds = self.system_info.get_uptime().as_secs();
-            if current_seconds >= self.cached_ota_time + 5 {
-                self.cached_ota_time = current_seconds;
-                display.fill_rect(240, 5, 60, 20, ACCENT_ORANGE)?;
-                let time_str = self.system_info.format_uptime();
-                display.draw_text(245, 8, &time_str, WHITE, None, 1)?;
-            }
-            return Ok(());
-        }
+        let _span = crate::trace::span(crate::trace::RENDER_OTA);
+        // Main content area - adjusted spacing
+        let y_start = 36;
+        let line_height = 16;
         
         if screen_changed {
             // Clear screen
@@ -844,25 +900,9 @@ impl UiManager {
             display.draw_text(10, 155, "[BOOT] Prev", TEXT_SECONDARY, None, 1)?;
             display.draw_text(200, 155, "[USER] Check", TEXT_SECONDARY, None, 1)?;
             
-            // Reset initialization flag
-            self.ota_screen_initialized = false;
-        }
-        
-        // Update time on first render
-        if !self.ota_screen_initialized {
-            let current_seconds = self.system_info.get_uptime().as_secs();
-            self.cached_ota_time = current_seconds;
-            display.fill_rect(240, 5, 60, 20, ACCENT_ORANGE)?;
-            let time_str = self.system_info.format_uptime();
-            display.draw_text(245, 8, &time_str, WHITE, None, 1)?;
-        }
-        
-        // Main content area - adjusted spacing
-        let y_start = 36;
-        let line_height = 16;
-        
-        // Static content - only draw once
-        if !self.ota_screen_initialized || screen_changed {
+            invalidate_widgets(&mut self.ota_widgets.widgets());
+            self.ota_widgets.section = None;
+            
             // Current version info
             display.draw_text(10, y_start, "Firmware:", TEXT_PRIMARY, None, 1)?;
             display.draw_text(80, y_start, crate::version::DISPLAY_VERSION, PRIMARY_BLUE, None, 1)?;
@@ -879,84 +919,95 @@ impl UiManager {
             display.draw_line(10, base_server_y - 3, 290, base_server_y - 3, BORDER_COLOR)?;
         }
         
-        // OTA Status - only format and update if truly changed
-        let status_changed = self.cached_ota_status_enum != Some(self.ota_status);
-        if status_changed || !self.ota_screen_initialized {
-            self.cached_ota_status_enum = Some(self.ota_status);
-            
-            let (status_text, status_color) = match &self.ota_status {
-                OtaStatus::Idle => ("Ready", TEXT_SECONDARY),
-                OtaStatus::Downloading { progress } => {
-                    self.string_buffer.clear();
-                    use std::fmt::Write;
-                    let _ = write!(&mut self.string_buffer, "Downloading {}%", progress);
-                    (self.string_buffer.as_str(), PRIMARY_BLUE)
-                },
-                OtaStatus::Verifying => ("Verifying Update", YELLOW),
-                OtaStatus::Ready => ("Update Ready - Restart", PRIMARY_GREEN),
-                OtaStatus::Failed => ("Update Failed", PRIMARY_RED),
-            };
-            
-            display.fill_rect(80, y_start + line_height, 200, 16, BLACK)?;
-            display.draw_text(80, y_start + line_height, status_text, status_color, None, 1)?;
+        let widgets = &mut self.ota_widgets;
+        
+        // Only update time every 5 seconds to reduce operations
+        let current_seconds = self.system_info.get_uptime().as_secs();
+        if current_seconds >= self.global_cached_time + 5 || screen_changed {
+            self.global_cached_time = current_seconds;
+            widgets.clock.set_text(&self.system_info.format_uptime());
         }
         
-        // Progress bar - use fixed position to leverage caching
-        let progress_y = y_start + line_height * 2 + 4;
+        // OTA Status
+        let (status_text, status_color) = match &self.ota_status {
+            OtaStatus::Idle => ("Ready", TEXT_SECONDARY),
+            OtaStatus::Downloading { progress } => {
+                self.string_buffer.clear();
+                use std::fmt::Write;
+                let _ = write!(&mut self.string_buffer, "Downloading {}%", progress);
+                (self.string_buffer.as_str(), PRIMARY_BLUE)
+            },
+            OtaStatus::Verifying => ("Verifying Update", YELLOW),
+            OtaStatus::Ready => ("Update Ready - Restart", PRIMARY_GREEN),
+            OtaStatus::Failed => ("Update Failed", PRIMARY_RED),
+        };
+        widgets.status.set_text(status_text);
+        widgets.status.set_color(status_color);
+        
+        // Progress bar, cleared again when leaving the download
         if let OtaStatus::Downloading { progress } = self.ota_status {
-            display.draw_progress_bar(10, progress_y, 280, 10, progress, PRIMARY_BLUE, SURFACE_LIGHT, BORDER_COLOR)?;
-        } else if status_changed && matches!(self.cached_ota_status_enum, Some(OtaStatus::Downloading { .. })) {
-            // Clear progress bar area when transitioning away from downloading
-            display.fill_rect(10, progress_y, 280, 10, BLACK)?;
+            widgets.progress.set_value(progress);
+            widgets.progress.set_visible(true);
+        } else {
+            widgets.progress.set_visible(false);
+        }
+        
+        render_widgets(display, &mut widgets.widgets())?;
+        
+        // Network section - only redrawn when the link changes
+        let section_current = widgets.section.as_ref()
+            .is_some_and(|drawn| drawn.matches(self.network_connected, &self.network_ip, &self.network_ssid));
+        if !section_current {
+            Self::draw_ota_section(display, self.network_connected, &self.network_ip, &mut self.string_buffer)?;
+            widgets.section = Some(LinkSnapshot {
+                connected: self.network_connected,
+                ip: self.network_ip.clone(),
+                ssid: self.network_ssid.clone(),
+            });
         }
         
+        Ok(())
+    }
+    
+    /// Static endpoint list of the OTA screen for the current link
+    fn draw_ota_section(display: &mut DisplayManager, connected: bool, ip: &Option<String>,
+                        buffer: &mut String) -> Result<()> {
+        use std::fmt::Write;
         // Fixed server section position
-        let server_section_y = y_start + line_height * 2 + 24;
+        let server_section_y = 36 + 16 * 2 + 24;
         
-        // Network section - only update on actual changes
-        let network_changed = self.cached_network_ip != self.network_ip;
-        if network_changed || !self.ota_screen_initialized {
-            // Clear the entire network section area
-            display.fill_rect(10, server_section_y, 290, 80, BLACK)?;
-            
-            if self.network_connected {
-                display.draw_text_centered(server_section_y + 4, "OTA Endpoints", TEXT_SECONDARY, None, 1)?;
-                
-                if let Some(ref ip) = self.network_ip {
-                    self.cached_network_ip = Some(ip.clone());
-                    
-                    // Format endpoints using pre-allocated buffer
-                    let endpoint_y = server_section_y + 20;
-                    display.draw_text(10, endpoint_y, "Upload:", TEXT_PRIMARY, None, 1)?;
-                    
-                    self.string_buffer.clear();
-                    use std::fmt::Write;
-                    let _ = write!(&mut self.string_buffer, "http://{}:8080/ota", ip);
-                    display.draw_text(60, endpoint_y, &self.string_buffer, PRIMARY_BLUE, None, 1)?;
-                    
-                    let status_y = endpoint_y + 16;
-                    display.draw_text(10, status_y, "Status:", TEXT_PRIMARY, None, 1)?;
-                    
-                    self.string_buffer.clear();
-                    let _ = write!(&mut self.string_buffer, "http://{}:8080/api/ota/status", ip);
-                    display.draw_text(60, status_y, &self.string_buffer, PRIMARY_BLUE, None, 1)?;
-                    
-                    let guide_y = status_y + 20;
-                    display.draw_text_centered(guide_y, "Upload .bin file at OTA URL", TEXT_SECONDARY, None, 1)?;
-                    display.draw_text_centered(guide_y + 14, "Device auto-restarts after update", TEXT_SECONDARY, None, 1)?;
-                } else {
-                    self.cached_network_ip = None;
-                }
-            } else {
-                self.cached_network_ip = None;
-                display.draw_text_centered(server_section_y + 8, "Network Required", PRIMARY_RED, None, 1)?;
-                display.draw_text_centered(server_section_y + 24, "Connect to WiFi to enable OTA", TEXT_SECONDARY, None, 1)?;
-            }
+        // Clear the entire network section area
+        display.fill_rect(10, server_section_y, 290, 80, BLACK)?;
+        
+        if !connected {
+            display.draw_text_centered(server_section_y + 8, "Network Required", PRIMARY_RED, None, 1)?;
+            display.draw_text_centered(server_section_y + 24, "Connect to WiFi to enable OTA", TEXT_SECONDARY, None, 1)?;
+            return Ok(());
         }
         
-        // Mark screen as initialized
-        self.ota_screen_initialized = true;
+        display.draw_text_centered(server_section_y + 4, "OTA Endpoints", TEXT_SECONDARY, None, 1)?;
+        let Some(ip) = ip else {
+            return Ok(());
+        };
+        
+        // Format endpoints using pre-allocated buffer
+        let endpoint_y = server_section_y + 20;
+        display.draw_text(10, endpoint_y, "Upload:", TEXT_PRIMARY, None, 1)?;
+        
+        buffer.clear();
+        let _ = write!(buffer, "http://{}:8080/ota", ip);
+        display.draw_text(60, endpoint_y, buffer, PRIMARY_BLUE, None, 1)?;
+        
+        let status_y = endpoint_y + 16;
+        display.draw_text(10, status_y, "Status:", TEXT_PRIMARY, None, 1)?;
+        
+        buffer.clear();
+        let _ = write!(buffer, "http://{}:8080/api/ota/status", ip);
+        display.draw_text(60, status_y, buffer, PRIMARY_BLUE, None, 1)?;
         
+        let guide_y = status_y + 20;
+        display.draw_text_centered(guide_y, "Upload .bin file at OTA URL", TEXT_SECONDARY, None, 1)?;
+        display.draw_text_centered(guide_y + 14, "Device auto-restarts after update", TEXT_SECONDARY, None, 1)?;
         Ok(())
     }
     
@@ -1,7 +1,126 @@
-// Reusable UI widgets
+// Reusable retained-mode UI widgets
+//
+// A widget remembers the state it last drew. Setters mark it damaged only when
+// the bound value actually changes, and `render` redraws damaged widgets with
+// their bounds reported to the DirtyRectManager as one rect. A frame where no
+// value changed draws nothing and costs no bus time.
 
-use crate::display::{Display, Color};
-use crate::ui::theme::Theme;
+use anyhow::Result;
+use crate::display::{DisplayManager, DirtyRect, colors};
+use crate::display::font5x7::FONT_HEIGHT;
+
+pub trait Widget {
+    /// Screen area the widget owns
+    fn bounds(&self) -> DirtyRect;
+
+    fn is_damaged(&self) -> bool;
+
+    /// Force a redraw, e.g. after the screen has been cleared
+    fn invalidate(&mut self);
+
+    /// Draw the current state and clear the damage flag
+    fn draw(&mut self, display: &mut DisplayManager) -> Result<()>;
+
+    /// Draw only if damaged; returns whether anything was drawn
+    fn render(&mut self, display: &mut DisplayManager) -> Result<bool> {
+        if !self.is_damaged() {
+            return Ok(false);
+        }
+        let bounds = self.bounds();
+        display.draw_widget(bounds, |display| self.draw(display))?;
+        Ok(true)
+    }
+}
+
+/// Render every damaged widget; returns how many were drawn
+pub fn render_widgets(display: &mut DisplayManager, widgets: &mut [&mut dyn Widget]) -> Result<u32> {
+    let mut drawn = 0;
+    for widget in widgets.iter_mut() {
+        if widget.render(display)? {
+            drawn += 1;
+        }
+    }
+    Ok(drawn)
+}
+
+/// Mark every widget for redraw
+pub fn invalidate_widgets(widgets: &mut [&mut dyn Widget]) {
+    for widget in widgets.iter_mut() {
+        widget.invalidate();
+    }
+}
+
+/// Single line of opaque text in a fixed-width field
+pub struct Label {
+    x: u16,
+    y: u16,
+    width: u16,
+    scale: u8,
+    text: String,
+    color: u16,
+    background: u16,
+    damaged: bool,
+}
+
+impl Label {
+    pub fn new(x: u16, y: u16, width: u16, color: u16) -> Self {
+        Self {
+            x,
+            y,
+            width,
+            scale: 1,
+            text: String::new(),
+            color,
+            background: colors::BLACK,
+            damaged: true,
+        }
+    }
+
+    pub fn with_scale(mut self, scale: u8) -> Self {
+        self.scale = scale;
+        self
+    }
+
+    pub fn with_background(mut self, background: u16) -> Self {
+        self.background = background;
+        self
+    }
+
+    pub fn set_text(&mut self, text: &str) {
+        if self.text != text {
+            self.text.clear();
+            self.text.push_str(text);
+            self.damaged = true;
+        }
+    }
+
+    pub fn set_color(&mut self, color: u16) {
+        if self.color != color {
+            self.color = color;
+            self.damaged = true;
+        }
+    }
+}
+
+impl Widget for Label {
+    fn bounds(&self) -> DirtyRect {
+        DirtyRect::new(self.x, self.y, self.width, (FONT_HEIGHT * self.scale) as u16)
+    }
+
+    fn is_damaged(&self) -> bool {
+        self.damaged
+    }
+
+    fn invalidate(&mut self) {
+        self.damaged = true;
+    }
+
+    fn draw(&mut self, display: &mut DisplayManager) -> Result<()> {
+        self.damaged = false;
+        display.draw_text_field(self.x, self.y, self.width, &self.text, self.color,
+                                self.background, self.scale)
+    }
+}
 
 pub struct ProgressBar {
     x: u16,
@@ -10,6 +129,12 @@ pub struct ProgressBar {
     height: u16,
     value: u8,
     max: u8,
+    fill_color: u16,
+    background: u16,
+    border_color: u16,
+    // A hidden bar draws as cleared screen
+    visible: bool,
+    damaged: bool,
 }
 
 impl ProgressBar {
@@ -21,76 +146,204 @@ impl ProgressBar {
             height,
             value: 0,
             max: 100,
+            fill_color: colors::PRIMARY_GREEN,
+            background: colors::SURFACE_LIGHT,
+            border_color: colors::BORDER_COLOR,
+            visible: true,
+            damaged: true,
         }
     }
-    
+
     pub fn set_value(&mut self, value: u8) {
-        self.value = value.min(self.max);
-    }
-    
-    pub fn draw(&self, display: &mut Display, theme: &Theme) {
-        // Draw border
-        display.draw_rect(self.x, self.y, self.width, self.height, theme.colors.border);
-        
-        // Draw fill
-        let fill_width = ((self.width - 2) * self.value as u16) / self.max as u16;
-        if fill_width > 0 {
-            display.fill_rect(
-                self.x + 1,
-                self.y + 1,
-                fill_width,
-                self.height - 2,
-                theme.colors.accent,
-            );
+        let value = value.min(self.max);
+        if self.value != value {
+            self.value = value;
+            self.damaged = true;
+        }
+    }
+
+    pub fn set_fill_color(&mut self, color: u16) {
+        if self.fill_color != color {
+            self.fill_color = color;
+            self.damaged = true;
+        }
+    }
+
+    pub fn set_visible(&mut self, visible: bool) {
+        if self.visible != visible {
+            self.visible = visible;
+            self.damaged = true;
         }
     }
 }
 
-pub struct Button {
+impl Widget for ProgressBar {
+    fn bounds(&self) -> DirtyRect {
+        DirtyRect::new(self.x, self.y, self.width, self.height)
+    }
+
+    fn is_damaged(&self) -> bool {
+        self.damaged
+    }
+
+    fn invalidate(&mut self) {
+        self.damaged = true;
+    }
+
+    fn draw(&mut self, display: &mut DisplayManager) -> Result<()> {
+        self.damaged = false;
+        if !self.visible {
+            return display.fill_rect(self.x, self.y, self.width, self.height, colors::BLACK);
+        }
+        let percent = (self.value as u16 * 100 / self.max.max(1) as u16) as u8;
+        display.draw_progress_bar(self.x, self.y, self.width, self.height, percent,
+                                  self.fill_color, self.background, self.border_color)
+    }
+}
+
+/// Circle outline with a filled disc sized by a 0.0-1.0 level
+pub struct CircleGauge {
+    cx: u16,
+    cy: u16,
+    radius: u16,
+    fill_radius: u16,
+    // Radius currently on screen; larger means the disc must be erased first
+    drawn_radius: u16,
+    color: u16,
+    outline_color: u16,
+    damaged: bool,
+}
+
+impl CircleGauge {
+    pub fn new(cx: u16, cy: u16, radius: u16, color: u16) -> Self {
+        Self {
+            cx,
+            cy,
+            radius,
+            fill_radius: 0,
+            drawn_radius: 0,
+            color,
+            outline_color: colors::BORDER_COLOR,
+            damaged: true,
+        }
+    }
+
+    pub fn set_level(&mut self, level: f32) {
+        // Quantized to whole pixels so sub-pixel changes cost nothing
+        let fill_radius = (self.radius as f32 * level.clamp(0.0, 1.0)) as u16;
+        if self.fill_radius != fill_radius {
+            self.fill_radius = fill_radius;
+            self.damaged = true;
+        }
+    }
+}
+
+impl Widget for CircleGauge {
+    fn bounds(&self) -> DirtyRect {
+        DirtyRect::new(self.cx.saturating_sub(self.radius), self.cy.saturating_sub(self.radius),
+                       self.radius * 2 + 1, self.radius * 2 + 1)
+    }
+
+    fn is_damaged(&self) -> bool {
+        self.damaged
+    }
+
+    fn invalidate(&mut self) {
+        // Screen was cleared underneath
+        self.drawn_radius = 0;
+        self.damaged = true;
+    }
+
+    fn draw(&mut self, display: &mut DisplayManager) -> Result<()> {
+        self.damaged = false;
+        if self.fill_radius < self.drawn_radius {
+            display.fill_circle(self.cx, self.cy, self.drawn_radius, colors::BLACK)?;
+        }
+        self.drawn_radius = self.fill_radius;
+        display.draw_circle(self.cx, self.cy, self.radius, self.outline_color)?;
+        if self.fill_radius > 0 {
+            display.fill_circle(self.cx, self.cy, self.fill_radius, self.color)?;
+        }
+        Ok(())
+    }
+}
+
+/// Header battery icon with percentage, and voltage while charging
+pub struct BatteryIndicator {
     x: u16,
     y: u16,
-    width: u16,
-    height: u16,
-    label: &'static str,
-    selected: bool,
+    background: u16,
+    percent: u8,
+    charging: bool,
+    on_usb: bool,
+    // Tenths of a volt, the resolution shown
+    decivolts: u16,
+    damaged: bool,
 }
 
-impl Button {
-    pub fn new(x: u16, y: u16, width: u16, height: u16, label: &'static str) -> Self {
+impl BatteryIndicator {
+    const WIDTH: u16 = 95;
+    const HEIGHT: u16 = 20;
+
+    pub fn new(x: u16, y: u16, background: u16) -> Self {
         Self {
             x,
             y,
-            width,
-            height,
-            label,
-            selected: false,
+            background,
+            percent: 0,
+            charging: false,
+            on_usb: false,
+            decivolts: 0,
+            damaged: true,
         }
     }
-    
-    pub fn set_selected(&mut self, selected: bool) {
-        self.selected = selected;
+
+    pub fn set_state(&mut self, percent: u8, charging: bool, on_usb: bool, millivolts: u16) {
+        let decivolts = millivolts.saturating_add(50) / 100;
+        // The voltage is only on screen while charging
+        let voltage_changed = charging && self.decivolts != decivolts;
+        if self.percent != percent || self.charging != charging || self.on_usb != on_usb || voltage_changed {
+            self.percent = percent;
+            self.charging = charging;
+            self.on_usb = on_usb;
+            self.decivolts = decivolts;
+            self.damaged = true;
+        }
     }
-    
-    pub fn draw(&self, display: &mut Display, theme: &Theme) {
-        let bg_color = if self.selected {
-            theme.colors.accent
-        } else {
-            theme.colors.surface
-        };
-        
-        let text_color = if self.selected {
-            Color::BLACK
+}
+
+impl Widget for BatteryIndicator {
+    fn bounds(&self) -> DirtyRect {
+        DirtyRect::new(self.x, self.y, Self::WIDTH, Self::HEIGHT)
+    }
+
+    fn is_damaged(&self) -> bool {
+        self.damaged
+    }
+
+    fn invalidate(&mut self) {
+        self.damaged = true;
+    }
+
+    fn draw(&mut self, display: &mut DisplayManager) -> Result<()> {
+        self.damaged = false;
+        display.fill_rect(self.x, self.y, Self::WIDTH, Self::HEIGHT, self.background)?;
+        display.draw_battery_icon(self.x + 5, self.y + 2, self.percent, self.charging, 1)?;
+
+        let color = if self.charging { colors::WHITE }
+                    else if self.percent > 50 { colors::PRIMARY_GREEN }
+                    else if self.percent > 20 { colors::YELLOW }
+                    else { colors::PRIMARY_RED };
+        if self.on_usb && !self.charging && self.percent == 0 {
+            display.draw_text(self.x + 35, self.y + 3, "USB", color, None, 1)?;
         } else {
-            theme.colors.text_primary
-        };
-        
-        // Draw button background
-        display.fill_rect(self.x, self.y, self.width, self.height, bg_color);
-        display.draw_rect(self.x, self.y, self.width, self.height, theme.colors.border);
-        
-        // Center text
-        let text_x = self.x + (self.width / 2) - (self.label.len() as u16 * 3);
-        let text_y = self.y + (self.height / 2) - 4;
-        display.draw_text(text_x, text_y, self.label, text_color);
-    }
-}
\ No newline at end of file
+            display.draw_text(self.x + 35, self.y + 3, &format!("{}%", self.percent), color, None, 1)?;
+        }
+
+        if self.charging {
+            display.draw_text(self.x + 65, self.y + 3, &format!("{}.{}V", self.decivolts / 10, self.decivolts % 10),
+                              colors::TEXT_SECONDARY, None, 1)?;
+        }
+        Ok(())
+    }
+}